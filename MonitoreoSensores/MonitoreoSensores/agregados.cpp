@@ -0,0 +1,189 @@
+/**
+ * @file agregados.cpp
+ * @autores Juan Pablo Hernández Ceballos
+ * Implementa los agregados por minuto y por hora de las mediciones de un canal.
+ */
+
+#include "agregados.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include "utilidades.h"
+
+// Acumula una medición en la cubeta.
+void Cubeta::agregar(double valor) {
+    if (cantidad == 0 || valor < minimo) {
+        minimo = valor;
+    }
+    if (cantidad == 0 || valor > maximo) {
+        maximo = valor;
+    }
+    suma += valor;
+    cantidad++;
+    boceto.agregar(valor);
+}
+
+// Combina con la cubeta otra línea de la misma cubeta (o de otro sensor, al sumar sensores).
+void Cubeta::combinar(const Cubeta& otra) {
+    if (otra.cantidad == 0) {
+        return;
+    }
+    if (cantidad == 0 || otra.minimo < minimo) {
+        minimo = otra.minimo;
+    }
+    if (cantidad == 0 || otra.maximo > maximo) {
+        maximo = otra.maximo;
+    }
+    suma += otra.suma;
+    cantidad += otra.cantidad;
+    boceto.combinar(otra.boceto);
+}
+
+/**
+ * Archivo de agregados de un nivel: la ruta del canal seguida del nombre del nivel (`pH-data.txt.1m`).
+ *
+ * @param ruta Archivo de salida del canal, o directorio de sus segmentos.
+ * @param nivel Índice en NIVELES_AGREGADO.
+ */
+std::string rutaAgregados(const std::string& ruta, int nivel) {
+    return rutaJunto(ruta, NIVELES_AGREGADO[nivel].nombre);
+}
+
+/**
+ * @param ruta Archivo de salida del canal, o directorio de sus segmentos.
+ * @param anillo Anillo de io_uring del hilo de persistencia (nullptr para el motor clásico).
+ * @param sincronizar Sincronizar los archivos (fdatasync) tras cada escritura.
+ */
+Agregados::Agregados(const std::string& ruta, AnilloEscritura* anillo, bool sincronizar)
+    : ruta(ruta), proximoCierre(std::numeric_limits<std::time_t>::max()) {
+    for (int n = 0; n < NUM_NIVELES_AGREGADO; ++n) {
+        archivos[n].reset(new Sumidero(anillo, sincronizar));
+    }
+}
+
+/**
+ * Abre los archivos de agregados en modo de anexado.
+ *
+ * @return false si alguno no se pudo abrir.
+ */
+bool Agregados::abrir() {
+    for (int n = 0; n < NUM_NIVELES_AGREGADO; ++n) {
+        std::string destino = rutaAgregados(ruta, n);
+        if (!archivos[n]->abrir(destino.c_str(), true)) {
+            std::cerr << "Error: No se pudo abrir el archivo: " << destino << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Acumula una medición escrita en la cubeta de su sensor en cada nivel.
+ *
+ * @param lectura Medición escrita en el archivo de salida.
+ */
+void Agregados::agregar(const Lectura& lectura) {
+    for (int n = 0; n < NUM_NIVELES_AGREGADO; ++n) {
+        int64_t segundos = NIVELES_AGREGADO[n].segundos;
+        int64_t numero = lectura.evento() / segundos;
+        Cubeta& cubeta = abiertas[n][(static_cast<uint64_t>(lectura.sensor) << 32) | static_cast<uint32_t>(numero)];
+        if (cubeta.cantidad == 0) {
+            cubeta.inicio = numero * segundos;
+            cubeta.sensor = lectura.sensor;
+            std::time_t cierre = cubeta.inicio + segundos + GRACIA_AGREGADOS_S;
+            if (cierre < proximoCierre) {
+                proximoCierre = cierre;
+            }
+        }
+        cubeta.agregar(lectura.numero);
+    }
+}
+
+/**
+ * Escribe y descarta las cubetas cuyo fin, más la gracia, ya pasó. No hace nada antes del próximo cierre,
+ * así que puede llamarse después de cada lote.
+ *
+ * @param ahora Hora actual, o la marca de agua del canal si se reordena por hora del evento.
+ */
+void Agregados::cerrarVencidas(std::time_t ahora) {
+    if (ahora < proximoCierre) {
+        return;
+    }
+    proximoCierre = std::numeric_limits<std::time_t>::max();
+    for (int n = 0; n < NUM_NIVELES_AGREGADO; ++n) {
+        int64_t espera = NIVELES_AGREGADO[n].segundos + GRACIA_AGREGADOS_S;
+        for (auto cubeta = abiertas[n].begin(); cubeta != abiertas[n].end();) {
+            if (cubeta->second.inicio + espera <= ahora) {
+                escribir(n, cubeta->second);
+                cubeta = abiertas[n].erase(cubeta);
+                continue;
+            }
+            if (cubeta->second.inicio + espera < proximoCierre) {
+                proximoCierre = cubeta->second.inicio + espera;
+            }
+            ++cubeta;
+        }
+        archivos[n]->presentar(); // Una escritura por nivel con todas las cubetas cerradas
+    }
+    for (int n = 0; n < NUM_NIVELES_AGREGADO; ++n) {
+        archivos[n]->vaciar(); // Con io_uring, el primero envía las de todos los niveles en una sola llamada
+    }
+}
+
+/**
+ * Escribe las cubetas abiertas y cierra los archivos. Una cubeta que sigue al reiniciar queda en dos líneas.
+ */
+void Agregados::cerrar() {
+    for (int n = 0; n < NUM_NIVELES_AGREGADO; ++n) {
+        for (const auto& cubeta : abiertas[n]) {
+            escribir(n, cubeta.second);
+        }
+        abiertas[n].clear();
+        archivos[n]->cerrar();
+    }
+}
+
+// Agrega la línea de una cubeta al bloque del archivo de su nivel.
+void Agregados::escribir(int nivel, const Cubeta& cubeta) {
+    char resumen[160];
+    int largo = snprintf(resumen, sizeof(resumen), "%lld %u %llu %.9g %.9g %.17g",
+                         static_cast<long long>(cubeta.inicio), cubeta.sensor,
+                         static_cast<unsigned long long>(cubeta.cantidad), cubeta.minimo, cubeta.maximo, cubeta.suma);
+    std::string linea(resumen, largo);
+    cubeta.boceto.escribir(linea);
+    linea += '\n';
+    archivos[nivel]->agregar(linea.data(), linea.size());
+}
+
+/**
+ * Lee las líneas de un archivo de agregados. Las líneas mal formadas (por ejemplo, una última línea
+ * incompleta tras una caída) se ignoran.
+ *
+ * @param ruta Archivo de agregados.
+ * @param visitar Recibe cada línea.
+ * @return false si el archivo no se pudo abrir.
+ */
+bool leerAgregados(const std::string& ruta, const std::function<void(const Cubeta&)>& visitar) {
+    std::ifstream archivo(ruta);
+    if (!archivo.is_open()) {
+        return false;
+    }
+    std::string linea;
+    while (std::getline(archivo, linea)) {
+        Cubeta cubeta;
+        long long inicio;
+        unsigned long long cantidad;
+        int leido = 0;
+        if (sscanf(linea.c_str(), "%lld %u %llu %lf %lf %lf%n", &inicio, &cubeta.sensor, &cantidad, &cubeta.minimo,
+                   &cubeta.maximo, &cubeta.suma, &leido) != 6 || archivo.eof() ||
+            !cubeta.boceto.leer(linea.c_str() + leido)) {
+            continue; // Sin el salto de línea final, la línea puede estar cortada
+        }
+        cubeta.inicio = inicio;
+        cubeta.cantidad = cantidad;
+        visitar(cubeta);
+    }
+    return true;
+}
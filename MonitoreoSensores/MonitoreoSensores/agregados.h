@@ -0,0 +1,89 @@
+/**
+ * @file agregados.h
+ * @autores Juan Pablo Hernández Ceballos
+ * Agregados por minuto y por hora de las mediciones de un canal.
+ *
+ * El hilo de persistencia acumula cada medición escrita en la cubeta de su sensor, por minuto y por
+ * hora del evento (la hora de la fuente o, si no la envía, la de recepción), y al cerrarse cada cubeta
+ * agrega una línea a su archivo de agregados (`ruta.1m` y `ruta.1h` junto al archivo o directorio del
+ * canal):
+ *
+ *     inicio sensor cantidad minimo maximo suma contenedores...
+ *
+ * con `inicio` en segundos desde el epoch y, al final, el boceto de cuantiles de la cubeta (ver
+ * boceto.h), que permite estimar percentiles de cualquier rango sin volver a los datos crudos. Una
+ * cubeta se cierra unos segundos después de su fin (según el reloj o, con reordenamiento, según la marca
+ * de agua del canal), para esperar a las mediciones que llegan por otro recolector; si llega una
+ * medición más tarde, o el monitor se reinicia dentro de la misma cubeta, la cubeta aparece en más de
+ * una línea y quien la lee las combina. Los archivos de agregados no se rotan ni se borran: ocupan del
+ * orden de cien kilobytes por sensor y día en el nivel por minuto y unos pocos en el nivel por hora, así
+ * que sobreviven a la retención de los datos crudos.
+ */
+
+#ifndef AGREGADOS_H
+#define AGREGADOS_H
+
+#include <cstdint>
+#include <ctime>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include "boceto.h"
+#include "lectura.h"
+#include "motor_es.h"
+
+/**
+ * Nivel de agregación.
+ */
+struct NivelAgregado {
+    const char* nombre;  ///< Sufijo del archivo y nombre en la línea de comandos
+    int64_t segundos;    ///< Duración de cada cubeta
+};
+
+const int NUM_NIVELES_AGREGADO = 2;                               ///< Niveles que se mantienen
+const NivelAgregado NIVELES_AGREGADO[NUM_NIVELES_AGREGADO] = {{"1m", 60}, {"1h", 3600}};  ///< Por minuto y por hora
+const int64_t GRACIA_AGREGADOS_S = 2;                             ///< Segundos que se espera tras el fin de una cubeta
+
+/**
+ * Resumen de las mediciones de un sensor en una cubeta. Los resúmenes se combinan sumando cantidades,
+ * sumas y bocetos y tomando el menor mínimo y el mayor máximo.
+ */
+struct Cubeta {
+    int64_t inicio = 0;      ///< Primer segundo de la cubeta (desde el epoch)
+    uint32_t sensor = 0;     ///< Sensor de las mediciones
+    uint64_t cantidad = 0;   ///< Mediciones acumuladas
+    double minimo = 0;       ///< Menor valor
+    double maximo = 0;       ///< Mayor valor
+    double suma = 0;         ///< Suma de los valores
+    Boceto boceto;           ///< Distribución de los valores
+
+    void agregar(double valor);
+    void combinar(const Cubeta& otra);
+};
+
+/**
+ * Agregados de un canal. Los usa solo el hilo de persistencia.
+ */
+class Agregados {
+public:
+    Agregados(const std::string& ruta, AnilloEscritura* anillo, bool sincronizar);
+
+    bool abrir();
+    void agregar(const Lectura& lectura);
+    void cerrarVencidas(std::time_t ahora);
+    void cerrar();
+
+private:
+    void escribir(int nivel, const Cubeta& cubeta);
+
+    std::string ruta;                                         ///< Archivo o directorio del canal
+    std::unique_ptr<Sumidero> archivos[NUM_NIVELES_AGREGADO]; ///< Archivo de cada nivel
+    std::unordered_map<uint64_t, Cubeta> abiertas[NUM_NIVELES_AGREGADO];  ///< Cubetas abiertas por sensor y número
+    std::time_t proximoCierre;                                ///< Antes de esta hora no vence ninguna cubeta
+};
+
+std::string rutaAgregados(const std::string& ruta, int nivel);
+bool leerAgregados(const std::string& ruta, const std::function<void(const Cubeta&)>& visitar);
+
+#endif //AGREGADOS_H
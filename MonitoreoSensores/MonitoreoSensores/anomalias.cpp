@@ -0,0 +1,272 @@
+/**
+ * @file anomalias.cpp
+ * @autores Juan Pablo Hernández Ceballos
+ * Implementa los detectores de anomalías por sensor y el guardado de su estado.
+ */
+
+#include "anomalias.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include "utilidades.h"
+
+namespace {
+
+const char* const FIRMA_ESTADO = "ANOMALIAS1";  ///< Primera línea del archivo de estado
+
+// Incorpora el promedio de una hora terminada a la línea base de su hora del día.
+void cerrarHora(EstadoAnomalias& estado) {
+    if (estado.cuentaHora > 0) {
+        estado.horas[estado.horaDelDia].agregar(estado.sumaHora / estado.cuentaHora, ALFA_ESTACIONAL);
+    }
+    estado.sumaHora = 0;
+    estado.cuentaHora = 0;
+}
+
+} // namespace
+
+/**
+ * Incorpora un valor. Las primeras `1 / alfa` veces pesa cada valor por igual (media y varianza
+ * acumuladas), para que las estadísticas sean útiles desde el principio.
+ *
+ * @param x Valor.
+ * @param alfa Peso de cada valor una vez pasado el arranque.
+ */
+void Estadistica::agregar(double x, double alfa) {
+    double a = std::max(alfa, 1.0 / static_cast<double>(n + 1));
+    double diferencia = x - media;
+    media += a * diferencia;
+    varianza = (1 - a) * (varianza + a * diferencia * diferencia);
+    n++;
+}
+
+/**
+ * Archivo de estado de los detectores: la ruta del canal seguida de `.anomalias`.
+ *
+ * @param ruta Archivo de salida del canal, o directorio de sus segmentos.
+ */
+std::string rutaAnomalias(const std::string& ruta) {
+    return rutaJunto(ruta, "anomalias");
+}
+
+/**
+ * @return Nombre del detector para las alertas y las métricas.
+ */
+const char* nombreAnomalia(TipoAnomalia tipo) {
+    switch (tipo) {
+        case ANOMALIA_Z:
+            return "z";
+        case ANOMALIA_ESTACIONAL:
+            return "estacional";
+        case ANOMALIA_CUSUM:
+            return "cusum";
+        default:
+            return "ninguna";
+    }
+}
+
+/**
+ * @param ruta Archivo de salida del canal, o directorio de sus segmentos.
+ * @param resolucion Menor diferencia significativa entre dos mediciones del canal; la desviación nunca
+ *                   se toma menor, para que un sensor muy estable no alerte por un cambio mínimo.
+ */
+DetectorAnomalias::DetectorAnomalias(const std::string& ruta, double resolucion)
+    : ruta(rutaAnomalias(ruta)), resolucion(resolucion) {
+    pthread_mutex_init(&mutex, NULL);
+}
+
+DetectorAnomalias::~DetectorAnomalias() {
+    pthread_mutex_destroy(&mutex);
+}
+
+/**
+ * Carga el estado guardado. Sin archivo no hay nada que cargar; las líneas mal formadas se ignoran.
+ *
+ * @return false si el archivo existe pero no es un archivo de estado.
+ */
+bool DetectorAnomalias::cargar() {
+    std::ifstream archivo(ruta);
+    if (!archivo.is_open()) {
+        return true;
+    }
+    std::string linea;
+    if (!std::getline(archivo, linea) || linea != FIRMA_ESTADO) {
+        std::cerr << "Error: El archivo de estado de anomalías no es válido: " << ruta << std::endl;
+        return false;
+    }
+    while (std::getline(archivo, linea)) {
+        std::istringstream campos(linea);
+        uint32_t sensor;
+        EstadoAnomalias estado;
+        campos >> sensor >> estado.general.n >> estado.general.media >> estado.general.varianza >> estado.cusumAlto >>
+            estado.cusumBajo >> estado.hora >> estado.horaDelDia >> estado.sumaHora >> estado.cuentaHora;
+        for (Estadistica& hora : estado.horas) {
+            campos >> hora.n >> hora.media >> hora.varianza;
+        }
+        if (!campos.fail() && estado.horaDelDia >= 0 && estado.horaDelDia < 24) {
+            estados[sensor] = estado;
+        }
+    }
+    return true;
+}
+
+/**
+ * Evalúa una medición válida con los detectores de su sensor y la incorpora a su estado.
+ *
+ * @param lectura Medición.
+ * @param puntaje Recibe el puntaje z de la medición (respecto de su hora del día si esa fue la anomalía).
+ * @return El detector que encontró una anomalía nueva, o ANOMALIA_NINGUNA.
+ */
+TipoAnomalia DetectorAnomalias::evaluar(const Lectura& lectura, double& puntaje) {
+    EstadoAnomalias& estado = estados[lectura.sensor];
+    double x = lectura.numero;
+
+    // Al empezar otra hora, la anterior pasa a la línea base de su hora del día
+    std::time_t evento = lectura.evento();
+    int64_t hora = evento / 3600;
+    if (hora > estado.hora) {
+        cerrarHora(estado);
+        struct tm local;
+        localtime_r(&evento, &local); // Solo una vez por hora y sensor
+        estado.hora = hora;
+        estado.horaDelDia = local.tm_hour;
+    }
+
+    // Puntajes respecto de la media móvil y de la hora del día
+    TipoAnomalia candidata = ANOMALIA_NINGUNA; // Puntaje z alto, pendiente de confirmación
+    bool corrimiento = false;                  // La CUSUM está sobre su umbral
+    double desviacion = std::max(std::sqrt(estado.general.varianza), resolucion);
+    puntaje = 0;
+    if (estado.general.n >= CALENTAMIENTO_ANOMALIAS) {
+        double z = (x - estado.general.media) / desviacion;
+        double acotado = std::max(-UMBRAL_Z_ANOMALIAS, std::min(UMBRAL_Z_ANOMALIAS, z)); // Una muestra no basta
+        estado.cusumAlto = std::min(2 * UMBRAL_CUSUM, std::max(0.0, estado.cusumAlto + acotado - HOLGURA_CUSUM));
+        estado.cusumBajo = std::min(2 * UMBRAL_CUSUM, std::max(0.0, estado.cusumBajo - acotado - HOLGURA_CUSUM));
+        corrimiento = estado.cusumAlto > UMBRAL_CUSUM || estado.cusumBajo > UMBRAL_CUSUM;
+        puntaje = z;
+        if (std::fabs(z) > UMBRAL_Z_ANOMALIAS) {
+            candidata = ANOMALIA_Z;
+        } else {
+            const Estadistica& base = estado.horas[estado.horaDelDia];
+            if (base.n >= CALENTAMIENTO_ESTACIONAL) {
+                double zHora = (x - base.media) / std::sqrt(base.varianza + desviacion * desviacion);
+                if (std::fabs(zHora) > UMBRAL_Z_ANOMALIAS) {
+                    candidata = ANOMALIA_ESTACIONAL;
+                    puntaje = zHora;
+                }
+            }
+        }
+
+        // Los valores anómalos entran recortados, para no arrastrar la línea base
+        x = std::max(estado.general.media - UMBRAL_Z_ANOMALIAS * desviacion,
+                     std::min(estado.general.media + UMBRAL_Z_ANOMALIAS * desviacion, x));
+    }
+    estado.general.agregar(x, ALFA_ANOMALIAS);
+    estado.sumaHora += x;
+    estado.cuentaHora++;
+
+    // Confirmación y un solo aviso por episodio: el episodio dura mientras haya puntajes altos o la
+    // CUSUM siga sobre su umbral (saturada, baja en cuanto la media vuelve a su nivel o se adapta)
+    estado.seguidas = candidata != ANOMALIA_NINGUNA ? estado.seguidas + 1 : 0;
+    TipoAnomalia encontrada = ANOMALIA_NINGUNA;
+    if (candidata != ANOMALIA_NINGUNA && estado.seguidas >= CONFIRMACION_ANOMALIAS) {
+        encontrada = candidata;
+    } else if (corrimiento) {
+        encontrada = ANOMALIA_CUSUM;
+    }
+    if (encontrada == ANOMALIA_NINGUNA) {
+        if (candidata == ANOMALIA_NINGUNA) {
+            estado.informado = false;
+        }
+        return ANOMALIA_NINGUNA;
+    }
+    if (estado.informado) {
+        return ANOMALIA_NINGUNA;
+    }
+    estado.informado = true;
+    return encontrada;
+}
+
+/**
+ * Publica una instantánea del estado si pasó el intervalo de guardado. Se llama después de cada lote.
+ *
+ * @param ahora Hora actual.
+ */
+void DetectorAnomalias::publicarSiToca(std::time_t ahora) {
+    if (ahora < proximoGuardado) {
+        return;
+    }
+    if (proximoGuardado != 0) {
+        publicar();
+    }
+    proximoGuardado = ahora + INTERVALO_ESTADO_ANOMALIAS_S;
+}
+
+/**
+ * Copia el estado de todos los sensores a la instantánea que guardará el hilo de persistencia, en lugar de
+ * la anterior si aún no se guardó. La copia reutiliza la memoria de las instantáneas anteriores.
+ */
+void DetectorAnomalias::publicar() {
+    pthread_mutex_lock(&mutex);
+    publicada.assign(estados.begin(), estados.end());
+    pendiente.store(true, std::memory_order_release);
+    pthread_mutex_unlock(&mutex);
+}
+
+/**
+ * Guarda la instantánea publicada, si hay una. La llama el hilo de persistencia después de cada lote, así
+ * que sin instantánea nueva solo lee un indicador.
+ *
+ * @return false si no se pudo escribir.
+ */
+bool DetectorAnomalias::guardarPublicado() {
+    if (!pendiente.load(std::memory_order_acquire)) {
+        return true;
+    }
+    pthread_mutex_lock(&mutex);
+    guardada.swap(publicada); // La memoria de la anterior queda para la próxima publicación
+    pendiente.store(false, std::memory_order_relaxed);
+    pthread_mutex_unlock(&mutex);
+    return guardar(guardada);
+}
+
+/**
+ * Guarda una instantánea del estado. Escribe un archivo temporal y lo renombra, de modo que una caída a
+ * mitad deja el estado anterior.
+ *
+ * @param estado Estado de cada sensor.
+ * @return false si no se pudo escribir.
+ */
+bool DetectorAnomalias::guardar(const Instantanea& estado) {
+    std::string temporal = ruta + ".tmp";
+    std::ofstream archivo(temporal, std::ios::trunc);
+    archivo << FIRMA_ESTADO << '\n';
+    char campo[64];
+    for (const auto& entrada : estado) {
+        const EstadoAnomalias& estado = entrada.second;
+        archivo << entrada.first << ' ' << estado.general.n;
+        for (double valor : {estado.general.media, estado.general.varianza, estado.cusumAlto, estado.cusumBajo}) {
+            snprintf(campo, sizeof(campo), " %.17g", valor);
+            archivo << campo;
+        }
+        snprintf(campo, sizeof(campo), " %lld %d %.17g %llu", static_cast<long long>(estado.hora), estado.horaDelDia,
+                 estado.sumaHora, static_cast<unsigned long long>(estado.cuentaHora));
+        archivo << campo;
+        for (const Estadistica& hora : estado.horas) {
+            snprintf(campo, sizeof(campo), " %llu %.17g %.17g", static_cast<unsigned long long>(hora.n), hora.media,
+                     hora.varianza);
+            archivo << campo;
+        }
+        archivo << '\n';
+    }
+    archivo.close();
+    if (archivo.fail() || rename(temporal.c_str(), ruta.c_str()) < 0) {
+        std::cerr << "Error: No se pudo guardar el estado de anomalías: " << ruta << std::endl;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,121 @@
+/**
+ * @file anomalias.h
+ * @autores Juan Pablo Hernández Ceballos
+ * Detección de anomalías en línea por sensor, además de las bandas fijas de alerta.
+ *
+ * Por cada sensor se mantienen, en memoria constante y con trabajo constante por medición:
+ * - una media y una varianza móviles exponenciales (EWMA), con las que se calcula el puntaje z de cada
+ *   medición;
+ * - dos sumas acumuladas (CUSUM) del puntaje z, hacia arriba y hacia abajo, que detectan corrimientos
+ *   pequeños y sostenidos que no llegan a disparar el puntaje z;
+ * - una línea base estacional: la media de cada hora del día, aprendida de un día a otro con el
+ *   promedio de cada hora del evento.
+ *
+ * Un puntaje z (general o respecto de la hora del día) solo cuenta como anomalía si se repite en
+ * CONFIRMACION_ANOMALIAS mediciones seguidas del sensor, de modo que una muestra ruidosa aislada no
+ * genera alertas; la CUSUM ya acumula varias mediciones (cada una aporta a lo más UMBRAL_Z_ANOMALIAS) y
+ * se informa al cruzar su umbral. Cada episodio se informa una sola vez: termina con una medición normal
+ * y la CUSUM de nuevo bajo su umbral. Los valores anómalos entran recortados
+ * a las estadísticas, para que una ráfaga no desplace la línea base.
+ *
+ * El estado aprendido se guarda cada minuto y al terminar en un archivo de texto (`ruta.anomalias`
+ * junto a la salida del canal), y se vuelve a cargar al iniciar, así que un reinicio no empieza de cero.
+ * El hilo de evaluación solo copia el estado a una instantánea; la escribe el hilo de persistencia, de
+ * modo que el disco nunca demora las alertas.
+ */
+
+#ifndef ANOMALIAS_H
+#define ANOMALIAS_H
+
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+#include <pthread.h>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "lectura.h"
+
+const double ALFA_ANOMALIAS = 0.02;             ///< Peso de cada medición en la media y varianza móviles
+const double ALFA_ESTACIONAL = 0.2;             ///< Peso de cada día en la media de una hora del día
+const uint64_t CALENTAMIENTO_ANOMALIAS = 50;    ///< Mediciones antes de evaluar el puntaje z
+const uint64_t CALENTAMIENTO_ESTACIONAL = 3;    ///< Días antes de evaluar la línea base de una hora
+const double UMBRAL_Z_ANOMALIAS = 4.0;          ///< Puntaje z a partir del cual una medición es anómala
+const double HOLGURA_CUSUM = 0.5;               ///< Corrimiento (en desviaciones) que la CUSUM tolera
+const double UMBRAL_CUSUM = 10.0;               ///< Suma acumulada que indica un corrimiento
+const uint32_t CONFIRMACION_ANOMALIAS = 3;      ///< Mediciones anómalas seguidas para informar un puntaje z
+const int INTERVALO_ESTADO_ANOMALIAS_S = 60;    ///< Segundos entre guardados del estado
+
+/**
+ * Detector que encontró la anomalía.
+ */
+enum TipoAnomalia {
+    ANOMALIA_NINGUNA,     ///< Medición normal (o episodio ya informado)
+    ANOMALIA_Z,           ///< Lejos de la media móvil
+    ANOMALIA_ESTACIONAL,  ///< Lejos de la media de su hora del día
+    ANOMALIA_CUSUM        ///< Corrimiento sostenido de la media
+};
+
+/**
+ * Media y varianza móviles exponenciales.
+ */
+struct Estadistica {
+    uint64_t n = 0;          ///< Valores incorporados
+    double media = 0;        ///< Media móvil
+    double varianza = 0;     ///< Varianza móvil
+
+    void agregar(double x, double alfa);
+};
+
+/**
+ * Estado aprendido de un sensor.
+ */
+struct EstadoAnomalias {
+    Estadistica general;            ///< Media y varianza de todas las mediciones
+    Estadistica horas[24];          ///< Media y varianza de los promedios de cada hora del día
+    double cusumAlto = 0;           ///< Suma acumulada de los corrimientos hacia arriba
+    double cusumBajo = 0;           ///< Suma acumulada de los corrimientos hacia abajo
+    int64_t hora = -1;              ///< Hora en curso (horas desde el epoch; -1 = ninguna)
+    int horaDelDia = 0;             ///< Hora del día local de la hora en curso
+    double sumaHora = 0;            ///< Suma de las mediciones de la hora en curso
+    uint64_t cuentaHora = 0;        ///< Mediciones de la hora en curso
+    uint32_t seguidas = 0;          ///< Mediciones anómalas seguidas (no se guarda)
+    bool informado = false;         ///< El episodio en curso ya se informó (no se guarda)
+};
+
+/**
+ * Detectores de anomalías de los sensores de un canal. Evalúa y publica instantáneas solo el hilo de
+ * evaluación del canal; las guarda solo el hilo de persistencia.
+ */
+class DetectorAnomalias {
+public:
+    DetectorAnomalias(const std::string& ruta, double resolucion);
+    ~DetectorAnomalias();
+
+    bool cargar();
+    TipoAnomalia evaluar(const Lectura& lectura, double& puntaje);
+    void publicarSiToca(std::time_t ahora);
+    void publicar();
+    bool guardarPublicado();
+
+private:
+    typedef std::vector<std::pair<uint32_t, EstadoAnomalias>> Instantanea;  ///< Copia del estado de cada sensor
+
+    bool guardar(const Instantanea& estado);
+
+    std::string ruta;          ///< Archivo del estado
+    double resolucion;         ///< Desviación mínima (la resolución de las mediciones del canal)
+    std::unordered_map<uint32_t, EstadoAnomalias> estados;  ///< Estado de cada sensor
+    std::time_t proximoGuardado = 0;  ///< Hora de la próxima instantánea periódica
+
+    pthread_mutex_t mutex;                 ///< Protege la instantánea publicada
+    Instantanea publicada;                 ///< Última instantánea publicada y aún no guardada
+    std::atomic<bool> pendiente{false};    ///< Hay una instantánea publicada sin guardar
+    Instantanea guardada;                  ///< Instantánea que escribe el hilo de persistencia (reutilizada)
+};
+
+std::string rutaAnomalias(const std::string& ruta);
+const char* nombreAnomalia(TipoAnomalia tipo);
+
+#endif //ANOMALIAS_H
@@ -0,0 +1,591 @@
+/**
+ * @file archivos_salida.cpp
+ * @autores Juan Pablo Hernández Ceballos
+ * Implementa los archivos de salida de un canal, sin segmentar o con un segmento por sensor y día, y su rotación.
+ */
+
+#include "archivos_salida.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "agregados.h"
+#include "clasificacion.h"
+#include "reorden.h"
+#include "utilidades.h"
+
+Segmento::Segmento(AnilloEscritura* anillo, bool sincronizar) : archivo(anillo, sincronizar) {
+}
+
+/**
+ * @param canal Canal de las mediciones.
+ * @param ruta Archivo de salida del canal o, segmentado, directorio de sus segmentos.
+ * @param segmentar true para escribir un archivo por sensor y día.
+ * @param rotacion Cuándo se sellan los archivos.
+ * @param anillo Anillo de io_uring del hilo de persistencia (nullptr para el motor clásico).
+ * @param sincronizar Sincronizar cada archivo (fdatasync) tras cada lote.
+ * @param wal WAL de las mediciones (nullptr si está desactivado).
+ */
+ArchivosSalida::ArchivosSalida(Canal canal, const std::string& ruta, bool segmentar, const Rotacion& rotacion,
+                               AnilloEscritura* anillo, bool sincronizar, Wal* wal)
+    : canal(canal), ruta(ruta), segmentar(segmentar), rotacion(rotacion), anillo(anillo), sincronizar(sincronizar),
+      wal(wal), rutaTardias(rutaJunto(ruta, "tardias")) {
+}
+
+/**
+ * Crea el directorio de los segmentos si hace falta. Sin segmentar no hace nada.
+ *
+ * @return false si el directorio no existe y no se pudo crear.
+ */
+bool ArchivosSalida::preparar() {
+    if (!segmentar) {
+        return true;
+    }
+    struct stat info;
+    if (mkdir(ruta.c_str(), 0755) < 0 && (errno != EEXIST || stat(ruta.c_str(), &info) < 0 || !S_ISDIR(info.st_mode))) {
+        std::cerr << "Error: No se pudo crear el directorio de salida: " << ruta << std::endl;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Ruta del archivo que recibe una medición. Segmentado, también calcula el día local del evento.
+ *
+ * @param sensor Sensor de la medición.
+ * @param evento Hora del evento (la de la fuente o, si no la envía, la de recepción).
+ * @param inicio Recibe el primer segundo del día (puede ser nullptr).
+ * @param fin Recibe el primer segundo del día siguiente (puede ser nullptr).
+ */
+std::string ArchivosSalida::rutaDe(uint32_t sensor, std::time_t evento, std::time_t* inicio, std::time_t* fin) const {
+    if (!segmentar) {
+        return ruta;
+    }
+    std::tm dia;
+    localtime_r(&evento, &dia);
+    dia.tm_hour = dia.tm_min = dia.tm_sec = 0;
+    dia.tm_isdst = -1; // mktime resuelve el horario de verano de cada límite
+    std::tm limite = dia;
+    if (inicio != nullptr) {
+        *inicio = mktime(&limite);
+    }
+    limite = dia;
+    limite.tm_mday++;
+    if (fin != nullptr) {
+        *fin = mktime(&limite);
+    }
+    char nombre[48];
+    snprintf(nombre, sizeof(nombre), "/%u-%04d%02d%02d.txt", sensor, dia.tm_year + 1900, dia.tm_mon + 1, dia.tm_mday);
+    return ruta + nombre;
+}
+
+/**
+ * Reenvía a los archivos de salida las mediciones del WAL que no alcanzaron a escribirse antes de una caída.
+ *
+ * Recorta cada archivo (y la salida de tardías) al tamaño registrado en su punto de control, lo que descarta
+ * una última línea incompleta y cualquier línea escrita después de él, y luego agrega los registros del
+ * canal que no cubre su corte, ordenados por hora del evento. Así cada medición queda en su archivo
+ * exactamente una vez, incluidas las que el reordenamiento retenía al caer.
+ * Las mediciones reenviadas se acumulan también en los agregados del canal, como las que se escriben
+ * en marcha; se escriben cuando el hilo de persistencia cierre sus cubetas. Las que quedan fuera del
+ * rango válido vigente no se reenvían, igual que en marcha: solo avanzan el punto de control.
+ *
+ * @param agregados Agregados del canal.
+ * @param limites Límites vigentes del canal.
+ * @return true si los archivos quedaron al día y sus puntos de control registrados.
+ */
+bool ArchivosSalida::recuperar(Agregados& agregados, const LimitesCanal& limites) {
+    // Agrupar por archivo los registros del canal que no cubre su corte
+    std::map<std::string, std::vector<const Wal::Registro*>> porArchivo;
+    std::map<std::string, Wal::PuntoControl> puntos;
+    Wal::Corte corte = wal->corte(canal);
+    Wal::PuntoControl puntoTardias = wal->puntoControl(rutaTardias);
+    struct stat info;
+    if (puntoTardias.existe && stat(rutaTardias.c_str(), &info) == 0 &&
+        static_cast<uint64_t>(info.st_size) > puntoTardias.offset && truncate(rutaTardias.c_str(), puntoTardias.offset) < 0) {
+        std::cerr << "Error: No se pudo recortar el archivo: " << rutaTardias << std::endl;
+        return false;
+    }
+    recibido = corte.lsn;
+    uint64_t fueraDeRango = 0;
+    if (!segmentar) {
+        porArchivo[ruta]; // El archivo único siempre queda registrado, aunque no haya nada que reenviar
+    }
+    for (const Wal::Registro& registro : wal->registros()) {
+        if (registro.canal != canal) {
+            continue;
+        }
+        recibido = std::max(recibido, registro.lsn);
+        std::string destino = rutaDe(registro.sensor, registro.evento / 1000, nullptr, nullptr);
+        if (corte.existe) {
+            if (registro.lsn <= corte.lsn && horaOrden(registro.evento, registro.recepcion) <= corte.marca) {
+                continue; // Ya está en su archivo o en la salida de tardías
+            }
+        } else { // Puntos guardados sin corte: cada archivo cubre hasta su LSN
+            auto punto = puntos.find(destino);
+            if (punto == puntos.end()) {
+                punto = puntos.emplace(destino, wal->puntoControl(destino)).first;
+            }
+            if (registro.lsn <= punto->second.lsn) {
+                continue;
+            }
+        }
+        float valor = canal == CANAL_PH ? std::stof(registro.valor) : static_cast<float>(std::stoi(registro.valor));
+        uint64_t invalida, alerta;
+        clasificarLote(&valor, 1, limites, &invalida, &alerta); // Como la evaluación en marcha
+        if (invalida != 0) {
+            fueraDeRango++;
+            continue;
+        }
+        porArchivo[destino].push_back(&registro);
+    }
+    if (fueraDeRango > 0) {
+        std::cout << "Descartadas " << fueraDeRango << " mediciones del WAL fuera del rango de " << NOMBRE_CANAL[canal]
+                  << std::endl;
+    }
+
+    for (auto& archivo : porArchivo) {
+        const char* destino = archivo.first.c_str();
+        std::stable_sort(archivo.second.begin(), archivo.second.end(),
+                         [](const Wal::Registro* a, const Wal::Registro* b) { return a->evento < b->evento; });
+        Wal::PuntoControl punto = wal->puntoControl(archivo.first);
+        if (punto.existe && stat(destino, &info) == 0 && static_cast<uint64_t>(info.st_size) > punto.offset) {
+            if (truncate(destino, punto.offset) < 0) { // Descartar lo escrito después del punto de control
+                std::cerr << "Error: No se pudo recortar el archivo: " << destino << std::endl;
+                return false;
+            }
+        }
+
+        std::ofstream file(destino, std::ios::app);
+        if (!file.is_open()) {
+            std::cerr << "Error: No se pudo abrir el archivo: " << destino << std::endl;
+            return false;
+        }
+        uint64_t ultimoLsn = punto.lsn;
+        Lectura lectura;
+        lectura.canal = canal;
+        for (const Wal::Registro* registro : archivo.second) {
+            lectura.sensor = registro->sensor;
+            lectura.recepcion = registro->recepcion;
+            lectura.desfaseEvento = static_cast<int32_t>(registro->evento - registro->recepcion * 1000);
+            if (canal == CANAL_PH) {
+                lectura.numero = std::stof(registro->valor);
+                file << static_cast<float>(lectura.numero);
+            } else {
+                lectura.numero = std::stoi(registro->valor);
+                file << static_cast<int>(lectura.numero);
+            }
+            file << " " << formatearHora(lectura.evento()) << "\n";
+            agregados.agregar(lectura);
+            ultimoLsn = std::max(ultimoLsn, registro->lsn);
+        }
+        file.close();
+        if (!archivo.second.empty()) {
+            std::cout << "Recuperadas " << archivo.second.size() << " mediciones del WAL en " << destino << std::endl;
+        }
+
+        if (stat(destino, &info) < 0) {
+            std::cerr << "Error: No se pudo consultar el archivo: " << destino << std::endl;
+            return false;
+        }
+        if (!wal->registrarPunto(canal, archivo.first, ultimoLsn, static_cast<uint64_t>(info.st_size))) {
+            return false;
+        }
+    }
+
+    // Todo lo recibido del canal quedó en algún archivo
+    std::vector<std::pair<std::string, uint64_t>> archivos;
+    if (puntoTardias.existe) {
+        archivos.emplace_back(rutaTardias, stat(rutaTardias.c_str(), &info) == 0 ? info.st_size : 0);
+    }
+    Wal::Corte nuevo;
+    nuevo.lsn = recibido;
+    return wal->registrarCorte(canal, archivos, nuevo, UINT64_MAX);
+}
+
+// Abre un segmento y lo guarda bajo su clave. Con el WAL, registra un punto de control para un archivo
+// nuevo: todo lo anterior a `lsn` ya está en él, así que la recuperación no lo vuelve a escribir.
+Segmento* ArchivosSalida::abrirSegmento(const Clave& clave, const std::string& rutaArchivo, std::time_t fin,
+                                        uint64_t lsn) {
+    std::unique_ptr<Segmento> segmento(new Segmento(anillo, sincronizar));
+    segmento->ruta = rutaArchivo;
+    segmento->sensor = clave.first;
+    segmento->inicioDia = clave.second;
+    segmento->finDia = fin;
+    segmento->apertura = std::time(nullptr);
+    if (!segmento->archivo.abrir(rutaArchivo.c_str(), true)) {
+        std::cerr << "Error: No se pudo abrir el archivo: " << rutaArchivo << std::endl;
+        return nullptr;
+    }
+    if (wal != nullptr) {
+        Wal::PuntoControl punto = wal->puntoControl(rutaArchivo);
+        if (punto.existe) {
+            segmento->lsnPunto = punto.lsn;
+        } else if (lsn > 0) {
+            segmento->lsnPunto = lsn - 1;
+            wal->registrarPunto(canal, rutaArchivo, segmento->lsnPunto, segmento->archivo.posicion());
+        }
+    }
+    Segmento* abierto = segmento.get();
+    segmentos[clave] = std::move(segmento);
+    return abierto;
+}
+
+/**
+ * Abre el archivo único del canal, en modo de anexado. Segmentado, los archivos se abren a medida que
+ * llegan mediciones de cada sensor y día.
+ *
+ * @return false si no se pudo abrir.
+ */
+bool ArchivosSalida::abrir() {
+    return segmentar || abrirSegmento(Clave(0, 0), ruta, 0, 0) != nullptr;
+}
+
+/**
+ * Conecta la salida de tardías del canal, abierta después de la recuperación. Sin ella (sin reordenamiento),
+ * no se desvía ninguna medición.
+ *
+ * @param salida Salida de tardías.
+ */
+void ArchivosSalida::desviarA(Sumidero* salida) {
+    tardias = salida;
+}
+
+/**
+ * Devuelve el archivo que recibe una medición, abriéndolo si hace falta, y anota su LSN para el
+ * siguiente punto de control. Al cambiar el día de un sensor, su segmento anterior queda por cerrar.
+ *
+ * @param lectura Medición por escribir (o descartada por la evaluación, que igual avanza el punto de control).
+ * @return El archivo, o nullptr si no se pudo abrir.
+ */
+Segmento* ArchivosSalida::destino(const Lectura& lectura) {
+    Segmento* segmento;
+    if (!segmentar) {
+        segmento = segmentos.begin()->second.get();
+    } else {
+        Segmento*& actual = actuales[lectura.sensor];
+        std::time_t evento = lectura.evento();
+        if (actual == nullptr || evento < actual->inicioDia || evento >= actual->finDia) {
+            std::time_t inicio, fin;
+            std::string rutaArchivo = rutaDe(lectura.sensor, evento, &inicio, &fin);
+            auto existente = segmentos.find(Clave(lectura.sensor, inicio));
+            segmento = existente != segmentos.end()
+                           ? existente->second.get()
+                           : abrirSegmento(Clave(lectura.sensor, inicio), rutaArchivo, fin, lectura.lsn);
+            if (segmento == nullptr) {
+                return nullptr;
+            }
+            if (actual != nullptr) {
+                vencidos.push_back(Clave(actual->sensor, actual->inicioDia));
+            }
+            actual = segmento;
+        }
+        segmento = actual;
+    }
+    if (wal != nullptr) {
+        if (segmento->ultimoLsn == 0) {
+            sucios.push_back(segmento);
+        }
+        recibido = std::max(recibido, lectura.lsn);
+        segmento->ultimoLsn = std::max(segmento->ultimoLsn, lectura.lsn); // Con reordenamiento no llegan en orden
+    }
+    return segmento;
+}
+
+// Agrega una línea al bloque de un archivo; se escribe con el resto del lote.
+void ArchivosSalida::agregar(Segmento* segmento, const char* linea, size_t largo) {
+    if (segmento->lineas++ == 0) {
+        pendientes.push_back(segmento);
+    }
+    segmento->archivo.agregar(linea, largo);
+}
+
+/**
+ * Agrega una medición tardía al bloque de la salida de tardías y, con el WAL, la anota para el siguiente
+ * corte. Una medición descartada por la evaluación (sin línea) solo se anota.
+ *
+ * @param lectura Medición tardía.
+ * @param linea Línea de la salida de tardías.
+ * @param largo Largo de la línea (0 si no se escribe).
+ */
+void ArchivosSalida::desviar(const Lectura& lectura, const char* linea, size_t largo) {
+    if (largo > 0) {
+        tardias->agregar(linea, largo);
+    }
+    if (wal != nullptr) {
+        recibido = std::max(recibido, lectura.lsn);
+        tardiasSucias = true;
+    }
+}
+
+/**
+ * Archivos con líneas sin escribir. Quien los escribe llama después a terminarLote().
+ */
+std::vector<Segmento*>& ArchivosSalida::conLineas() {
+    return pendientes;
+}
+
+/**
+ * Cambia los límites de la rotación. Se aplican desde el lote siguiente; los archivos ya abiertos
+ * conservan su hora de apertura.
+ *
+ * @param nueva Límites nuevos.
+ */
+void ArchivosSalida::cambiarRotacion(const Rotacion& nueva) {
+    rotacion = nueva;
+}
+
+/**
+ * Indica lo que el hilo de persistencia retiene para reordenar por hora del evento: el corte registrado
+ * lleva la marca de agua, porque lo escrito ya no es un prefijo de los LSN, y el WAL conserva desde el LSN
+ * retenido más bajo.
+ *
+ * @param lsn LSN retenido más bajo (UINT64_MAX si no se retiene ninguno).
+ * @param marcaAgua Marca de agua del canal: todo lo recibido con hora de orden hasta aquí ya salió (ms).
+ */
+void ArchivosSalida::retener(uint64_t lsn, int64_t marcaAgua) {
+    lsnRetenido = lsn;
+    marca = marcaAgua;
+}
+
+/**
+ * Cierra el lote ya escrito y sella los archivos que pasaron del tamaño o de la antigüedad de la rotación.
+ */
+void ArchivosSalida::terminarLote() {
+    std::time_t ahora = rotacion.segundos > 0 ? std::time(nullptr) : 0;
+    size_t restantes = 0;
+    for (Segmento* segmento : pendientes) {
+        if (segmento->archivo.pendiente() > 0) { // La escritura falló: sus líneas se reintentan en el lote siguiente
+            pendientes[restantes++] = segmento;
+            continue;
+        }
+        segmento->lineas = 0;
+        if ((rotacion.bytes > 0 && segmento->archivo.posicion() >= rotacion.bytes) ||
+            (rotacion.segundos > 0 && ahora - segmento->apertura >= rotacion.segundos)) {
+            sellar(segmento, true);
+        }
+    }
+    pendientes.resize(restantes);
+}
+
+// Registra en el WAL, de una sola vez, el punto de control de los archivos con mediciones nuevas (y de la salida
+// de tardías) junto con el corte del canal: el mayor LSN recibido y la marca de agua. Antes vacía cada archivo;
+// si alguno no se puede vaciar no registra nada y todos siguen pendientes, así que el punto de control nunca
+// cubre bytes que no llegaron al archivo.
+bool ArchivosSalida::registrarPuntos() {
+    if (sucios.empty() && !tardiasSucias) {
+        return true;
+    }
+    for (Segmento* segmento : sucios) {
+        segmento->archivo.presentar(); // Con io_uring, todos se escriben con una sola llamada
+    }
+    if (tardias != nullptr) {
+        tardias->presentar();
+    }
+    bool correcto = true;
+    for (Segmento* segmento : sucios) {
+        if (!segmento->archivo.vaciar()) { // Vaciar el archivo antes de registrar su tamaño
+            std::cerr << "Error: No se pudo escribir el archivo: " << segmento->ruta << ": " << strerror(errno)
+                      << std::endl;
+            correcto = false;
+        }
+    }
+    if (tardias != nullptr && !tardias->vaciar()) {
+        std::cerr << "Error: No se pudo escribir la salida de tardías: " << strerror(errno) << std::endl;
+        correcto = false;
+    }
+    if (!correcto) {
+        return false;
+    }
+    porRegistrar.clear();
+    for (const Segmento* segmento : sucios) {
+        porRegistrar.emplace_back(segmento->ruta, segmento->archivo.posicion());
+    }
+    if (tardias != nullptr) {
+        porRegistrar.emplace_back(rutaTardias, tardias->posicion());
+    }
+    Wal::Corte corte;
+    corte.lsn = recibido;
+    corte.marca = marca;
+    if (!wal->registrarCorte(canal, porRegistrar, corte, lsnRetenido)) {
+        return false;
+    }
+    for (Segmento* segmento : sucios) {
+        segmento->lsnPunto = recibido;
+        segmento->ultimoLsn = 0;
+    }
+    sucios.clear();
+    tardiasSucias = false;
+    return true;
+}
+
+/**
+ * Sella el archivo activo de un segmento: lo renombra con la hora de rotación y, si se pide, abre uno
+ * nuevo con el mismo nombre. Con el WAL, el punto de control del archivo nuevo empieza en cero con el
+ * LSN del sellado, así que la recuperación nunca reenvía al archivo nuevo lo que quedó en el sellado.
+ *
+ * @param segmento Segmento a sellar; su archivo está vacío de líneas pendientes.
+ * @param reabrir true para seguir escribiendo en un archivo nuevo.
+ * @return false si no se pudo sellar o reabrir.
+ */
+bool ArchivosSalida::sellar(Segmento* segmento, bool reabrir) {
+    // El archivo queda cubierto por su punto de control antes de renombrarlo
+    if ((wal != nullptr && !registrarPuntos()) || segmento->archivo.pendiente() > 0) {
+        return false; // Se sella en un lote posterior, cuando se pueda escribir
+    }
+    bool vacio = segmento->archivo.posicion() == 0;
+    segmento->archivo.cerrar();
+    if (vacio && !reabrir) {
+        return true; // Nada que sellar
+    }
+    bool sellado = false;
+    if (!vacio) {
+        std::string sellada = rutaSellada(segmento->ruta, std::time(nullptr));
+        sellado = rename(segmento->ruta.c_str(), sellada.c_str()) == 0;
+        if (!sellado) {
+            std::cerr << "Error: No se pudo sellar el archivo: " << segmento->ruta << std::endl;
+        } else if (wal != nullptr) {
+            wal->registrarPunto(canal, segmento->ruta, segmento->lsnPunto, 0);
+        }
+    }
+    if (!reabrir) {
+        return sellado;
+    }
+    segmento->apertura = std::time(nullptr);
+    if (!segmento->archivo.abrir(segmento->ruta.c_str(), true)) {
+        std::cerr << "Error: No se pudo abrir el archivo: " << segmento->ruta << std::endl;
+        return false;
+    }
+    return sellado;
+}
+
+/**
+ * Registra en el WAL hasta qué medición llegó cada archivo y cierra los segmentos de días anteriores
+ * (sellándolos, si se pidió).
+ *
+ * Cada archivo se vacía antes de registrar su tamaño, de modo que el punto de control nunca apunta a
+ * datos que aún están en memoria.
+ *
+ * @return false si algún archivo no se pudo escribir o su punto de control no se pudo guardar.
+ */
+bool ArchivosSalida::registrarAvance() {
+    bool correcto = wal == nullptr || registrarPuntos();
+    size_t restantes = 0;
+    for (const Clave& clave : vencidos) {
+        auto segmento = segmentos.find(clave);
+        if (segmento != segmentos.end() && actuales[clave.first] != segmento->second.get()) {
+            if (segmento->second->ultimoLsn != 0) {
+                vencidos[restantes++] = clave; // Aún falta registrar su punto: se cierra más adelante
+                continue;
+            }
+            if (!segmento->second->archivo.vaciar()) {
+                correcto = false;
+                vencidos[restantes++] = clave; // Aún falta escribirlo: se cierra más adelante
+                continue;
+            }
+            if (rotacion.sellarDias) { // El sensor ya escribe en otro día
+                sellar(segmento->second.get(), false);
+            }
+            segmento->second->archivo.cerrar();
+            segmentos.erase(segmento);
+        }
+    }
+    vencidos.resize(restantes);
+    return correcto;
+}
+
+/**
+ * Escribe y sincroniza con el disco todos los archivos abiertos, aunque no se haya pedido sincronizar
+ * cada lote (lo usa la orden `vaciar` del socket de control). Con io_uring, las escrituras y las
+ * sincronizaciones de todos los archivos se envían con una sola llamada.
+ *
+ * @return false si algún archivo no se pudo escribir o sincronizar.
+ */
+bool ArchivosSalida::sincronizarTodo() {
+    for (auto& segmento : segmentos) {
+        segmento.second->archivo.presentar(true);
+    }
+    bool correcto = true;
+    for (auto& segmento : segmentos) {
+        Sumidero& archivo = segmento.second->archivo;
+        correcto = archivo.vaciar() && archivo.sincronizarDatos() && correcto;
+    }
+    return correcto;
+}
+
+/**
+ * Registra el avance pendiente y cierra todos los archivos.
+ *
+ * @return false si algo no se pudo escribir; su punto de control queda atrás y la recuperación lo reenvía.
+ */
+bool ArchivosSalida::cerrar() {
+    bool correcto = registrarAvance();
+    for (auto& segmento : segmentos) {
+        correcto = segmento.second->archivo.pendiente() == 0 && correcto;
+        segmento.second->archivo.cerrar();
+    }
+    segmentos.clear();
+    actuales.clear();
+    return correcto;
+}
+
+/**
+ * Ruta con la que se sella un archivo: la original seguida de la hora de rotación y de un contador que
+ * distingue las rotaciones de un mismo segundo (`ruta.AAAAMMDD-HHMMSS-NNN`). El orden alfabético de
+ * los archivos sellados de una misma ruta es su orden de rotación.
+ *
+ * @param ruta Ruta del archivo activo.
+ * @param instante Hora de la rotación.
+ */
+std::string rutaSellada(const std::string& ruta, std::time_t instante) {
+    std::tm local;
+    localtime_r(&instante, &local);
+    char sello[64];
+    std::string sellada;
+    for (int n = 0; n < 1000; ++n) {
+        snprintf(sello, sizeof(sello), ".%04d%02d%02d-%02d%02d%02d-%03d", local.tm_year + 1900, local.tm_mon + 1,
+                 local.tm_mday, local.tm_hour, local.tm_min, local.tm_sec, n);
+        sellada = ruta + sello;
+        if (access(sellada.c_str(), F_OK) < 0) {
+            break;
+        }
+    }
+    return sellada;
+}
+
+/**
+ * Indica si un texto es una hora de rotación (AAAAMMDD-HHMMSS-NNN).
+ */
+bool esSello(const std::string& texto) {
+    if (texto.size() != LARGO_SELLO) {
+        return false;
+    }
+    for (size_t i = 0; i < LARGO_SELLO; ++i) {
+        if (i == 8 || i == 15 ? texto[i] != '-' : (texto[i] < '0' || texto[i] > '9')) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Separa el nombre de un archivo sellado en el nombre del archivo activo y la hora de rotación.
+ *
+ * @param nombre Nombre del archivo.
+ * @param base Recibe el nombre del archivo activo.
+ * @param sello Recibe la hora de rotación (AAAAMMDD-HHMMSS-NNN).
+ * @return false si el nombre no es el de un archivo sellado.
+ */
+bool separarSello(const std::string& nombre, std::string& base, std::string& sello) {
+    if (nombre.size() < LARGO_SELLO + 2 || nombre[nombre.size() - LARGO_SELLO - 1] != '.' ||
+        !esSello(nombre.substr(nombre.size() - LARGO_SELLO))) {
+        return false;
+    }
+    base = nombre.substr(0, nombre.size() - LARGO_SELLO - 1);
+    sello = nombre.substr(nombre.size() - LARGO_SELLO);
+    return true;
+}
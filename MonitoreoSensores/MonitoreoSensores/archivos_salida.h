@@ -0,0 +1,123 @@
+/**
+ * @file archivos_salida.h
+ * @autores Juan Pablo Hernández Ceballos
+ * Archivos de salida de un canal del monitor.
+ *
+ * Sin segmentar, todas las mediciones del canal van a un solo archivo. Segmentado, la ruta del canal es
+ * un directorio con un archivo por sensor y día del evento (`sensor-AAAAMMDD.txt`): cada archivo
+ * recibe solo las mediciones de su sensor y deja de crecer al cambiar el día, así que puede archivarse
+ * o borrarse entero sin reescribir los demás. Con el WAL, cada archivo tiene su propio punto de control.
+ * Los puntos de control de los archivos con mediciones nuevas se registran juntos con el corte del canal
+ * (ver Wal::Corte): cuando el hilo de persistencia retiene mediciones para reordenarlas, el contenido de un
+ * archivo no es un prefijo de los LSN, y el corte indica con la marca de agua cuáles ya están escritos. Las
+ * mediciones que llegan tarde van a la salida de tardías del canal, que se registra con los demás archivos.
+ *
+ * Los archivos siempre se abren en modo de anexado. Con rotación, al pasar de un tamaño o de una
+ * antigüedad el archivo activo se sella: se renombra agregándole la hora de rotación
+ * (`ruta.AAAAMMDD-HHMMSS-NNN`) y se sigue escribiendo en uno nuevo con el mismo nombre. Los archivos
+ * sellados ya no cambian; el compactador los agrupa, los codifica y aplica la retención.
+ */
+
+#ifndef ARCHIVOS_SALIDA_H
+#define ARCHIVOS_SALIDA_H
+
+#include <cstdint>
+#include <ctime>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "lectura.h"
+#include "motor_es.h"
+#include "wal.h"
+
+class Agregados;
+struct LimitesCanal;
+
+const size_t LARGO_SELLO = 19;  ///< Largo de la hora de rotación de un archivo sellado (AAAAMMDD-HHMMSS-NNN)
+
+/**
+ * Cuándo se sellan los archivos de salida.
+ */
+struct Rotacion {
+    uint64_t bytes = 0;       ///< Tamaño a partir del cual se rota el archivo activo (0 = sin límite)
+    int64_t segundos = 0;     ///< Antigüedad a partir de la cual se rota el archivo activo (0 = sin límite)
+    bool sellarDias = false;  ///< Sellar los segmentos de días anteriores al cerrarlos
+};
+
+/**
+ * Archivo de salida abierto: el único del canal o el segmento de un sensor y un día.
+ */
+struct Segmento {
+    Segmento(AnilloEscritura* anillo, bool sincronizar);
+
+    std::string ruta;          ///< Ruta del archivo (clave de su punto de control)
+    Sumidero archivo;          ///< Archivo abierto en modo de anexado
+    uint32_t sensor = 0;       ///< Sensor del segmento (0 sin segmentar)
+    std::time_t inicioDia = 0; ///< Primer segundo del día del segmento
+    std::time_t finDia = 0;    ///< Primer segundo del día siguiente
+    std::time_t apertura = 0;  ///< Hora en que empezó el archivo activo (para la rotación por tiempo)
+    uint64_t ultimoLsn = 0;    ///< Último LSN escrito que aún no está en el punto de control
+    uint64_t lsnPunto = 0;     ///< LSN del último punto de control registrado
+    uint64_t lineas = 0;       ///< Líneas agregadas que aún no se escriben
+};
+
+/**
+ * Archivos de salida de un canal. Los usa un solo hilo (el de persistencia, o el principal al recuperar).
+ */
+class ArchivosSalida {
+public:
+    ArchivosSalida(Canal canal, const std::string& ruta, bool segmentar, const Rotacion& rotacion, AnilloEscritura* anillo,
+                   bool sincronizar, Wal* wal);
+
+    bool preparar();
+    bool recuperar(Agregados& agregados, const LimitesCanal& limites);
+    bool abrir();
+    void desviarA(Sumidero* salida);
+    Segmento* destino(const Lectura& lectura);
+    void agregar(Segmento* segmento, const char* linea, size_t largo);
+    void desviar(const Lectura& lectura, const char* linea, size_t largo);
+    std::vector<Segmento*>& conLineas();
+    void cambiarRotacion(const Rotacion& nueva);
+    void retener(uint64_t lsn, int64_t marca);
+    void terminarLote();
+    bool registrarAvance();
+    bool sincronizarTodo();
+    bool cerrar();
+
+private:
+    typedef std::pair<uint32_t, std::time_t> Clave;  ///< Sensor y primer segundo del día
+
+    std::string rutaDe(uint32_t sensor, std::time_t evento, std::time_t* inicio, std::time_t* fin) const;
+    Segmento* abrirSegmento(const Clave& clave, const std::string& ruta, std::time_t fin, uint64_t lsn);
+    bool registrarPuntos();
+    bool sellar(Segmento* segmento, bool reabrir);
+
+    Canal canal;                                      ///< Canal de las mediciones
+    std::string ruta;                                 ///< Archivo del canal, o directorio de sus segmentos
+    bool segmentar;                                   ///< Un archivo por sensor y día
+    Rotacion rotacion;                                ///< Cuándo se sellan los archivos
+    AnilloEscritura* anillo;                          ///< Anillo compartido de io_uring (nullptr = motor clásico)
+    bool sincronizar;                                 ///< fdatasync tras cada lote
+    Wal* wal;                                         ///< WAL de las mediciones (nullptr si está desactivado)
+    std::map<Clave, std::unique_ptr<Segmento>> segmentos;  ///< Archivos abiertos
+    std::unordered_map<uint32_t, Segmento*> actuales; ///< Segmento del día en curso de cada sensor
+    std::vector<Segmento*> sucios;                    ///< Segmentos con LSN sin registrar en el punto de control
+    std::vector<Segmento*> pendientes;                ///< Segmentos con líneas sin escribir
+    std::vector<Clave> vencidos;                      ///< Segmentos de días anteriores, por cerrar
+    uint64_t lsnRetenido = UINT64_MAX;                ///< LSN más bajo retenido por el reordenamiento
+    int64_t marca = INT64_MAX;                        ///< Marca de agua del reordenamiento
+    uint64_t recibido = 0;                            ///< Mayor LSN recibido del canal
+    std::string rutaTardias;                          ///< Salida de tardías (clave de su punto de control)
+    Sumidero* tardias = nullptr;                      ///< Salida de tardías (nullptr sin reordenamiento)
+    bool tardiasSucias = false;                       ///< Hay mediciones desviadas sin registrar
+    std::vector<std::pair<std::string, uint64_t>> porRegistrar;  ///< Búfer reutilizado para registrar el corte
+};
+
+std::string rutaSellada(const std::string& ruta, std::time_t instante);
+bool esSello(const std::string& texto);
+bool separarSello(const std::string& nombre, std::string& base, std::string& sello);
+
+#endif //ARCHIVOS_SALIDA_H
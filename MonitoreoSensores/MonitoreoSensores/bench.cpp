@@ -0,0 +1,738 @@
+/**
+ * @file bench.cpp
+ * @autores Juan Pablo Hernández Ceballos
+ * Banco de pruebas de rendimiento de la ruta de ingreso del monitor.
+ *
+ * @detalles
+ * Sin opciones ejecuta los microbancos y muestra los resultados en JSON:
+ * - Buffer::add/remove con varios productores y consumidores compitiendo, en modo eficiencia y latencia,
+ *   y con varios productores en un mismo carril frente a un carril por productor.
+ * - is_float / is_integer sobre mediciones típicas.
+ * - getCurrentTime frente a horaActual (hora guardada por hilo, sin reservar memoria).
+ * - SeguimientoSecuencias::registrar (clasificación de secuencias por sensor).
+ * - clasificarLote con cada implementación disponible (escalar, SSE2, AVX2) sobre lotes de 64 mediciones.
+ * - Ingreso de texto: búsqueda de delimitadores con cada implementación y decodificación de mediciones,
+ *   por byte (ops_por_s = bytes por segundo), y decodificación rápida frente a la validación general.
+ * - Escritura de mediciones en un archivo de salida (con std::endl y con '\n') y por lotes de 64 líneas
+ *   con cada motor de entrada y salida (clásico e io_uring, si el núcleo lo ofrece).
+ *
+ * Con `-e` ejecuta la prueba de extremo a extremo: lanza el monitor indicado con `-m` en un
+ * directorio temporal, le envía mediciones por su pipe a una tasa fija (`-r` mediciones por
+ * segundo durante `-s` segundos) y mide cuándo aparece cada una en el archivo de salida. El
+ * resultado (rendimiento y percentiles de latencia) también se muestra en JSON. Con `-l` el monitor
+ * espera en modo latencia (giro antes de bloquear) en el canal de temperatura, y con `-u` usa el motor
+ * de entrada y salida io_uring.
+ *
+ * Con `-c` ejecuta las comprobaciones de correctitud de extremo a extremo, también sobre el monitor de
+ * `-m` y el sensor de `-n`: cada una muestra su resultado en JSON y el programa termina con 1 si alguna
+ * falla.
+ *
+ * Este archivo contiene las siguientes funciones:
+ * - ahoraNs: Hora monótona en nanosegundos.
+ * - medir: Ejecuta una función varias veces y devuelve los nanosegundos por operación.
+ * - benchBuffer: Microbanco de Buffer con productores y consumidores concurrentes.
+ * - microbancos: Ejecuta todos los microbancos.
+ * - extremoAExtremo: Prueba de extremo a extremo a través del pipe del monitor.
+ * - contarLineas: Cuenta las líneas de un archivo.
+ * - comprobarSensoresSinIdentificador: Dos sensores del mismo tipo sin -n ante un monitor con -u.
+ * - comprobarDecimales: decodificarMedicion frente a std::stof en decimales cerca de los puntos medios.
+ * - comprobaciones: Ejecuta todas las comprobaciones.
+ * - main: Función principal.
+ */
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <climits>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "buffer.h"
+#include "clasificacion.h"
+#include "escaneo.h"
+#include "motor_es.h"
+#include "secuencias.h"
+#include "utilidades.h"
+
+/**
+ * Hora monótona en nanosegundos.
+ */
+uint64_t ahoraNs() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return static_cast<uint64_t>(t.tv_sec) * 1000000000ull + t.tv_nsec;
+}
+
+/**
+ * Ejecuta una función `iteraciones` veces y devuelve los nanosegundos por operación.
+ */
+template <typename Funcion>
+double medir(long iteraciones, Funcion funcion) {
+    uint64_t inicio = ahoraNs();
+    for (long i = 0; i < iteraciones; ++i) {
+        funcion(i);
+    }
+    return static_cast<double>(ahoraNs() - inicio) / iteraciones;
+}
+
+/**
+ * Argumentos de los hilos del microbanco de Buffer.
+ */
+struct ArgsBuffer {
+    Buffer* buffer;     ///< Buffer compartido
+    long operaciones;   ///< Mediciones que agrega cada productor
+    bool carriles;      ///< Cada productor usa su propio carril
+    std::atomic<int> siguiente{0};  ///< Carril del próximo productor
+};
+
+// Hilo productor: agrega sus mediciones al buffer.
+void* productorBench(void* arg) {
+    ArgsBuffer* args = reinterpret_cast<ArgsBuffer*>(arg);
+    int carril = args->carriles ? args->siguiente++ : 0;
+    Lectura lectura;
+    lectura.fijarValor("7.26", 4);
+    for (long i = 0; i < args->operaciones; ++i) {
+        args->buffer->add(lectura, carril);
+    }
+    return nullptr;
+}
+
+// Hilo consumidor: retira mediciones hasta que el buffer se cierra y queda vacío.
+void* consumidorBench(void* arg) {
+    ArgsBuffer* args = reinterpret_cast<ArgsBuffer*>(arg);
+    Lectura lectura;
+    while (args->buffer->remove(lectura)) {
+    }
+    return nullptr;
+}
+
+/**
+ * Microbanco de Buffer: `productores` hilos agregan mediciones mientras `consumidores` hilos las retiran.
+ * Con `carriles`, cada productor agrega por su propio carril, como los recolectores del monitor.
+ *
+ * @return Nanosegundos por medición transferida.
+ */
+double benchBuffer(int productores, int consumidores, int capacidad, long operaciones, ModoEspera modo,
+                   bool carriles) {
+    Buffer buffer(capacidad, carriles ? productores : 1);
+    buffer.setWaitMode(modo);
+    ArgsBuffer args;
+    args.buffer = &buffer;
+    args.operaciones = operaciones / productores;
+    args.carriles = carriles;
+    std::vector<pthread_t> hilosProductores(productores), hilosConsumidores(consumidores);
+
+    uint64_t inicio = ahoraNs();
+    for (pthread_t& hilo : hilosConsumidores) {
+        pthread_create(&hilo, NULL, consumidorBench, &args);
+    }
+    for (pthread_t& hilo : hilosProductores) {
+        pthread_create(&hilo, NULL, productorBench, &args);
+    }
+    for (pthread_t& hilo : hilosProductores) {
+        pthread_join(hilo, NULL);
+    }
+    buffer.close();
+    for (pthread_t& hilo : hilosConsumidores) {
+        pthread_join(hilo, NULL);
+    }
+#ifdef BUFFER_PERFILADO
+    std::cerr << "Perfil de Buffer " << productores << "p" << consumidores << "c capacidad " << capacidad << ":\n"
+              << buffer.profile();
+#endif
+    return static_cast<double>(ahoraNs() - inicio) / (args.operaciones * productores);
+}
+
+const size_t TAM_BLOQUE_TEXTO = 1 << 20;  ///< Bytes del bloque de texto de los microbancos de ingreso
+
+/**
+ * Ejecuta todos los microbancos y muestra los resultados en JSON.
+ */
+void microbancos() {
+    std::vector<std::pair<std::string, double>> resultados;
+
+    // Buffer con distintos niveles de competencia
+    const long operaciones = 400000;
+    const int configuraciones[][5] = {{1, 1, 10, ESPERA_EFICIENCIA, 0}, {1, 1, 1024, ESPERA_EFICIENCIA, 0},
+                                      {2, 2, 10, ESPERA_EFICIENCIA, 0}, {4, 4, 1024, ESPERA_EFICIENCIA, 0},
+                                      {1, 1, 10, ESPERA_LATENCIA, 0}, {1, 1, 1024, ESPERA_LATENCIA, 0},
+                                      {4, 1, 1024, ESPERA_EFICIENCIA, 0}, {4, 1, 1024, ESPERA_EFICIENCIA, 1}};
+    for (const auto& c : configuraciones) {
+        std::string nombre = "buffer_" + std::to_string(c[0]) + "p" + std::to_string(c[1]) + "c_cap" + std::to_string(c[2]);
+        if (c[3] == ESPERA_LATENCIA) {
+            nombre += "_latencia";
+        }
+        if (c[4]) {
+            nombre += "_carriles";
+        }
+        resultados.emplace_back(nombre, benchBuffer(c[0], c[1], c[2], operaciones, static_cast<ModoEspera>(c[3]), c[4]));
+    }
+
+    // Validación de mediciones
+    const std::string muestras[] = {"68", "7.26", "6.5", "21", "-3", "abc"};
+    volatile bool sumidero = false;
+    resultados.emplace_back("is_integer", medir(1000000, [&](long i) { sumidero = is_integer(muestras[i % 6]); }));
+    resultados.emplace_back("is_float", medir(1000000, [&](long i) { sumidero = is_float(muestras[i % 6]); }));
+    (void) sumidero;
+
+    // Seguimiento de secuencias: 16 sensores, con un hueco y un duplicado cada 100 mediciones
+    SeguimientoSecuencias secuencias;
+    uint32_t siguiente[16] = {};
+    volatile uint64_t perdidasTotal = 0;
+    resultados.emplace_back("secuencias_registrar", medir(1000000, [&](long i) {
+        uint32_t sensor = i % 16;
+        uint32_t secuencia = ++siguiente[sensor];
+        if (secuencia % 100 == 0) {
+            secuencia = ++siguiente[sensor]; // Hueco
+        } else if (secuencia % 100 == 50) {
+            secuencia--; // Duplicado
+        }
+        uint64_t perdidas;
+        secuencias.registrar(sensor, secuencia, perdidas);
+        perdidasTotal = perdidasTotal + perdidas;
+    }));
+
+    // Clasificación por lotes contra los límites de pH, con cada implementación disponible
+    const size_t totalValores = 1 << 16;
+    std::vector<float> valores(totalValores);
+    for (size_t i = 0; i < totalValores; ++i) {
+        valores[i] = static_cast<float>((i * 2654435761u) % 1500) / 100.0f - 0.5f; // -0.5 a 14.5
+    }
+    const LimitesCanal limites = {0.0f, 14.0f, 6.0f, 8.0f};
+    uint64_t invalidas, alertas;
+    volatile uint64_t marcadas = 0;
+    for (int implementacion = SIMD_ESCALAR; implementacion <= SIMD_AVX2; ++implementacion) {
+        ImplementacionSimd simd = static_cast<ImplementacionSimd>(implementacion);
+        if (!implementacionDisponible(simd)) {
+            continue;
+        }
+        double nsPorLote = medir(totalValores / BITS_MASCARA * 20, [&](long i) {
+            size_t inicio = (i * BITS_MASCARA) % totalValores;
+            clasificarLote(simd, valores.data() + inicio, BITS_MASCARA, limites, &invalidas, &alertas);
+            marcadas = marcadas + __builtin_popcountll(invalidas | alertas);
+        });
+        resultados.emplace_back(std::string("clasificar_lote_") + nombreImplementacion(simd), nsPorLote / BITS_MASCARA);
+    }
+
+    // Ingreso de texto: un bloque como los que lee el recolector, con mediciones de pH y temperatura
+    std::string texto;
+    for (uint32_t i = 1; texto.size() < TAM_BLOQUE_TEXTO; ++i) {
+        texto += i % 2 ? "21:" + std::to_string(i) + ":7.26" : "20:" + std::to_string(i) + ":68";
+        texto += '\0';
+    }
+    std::vector<uint32_t> posiciones(texto.size());
+    volatile size_t encontrados = 0;
+    for (int implementacion = SIMD_ESCALAR; implementacion <= SIMD_AVX2; ++implementacion) {
+        ImplementacionSimd simd = static_cast<ImplementacionSimd>(implementacion);
+        if (!implementacionDisponible(simd)) {
+            continue;
+        }
+        double nsPorBloque = medir(200, [&](long) {
+            encontrados = buscarDelimitadores(simd, texto.data(), texto.size(), posiciones.data());
+        });
+        resultados.emplace_back(std::string("delimitadores_") + nombreImplementacion(simd) + "_por_byte",
+                                nsPorBloque / texto.size());
+    }
+    volatile double suma = 0;
+    double nsPorBloque = medir(200, [&](long) {
+        size_t fines = buscarDelimitadores(texto.data(), texto.size(), posiciones.data());
+        size_t inicio = 0;
+        MedicionDecodificada medicion;
+        double total = 0;
+        for (size_t k = 0; k < fines; ++k) {
+            if (decodificarMedicion(texto.data() + inicio, posiciones[k] - inicio, medicion)) {
+                total += medicion.numero;
+            }
+            inicio = posiciones[k] + 1;
+        }
+        suma = suma + total;
+    });
+    resultados.emplace_back("ingreso_texto_por_byte", nsPorBloque / texto.size());
+    const char* const registros[] = {"21:123457:7.26", "20:123458:68"};
+    resultados.emplace_back("decodificar_medicion", medir(1000000, [&](long i) {
+        MedicionDecodificada medicion;
+        decodificarMedicion(registros[i % 2], std::strlen(registros[i % 2]), medicion);
+        suma = suma + medicion.numero;
+    }));
+    resultados.emplace_back("decodificar_general", medir(1000000, [&](long i) {
+        uint32_t sensor, secuencia;
+        int64_t evento;
+        std::string valor;
+        separarIdentidad(registros[i % 2], sensor, secuencia, evento, valor);
+        suma = suma + (is_integer(valor) ? std::stoi(valor) : is_float(valor) ? std::stof(valor) : 0);
+    }));
+
+    // Hora actual
+    volatile size_t largo = 0;
+    resultados.emplace_back("getCurrentTime", medir(1000000, [&](long) { largo = getCurrentTime().size(); }));
+    resultados.emplace_back("horaActual", medir(1000000, [&](long) { largo = horaActual()[0]; }));
+    (void) largo;
+
+    // Escritura de mediciones como lo hacen los hilos consumidores
+    char plantilla[] = "/tmp/bench-salidaXXXXXX";
+    int fd = mkstemp(plantilla);
+    if (fd >= 0) {
+        close(fd);
+        {
+            std::ofstream archivo(plantilla);
+            resultados.emplace_back("escritura_endl", medir(200000, [&](long i) {
+                archivo << 20 + i % 10 << " " << getCurrentTime() << std::endl;
+            }));
+        }
+        {
+            std::ofstream archivo(plantilla);
+            resultados.emplace_back("escritura_salto", medir(200000, [&](long i) {
+                archivo << 20 + i % 10 << " " << getCurrentTime() << "\n";
+            }));
+        }
+        const MotorEs motores[] = {MOTOR_CLASICO, MOTOR_URING};
+        const char* nombres[] = {"escritura_lote_clasico", "escritura_lote_uring"};
+        for (int m = 0; m < 2; ++m) {
+            if (motores[m] == MOTOR_URING && !uringDisponible()) {
+                continue;
+            }
+            AnilloEscritura anillo;
+            Sumidero archivo(motores[m] == MOTOR_URING && anillo.iniciar(ENTRADAS_ANILLO_ESCRITURA) ? &anillo : nullptr,
+                             false);
+            if (!archivo.abrir(plantilla, false)) {
+                continue;
+            }
+            char linea[64];
+            resultados.emplace_back(nombres[m], medir(200000, [&](long i) {
+                int largo = snprintf(linea, sizeof(linea), "%ld %s\n", 20 + i % 10, horaActual());
+                archivo.agregar(linea, largo);
+                if (i % 64 == 63) { // Un lote de consumidor
+                    archivo.vaciar();
+                }
+            }));
+        }
+        unlink(plantilla);
+    }
+
+    std::cout << "{\"microbancos\": [";
+    for (size_t i = 0; i < resultados.size(); ++i) {
+        std::cout << (i ? ", " : "") << "{\"nombre\": \"" << resultados[i].first << "\", \"ns_por_op\": "
+                  << resultados[i].second << ", \"ops_por_s\": " << static_cast<long>(1e9 / resultados[i].second) << "}";
+    }
+    std::cout << "]}" << std::endl;
+}
+
+/**
+ * Estado compartido con el hilo que vigila el archivo de salida del monitor.
+ */
+struct Vigilancia {
+    std::string ruta;                  ///< Archivo de salida a vigilar
+    std::vector<uint64_t>* llegadas;   ///< Hora de aparición de cada línea
+    long esperadas;                    ///< Líneas que se esperan
+    std::atomic<bool> detener{false};  ///< Solicitud de término
+};
+
+// Hilo que relee el archivo de salida y anota la hora en que aparece cada línea nueva.
+void* vigilarSalida(void* arg) {
+    Vigilancia* v = reinterpret_cast<Vigilancia*>(arg);
+    int fd = -1;
+    long lineas = 0;
+    char bloque[65536];
+    while (!v->detener && lineas < v->esperadas) {
+        if (fd < 0 && (fd = open(v->ruta.c_str(), O_RDONLY)) < 0) {
+            usleep(50);
+            continue;
+        }
+        ssize_t leidos = read(fd, bloque, sizeof(bloque));
+        if (leidos <= 0) {
+            usleep(20);
+            continue;
+        }
+        uint64_t ahora = ahoraNs();
+        for (ssize_t i = 0; i < leidos && lineas < v->esperadas; ++i) {
+            if (bloque[i] == '\n') {
+                (*v->llegadas)[lineas++] = ahora;
+            }
+        }
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    return nullptr;
+}
+
+/**
+ * Prueba de extremo a extremo: envía mediciones de temperatura al monitor a una tasa fija y mide
+ * cuánto tardan en aparecer en su archivo de salida.
+ *
+ * @param monitor Ruta del ejecutable del monitor.
+ * @param tasa Mediciones por segundo.
+ * @param segundos Duración del envío.
+ * @param latencia true para que el monitor espere en modo latencia.
+ * @param uring true para que el monitor use el motor de entrada y salida io_uring.
+ * @return 0 si la prueba se completó.
+ */
+int extremoAExtremo(const char* monitor, long tasa, int segundos, bool latencia, bool uring) {
+    char rutaMonitor[PATH_MAX];
+    if (realpath(monitor, rutaMonitor) == nullptr) {
+        std::cerr << "Error: No se encontró el monitor: " << monitor << std::endl;
+        return 1;
+    }
+    char directorio[] = "/tmp/bench-e2eXXXXXX";
+    if (mkdtemp(directorio) == nullptr) {
+        std::cerr << "Error: No se pudo crear el directorio temporal" << std::endl;
+        return 1;
+    }
+    std::string pipe = std::string(directorio) + "/pipe";
+    std::string salida = std::string(directorio) + "/temperature-data.txt";
+
+    // Lanzar el monitor en el directorio temporal
+    pid_t pid = fork();
+    if (pid == 0) {
+        if (chdir(directorio) < 0) {
+            _exit(127);
+        }
+        int nulo = open("/dev/null", O_WRONLY);
+        dup2(nulo, STDOUT_FILENO);
+        std::vector<const char*> argumentos = {rutaMonitor, "-b", "1024", "-t", "temperature-data.txt",
+                                               "-h", "pH-data.txt", "-p", pipe.c_str(), "-i", "0"};
+        if (latencia) {
+            argumentos.insert(argumentos.end(), {"-l", "temperatura"});
+        }
+        if (uring) {
+            argumentos.insert(argumentos.end(), {"-e", "uring"});
+        }
+        argumentos.push_back(nullptr);
+        execv(rutaMonitor, const_cast<char* const*>(argumentos.data()));
+        _exit(127);
+    }
+
+    // Esperar a que el monitor cree y abra el pipe
+    int pipeFd = -1;
+    for (int intento = 0; intento < 500 && pipeFd < 0; ++intento) {
+        pipeFd = open(pipe.c_str(), O_WRONLY | O_NONBLOCK);
+        if (pipeFd < 0) {
+            usleep(10000);
+        }
+    }
+    if (pipeFd < 0) {
+        std::cerr << "Error: El monitor no abrió el pipe: " << pipe << std::endl;
+        kill(pid, SIGKILL);
+        waitpid(pid, NULL, 0);
+        return 1;
+    }
+    fcntl(pipeFd, F_SETFL, 0); // Escrituras bloqueantes para no perder mediciones
+
+    long total = tasa * segundos;
+    std::vector<uint64_t> envios(total), llegadas(total, 0);
+    Vigilancia vigilancia;
+    vigilancia.ruta = salida;
+    vigilancia.llegadas = &llegadas;
+    vigilancia.esperadas = total;
+    pthread_t hiloVigilancia;
+    pthread_create(&hiloVigilancia, NULL, vigilarSalida, &vigilancia);
+
+    // Enviar las mediciones a la tasa indicada (temperaturas dentro del rango normal)
+    uint64_t periodo = 1000000000ull / tasa;
+    uint64_t inicio = ahoraNs();
+    for (long i = 0; i < total; ++i) {
+        uint64_t objetivo = inicio + i * periodo;
+        uint64_t ahora;
+        while ((ahora = ahoraNs()) < objetivo) {
+            if (objetivo - ahora > 100000) {
+                usleep((objetivo - ahora) / 1000 - 50);
+            }
+        }
+        char medicion[8];
+        int largo = snprintf(medicion, sizeof(medicion), "%ld", 21 + i % 10);
+        envios[i] = ahoraNs();
+        if (write(pipeFd, medicion, largo + 1) < 0) {
+            std::cerr << "Error: Falló la escritura en el pipe" << std::endl;
+            break;
+        }
+    }
+    uint64_t finEnvio = ahoraNs();
+
+    // Esperar hasta 5 segundos a que aparezcan todas las mediciones
+    uint64_t limite = finEnvio + 5000000000ull;
+    while (llegadas[total - 1] == 0 && ahoraNs() < limite) {
+        usleep(1000);
+    }
+    vigilancia.detener = true;
+    pthread_join(hiloVigilancia, NULL);
+    close(pipeFd);
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+
+    // Calcular rendimiento y percentiles de latencia
+    std::vector<double> latencias;
+    uint64_t ultimaLlegada = inicio;
+    for (long i = 0; i < total; ++i) {
+        if (llegadas[i] != 0) {
+            latencias.push_back((llegadas[i] - envios[i]) / 1000.0);
+            ultimaLlegada = std::max(ultimaLlegada, llegadas[i]);
+        }
+    }
+    std::sort(latencias.begin(), latencias.end());
+    auto percentil = [&](double p) {
+        return latencias.empty() ? 0.0 : latencias[std::min(latencias.size() - 1, static_cast<size_t>(p * latencias.size()))];
+    };
+    double duracion = (ultimaLlegada - inicio) / 1e9;
+
+    std::cout << "{\"extremo_a_extremo\": {\"tasa_objetivo\": " << tasa << ", \"segundos\": " << segundos
+              << ", \"enviadas\": " << total << ", \"recibidas\": " << latencias.size()
+              << ", \"rendimiento_por_s\": " << (duracion > 0 ? latencias.size() / duracion : 0)
+              << ", \"latencia_us\": {\"p50\": " << percentil(0.50) << ", \"p90\": " << percentil(0.90)
+              << ", \"p99\": " << percentil(0.99) << ", \"p999\": " << percentil(0.999)
+              << ", \"max\": " << (latencias.empty() ? 0.0 : latencias.back()) << "}}}" << std::endl;
+
+    unlink(salida.c_str());
+    unlink((std::string(directorio) + "/pH-data.txt").c_str());
+    rmdir(directorio);
+    return latencias.size() == static_cast<size_t>(total) ? 0 : 1;
+}
+
+/**
+ * Cuenta las líneas de un archivo.
+ *
+ * @param ruta Ruta del archivo.
+ * @return Cantidad de líneas (0 si no existe).
+ */
+long contarLineas(const std::string& ruta) {
+    std::ifstream archivo(ruta);
+    std::string linea;
+    long lineas = 0;
+    while (std::getline(archivo, linea)) {
+        lineas++;
+    }
+    return lineas;
+}
+
+/**
+ * Comprobación: dos sensores del mismo tipo lanzados sin `-n` envían al mismo monitor con descarte de
+ * duplicados (`-u`). Cada uno debe recibir su propio identificador, así que ninguna de sus mediciones
+ * (con las mismas secuencias) puede descartarse como duplicada de las del otro.
+ *
+ * @param monitor Ruta del ejecutable del monitor.
+ * @param sensor Ruta del ejecutable del sensor.
+ * @return true si la comprobación se cumple.
+ */
+bool comprobarSensoresSinIdentificador(const char* monitor, const char* sensor) {
+    const int MEDICIONES = 200; // Mediciones de cada sensor
+    char rutaMonitor[PATH_MAX], rutaSensor[PATH_MAX];
+    if (realpath(monitor, rutaMonitor) == nullptr || realpath(sensor, rutaSensor) == nullptr) {
+        std::cerr << "Error: No se encontró el monitor o el sensor: " << monitor << ", " << sensor << std::endl;
+        return false;
+    }
+    char directorio[] = "/tmp/bench-idXXXXXX";
+    if (mkdtemp(directorio) == nullptr) {
+        std::cerr << "Error: No se pudo crear el directorio temporal" << std::endl;
+        return false;
+    }
+    std::string base(directorio);
+    std::string pipe = base + "/pipe";
+    std::string datos = base + "/datos.txt";
+    std::string salida = base + "/pH-data.txt";
+    {
+        std::ofstream archivoDatos(datos);
+        for (int i = 0; i < MEDICIONES; ++i) {
+            archivoDatos << "7." << i % 10 << "\n";
+        }
+    }
+
+    // Lanzar el monitor con descarte de duplicados; termina un segundo después de que los sensores callan
+    pid_t pidMonitor = fork();
+    if (pidMonitor == 0) {
+        if (chdir(directorio) < 0) {
+            _exit(127);
+        }
+        int nulo = open("/dev/null", O_WRONLY);
+        dup2(nulo, STDOUT_FILENO);
+        execl(rutaMonitor, rutaMonitor, "-b", "1024", "-t", "temperature-data.txt", "-h", "pH-data.txt",
+              "-p", pipe.c_str(), "-i", "1", "-u", (char*) nullptr);
+        _exit(127);
+    }
+    for (int intento = 0; intento < 500 && access(pipe.c_str(), F_OK) < 0; ++intento) {
+        usleep(10000);
+    }
+
+    // Lanzar los dos sensores de tipo 1 sin identificador
+    pid_t sensores[2];
+    for (pid_t& pid : sensores) {
+        pid = fork();
+        if (pid == 0) {
+            int nulo = open("/dev/null", O_WRONLY);
+            dup2(nulo, STDERR_FILENO);
+            execl(rutaSensor, rutaSensor, "-s", "1", "-t", "0", "-f", datos.c_str(), "-p", pipe.c_str(),
+                  (char*) nullptr);
+            _exit(127);
+        }
+    }
+    bool sensoresBien = true;
+    for (pid_t pid : sensores) {
+        int estado;
+        waitpid(pid, &estado, 0);
+        sensoresBien = sensoresBien && WIFEXITED(estado) && WEXITSTATUS(estado) == 0;
+    }
+
+    // Esperar hasta 10 segundos a que el monitor termine
+    int estado = 0;
+    pid_t terminado = 0;
+    for (int intento = 0; intento < 1000 && (terminado = waitpid(pidMonitor, &estado, WNOHANG)) == 0; ++intento) {
+        usleep(10000);
+    }
+    if (terminado == 0) {
+        kill(pidMonitor, SIGKILL);
+        waitpid(pidMonitor, NULL, 0);
+    }
+    long recibidas = contarLineas(salida);
+    bool correcta = sensoresBien && terminado == pidMonitor && recibidas == 2 * MEDICIONES;
+    std::cout << "{\"comprobacion\": \"sensores_sin_identificador\", \"enviadas\": " << 2 * MEDICIONES
+              << ", \"registradas\": " << recibidas << ", \"correcta\": " << (correcta ? "true" : "false") << "}"
+              << std::endl;
+
+    for (const char* nombre : {"pH-data.txt", "temperature-data.txt", "pH-data.txt.anomalias",
+                               "temperature-data.txt.anomalias", "pH-data.txt.1m", "pH-data.txt.1h",
+                               "temperature-data.txt.1m", "temperature-data.txt.1h", "datos.txt", "pipe"}) {
+        unlink((base + "/" + nombre).c_str());
+    }
+    rmdir(directorio);
+    return correcta;
+}
+
+/**
+ * Comprobación: la decodificación rápida de los decimales da exactamente el float de std::stof. Además de
+ * valores típicos y extremos, prueba decimales de hasta 15 dígitos pegados al punto medio entre dos float
+ * consecutivos, donde dividir en double y luego convertir a float redondearía dos veces.
+ *
+ * @return true si todas las decodificaciones coinciden.
+ */
+bool comprobarDecimales() {
+    std::vector<std::string> textos = {"0.0", "7.26", "-7.26", "0.1", "14.0", "0.000000000000001", "999999999999.999",
+                                       "16777217.0", "16777219.0", "3.4028235", "1.17549435", "0.30000001192092896"};
+    uint64_t estado = 88172645463325252ull; // xorshift64: la misma serie en cada ejecución
+    char texto[40];
+    for (int i = 0; i < 200000; ++i) {
+        estado ^= estado << 13;
+        estado ^= estado >> 7;
+        estado ^= estado << 17;
+        // Un float al azar entre 2^-10 y 2^30 y el punto medio (exacto en double) con el siguiente
+        float f = std::ldexp(1.0f + (estado >> 41) / 8388608.0f, static_cast<int>(estado % 41) - 10);
+        double medio = (static_cast<double>(f) + static_cast<double>(std::nextafter(f, INFINITY))) / 2;
+        int enteros = snprintf(texto, sizeof(texto), "%.0f", std::floor(medio));
+        int fraccion = std::max(1, 15 - enteros);
+        snprintf(texto, sizeof(texto), "%.*f", fraccion, medio);
+        std::string base(texto);
+        for (int delta = -2; delta <= 2; ++delta) { // El último dígito corrido, a ambos lados del punto medio
+            std::string variante = base;
+            int digito = variante.back() - '0' + delta;
+            if (digito < 0 || digito > 9) {
+                continue;
+            }
+            variante.back() = static_cast<char>('0' + digito);
+            textos.push_back(variante);
+        }
+    }
+    long comparadas = 0, distintas = 0;
+    std::string ejemplo;
+    for (const std::string& t : textos) {
+        MedicionDecodificada medicion;
+        if (!decodificarMedicion(t.data(), t.size(), medicion) || medicion.tipo != VALOR_DECIMAL) {
+            continue; // Fuera del formato corto: pasa por la validación general
+        }
+        comparadas++;
+        float esperado = std::stof(t);
+        float obtenido = static_cast<float>(medicion.numero);
+        if (memcmp(&esperado, &obtenido, sizeof(float)) != 0) {
+            distintas++;
+            ejemplo = t;
+        }
+    }
+    bool correcta = comparadas > 0 && distintas == 0;
+    std::cout << "{\"comprobacion\": \"decimales_como_stof\", \"comparadas\": " << comparadas
+              << ", \"distintas\": " << distintas;
+    if (!ejemplo.empty()) {
+        std::cout << ", \"ejemplo\": \"" << ejemplo << "\"";
+    }
+    std::cout << ", \"correcta\": " << (correcta ? "true" : "false") << "}" << std::endl;
+    return correcta;
+}
+
+/**
+ * Ejecuta todas las comprobaciones de correctitud.
+ *
+ * @param monitor Ruta del ejecutable del monitor.
+ * @param sensor Ruta del ejecutable del sensor.
+ * @return 0 si todas se cumplen.
+ */
+int comprobaciones(const char* monitor, const char* sensor) {
+    bool correctas = comprobarDecimales();
+    correctas = comprobarSensoresSinIdentificador(monitor, sensor) && correctas;
+    return correctas ? 0 : 1;
+}
+
+int main(int argc, char *argv[]) {
+    // Iniciando variables
+    int option;  // Opción para getopt
+    bool endToEnd = false;  // Ejecutar la prueba de extremo a extremo
+    bool checks = false;  // Ejecutar las comprobaciones
+    const char* monitorPath = "./monitor";  // Ejecutable del monitor
+    const char* sensorPath = "./sensor";  // Ejecutable del sensor
+    long rate = 1000;  // Mediciones por segundo
+    int seconds = 5;  // Duración del envío
+    bool latency = false;  // Monitor en modo latencia
+    bool uring = false;  // Monitor con el motor io_uring
+
+    // Revisando argumentos y asignándolos
+    while ((option = getopt(argc, argv, "ecm:n:r:s:lu")) != -1) {
+        switch (option) {
+            case 'e':
+                endToEnd = true;
+                break;
+            case 'c':
+                checks = true;
+                break;
+            case 'm':
+                monitorPath = optarg;
+                break;
+            case 'n':
+                sensorPath = optarg;
+                break;
+            case 'r':
+                rate = atol(optarg);
+                break;
+            case 's':
+                seconds = atoi(optarg);
+                break;
+            case 'l':
+                latency = true;
+                break;
+            case 'u':
+                uring = true;
+                break;
+            default:
+                std::cerr << "Uso: " << argv[0] << " [-e [-m monitor] [-r medicionesPorSegundo] [-s segundos] [-l] [-u] | -c [-m monitor] [-n sensor]]" << std::endl;
+                return 1;
+        }
+    }
+    if (rate <= 0 || seconds <= 0) {
+        std::cerr << "Error: la tasa y la duración deben ser positivas" << std::endl;
+        return 1;
+    }
+
+    if (checks) {
+        return comprobaciones(monitorPath, sensorPath);
+    }
+    if (endToEnd) {
+        return extremoAExtremo(monitorPath, rate, seconds, latency, uring);
+    }
+    microbancos();
+    return 0;
+}
@@ -0,0 +1,200 @@
+/**
+ * @file boceto.cpp
+ * @autores Juan Pablo Hernández Ceballos
+ * Implementa el boceto de cuantiles combinable.
+ */
+
+#include "boceto.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+
+const double GAMMA = (1 + PRECISION_BOCETO) / (1 - PRECISION_BOCETO);  ///< Razón entre contenedores consecutivos
+const double LOG_GAMMA = std::log(GAMMA);
+const double MINIMO_INDEXABLE = 1e-9;  ///< Valores absolutos menores se cuentan como cero
+
+// Contenedor del valor absoluto `x` (mayor o igual que MINIMO_INDEXABLE).
+int32_t indice(double x) {
+    return static_cast<int32_t>(std::ceil(std::log(x) / LOG_GAMMA));
+}
+
+// Valor representativo del contenedor: el que tiene el mismo error relativo respecto de sus dos límites.
+double representante(int32_t i) {
+    return 2 * std::pow(GAMMA, i) / (GAMMA + 1);
+}
+
+// Junta en `destino` los contenedores de `origen`.
+void sumarContenedores(std::map<int32_t, uint64_t>& destino, const std::map<int32_t, uint64_t>& origen) {
+    for (const auto& contenedor : origen) {
+        destino[contenedor.first] += contenedor.second;
+    }
+}
+
+// Escribe los contenedores con su prefijo.
+void escribirContenedores(std::string& texto, char prefijo, const std::map<int32_t, uint64_t>& contenedores) {
+    char par[48];
+    for (const auto& contenedor : contenedores) {
+        int largo = snprintf(par, sizeof(par), " %c%d:%llu", prefijo, contenedor.first,
+                             static_cast<unsigned long long>(contenedor.second));
+        texto.append(par, largo);
+    }
+}
+
+} // namespace
+
+/**
+ * Cuenta un valor.
+ *
+ * @param valor Medición.
+ */
+void Boceto::agregar(double valor) {
+    if (std::isnan(valor)) {
+        return;
+    }
+    if (valor >= MINIMO_INDEXABLE) {
+        positivos[indice(valor)]++;
+    } else if (valor <= -MINIMO_INDEXABLE) {
+        negativos[indice(-valor)]++;
+    } else {
+        ceros++;
+    }
+    total++;
+    if (positivos.size() + negativos.size() > MAX_CONTENEDORES_BOCETO) {
+        limitar();
+    }
+}
+
+/**
+ * Suma al boceto los contenedores de otro.
+ *
+ * @param otro Boceto de otras mediciones (de otra cubeta o de otro sensor).
+ */
+void Boceto::combinar(const Boceto& otro) {
+    sumarContenedores(positivos, otro.positivos);
+    sumarContenedores(negativos, otro.negativos);
+    ceros += otro.ceros;
+    total += otro.total;
+    if (positivos.size() + negativos.size() > MAX_CONTENEDORES_BOCETO) {
+        limitar();
+    }
+}
+
+/**
+ * @return Cantidad de valores contados.
+ */
+uint64_t Boceto::cantidad() const {
+    return total;
+}
+
+/**
+ * Estima un cuantil.
+ *
+ * @param q Cuantil entre 0 y 1 (0.99 para el percentil 99).
+ * @return El valor estimado, o NaN si el boceto está vacío.
+ */
+double Boceto::cuantil(double q) const {
+    if (total == 0) {
+        return NAN;
+    }
+    q = q < 0 ? 0 : (q > 1 ? 1 : q);
+    uint64_t rango = static_cast<uint64_t>(q * (total - 1)); // Posición del valor buscado, en orden ascendente
+    uint64_t vistos = 0;
+    for (auto contenedor = negativos.rbegin(); contenedor != negativos.rend(); ++contenedor) { // Más negativos primero
+        vistos += contenedor->second;
+        if (vistos > rango) {
+            return -representante(contenedor->first);
+        }
+    }
+    vistos += ceros;
+    if (vistos > rango) {
+        return 0;
+    }
+    for (const auto& contenedor : positivos) {
+        vistos += contenedor.second;
+        if (vistos > rango) {
+            return representante(contenedor.first);
+        }
+    }
+    return representante(positivos.rbegin()->first);
+}
+
+/**
+ * Agrega al texto los contenedores del boceto, cada uno precedido de un espacio.
+ *
+ * @param texto Texto al que se agregan.
+ */
+void Boceto::escribir(std::string& texto) const {
+    escribirContenedores(texto, 'n', negativos);
+    if (ceros > 0) {
+        char par[32];
+        int largo = snprintf(par, sizeof(par), " z:%llu", static_cast<unsigned long long>(ceros));
+        texto.append(par, largo);
+    }
+    escribirContenedores(texto, 'p', positivos);
+}
+
+/**
+ * Lee contenedores en el formato de `escribir` y los suma al boceto.
+ *
+ * @param texto Contenedores separados por espacios.
+ * @return false si algún contenedor está mal formado (los anteriores quedan sumados).
+ */
+bool Boceto::leer(const char* texto) {
+    while (true) {
+        while (*texto == ' ') {
+            texto++;
+        }
+        if (*texto == '\0' || *texto == '\n') {
+            return true;
+        }
+        char prefijo = *texto++;
+        long i = 0;
+        if (prefijo == 'p' || prefijo == 'n') {
+            char* fin;
+            i = strtol(texto, &fin, 10);
+            if (fin == texto) {
+                return false;
+            }
+            texto = fin;
+        } else if (prefijo != 'z') {
+            return false;
+        }
+        if (*texto++ != ':') {
+            return false;
+        }
+        char* fin;
+        unsigned long long cuenta = strtoull(texto, &fin, 10);
+        if (fin == texto) {
+            return false;
+        }
+        texto = fin;
+        if (prefijo == 'p') {
+            positivos[static_cast<int32_t>(i)] += cuenta;
+        } else if (prefijo == 'n') {
+            negativos[static_cast<int32_t>(i)] += cuenta;
+        } else {
+            ceros += cuenta;
+        }
+        total += cuenta;
+    }
+}
+
+// Junta los contenedores de valores más pequeños hasta volver al máximo: primero los positivos más
+// cercanos a cero, luego los negativos más cercanos a cero.
+void Boceto::limitar() {
+    while (positivos.size() > 1 && positivos.size() + negativos.size() > MAX_CONTENEDORES_BOCETO) {
+        auto menor = positivos.begin();
+        uint64_t cuenta = menor->second;
+        positivos.erase(menor);
+        positivos.begin()->second += cuenta;
+    }
+    while (negativos.size() > 1 && positivos.size() + negativos.size() > MAX_CONTENEDORES_BOCETO) {
+        auto menor = negativos.begin();
+        uint64_t cuenta = menor->second;
+        negativos.erase(menor);
+        negativos.begin()->second += cuenta;
+    }
+}
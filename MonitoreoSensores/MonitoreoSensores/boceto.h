@@ -0,0 +1,48 @@
+/**
+ * @file boceto.h
+ * @autores Juan Pablo Hernández Ceballos
+ * Boceto de cuantiles combinable (DDSketch) para las mediciones de una cubeta de agregados.
+ *
+ * Cada valor se cuenta en el contenedor `ceil(log_gamma(|x|))`, con gamma = (1 + a) / (1 - a), así que
+ * cualquier cuantil se estima con error relativo de a lo más `a` (1 %). Dos bocetos se combinan sumando
+ * los contenedores, sin perder precisión, de modo que los de varias cubetas y sensores dan el mismo
+ * resultado que un solo boceto con todas sus mediciones. Las mediciones de un sensor caen en pocas
+ * decenas de contenedores; si un boceto pasa de MAX_CONTENEDORES_BOCETO se juntan los de valores más
+ * pequeños, lo que solo afecta a los cuantiles más bajos.
+ *
+ * En texto, cada contenedor es `p<indice>:<cuenta>` (valores positivos), `n<indice>:<cuenta>`
+ * (negativos) o `z:<cuenta>` (cero), separados por espacios.
+ */
+
+#ifndef BOCETO_H
+#define BOCETO_H
+
+#include <cstdint>
+#include <map>
+#include <string>
+
+const double PRECISION_BOCETO = 0.01;        ///< Error relativo de los cuantiles
+const size_t MAX_CONTENEDORES_BOCETO = 2048; ///< Contenedores por boceto antes de juntar los menores
+
+/**
+ * Boceto de cuantiles de un conjunto de mediciones.
+ */
+class Boceto {
+public:
+    void agregar(double valor);
+    void combinar(const Boceto& otro);
+    uint64_t cantidad() const;
+    double cuantil(double q) const;
+    void escribir(std::string& texto) const;
+    bool leer(const char* texto);
+
+private:
+    void limitar();
+
+    std::map<int32_t, uint64_t> positivos;  ///< Cuenta por contenedor de los valores positivos
+    std::map<int32_t, uint64_t> negativos;  ///< Cuenta por contenedor del valor absoluto de los negativos
+    uint64_t ceros = 0;                     ///< Valores demasiado cercanos a cero para un contenedor
+    uint64_t total = 0;                     ///< Valores contados
+};
+
+#endif //BOCETO_H
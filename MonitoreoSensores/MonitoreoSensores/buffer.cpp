@@ -6,43 +6,423 @@
 
 #include "buffer.h"
 
+#include <cerrno>
+#include <ctime>
+#include <sstream>
+
 
 // Constructor de la célula Buffer. Inicializa los dispositivos de cifrado y establece las comunicaciones secretas.
-Buffer::Buffer(int size) : size(size){
+// Cada agente recibe su propio carril, y todas las celdas del flujo se fabrican aquí; después solo se reciclan.
+Buffer::Buffer(int size, int producers)
+    : lanes(producers > 0 ? producers : 1), size(size > 0 ? size : 1), closed(false), count(0), sleepers(0), nextLane(0) {
+    for (Lane& lane : lanes) {
+        pthread_mutex_init(&lane.mutex, NULL);
+        pthread_cond_init(&lane.condProducer, NULL);
+        lane.slots.resize(static_cast<size_t>(this->size.load()));
+    }
     pthread_mutex_init(&mutex, NULL);
-    pthread_cond_init(&condProducer, NULL);
     pthread_cond_init(&condConsumer, NULL);
 }
 
 // Destructor de la célula Buffer. Neutraliza los dispositivos de seguridad y elimina todas las pistas.
 Buffer::~Buffer() {
+    for (Lane& lane : lanes) {
+        pthread_mutex_destroy(&lane.mutex);
+        pthread_cond_destroy(&lane.condProducer);
+    }
     pthread_mutex_destroy(&mutex);
-    pthread_cond_destroy(&condProducer);
     pthread_cond_destroy(&condConsumer);
 }
 
-// Agrega un paquete al flujo encriptado. En caso de detección, se activa la espera hasta que se resuelva el acceso.
-void Buffer::add(std::string data) {
-    pthread_mutex_lock(&mutex);
-    while (dataQueue.size() >= size) {
-        pthread_cond_wait(&condProducer, &mutex);
+// Agrega un paquete al carril del agente `producer`. En caso de detección, se activa la espera hasta que se resuelva el acceso.
+// Devuelve false si el flujo fue clausurado y el paquete no se aceptó.
+bool Buffer::add(const Lectura& data, int producer) {
+    size_t index = static_cast<size_t>(producer);
+    Lane& lane = lanes[index < lanes.size() ? index : index % lanes.size()];
+    if (lane.count.load(std::memory_order_relaxed) >= size.load(std::memory_order_relaxed)) { // En modo latencia, girar antes de dormir
+        spin([this, &lane] { return lane.count.load(std::memory_order_relaxed) < size.load(std::memory_order_relaxed); });
     }
-    dataQueue.push(data);
-    pthread_cond_signal(&condConsumer);
-    pthread_mutex_unlock(&mutex);
+    lock(lane);
+    if (lane.used >= static_cast<size_t>(size.load()) && !closed) {
+        uint64_t inicio = relojNs(); // Solo se mide el tiempo cuando hay que esperar
+        while (lane.used >= static_cast<size_t>(size.load()) && !closed) {
+            waitProducer(lane);
+        }
+        if (metrics.esperaAdd != nullptr) {
+            metrics.esperaAdd->observar(relojNs() - inicio);
+        }
+    }
+    if (closed) {
+        unlock(lane);
+        return false;
+    }
+    size_t tail = lane.head + lane.used; // Sin división: el anillo da a lo sumo una vuelta
+    lane.slots[tail < lane.slots.size() ? tail : tail - lane.slots.size()] = data;
+    lane.used++;
+    count.fetch_add(1); // Con el mutex del carril: ningún consumidor lo ve antes que al paquete
+    waitPolicy.registrarLlegada();
+    updateOccupancy(lane);
+    unlock(lane);
+    wakeConsumer();
+    return true;
 }
 
 // Retira y decodifica un paquete del flujo encubierto. Si el flujo está vacío, se activa la espera hasta que se reciban datos.
-std::string Buffer::remove() {
+// Devuelve false cuando el flujo está clausurado y ya no quedan paquetes por drenar.
+bool Buffer::remove(Lectura& data) {
+    if (count.load(std::memory_order_relaxed) == 0) { // En modo latencia, girar antes de dormir
+        spin([this] { return count.load(std::memory_order_relaxed) > 0; });
+    }
+    while (take([&data](const Lectura& lectura) { data = lectura; }, 1) == 0) {
+        if (drained()) {
+            return false;
+        }
+        waitConsumer();
+    }
+    return true;
+}
+
+// Intenta retirar un paquete sin esperar. Devuelve false si el flujo está vacío en este instante.
+bool Buffer::tryRemove(Lectura& data) {
+    return take([&data](const Lectura& lectura) { data = lectura; }, 1) > 0;
+}
+
+// Retira de una sola vez hasta `max` paquetes, esperando si el flujo está vacío. Los paquetes quedan en
+// `data`, que se vacía antes. Devuelve false cuando el flujo está clausurado y ya no quedan paquetes.
+bool Buffer::removeBatch(std::vector<Lectura>& data, size_t max) {
+    data.clear();
+    if (count.load(std::memory_order_relaxed) == 0) { // En modo latencia, girar antes de dormir
+        spin([this] { return count.load(std::memory_order_relaxed) > 0; });
+    }
+    while (take([&data](const Lectura& lectura) { data.push_back(lectura); }, max) == 0) {
+        if (drained()) {
+            return false;
+        }
+        waitConsumer();
+    }
+    return true;
+}
+
+// Como removeBatch(), pero la espera dura a lo más `timeoutMs` milisegundos: si vence sin paquetes,
+// devuelve true con `data` vacío para que el agente atienda sus plazos y vuelva a intentarlo.
+bool Buffer::removeBatchFor(std::vector<Lectura>& data, size_t max, int timeoutMs) {
+    data.clear();
+    while (take([&data](const Lectura& lectura) { data.push_back(lectura); }, max) == 0) {
+        if (drained()) {
+            return false;
+        }
+        if (!waitConsumer(timeoutMs)) {
+            return true;
+        }
+    }
+    return true;
+}
+
+// Retira de una sola vez hasta `max` paquetes sin esperar. Devuelve false si el flujo está vacío en este instante.
+bool Buffer::tryRemoveBatch(std::vector<Lectura>& data, size_t max) {
+    data.clear();
+    return take([&data](const Lectura& lectura) { data.push_back(lectura); }, max) > 0;
+}
+
+// Traslada hasta `max` paquetes a `store` y avisa a los productores. Toma todos los carriles y los mezcla
+// entregando siempre el paquete de menor LSN, de modo que con el WAL salen en el orden en que se registraron.
+// Sin WAL los LSN son 0 y se vacía primero el carril por el que toca empezar, que rota en cada retiro.
+template <typename Destino>
+size_t Buffer::take(Destino store, size_t max) {
+    size_t start = lanes.size() > 1 ? nextLane.fetch_add(1, std::memory_order_relaxed) % lanes.size() : 0;
+    for (Lane& lane : lanes) { // Siempre en el mismo orden; los productores solo toman el suyo
+        lock(lane);
+    }
+    size_t taken = 0;
+    while (taken < max) {
+        Lane* best = nullptr;
+        for (size_t i = 0, index = start; i < lanes.size(); ++i, index = index + 1 < lanes.size() ? index + 1 : 0) {
+            Lane& lane = lanes[index];
+            if (lane.used > 0 && (best == nullptr || lane.slots[lane.head].lsn < best->slots[best->head].lsn)) {
+                best = &lane;
+            }
+        }
+        if (best == nullptr) {
+            break;
+        }
+        store(best->slots[best->head]);
+        best->head = best->head + 1 < best->slots.size() ? best->head + 1 : 0;
+        best->used--;
+        taken++;
+    }
+    if (taken > 0) {
+        count.fetch_sub(static_cast<int>(taken));
+    }
+    for (Lane& lane : lanes) {
+        int freed = lane.count.load(std::memory_order_relaxed) - static_cast<int>(lane.used);
+        if (freed > 0) {
+            updateOccupancy(lane);
+            if (freed > 1) {
+                pthread_cond_broadcast(&lane.condProducer); // Se liberó más de un lugar
+            } else {
+                pthread_cond_signal(&lane.condProducer);
+            }
+        }
+        unlock(lane);
+    }
+    return taken;
+}
+
+// El flujo está clausurado y sin paquetes: ya no llegará nada más.
+bool Buffer::drained() const {
+    return closed && count.load() == 0;
+}
+
+// Clausura el flujo: no se aceptan más paquetes y los que quedan se pueden seguir drenando. Despierta a todos los que esperan.
+// Se marca con todos los carriles tomados, así ningún agente deja un paquete después de que el flujo se dio por drenado.
+void Buffer::close() {
+    for (Lane& lane : lanes) {
+        lock(lane);
+    }
+    closed = true;
+    for (Lane& lane : lanes) {
+        pthread_cond_broadcast(&lane.condProducer);
+        unlock(lane);
+    }
+    pthread_mutex_lock(&mutex);
+    pthread_cond_broadcast(&condConsumer);
+    pthread_mutex_unlock(&mutex);
+}
+
+// Conecta el flujo con sus instrumentos de medición. Debe llamarse antes de que circulen paquetes.
+void Buffer::setMetrics(const MetricasBuffer& metrics) {
+    this->metrics = metrics;
+    if (metrics.capacidad != nullptr) {
+        metrics.capacidad->fijar(size.load());
+    }
+    for (Lane& lane : lanes) {
+        lock(lane);
+        updateOccupancy(lane);
+        unlock(lane);
+    }
+}
+
+// Cambia la capacidad de cada carril sin detener el flujo. Las ranuras nuevas se fabrican fuera de los
+// mutex y cada carril se reorganiza con solo el suyo tomado, así que los demás agentes siguen operando y el
+// del carril espera lo que tarda la copia. Al crecer, los carriles se agrandan antes de publicar la capacidad
+// (un agente nunca da la vuelta al anillo); al achicarse, la capacidad se publica antes y un carril con más
+// paquetes que la nueva capacidad los conserva todos: su agente espera a que se drene por debajo del límite.
+void Buffer::resize(int newSize) {
+    newSize = newSize > 0 ? newSize : 1;
+    bool growing = newSize > size.load();
+    if (!growing) {
+        size.store(newSize);
+    }
+    for (Lane& lane : lanes) {
+        std::vector<Lectura> slots(static_cast<size_t>(newSize));
+        lock(lane);
+        if (slots.size() < lane.used) {
+            slots.resize(lane.used); // Excepcional: solo al achicar un carril muy lleno
+        }
+        for (size_t i = 0; i < lane.used; ++i) {
+            size_t index = lane.head + i;
+            slots[i] = lane.slots[index < lane.slots.size() ? index : index - lane.slots.size()];
+        }
+        lane.slots.swap(slots);
+        lane.head = 0;
+        unlock(lane);
+    }
+    if (growing) {
+        size.store(newSize);
+        for (Lane& lane : lanes) {
+            lock(lane);
+            pthread_cond_broadcast(&lane.condProducer); // Hay lugar para los que esperaban
+            unlock(lane);
+        }
+    }
+    if (metrics.capacidad != nullptr) {
+        metrics.capacidad->fijar(newSize);
+    }
+}
+
+// Paquetes en todos los carriles, leídos sin tomar ningún mutex (lo usa el socket de control).
+int Buffer::occupancy() const {
+    return count.load(std::memory_order_relaxed);
+}
+
+// Capacidad total: la de cada carril por la cantidad de carriles.
+int Buffer::capacity() const {
+    return size.load(std::memory_order_relaxed) * static_cast<int>(lanes.size());
+}
+
+// Publica la ocupación del carril y la total con su nivel máximo. Requiere el mutex del carril.
+void Buffer::updateOccupancy(Lane& lane) {
+    lane.count.store(static_cast<int>(lane.used), std::memory_order_relaxed);
+    int64_t ocupacion = count.load(std::memory_order_relaxed);
+    if (metrics.ocupacion != nullptr) {
+        metrics.ocupacion->fijar(ocupacion);
+    }
+    if (metrics.ocupacionMaxima != nullptr) {
+        metrics.ocupacionMaxima->maximo(ocupacion);
+    }
+#ifdef BUFFER_PERFILADO
+    int cubeta = 0; // Cubeta 0: vacío; cubeta i: [2^(i-1), 2^i)
+    while (cubeta < CUBETAS_PROFUNDIDAD - 1 && (1ll << cubeta) <= ocupacion) {
+        cubeta++;
+    }
+    perfil.profundidad[cubeta].fetch_add(1, std::memory_order_relaxed);
+#endif
+}
+
+// Elige entre dormir de inmediato (eficiencia) o vigilar el flujo un instante antes de dormir (latencia).
+void Buffer::setWaitMode(ModoEspera mode) {
+    waitPolicy.fijarModo(mode);
+}
+
+// Vigila el flujo sin el mutex hasta que `ready` se cumpla o se agote el presupuesto de giro. Mientras el
+// que espera gira, la señal del otro extremo no encuentra a nadie dormido y no llega al futex.
+template <typename Condicion>
+void Buffer::spin(Condicion ready) {
+    if (waitPolicy.modo() != ESPERA_LATENCIA) {
+        return;
+    }
+    Contador* resultado = waitPolicy.girar(ready) ? metrics.girosExitosos : metrics.girosFallidos;
+    if (resultado != nullptr) {
+        resultado->sumar();
+    }
+}
+
+// Toma el control de un carril. Con BUFFER_PERFILADO se mide cuánto costó entrar y desde cuándo se retiene.
+void Buffer::lock(Lane& lane) {
+#ifdef BUFFER_PERFILADO
+    uint64_t inicio = relojNs();
+    pthread_mutex_lock(&lane.mutex);
+    lane.tomado = relojNs();
+    perfil.adquisicion.observar(lane.tomado - inicio);
+#else
+    pthread_mutex_lock(&lane.mutex);
+#endif
+}
+
+// Libera el control de un carril. Con BUFFER_PERFILADO se registra el tiempo de retención.
+void Buffer::unlock(Lane& lane) {
+#ifdef BUFFER_PERFILADO
+    perfil.retencion.observar(relojNs() - lane.tomado);
+#endif
+    pthread_mutex_unlock(&lane.mutex);
+}
+
+// Un productor aguarda a que se libere espacio en su carril. Con BUFFER_PERFILADO se cuentan los despertares
+// y los que no encontraron espacio (espurios o robados por otro productor del mismo carril).
+void Buffer::waitProducer(Lane& lane) {
+#ifdef BUFFER_PERFILADO
+    uint64_t inicio = relojNs();
+    perfil.retencion.observar(inicio - lane.tomado); // La espera suelta el mutex
+    pthread_cond_wait(&lane.condProducer, &lane.mutex);
+    lane.tomado = relojNs();
+    perfil.esperaProductor.observar(lane.tomado - inicio);
+    perfil.despertaresProductor.fetch_add(1, std::memory_order_relaxed);
+    if (lane.used >= static_cast<size_t>(size.load()) && !closed) {
+        perfil.espuriosProductor.fetch_add(1, std::memory_order_relaxed);
+    }
+#else
+    pthread_cond_wait(&lane.condProducer, &lane.mutex);
+#endif
+}
+
+// Un consumidor aguarda a que llegue un paquete a cualquier carril o a que se clausure el flujo. Anota su
+// espera antes de revisar `count`, y los productores suben `count` antes de revisar `sleepers`: uno de los
+// dos ve al otro, así que el aviso no se pierde. Con BUFFER_PERFILADO, mismo registro que waitProducer().
+// Con `timeoutMs` no negativo la espera tiene plazo; devuelve false si venció sin paquetes.
+bool Buffer::waitConsumer(int timeoutMs) {
+    struct timespec plazo;
+    if (timeoutMs >= 0) {
+        clock_gettime(CLOCK_REALTIME, &plazo); // El reloj por omisión de pthread_cond_timedwait
+        plazo.tv_sec += timeoutMs / 1000;
+        plazo.tv_nsec += static_cast<long>(timeoutMs % 1000) * 1000000L;
+        if (plazo.tv_nsec >= 1000000000L) {
+            plazo.tv_sec++;
+            plazo.tv_nsec -= 1000000000L;
+        }
+    }
     pthread_mutex_lock(&mutex);
-    while (dataQueue.empty()) {
-        pthread_cond_wait(&condConsumer, &mutex);
+    sleepers.fetch_add(1);
+    uint64_t inicio = relojNs();
+    bool waited = false;
+    bool expired = false;
+    while (count.load() == 0 && !closed && !expired) {
+        if (timeoutMs >= 0) {
+            expired = pthread_cond_timedwait(&condConsumer, &mutex, &plazo) == ETIMEDOUT;
+        } else {
+            pthread_cond_wait(&condConsumer, &mutex);
+        }
+        waited = true;
+#ifdef BUFFER_PERFILADO
+        perfil.despertaresConsumidor.fetch_add(1, std::memory_order_relaxed);
+        if (count.load() == 0 && !closed && !expired) {
+            perfil.espuriosConsumidor.fetch_add(1, std::memory_order_relaxed);
+        }
+#endif
     }
-    std::string data = dataQueue.front();
-    dataQueue.pop();
-    pthread_cond_signal(&condProducer);
+    sleepers.fetch_sub(1);
     pthread_mutex_unlock(&mutex);
-    return data;
+    if (waited) { // Solo se mide el tiempo cuando hubo que esperar
+        uint64_t espera = relojNs() - inicio;
+        if (metrics.esperaRemove != nullptr) {
+            metrics.esperaRemove->observar(espera);
+        }
+#ifdef BUFFER_PERFILADO
+        perfil.esperaConsumidor.observar(espera);
+#endif
+    }
+    return !expired;
 }
 
+// Avisa a un consumidor dormido, si lo hay, de que llegó un paquete.
+void Buffer::wakeConsumer() {
+    if (sleepers.load() > 0) {
+        pthread_mutex_lock(&mutex);
+        pthread_cond_signal(&condConsumer);
+        pthread_mutex_unlock(&mutex);
+    }
+}
 
+/**
+ * Informe de contención del buffer: esperas en las variables de condición, adquisición y retención del
+ * mutex de los carriles, despertares y distribución de la ocupación. Sin BUFFER_PERFILADO solo indica que
+ * está desactivado.
+ *
+ * @return Texto legible, una métrica por línea.
+ */
+std::string Buffer::profile() {
+#ifdef BUFFER_PERFILADO
+    std::ostringstream salida;
+    auto histograma = [&salida](const char* nombre, const Histograma& h) {
+        salida << "  " << nombre << ": " << h.cantidad() << " veces, total " << h.suma() / 1000 << " us";
+        if (h.cantidad() > 0) {
+            salida << ", p50 <= " << h.percentil(0.5) << " ns, p99 <= " << h.percentil(0.99) << " ns";
+        }
+        salida << "\n";
+    };
+    histograma("espera en condProducer", perfil.esperaProductor);
+    histograma("espera en condConsumer", perfil.esperaConsumidor);
+    histograma("adquisición del mutex", perfil.adquisicion);
+    histograma("retención del mutex", perfil.retencion);
+    salida << "  despertares de productores: " << perfil.despertaresProductor << " (" << perfil.espuriosProductor
+           << " sin espacio)\n";
+    salida << "  despertares de consumidores: " << perfil.despertaresConsumidor << " (" << perfil.espuriosConsumidor
+           << " sin datos)\n";
+    salida << "  ocupación:";
+    for (int i = 0; i < CUBETAS_PROFUNDIDAD; ++i) {
+        uint64_t veces = perfil.profundidad[i].load(std::memory_order_relaxed);
+        if (veces == 0) {
+            continue;
+        }
+        if (i == 0) {
+            salida << " [0]=";
+        } else {
+            salida << " [" << (1ll << (i - 1)) << "," << (1ll << i) << ")=";
+        }
+        salida << veces;
+    }
+    salida << " (capacidad " << size.load() << " por carril, " << lanes.size() << " carriles)\n";
+    return salida.str();
+#else
+    return "  perfilado desactivado (compilar con -DBUFFER_PERFILADO=ON)\n";
+#endif
+}
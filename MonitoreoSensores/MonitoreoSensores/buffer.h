@@ -1,25 +1,111 @@
 #ifndef BUFFER_H
 #define BUFFER_H
 
-#include <queue>
+#include <atomic>
+#include <deque>
 #include <pthread.h>
 #include <string>
+#include <vector>
+#include "espera.h"
+#include "lectura.h"
+#include "metricas.h"
 
+/**
+ * Métricas opcionales del buffer; los punteros nulos se ignoran.
+ */
+struct MetricasBuffer {
+    Medidor* capacidad = nullptr;        ///< Capacidad de cada carril
+    Medidor* ocupacion = nullptr;        ///< Elementos en cola
+    Medidor* ocupacionMaxima = nullptr;  ///< Nivel máximo de ocupación alcanzado
+    Histograma* esperaAdd = nullptr;     ///< Tiempo bloqueado en add() con el buffer lleno
+    Histograma* esperaRemove = nullptr;  ///< Tiempo bloqueado en remove() con el buffer vacío
+    Contador* girosExitosos = nullptr;   ///< Esperas resueltas girando, sin bloquear
+    Contador* girosFallidos = nullptr;   ///< Esperas que agotaron el giro y bloquearon
+};
+
+#ifdef BUFFER_PERFILADO
+const int CUBETAS_PROFUNDIDAD = 24;  ///< Cubetas de la distribución de ocupación (potencias de dos)
+
+/**
+ * Perfil de contención del buffer. Solo existe al compilar con BUFFER_PERFILADO. Los carriles se
+ * actualizan en paralelo, así que los contadores son atómicos (relajados).
+ */
+struct PerfilBuffer {
+    Histograma esperaProductor;              ///< Tiempo en pthread_cond_wait sobre condProducer
+    Histograma esperaConsumidor;             ///< Tiempo en pthread_cond_wait sobre condConsumer
+    Histograma adquisicion;                  ///< Tiempo hasta obtener el mutex de un carril
+    Histograma retencion;                    ///< Tiempo con el mutex de un carril tomado, sin contar las esperas
+    std::atomic<uint64_t> despertaresProductor{0};   ///< Retornos de la espera en condProducer
+    std::atomic<uint64_t> espuriosProductor{0};      ///< Despertares de productores que no encontraron espacio
+    std::atomic<uint64_t> despertaresConsumidor{0};  ///< Retornos de la espera en condConsumer
+    std::atomic<uint64_t> espuriosConsumidor{0};     ///< Despertares de consumidores que no encontraron datos
+    std::atomic<uint64_t> profundidad[CUBETAS_PROFUNDIDAD] = {};  ///< Ocupación tras cada operación
+};
+#endif
+
+/**
+ * Buffer acotado entre los productores (recolectores) y los consumidores de un canal.
+ *
+ * Cada productor tiene su propio carril: un anillo de `size` ranuras reservadas al crear el buffer, con su
+ * propio mutex, de modo que los productores no compiten entre sí y agregar o retirar mediciones no reserva
+ * memoria. Los consumidores mezclan los carriles en orden de LSN; las mediciones de un mismo carril salen en
+ * el orden en que entraron. La capacidad se puede cambiar sin detener el flujo (ver resize()).
+ */
 class Buffer {
 private:
-    std::queue<std::string> dataQueue;
-    pthread_mutex_t mutex;
-    pthread_cond_t condProducer;
+    // Carril de un productor.
+    struct Lane {
+        pthread_mutex_t mutex;
+        pthread_cond_t condProducer;
+        std::vector<Lectura> slots;  // Ranuras reservadas de una vez; forman un anillo
+        size_t head = 0;             // Ranura de la medición más antigua
+        size_t used = 0;             // Ranuras ocupadas
+        std::atomic<int> count{0};   // Copia de `used` que se puede leer sin el mutex mientras se gira
+#ifdef BUFFER_PERFILADO
+        uint64_t tomado = 0;         // Momento en que se tomó el mutex por última vez
+#endif
+    };
+
+    std::deque<Lane> lanes;
+    pthread_mutex_t mutex;          // Solo para dormir a los consumidores
     pthread_cond_t condConsumer;
-    int size;
+    std::atomic<int> size;          // Capacidad de cada carril; puede cambiar en caliente con resize()
+    std::atomic<bool> closed;
+    MetricasBuffer metrics;
+    EsperaAdaptativa waitPolicy;
+    std::atomic<int> count;         // Mediciones en todos los carriles
+    std::atomic<int> sleepers;      // Consumidores dormidos (o por dormirse) en condConsumer
+    std::atomic<unsigned> nextLane; // Carril por el que empieza el próximo retiro
+#ifdef BUFFER_PERFILADO
+    PerfilBuffer perfil;
+#endif
+
+    void updateOccupancy(Lane& lane);
+    void lock(Lane& lane);
+    void unlock(Lane& lane);
+    void waitProducer(Lane& lane);
+    bool waitConsumer(int timeoutMs = -1);
+    void wakeConsumer();
+    template <typename Condicion> void spin(Condicion ready);
+    template <typename Destino> size_t take(Destino store, size_t max);
+    bool drained() const;
 
 public:
-    Buffer(int size);
+    Buffer(int size, int producers = 1);
     ~Buffer();
-    void add(std::string data);
-    std::string remove();
+    bool add(const Lectura& data, int producer = 0);
+    bool remove(Lectura& data);
+    bool tryRemove(Lectura& data);
+    bool removeBatch(std::vector<Lectura>& data, size_t max);
+    bool removeBatchFor(std::vector<Lectura>& data, size_t max, int timeoutMs);
+    bool tryRemoveBatch(std::vector<Lectura>& data, size_t max);
+    void close();
+    void setMetrics(const MetricasBuffer& metrics);
+    void resize(int size);
+    int occupancy() const;
+    int capacity() const;
+    std::string profile();
+    void setWaitMode(ModoEspera mode);
 };
 
 #endif //BUFFER_H
-
-
@@ -0,0 +1,155 @@
+/**
+ * @file clasificacion.cpp
+ * @autores Juan Pablo Hernández Ceballos
+ * Implementa los núcleos de clasificación escalar, SSE2 y AVX2 y la selección en tiempo de ejecución.
+ *
+ * Los núcleos vectoriales se compilan con atributos `target`, de modo que el binario corre en cualquier
+ * CPU x86-64 y solo usa AVX2 si la CPU lo anuncia. Los valores NaN se consideran inválidos.
+ */
+
+#include "clasificacion.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CLASIFICACION_X86 1
+#endif
+
+namespace {
+
+// Clasifica los valores [inicio, fin) de una palabra de máscara, uno por uno.
+void clasificarEscalar(const float* valores, size_t inicio, size_t fin, const LimitesCanal& limites,
+                       uint64_t& invalidas, uint64_t& alertas) {
+    for (size_t i = inicio; i < fin; ++i) {
+        float v = valores[i];
+        uint64_t bit = 1ull << (i % BITS_MASCARA);
+        if (!(v >= limites.minimo && v <= limites.maximo)) {
+            invalidas |= bit;
+        } else if (v <= limites.alertaBaja || v >= limites.alertaAlta) {
+            alertas |= bit;
+        }
+    }
+}
+
+#ifdef CLASIFICACION_X86
+// Clasifica una palabra de máscara de 4 en 4 valores; el resto se hace en escalar.
+void clasificarSse2(const float* valores, size_t inicio, size_t fin, const LimitesCanal& limites,
+                    uint64_t& invalidas, uint64_t& alertas) {
+    const __m128 minimo = _mm_set1_ps(limites.minimo);
+    const __m128 maximo = _mm_set1_ps(limites.maximo);
+    const __m128 baja = _mm_set1_ps(limites.alertaBaja);
+    const __m128 alta = _mm_set1_ps(limites.alertaAlta);
+    size_t i = inicio;
+    for (; i + 4 <= fin; i += 4) {
+        __m128 v = _mm_loadu_ps(valores + i);
+        __m128 invalida = _mm_or_ps(_mm_cmpnge_ps(v, minimo), _mm_cmpnle_ps(v, maximo)); // NaN: inválida
+        __m128 alerta = _mm_andnot_ps(invalida, _mm_or_ps(_mm_cmple_ps(v, baja), _mm_cmpge_ps(v, alta)));
+        unsigned desplazamiento = i % BITS_MASCARA;
+        invalidas |= static_cast<uint64_t>(_mm_movemask_ps(invalida)) << desplazamiento;
+        alertas |= static_cast<uint64_t>(_mm_movemask_ps(alerta)) << desplazamiento;
+    }
+    clasificarEscalar(valores, i, fin, limites, invalidas, alertas);
+}
+
+// Clasifica una palabra de máscara de 8 en 8 valores; el resto se hace en escalar.
+__attribute__((target("avx2")))
+void clasificarAvx2(const float* valores, size_t inicio, size_t fin, const LimitesCanal& limites,
+                    uint64_t& invalidas, uint64_t& alertas) {
+    const __m256 minimo = _mm256_set1_ps(limites.minimo);
+    const __m256 maximo = _mm256_set1_ps(limites.maximo);
+    const __m256 baja = _mm256_set1_ps(limites.alertaBaja);
+    const __m256 alta = _mm256_set1_ps(limites.alertaAlta);
+    size_t i = inicio;
+    for (; i + 8 <= fin; i += 8) {
+        __m256 v = _mm256_loadu_ps(valores + i);
+        __m256 invalida = _mm256_or_ps(_mm256_cmp_ps(v, minimo, _CMP_NGE_UQ), _mm256_cmp_ps(v, maximo, _CMP_NLE_UQ));
+        __m256 alerta = _mm256_andnot_ps(invalida, _mm256_or_ps(_mm256_cmp_ps(v, baja, _CMP_LE_OQ),
+                                                                _mm256_cmp_ps(v, alta, _CMP_GE_OQ)));
+        unsigned desplazamiento = i % BITS_MASCARA;
+        invalidas |= static_cast<uint64_t>(_mm256_movemask_ps(invalida)) << desplazamiento;
+        alertas |= static_cast<uint64_t>(_mm256_movemask_ps(alerta)) << desplazamiento;
+    }
+    clasificarEscalar(valores, i, fin, limites, invalidas, alertas);
+}
+#endif
+
+typedef void (*NucleoClasificacion)(const float*, size_t, size_t, const LimitesCanal&, uint64_t&, uint64_t&);
+
+// Núcleo de cada implementación (nullptr si no está disponible en esta arquitectura).
+NucleoClasificacion nucleo(ImplementacionSimd implementacion) {
+    switch (implementacion) {
+#ifdef CLASIFICACION_X86
+        case SIMD_AVX2:
+            return clasificarAvx2;
+        case SIMD_SSE2:
+            return clasificarSse2;
+#endif
+        case SIMD_ESCALAR:
+            return clasificarEscalar;
+        default:
+            return nullptr;
+    }
+}
+
+} // namespace
+
+/**
+ * Indica si la CPU actual puede ejecutar una implementación.
+ */
+bool implementacionDisponible(ImplementacionSimd implementacion) {
+#ifdef CLASIFICACION_X86
+    if (implementacion == SIMD_AVX2) {
+        return __builtin_cpu_supports("avx2");
+    }
+    if (implementacion == SIMD_SSE2) {
+        return __builtin_cpu_supports("sse2");
+    }
+#endif
+    return implementacion == SIMD_ESCALAR;
+}
+
+/**
+ * Mejor implementación disponible en la CPU actual. Se calcula una sola vez.
+ */
+ImplementacionSimd mejorImplementacion() {
+    static const ImplementacionSimd mejor = implementacionDisponible(SIMD_AVX2) ? SIMD_AVX2
+                                          : implementacionDisponible(SIMD_SSE2) ? SIMD_SSE2
+                                          : SIMD_ESCALAR;
+    return mejor;
+}
+
+const char* nombreImplementacion(ImplementacionSimd implementacion) {
+    static const char* const nombres[] = {"escalar", "sse2", "avx2"};
+    return nombres[implementacion];
+}
+
+/**
+ * Clasifica un lote con la mejor implementación disponible.
+ *
+ * @param valores Valores del lote.
+ * @param n Cantidad de valores.
+ * @param limites Límites del canal.
+ * @param invalidas Recibe la máscara de valores fuera de [minimo, maximo]; ceil(n / 64) palabras.
+ * @param alertas Recibe la máscara de valores válidos en zona de alerta; ceil(n / 64) palabras.
+ */
+void clasificarLote(const float* valores, size_t n, const LimitesCanal& limites, uint64_t* invalidas,
+                    uint64_t* alertas) {
+    clasificarLote(mejorImplementacion(), valores, n, limites, invalidas, alertas);
+}
+
+/**
+ * Clasifica un lote con una implementación concreta (debe estar disponible), por ejemplo para compararlas.
+ */
+void clasificarLote(ImplementacionSimd implementacion, const float* valores, size_t n, const LimitesCanal& limites,
+                    uint64_t* invalidas, uint64_t* alertas) {
+    NucleoClasificacion clasificar = nucleo(implementacion);
+    if (clasificar == nullptr) {
+        clasificar = clasificarEscalar;
+    }
+    for (size_t palabra = 0; palabra * BITS_MASCARA < n; ++palabra) {
+        size_t inicio = palabra * BITS_MASCARA;
+        size_t fin = inicio + BITS_MASCARA < n ? inicio + BITS_MASCARA : n;
+        invalidas[palabra] = 0;
+        alertas[palabra] = 0;
+        clasificar(valores, inicio, fin, limites, invalidas[palabra], alertas[palabra]);
+    }
+}
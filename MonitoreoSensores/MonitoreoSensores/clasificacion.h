@@ -0,0 +1,49 @@
+/**
+ * @file clasificacion.h
+ * @autores Juan Pablo Hernández Ceballos
+ * Clasificación vectorizada de lotes de mediciones contra los límites de su canal.
+ *
+ * Un lote de valores flotantes se compara de una vez contra el rango válido y los umbrales de alerta
+ * del canal, y el resultado se entrega como máscaras de bits (bit i = medición i). Así las etapas
+ * siguientes solo recorren las mediciones marcadas. Hay implementaciones AVX2 (8 valores por
+ * instrucción), SSE2 (4) y escalar; la mejor disponible se elige al iniciar según la CPU.
+ */
+
+#ifndef CLASIFICACION_H
+#define CLASIFICACION_H
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Límites de un canal. Un valor es válido si está en [minimo, maximo]; un valor válido genera una
+ * alerta si es menor o igual que `alertaBaja` o mayor o igual que `alertaAlta`.
+ */
+struct LimitesCanal {
+    float minimo;      ///< Menor valor válido
+    float maximo;      ///< Mayor valor válido
+    float alertaBaja;  ///< Umbral inferior de alerta (inclusive)
+    float alertaAlta;  ///< Umbral superior de alerta (inclusive)
+};
+
+/**
+ * Implementaciones del núcleo de clasificación.
+ */
+enum ImplementacionSimd {
+    SIMD_ESCALAR = 0,  ///< Una comparación por medición
+    SIMD_SSE2 = 1,     ///< 4 mediciones por instrucción
+    SIMD_AVX2 = 2      ///< 8 mediciones por instrucción
+};
+
+const size_t BITS_MASCARA = 64;  ///< Mediciones por palabra de máscara
+
+ImplementacionSimd mejorImplementacion();
+bool implementacionDisponible(ImplementacionSimd implementacion);
+const char* nombreImplementacion(ImplementacionSimd implementacion);
+
+void clasificarLote(const float* valores, size_t n, const LimitesCanal& limites, uint64_t* invalidas,
+                    uint64_t* alertas);
+void clasificarLote(ImplementacionSimd implementacion, const float* valores, size_t n, const LimitesCanal& limites,
+                    uint64_t* invalidas, uint64_t* alertas);
+
+#endif //CLASIFICACION_H
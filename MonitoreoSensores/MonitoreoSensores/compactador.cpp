@@ -0,0 +1,469 @@
+/**
+ * @file compactador.cpp
+ * @autores Juan Pablo Hernández Ceballos
+ * Implementa la compactación y la retención de los archivos de salida sellados.
+ */
+
+#include "compactador.h"
+#include "archivos_salida.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <iostream>
+#include <map>
+#include <sched.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+
+const char FIRMA_COMPACTADO[4] = {'M', 'S', 'C', '1'};  // Firma de los archivos compactados
+const size_t TAM_BLOQUE = 65536;                         // Bytes que se leen y escriben de una vez
+const int IOPRIO_QUIEN_PROCESO = 1;                      // IOPRIO_WHO_PROCESS (con tid 0: el hilo actual)
+const int IOPRIO_CLASE_OCIOSA = 3;                       // IOPRIO_CLASS_IDLE
+const int IOPRIO_DESPLAZAMIENTO = 13;                    // IOPRIO_CLASS_SHIFT
+const int MARGEN_SELLADO_S = 2;                          // Segundos que debe tener un sellado para compactarlo
+
+void escribirVarint(std::string& salida, uint64_t valor) {
+    while (valor >= 0x80) {
+        salida.push_back(static_cast<char>(valor | 0x80));
+        valor >>= 7;
+    }
+    salida.push_back(static_cast<char>(valor));
+}
+
+bool leerVarint(const unsigned char*& p, const unsigned char* fin, uint64_t& valor) {
+    valor = 0;
+    for (int desplazamiento = 0; p < fin && desplazamiento < 64; desplazamiento += 7) {
+        unsigned char byte = *p++;
+        valor |= static_cast<uint64_t>(byte & 0x7f) << desplazamiento;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Escribe todo el bloque, reintentando si write() escribe solo una parte.
+bool escribirTodo(int fd, const char* datos, size_t largo) {
+    while (largo > 0) {
+        ssize_t escritos = write(fd, datos, largo);
+        if (escritos < 0) {
+            return false;
+        }
+        datos += escritos;
+        largo -= escritos;
+    }
+    return true;
+}
+
+uint64_t zigzag(int64_t n) {
+    return (static_cast<uint64_t>(n) << 1) ^ static_cast<uint64_t>(n >> 63);
+}
+
+int64_t deshacerZigzag(uint64_t n) {
+    return static_cast<int64_t>(n >> 1) ^ -static_cast<int64_t>(n & 1);
+}
+
+uint32_t bitsDe(float valor) {
+    uint32_t bits;
+    memcpy(&bits, &valor, sizeof(bits));
+    return bits;
+}
+
+float flotanteDe(uint32_t bits) {
+    float valor;
+    memcpy(&valor, &bits, sizeof(valor));
+    return valor;
+}
+
+// Interpreta una línea de texto `valor HH:MM:SS`.
+bool leerLinea(const char* linea, size_t largo, Canal canal, double& valor, int32_t& segundos) {
+    std::string texto(linea, largo);
+    char* fin;
+    valor = canal == CANAL_PH ? std::strtof(texto.c_str(), &fin) : std::strtol(texto.c_str(), &fin, 10);
+    int horas, minutos, segs;
+    if (fin == texto.c_str() || sscanf(fin, " %d:%d:%d", &horas, &minutos, &segs) != 3) {
+        return false;
+    }
+    segundos = horas * 3600 + minutos * 60 + segs;
+    return true;
+}
+
+// Hora de rotación (AAAAMMDD-HHMMSS-NNN) como segundos desde el epoch.
+std::time_t instanteDe(const std::string& sello) {
+    std::tm local;
+    memset(&local, 0, sizeof(local));
+    if (sscanf(sello.c_str(), "%4d%2d%2d-%2d%2d%2d", &local.tm_year, &local.tm_mon, &local.tm_mday, &local.tm_hour,
+               &local.tm_min, &local.tm_sec) != 6) {
+        return 0;
+    }
+    local.tm_year -= 1900;
+    local.tm_mon -= 1;
+    local.tm_isdst = -1;
+    return mktime(&local);
+}
+
+// Separa el nombre de un archivo compactado (`base.DESDE_HASTA.msc`).
+bool separarCompactado(const std::string& nombre, std::string& base, std::string& desde, std::string& hasta) {
+    size_t largoExtension = strlen(EXTENSION_COMPACTADO);
+    if (nombre.size() <= largoExtension ||
+        nombre.compare(nombre.size() - largoExtension, largoExtension, EXTENSION_COMPACTADO) != 0) {
+        return false;
+    }
+    std::string sinExtension = nombre.substr(0, nombre.size() - largoExtension);
+    size_t separador = sinExtension.rfind('_');
+    if (separador == std::string::npos) {
+        return false;
+    }
+    hasta = sinExtension.substr(separador + 1);
+    return esSello(hasta) && separarSello(sinExtension.substr(0, separador), base, desde);
+}
+
+} // namespace
+
+/**
+ * Lee las mediciones de un archivo de salida, de texto o compactado.
+ *
+ * @param ruta Archivo a leer.
+ * @param canal Canal de sus mediciones (define cómo se interpreta el valor).
+ * @param visitar Recibe cada medición (valor y hora en segundos del día); si devuelve false, la lectura se detiene.
+ * @param leidos Recibe los bytes de cada bloque leído; si devuelve false, la lectura se detiene (puede ser nulo).
+ * @return false si el archivo no se pudo leer completo o tiene una línea mal formada.
+ */
+bool leerSegmento(const std::string& ruta, Canal canal, const std::function<bool(double, int32_t)>& visitar,
+                  const std::function<bool(size_t)>& leidos) {
+    int fd = open(ruta.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    std::string datos;  // Texto pendiente de una línea incompleta, o el archivo compactado completo
+    std::vector<char> bloque(TAM_BLOQUE);
+    bool compactado = false, primero = true, correcto = true;
+    ssize_t leido;
+    while (correcto && (leido = read(fd, bloque.data(), bloque.size())) > 0) {
+        if (leidos && !leidos(static_cast<size_t>(leido))) {
+            correcto = false;
+            break;
+        }
+        if (primero) {
+            compactado = leido >= static_cast<ssize_t>(sizeof(FIRMA_COMPACTADO)) &&
+                         memcmp(bloque.data(), FIRMA_COMPACTADO, sizeof(FIRMA_COMPACTADO)) == 0;
+            primero = false;
+        }
+        datos.append(bloque.data(), leido);
+        if (compactado) {
+            continue; // Se decodifica al final
+        }
+        size_t inicio = 0, fin;
+        while (correcto && (fin = datos.find('\n', inicio)) != std::string::npos) {
+            double valor;
+            int32_t segundos;
+            correcto = leerLinea(datos.data() + inicio, fin - inicio, canal, valor, segundos) && visitar(valor, segundos);
+            inicio = fin + 1;
+        }
+        datos.erase(0, inicio);
+    }
+    close(fd);
+    if (!correcto || leido < 0) {
+        return false;
+    }
+    if (!compactado) {
+        return datos.empty(); // Una línea sin terminar es un archivo incompleto
+    }
+
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(datos.data()) + sizeof(FIRMA_COMPACTADO);
+    const unsigned char* fin = reinterpret_cast<const unsigned char*>(datos.data()) + datos.size();
+    if (p >= fin || *p++ != canal) {
+        return false;
+    }
+    int64_t segundos = 0, entero = 0;
+    uint32_t bits = 0;
+    uint64_t delta, codigo;
+    while (p < fin) {
+        if (!leerVarint(p, fin, delta) || !leerVarint(p, fin, codigo)) {
+            return false;
+        }
+        segundos += deshacerZigzag(delta);
+        double valor;
+        if (canal == CANAL_PH) {
+            bits ^= static_cast<uint32_t>(codigo);
+            valor = flotanteDe(bits);
+        } else {
+            entero += deshacerZigzag(codigo);
+            valor = static_cast<double>(entero);
+        }
+        if (!visitar(valor, static_cast<int32_t>(segundos))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @param fuentes Directorios y archivos que se revisan.
+ * @param retencion Segundos que se conservan los datos sellados (0 = siempre).
+ */
+Compactador::Compactador(const std::vector<FuenteCompactacion>& fuentes, int64_t retencion)
+    : fuentes(fuentes), retencion(retencion), detenido(false) {
+    pthread_mutex_init(&mutex, nullptr);
+    pthread_cond_init(&condicion, nullptr);
+}
+
+Compactador::~Compactador() {
+    pthread_mutex_destroy(&mutex);
+    pthread_cond_destroy(&condicion);
+}
+
+// Conecta las métricas del compactador (cualquiera puede ser nullptr).
+void Compactador::conectarMetricas(Contador* compactados, Contador* expirados, Contador* bytesLeidos) {
+    this->compactados = compactados;
+    this->expirados = expirados;
+    this->bytesLeidos = bytesLeidos;
+}
+
+/**
+ * Cambia la retención; se aplica desde la siguiente revisión de los directorios.
+ *
+ * @param retencion Segundos que se conservan los datos sellados (0 = siempre).
+ */
+void Compactador::cambiarRetencion(int64_t retencion) {
+    this->retencion.store(retencion);
+}
+
+/**
+ * Pide al hilo que termine. Una compactación en curso se abandona sin tocar los archivos sellados.
+ */
+void Compactador::detener() {
+    pthread_mutex_lock(&mutex);
+    detenido = true;
+    pthread_cond_signal(&condicion);
+    pthread_mutex_unlock(&mutex);
+}
+
+// Espera el tiempo indicado o hasta que se pida terminar. Devuelve false si se pidió terminar.
+bool Compactador::esperar(long nanosegundos) {
+    struct timespec limite;
+    clock_gettime(CLOCK_REALTIME, &limite);
+    limite.tv_sec += nanosegundos / 1000000000L;
+    limite.tv_nsec += nanosegundos % 1000000000L;
+    if (limite.tv_nsec >= 1000000000L) {
+        limite.tv_sec++;
+        limite.tv_nsec -= 1000000000L;
+    }
+    pthread_mutex_lock(&mutex);
+    while (!detenido && pthread_cond_timedwait(&condicion, &mutex, &limite) != ETIMEDOUT) {
+    }
+    bool seguir = !detenido;
+    pthread_mutex_unlock(&mutex);
+    return seguir;
+}
+
+/**
+ * Bucle del compactador: baja su prioridad de CPU y de E/S y revisa los directorios hasta que se le
+ * pide terminar.
+ */
+void Compactador::ejecutar() {
+    struct sched_param parametro;
+    memset(&parametro, 0, sizeof(parametro));
+    pthread_setschedparam(pthread_self(), SCHED_IDLE, &parametro); // Solo corre cuando la CPU está libre
+    syscall(SYS_ioprio_set, IOPRIO_QUIEN_PROCESO, 0, IOPRIO_CLASE_OCIOSA << IOPRIO_DESPLAZAMIENTO); // Idem con el disco
+    do {
+        for (const FuenteCompactacion& fuente : fuentes) {
+            revisar(fuente);
+        }
+    } while (esperar(INTERVALO_COMPACTACION_S * 1000000000L));
+}
+
+/**
+ * Revisa un directorio: borra lo que superó la retención y los restos de compactaciones interrumpidas,
+ * y compacta los grupos de archivos sellados consecutivos de cada archivo activo.
+ *
+ * @param fuente Directorio y archivo activo a revisar.
+ */
+void Compactador::revisar(const FuenteCompactacion& fuente) {
+    DIR* directorio = opendir(fuente.directorio.c_str());
+    if (directorio == nullptr) {
+        return;
+    }
+    std::map<std::string, std::vector<Archivo>> porBase;  // Archivos de cada archivo activo
+    std::time_t ahora = std::time(nullptr);
+    int64_t retenidos = retencion.load(); // La misma retención en toda la revisión
+    struct dirent* entrada;
+    while ((entrada = readdir(directorio)) != nullptr) {
+        Archivo archivo;
+        archivo.nombre = entrada->d_name;
+        std::string ruta = fuente.directorio + "/" + archivo.nombre;
+        size_t largo = archivo.nombre.size();
+        if (largo > 4 && archivo.nombre.compare(largo - 4, 4, ".tmp") == 0 &&
+            archivo.nombre.find(EXTENSION_COMPACTADO) != std::string::npos) {
+            unlink(ruta.c_str()); // Resto de una compactación interrumpida
+            continue;
+        }
+        archivo.compactado = separarCompactado(archivo.nombre, archivo.base, archivo.desde, archivo.hasta);
+        if (!archivo.compactado) {
+            if (!separarSello(archivo.nombre, archivo.base, archivo.desde)) {
+                continue; // Archivo activo u otro archivo
+            }
+            archivo.hasta = archivo.desde;
+        }
+        struct stat info;
+        if ((!fuente.prefijo.empty() && archivo.base != fuente.prefijo) || stat(ruta.c_str(), &info) < 0) {
+            continue;
+        }
+        archivo.tamano = static_cast<uint64_t>(info.st_size);
+        archivo.modificado = info.st_mtime;
+        if (retenidos > 0 && archivo.modificado < ahora - retenidos) {
+            if (unlink(ruta.c_str()) == 0 && expirados != nullptr) { // Sus datos superaron la retención
+                expirados->sumar();
+            }
+            continue;
+        }
+        porBase[archivo.base].push_back(archivo);
+    }
+    closedir(directorio);
+
+    for (auto& base : porBase) {
+        std::vector<Archivo>& archivos = base.second;
+        std::sort(archivos.begin(), archivos.end(), [](const Archivo& a, const Archivo& b) {
+            return a.desde != b.desde ? a.desde < b.desde : a.hasta > b.hasta; // Los compactados, antes de lo que contienen
+        });
+        // Un archivo dentro del rango de un compactado anterior ya está en él: quedó de una compactación interrumpida
+        std::vector<Archivo> vigentes;
+        for (const Archivo& archivo : archivos) {
+            if (!vigentes.empty() && archivo.hasta <= vigentes.back().hasta) {
+                unlink((fuente.directorio + "/" + archivo.nombre).c_str());
+                continue;
+            }
+            vigentes.push_back(archivo);
+        }
+
+        // Agrupar archivos consecutivos hasta el tamaño objetivo y compactar cada grupo
+        std::vector<Archivo> grupo;
+        uint64_t tamanoGrupo = 0;
+        bool conTexto = false;
+        for (size_t i = 0; i <= vigentes.size(); ++i) {
+            bool candidato = i < vigentes.size() && rechazados.count(vigentes[i].nombre) == 0 &&
+                             (!vigentes[i].compactado || vigentes[i].tamano < MAXIMO_RECOMPACTAR) &&
+                             instanteDe(vigentes[i].hasta) < ahora - MARGEN_SELLADO_S;
+            if (candidato) {
+                grupo.push_back(vigentes[i]);
+                tamanoGrupo += vigentes[i].tamano;
+                conTexto = conTexto || !vigentes[i].compactado;
+            }
+            if (!candidato || tamanoGrupo >= OBJETIVO_COMPACTACION) {
+                if ((conTexto || grupo.size() > 1) && !compactar(fuente, grupo)) {
+                    return; // Se pidió terminar o hubo un error; se reintenta en la próxima revisión
+                }
+                grupo.clear();
+                tamanoGrupo = 0;
+                conTexto = false;
+            }
+        }
+    }
+}
+
+/**
+ * Reescribe un grupo de archivos consecutivos en un solo archivo compactado, leyéndolos al ritmo
+ * limitado. El compactado se escribe en un temporal, se sincroniza y se renombra antes de borrar los
+ * originales; conserva la hora de modificación del más reciente, que es la que cuenta para la retención.
+ *
+ * @param fuente Directorio y canal de los archivos.
+ * @param grupo Archivos a reunir, en orden de rotación.
+ * @return false si se pidió terminar o si no se pudo escribir el compactado.
+ */
+bool Compactador::compactar(const FuenteCompactacion& fuente, const std::vector<Archivo>& grupo) {
+    std::string destino = fuente.directorio + "/" + grupo.front().base + "." + grupo.front().desde + "_" +
+                          grupo.back().hasta + EXTENSION_COMPACTADO;
+    std::string temporal = destino + ".tmp";
+    int fd = open(temporal.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        std::cerr << "Error: No se pudo crear el archivo compactado: " << temporal << std::endl;
+        return false;
+    }
+
+    std::string salida(FIRMA_COMPACTADO, sizeof(FIRMA_COMPACTADO));
+    salida.push_back(static_cast<char>(fuente.canal));
+    int64_t segundosPrevios = 0, enteroPrevio = 0;
+    uint32_t bitsPrevios = 0;
+    bool escrito = true;
+    auto visitar = [&](double valor, int32_t segundos) {
+        escribirVarint(salida, zigzag(segundos - segundosPrevios));
+        segundosPrevios = segundos;
+        if (fuente.canal == CANAL_PH) {
+            uint32_t bits = bitsDe(static_cast<float>(valor));
+            escribirVarint(salida, bits ^ bitsPrevios);
+            bitsPrevios = bits;
+        } else {
+            int64_t entero = static_cast<int64_t>(valor);
+            escribirVarint(salida, zigzag(entero - enteroPrevio));
+            enteroPrevio = entero;
+        }
+        if (salida.size() >= TAM_BLOQUE) {
+            escrito = escrito && escribirTodo(fd, salida.data(), salida.size());
+            salida.clear();
+        }
+        return escrito;
+    };
+    uint64_t inicio = relojNs(), bytes = 0;
+    auto leidos = [&](size_t n) { // Limitar el ritmo de lectura
+        bytes += n;
+        if (bytesLeidos != nullptr) {
+            bytesLeidos->sumar(n);
+        }
+        uint64_t debido = bytes * 1000000000ull / RITMO_COMPACTACION;
+        uint64_t transcurrido = relojNs() - inicio;
+        return debido <= transcurrido || esperar(static_cast<long>(debido - transcurrido));
+    };
+
+    std::time_t modificado = 0;
+    bool correcto = true;
+    for (const Archivo& archivo : grupo) {
+        if (!leerSegmento(fuente.directorio + "/" + archivo.nombre, fuente.canal, visitar, leidos)) {
+            pthread_mutex_lock(&mutex);
+            bool seDetuvo = detenido;
+            pthread_mutex_unlock(&mutex);
+            if (!seDetuvo && escrito) {
+                std::cerr << "Error: No se pudo leer el archivo para compactarlo: " << archivo.nombre << std::endl;
+                rechazados.insert(archivo.nombre);
+            }
+            correcto = false;
+            break;
+        }
+        modificado = std::max(modificado, archivo.modificado);
+    }
+    correcto = correcto && escrito && escribirTodo(fd, salida.data(), salida.size()) && fsync(fd) == 0;
+    if (correcto) {
+        struct timespec horas[2] = {{modificado, 0}, {modificado, 0}};
+        futimens(fd, horas);
+    }
+    close(fd);
+    if (!correcto || rename(temporal.c_str(), destino.c_str()) < 0) {
+        unlink(temporal.c_str());
+        return false;
+    }
+    for (const Archivo& archivo : grupo) {
+        unlink((fuente.directorio + "/" + archivo.nombre).c_str());
+    }
+    if (compactados != nullptr) {
+        compactados->sumar(grupo.size());
+    }
+    return true;
+}
+
+/**
+ * Función del hilo compactador.
+ *
+ * @param arg Puntero al `Compactador`.
+ * @return void* Siempre devuelve nullptr.
+ */
+void* compactador_hilo(void* arg) {
+    reinterpret_cast<Compactador*>(arg)->ejecutar();
+    return nullptr;
+}
@@ -0,0 +1,94 @@
+/**
+ * @file compactador.h
+ * @autores Juan Pablo Hernández Ceballos
+ * Compactación y retención de los archivos de salida sellados.
+ *
+ * Un hilo de baja prioridad (SCHED_IDLE y clase de E/S ociosa) revisa cada pocos segundos los
+ * directorios de salida. Agrupa los archivos sellados consecutivos de cada archivo activo hasta un
+ * tamaño objetivo y los reescribe en un solo archivo codificado (`ruta.PRIMERO_ULTIMO.msc`, con las
+ * horas de rotación del primero y del último), y borra los archivos sellados o compactados cuyos datos
+ * superan la retención. Lee a un ritmo limitado, de modo que nunca compite con el ingreso por el disco.
+ *
+ * Formato compacto: la firma "MSC1", el canal (1 byte) y, por cada medición, la diferencia con la hora
+ * anterior en segundos del día (varint zigzag) seguida del valor: en pH, los bits del flotante en XOR
+ * con los del anterior (varint); en temperatura, la diferencia con el anterior (varint zigzag).
+ * Al decodificarlo se obtienen exactamente las mismas líneas del archivo de texto.
+ */
+
+#ifndef COMPACTADOR_H
+#define COMPACTADOR_H
+
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+#include <functional>
+#include <pthread.h>
+#include <set>
+#include <string>
+#include <vector>
+#include "lectura.h"
+#include "metricas.h"
+
+const char* const EXTENSION_COMPACTADO = ".msc";        ///< Extensión de los archivos compactados
+const uint64_t OBJETIVO_COMPACTACION = 64ull << 20;     ///< Bytes de entrada que reúne cada archivo compactado
+const uint64_t MAXIMO_RECOMPACTAR = 8ull << 20;         ///< Compactados menores que esto se vuelven a agrupar
+const uint64_t RITMO_COMPACTACION = 16ull << 20;        ///< Bytes por segundo que lee el compactador
+const int INTERVALO_COMPACTACION_S = 5;                 ///< Segundos entre revisiones de los directorios
+
+/**
+ * Archivos que revisa el compactador.
+ */
+struct FuenteCompactacion {
+    Canal canal;             ///< Canal de las mediciones de los archivos
+    std::string directorio;  ///< Directorio de los archivos
+    std::string prefijo;     ///< Archivo activo cuyos sellados se revisan ("" = todos los del directorio)
+};
+
+bool leerSegmento(const std::string& ruta, Canal canal, const std::function<bool(double, int32_t)>& visitar,
+                  const std::function<bool(size_t)>& leidos = nullptr);
+
+/**
+ * Compactador de los archivos sellados.
+ */
+class Compactador {
+public:
+    Compactador(const std::vector<FuenteCompactacion>& fuentes, int64_t retencion);
+    ~Compactador();
+
+    void conectarMetricas(Contador* compactados, Contador* expirados, Contador* bytesLeidos);
+    void cambiarRetencion(int64_t retencion);
+    void ejecutar();
+    void detener();
+
+private:
+    /**
+     * Archivo sellado o compactado encontrado en un directorio.
+     */
+    struct Archivo {
+        std::string nombre;      ///< Nombre dentro del directorio
+        std::string base;        ///< Nombre del archivo activo del que proviene
+        std::string desde;       ///< Hora de rotación del primer archivo sellado que contiene
+        std::string hasta;       ///< Hora de rotación del último
+        bool compactado = false; ///< Está en el formato compacto
+        uint64_t tamano = 0;     ///< Bytes del archivo
+        std::time_t modificado = 0; ///< Última escritura de sus datos
+    };
+
+    void revisar(const FuenteCompactacion& fuente);
+    bool compactar(const FuenteCompactacion& fuente, const std::vector<Archivo>& grupo);
+    bool esperar(long nanosegundos);
+
+    std::vector<FuenteCompactacion> fuentes;  ///< Directorios que se revisan
+    std::atomic<int64_t> retencion;           ///< Segundos que se conservan los datos sellados (0 = siempre)
+    std::set<std::string> rechazados;         ///< Archivos que no se pudieron leer; no se vuelven a intentar
+    Contador* compactados = nullptr;          ///< Archivos sellados reunidos en un compactado
+    Contador* expirados = nullptr;            ///< Archivos borrados por la retención
+    Contador* bytesLeidos = nullptr;          ///< Bytes leídos al compactar
+    pthread_mutex_t mutex;                    ///< Protege `detenido`
+    pthread_cond_t condicion;                 ///< Despierta al hilo al detenerlo
+    bool detenido;                            ///< Se pidió terminar
+};
+
+void* compactador_hilo(void* arg);
+
+#endif //COMPACTADOR_H
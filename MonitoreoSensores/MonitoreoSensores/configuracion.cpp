@@ -0,0 +1,188 @@
+/**
+ * @file configuracion.cpp
+ * @autores Juan Pablo Hernández Ceballos
+ * Implementa la lectura y la publicación de la configuración del monitor.
+ */
+
+#include "configuracion.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include "utilidades.h"
+
+namespace {
+
+// Interpreta un par de números separados por una coma, como `6,8`; el primero no puede ser mayor.
+bool leerPar(const std::string& texto, float& primero, float& segundo) {
+    char* fin;
+    primero = std::strtof(texto.c_str(), &fin);
+    if (fin == texto.c_str() || *fin != ',') {
+        return false;
+    }
+    const char* inicio = fin + 1;
+    segundo = std::strtof(inicio, &fin);
+    return fin != inicio && *fin == '\0' && primero <= segundo;
+}
+
+// Interpreta una opción del archivo sobre la configuración en armado.
+bool aplicarOpcion(const std::string& clave, const std::string& valor, Configuracion& config) {
+    if (clave == "buffer") {
+        return leerTamBuffer(valor, config.tamBuffer);
+    }
+    if (clave == "rotacion") {
+        config.rotacion.bytes = 0;
+        config.rotacion.segundos = 0;
+        return valor == "no" || leerRotacion(valor, config.rotacion);
+    }
+    if (clave == "retencion") {
+        config.retencion = 0;
+        return valor == "no" || leerDuracion(valor, config.retencion);
+    }
+    for (int c = 0; c < NUM_CANALES; ++c) {
+        std::string canal = std::string(NOMBRE_CANAL[c]) + ".";
+        if (clave.compare(0, canal.size(), canal) != 0) {
+            continue;
+        }
+        LimitesCanal& limites = config.limites[c];
+        std::string campo = clave.substr(canal.size());
+        if (campo == "rango") {
+            return leerPar(valor, limites.minimo, limites.maximo);
+        }
+        if (campo == "alerta") {
+            return leerPar(valor, limites.alertaBaja, limites.alertaAlta);
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+/**
+ * Indica si hay archivos sellados que mantener (rotación o retención activas).
+ *
+ * @return true si el compactador tiene trabajo con esta configuración.
+ */
+bool Configuracion::mantieneSellados() const {
+    return rotacion.bytes > 0 || rotacion.segundos > 0 || retencion > 0;
+}
+
+/**
+ * @param inicial Configuración con la que arranca el monitor.
+ */
+ConfiguracionPublicada::ConfiguracionPublicada(const Configuracion& inicial) : vigente(nullptr) {
+    publicar(inicial);
+}
+
+/**
+ * Versión vigente. Quien la toma puede usarla hasta que termine el monitor.
+ *
+ * @return Configuración vigente.
+ */
+const Configuracion* ConfiguracionPublicada::actual() const {
+    return vigente.load(std::memory_order_acquire);
+}
+
+/**
+ * Publica una versión nueva: los hilos la toman al empezar su siguiente lote.
+ *
+ * @param nueva Configuración a publicar; su número de versión se asigna aquí.
+ * @return Versión publicada.
+ */
+const Configuracion* ConfiguracionPublicada::publicar(const Configuracion& nueva) {
+    Configuracion* copia = new Configuracion(nueva);
+    copia->version = versiones.size();
+    copia->rotacion.sellarDias = copia->mantieneSellados();
+    versiones.emplace_back(copia);
+    vigente.store(copia, std::memory_order_release); // Todo lo escrito en la copia es visible antes que el puntero
+    return copia;
+}
+
+/**
+ * Interpreta la capacidad de los buffers de los canales: un entero entre 1 y MAX_TAM_BUFFER.
+ *
+ * @param texto Capacidad.
+ * @param tamano Recibe la capacidad.
+ * @return false si no es un número o está fuera de ese rango.
+ */
+bool leerTamBuffer(const std::string& texto, int& tamano) {
+    char* fin;
+    long leido = std::strtol(texto.c_str(), &fin, 10);
+    if (fin == texto.c_str() || *fin != '\0' || leido <= 0 || leido > MAX_TAM_BUFFER) {
+        return false;
+    }
+    tamano = static_cast<int>(leido);
+    return true;
+}
+
+/**
+ * Interpreta los límites de la rotación de los archivos de salida: un tamaño (`64M`), una antigüedad
+ * (`1h`) o ambos separados por una coma (`64M,1h`). Las antigüedades llevan sufijo `s`, `m`, `h` o `d`.
+ * 
+ * @param texto Límites de la rotación.
+ * @param rotacion Recibe los límites.
+ * @return false si algún límite no es válido.
+ */
+bool leerRotacion(const std::string& texto, Rotacion& rotacion) {
+    size_t inicio = 0;
+    while (inicio <= texto.size()) {
+        size_t fin = texto.find(',', inicio);
+        std::string limite = texto.substr(inicio, fin == std::string::npos ? std::string::npos : fin - inicio);
+        char sufijo = limite.empty() ? '\0' : limite.back();
+        bool esTiempo = sufijo == 's' || sufijo == 'm' || sufijo == 'h' || sufijo == 'd';
+        if (esTiempo ? !leerDuracion(limite, rotacion.segundos) : !leerTamano(limite, rotacion.bytes)) {
+            std::cerr << "Error: límite de rotación no válido: " << limite << std::endl;
+            return false;
+        }
+        if (fin == std::string::npos) {
+            break;
+        }
+        inicio = fin + 1;
+    }
+    return true;
+}
+
+/**
+ * Lee el archivo de configuración sobre una configuración existente. Si alguna línea no es válida no se
+ * cambia nada: la configuración se aplica completa o no se aplica.
+ *
+ * @param ruta Archivo de configuración.
+ * @param config Configuración de partida; recibe la leída.
+ * @return false si el archivo no se pudo abrir o tiene alguna opción no válida.
+ */
+bool leerConfiguracion(const std::string& ruta, Configuracion& config) {
+    std::ifstream archivo(ruta);
+    if (!archivo.is_open()) {
+        std::cerr << "Error: No se pudo abrir el archivo de configuración: " << ruta << std::endl;
+        return false;
+    }
+    Configuracion leida = config;
+    std::string linea;
+    int numero = 0;
+    while (std::getline(archivo, linea)) {
+        numero++;
+        std::stringstream palabras(linea);
+        std::string palabra;
+        if (!(palabras >> palabra) || palabra[0] == '#') {
+            continue; // Línea vacía o comentario
+        }
+        size_t igual = palabra.find('=');
+        std::string resto;
+        if (igual == std::string::npos || ((palabras >> resto) && resto[0] != '#') || // Solo un comentario al final
+            !aplicarOpcion(palabra.substr(0, igual), palabra.substr(igual + 1), leida)) {
+            std::cerr << "Error: Opción no válida en la línea " << numero << " de " << ruta << ": " << linea << std::endl;
+            return false;
+        }
+    }
+    for (int c = 0; c < NUM_CANALES; ++c) {
+        const LimitesCanal& limites = leida.limites[c];
+        if (limites.alertaBaja < limites.minimo || limites.alertaAlta > limites.maximo) {
+            std::cerr << "Error: Los umbrales de alerta de " << NOMBRE_CANAL[c] << " quedan fuera de su rango válido en "
+                      << ruta << std::endl;
+            return false;
+        }
+    }
+    config = leida;
+    return true;
+}
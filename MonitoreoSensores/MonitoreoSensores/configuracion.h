@@ -0,0 +1,68 @@
+/**
+ * @file configuracion.h
+ * @autores Juan Pablo Hernández Ceballos
+ * Configuración del monitor que se puede recargar sin detenerlo.
+ *
+ * El archivo de configuración tiene una opción `clave=valor` por línea (las líneas vacías y las que
+ * empiezan con `#` se ignoran):
+ *
+ *     buffer=256                 capacidad de los buffers de los canales
+ *     pH.rango=0,14              rango válido de un canal (pH o temperatura)
+ *     pH.alerta=6,8              umbrales de alerta de un canal
+ *     rotacion=64M,1h            límites de la rotación de los archivos de salida (`no` para desactivarla)
+ *     retencion=7d               retención de los archivos sellados (`no` para conservarlos siempre)
+ *
+ * Las claves que no aparecen conservan su valor. Cada recarga arma una versión nueva completa y la
+ * publica cambiando un solo puntero, al estilo RCU: los hilos toman el puntero al empezar cada lote y
+ * siguen con la versión que tomaron hasta terminarlo, sin bloquearse nunca. Las versiones anteriores no
+ * se liberan hasta que termina el monitor, porque algún hilo puede seguir leyéndolas; cada una ocupa
+ * menos de cien bytes y las recargas son manuales.
+ */
+
+#ifndef CONFIGURACION_H
+#define CONFIGURACION_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "archivos_salida.h"
+#include "clasificacion.h"
+#include "lectura.h"
+
+const int MAX_TAM_BUFFER = 1 << 20;  ///< Mayor capacidad de los buffers de los canales (por carril)
+
+/**
+ * Versión de la configuración. Una vez publicada no cambia.
+ */
+struct Configuracion {
+    uint64_t version = 0;                  ///< Número de publicación (0 = la del inicio)
+    int tamBuffer = 0;                     ///< Capacidad de los buffers de los canales
+    LimitesCanal limites[NUM_CANALES] = {};  ///< Rango válido y umbrales de alerta de cada canal
+    Rotacion rotacion;                     ///< Cuándo se sellan los archivos de salida
+    int64_t retencion = 0;                 ///< Segundos que se conservan los archivos sellados (0 = siempre)
+
+    bool mantieneSellados() const;
+};
+
+/**
+ * Configuración vigente del monitor. Solo un hilo publica; cualquiera puede leer.
+ */
+class ConfiguracionPublicada {
+public:
+    explicit ConfiguracionPublicada(const Configuracion& inicial);
+
+    const Configuracion* actual() const;
+    const Configuracion* publicar(const Configuracion& nueva);
+
+private:
+    std::atomic<const Configuracion*> vigente;                   ///< Versión que toman los hilos
+    std::vector<std::unique_ptr<const Configuracion>> versiones; ///< Todas las versiones publicadas
+};
+
+bool leerTamBuffer(const std::string& texto, int& tamano);
+bool leerRotacion(const std::string& texto, Rotacion& rotacion);
+bool leerConfiguracion(const std::string& ruta, Configuracion& config);
+
+#endif //CONFIGURACION_H
@@ -0,0 +1,196 @@
+/**
+ * @file consulta.cpp
+ * @autores Juan Pablo Hernández Ceballos
+ * Consulta los agregados por minuto o por hora de un canal del monitor.
+ *
+ * Uso: consulta -a archivo [-n 1m|1h|auto] [-d desde] [-h hasta] [-s sensor] [-q 50,99] [-r]
+ *
+ * `archivo` es la ruta de salida del canal (la misma de `-t` o `-h` del monitor); la consulta lee solo
+ * su archivo de agregados del nivel pedido, nunca los datos crudos. Las fechas se dan en hora local como
+ * `AAAA-MM-DD` o `AAAA-MM-DD HH:MM`; `hasta` excluye su propio minuto. Sin `-s` se combinan todos los
+ * sensores. Imprime una línea por cubeta: `AAAA-MM-DD HH:MM cantidad minimo maximo promedio`, seguida
+ * de los percentiles pedidos con `-q` (estimados con los bocetos de cuantiles, con error relativo de
+ * 1 %). Con `-r` combina todo el rango en una sola línea, con la fecha de su primera cubeta.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <string>
+#include <unistd.h>
+#include <vector>
+#include "agregados.h"
+
+namespace {
+
+const int64_t RANGO_POR_MINUTO_S = 6 * 3600;  ///< Con `-n auto`, rangos hasta este largo se leen por minuto
+
+/**
+ * Convierte una fecha en hora local (`AAAA-MM-DD` o `AAAA-MM-DD HH:MM`) a segundos desde el epoch.
+ *
+ * @param texto Fecha.
+ * @param instante Recibe los segundos.
+ * @return false si la fecha no tiene ninguno de los dos formatos.
+ */
+bool leerFecha(const char* texto, int64_t& instante) {
+    struct tm fecha;
+    memset(&fecha, 0, sizeof(fecha));
+    const char* fin = strptime(texto, "%Y-%m-%d %H:%M", &fecha);
+    if (fin == nullptr || *fin != '\0') {
+        memset(&fecha, 0, sizeof(fecha));
+        fin = strptime(texto, "%Y-%m-%d", &fecha);
+        if (fin == nullptr || *fin != '\0') {
+            return false;
+        }
+    }
+    fecha.tm_isdst = -1; // Que mktime decida si rige el horario de verano
+    instante = mktime(&fecha);
+    return true;
+}
+
+/**
+ * Lee una lista de percentiles separados por comas (`50,90,99.9`).
+ *
+ * @param texto Lista.
+ * @param cuantiles Recibe los cuantiles entre 0 y 1.
+ * @return false si algún percentil no es un número entre 0 y 100.
+ */
+bool leerPercentiles(const char* texto, std::vector<double>& cuantiles) {
+    while (true) {
+        char* fin;
+        double percentil = strtod(texto, &fin);
+        if (fin == texto || percentil < 0 || percentil > 100 || (*fin != ',' && *fin != '\0')) {
+            return false;
+        }
+        cuantiles.push_back(percentil / 100);
+        if (*fin == '\0') {
+            return true;
+        }
+        texto = fin + 1;
+    }
+}
+
+// Imprime una cubeta combinada con sus percentiles.
+void imprimir(time_t inicio, const Cubeta& cubeta, const std::vector<double>& cuantiles) {
+    struct tm fecha;
+    localtime_r(&inicio, &fecha);
+    char hora[32];
+    strftime(hora, sizeof(hora), "%Y-%m-%d %H:%M", &fecha);
+    printf("%s %llu %g %g %g", hora, static_cast<unsigned long long>(cubeta.cantidad), cubeta.minimo, cubeta.maximo,
+           cubeta.suma / cubeta.cantidad);
+    for (double q : cuantiles) {
+        printf(" %g", cubeta.boceto.cuantil(q));
+    }
+    printf("\n");
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    // Declaración de variables para los argumentos de línea de comandos
+    int opcion;
+    const char* archivo = nullptr;
+    const char* nivelNombre = "auto";
+    int64_t desde = std::numeric_limits<int64_t>::min();
+    int64_t hasta = std::numeric_limits<int64_t>::max();
+    long sensor = -1;
+    std::vector<double> cuantiles;
+    bool resumen = false;
+    const char* uso = " -a archivo [-n 1m|1h|auto] [-d desde] [-h hasta] [-s sensor] [-q 50,99] [-r]";
+
+    // Procesamiento de argumentos de línea de comandos usando getopt
+    while ((opcion = getopt(argc, argv, "a:n:d:h:s:q:r")) != -1) {
+        switch (opcion) {
+            case 'a':
+                // Ruta de salida del canal
+                archivo = optarg;
+                break;
+            case 'n':
+                // Nivel de agregación
+                nivelNombre = optarg;
+                break;
+            case 'd':
+            case 'h':
+                // Inicio o fin del rango
+                if (!leerFecha(optarg, opcion == 'd' ? desde : hasta)) {
+                    std::cerr << "Error: Fecha no válida: " << optarg << " (AAAA-MM-DD o AAAA-MM-DD HH:MM)" << std::endl;
+                    return 1;
+                }
+                break;
+            case 's':
+                // Solo las mediciones de un sensor
+                sensor = atol(optarg);
+                break;
+            case 'q':
+                // Percentiles que se estiman
+                if (!leerPercentiles(optarg, cuantiles)) {
+                    std::cerr << "Error: Percentiles no válidos: " << optarg << " (por ejemplo 50,90,99)" << std::endl;
+                    return 1;
+                }
+                break;
+            case 'r':
+                // Una sola línea para todo el rango
+                resumen = true;
+                break;
+            default:
+                std::cerr << "Uso: " << argv[0] << uso << std::endl;
+                return 1;
+        }
+    }
+    if (archivo == nullptr) {
+        std::cerr << "Uso: " << argv[0] << uso << std::endl;
+        return 1;
+    }
+
+    // Elegir el nivel: por minuto solo si el rango es corto
+    int nivel = -1;
+    for (int n = 0; n < NUM_NIVELES_AGREGADO; ++n) {
+        if (strcmp(nivelNombre, NIVELES_AGREGADO[n].nombre) == 0) {
+            nivel = n;
+        }
+    }
+    if (strcmp(nivelNombre, "auto") == 0) {
+        bool corto = desde != std::numeric_limits<int64_t>::min() && hasta != std::numeric_limits<int64_t>::max() &&
+                     hasta - desde <= RANGO_POR_MINUTO_S;
+        nivel = corto ? 0 : NUM_NIVELES_AGREGADO - 1;
+    }
+    if (nivel < 0) {
+        std::cerr << "Error: Nivel no válido: " << nivelNombre << " (1m, 1h o auto)" << std::endl;
+        return 1;
+    }
+
+    // Combinar las líneas de cada cubeta (y de todos los sensores, si no se eligió uno)
+    std::map<int64_t, Cubeta> cubetas;
+    std::string ruta = rutaAgregados(archivo, nivel);
+    bool leido = leerAgregados(ruta, [&](const Cubeta& cubeta) {
+        if (cubeta.inicio + NIVELES_AGREGADO[nivel].segundos <= desde || cubeta.inicio >= hasta ||
+            (sensor >= 0 && cubeta.sensor != static_cast<uint32_t>(sensor))) {
+            return;
+        }
+        cubetas[cubeta.inicio].combinar(cubeta);
+    });
+    if (!leido) {
+        std::cerr << "Error: No se pudo abrir el archivo: " << ruta << std::endl;
+        return 1;
+    }
+
+    // Imprimir una línea por cubeta, en orden, o una sola con el rango combinado
+    if (resumen) {
+        if (!cubetas.empty()) {
+            Cubeta total;
+            for (const auto& entrada : cubetas) {
+                total.combinar(entrada.second);
+            }
+            imprimir(cubetas.begin()->first, total, cuantiles);
+        }
+        return 0;
+    }
+    for (const auto& entrada : cubetas) {
+        imprimir(entrada.first, entrada.second, cuantiles);
+    }
+    return 0;
+}
@@ -0,0 +1,207 @@
+/**
+ * @file control.cpp
+ * @autores Juan Pablo Hernández Ceballos
+ * Implementa el socket de control y la tabla de los últimos valores de cada sensor.
+ */
+
+#include "control.h"
+#include "socket_unix.h"
+
+#include <cstring>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+namespace {
+
+// Clave de un sensor en la tabla: canal y sensor, más uno para que 0 indique una ranura libre.
+uint64_t claveSensor(Canal canal, uint32_t sensor) {
+    return ((static_cast<uint64_t>(canal) << 32) | sensor) + 1;
+}
+
+// Primera ranura donde se busca una clave (hash de Fibonacci).
+size_t ranuraInicial(uint64_t clave) {
+    return static_cast<size_t>((clave * 0x9E3779B97F4A7C15ull) >> 40) & (TAM_ULTIMOS_VALORES - 1);
+}
+
+// Conexión abierta al socket de control, con lo recibido que aún no forma una línea.
+struct Cliente {
+    int fd = -1;
+    std::string pendiente;
+};
+
+} // namespace
+
+/**
+ * Guarda el valor de una medición como el último de su sensor. Solo la llama el hilo de evaluación del
+ * canal de la medición.
+ *
+ * @param lectura Medición válida.
+ */
+void UltimosValores::registrar(const Lectura& lectura) {
+    uint64_t clave = claveSensor(lectura.canal, lectura.sensor);
+    size_t i = ranuraInicial(clave);
+    for (size_t intentos = 0; intentos < TAM_ULTIMOS_VALORES; ++intentos, i = (i + 1) & (TAM_ULTIMOS_VALORES - 1)) {
+        Ranura& ranura = ranuras[i];
+        uint64_t actual = ranura.clave.load(std::memory_order_acquire);
+        if (actual == 0) { // Libre: reclamarla (otro canal puede ganarla al mismo tiempo)
+            if (!ranura.clave.compare_exchange_strong(actual, clave, std::memory_order_acq_rel) && actual != clave) {
+                continue;
+            }
+        } else if (actual != clave) {
+            continue;
+        }
+        uint64_t bits;
+        memcpy(&bits, &lectura.numero, sizeof(bits));
+        uint32_t version = ranura.version.load(std::memory_order_relaxed);
+        ranura.version.store(version + 1, std::memory_order_relaxed); // Impar: en modificación
+        std::atomic_thread_fence(std::memory_order_release);
+        ranura.numero.store(bits, std::memory_order_relaxed);
+        ranura.eventoMs.store(lectura.eventoMs(), std::memory_order_relaxed);
+        ranura.version.store(version + 2, std::memory_order_release);
+        return;
+    }
+}
+
+/**
+ * Recorre los sensores de la tabla con una copia coherente de su último valor.
+ *
+ * @param visitar Función que recibe cada valor.
+ */
+void UltimosValores::visitar(const std::function<void(const Valor&)>& visitar) const {
+    for (const Ranura& ranura : ranuras) {
+        uint64_t clave = ranura.clave.load(std::memory_order_acquire);
+        if (clave == 0) {
+            continue;
+        }
+        Valor valor;
+        valor.canal = static_cast<Canal>((clave - 1) >> 32);
+        valor.sensor = static_cast<uint32_t>(clave - 1);
+        uint32_t antes, despues;
+        uint64_t bits;
+        do { // Repetir si el escritor la modificó mientras se copiaba
+            antes = ranura.version.load(std::memory_order_acquire);
+            bits = ranura.numero.load(std::memory_order_relaxed);
+            valor.eventoMs = ranura.eventoMs.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            despues = ranura.version.load(std::memory_order_relaxed);
+        } while ((antes & 1) != 0 || antes != despues);
+        if (antes == 0) {
+            continue; // Reclamada, pero aún sin su primer valor
+        }
+        memcpy(&valor.numero, &bits, sizeof(bits));
+        visitar(valor);
+    }
+}
+
+ServidorControl::ServidorControl(const std::string& ruta, Responder responder)
+    : ruta(ruta), responder(responder), fd(-1), hilo() {
+}
+
+ServidorControl::~ServidorControl() {
+    detener();
+}
+
+/**
+ * Abre el socket y lanza el hilo que atiende las conexiones.
+ *
+ * @return true si el servidor quedó escuchando.
+ */
+bool ServidorControl::iniciar() {
+    fd = escucharUnix(ruta);
+    if (fd < 0) {
+        return false;
+    }
+    activo = true;
+    if (pthread_create(&hilo, NULL, atender, this) != 0) {
+        activo = false;
+        close(fd);
+        fd = -1;
+        return false;
+    }
+    return true;
+}
+
+// Detiene el hilo, cierra el socket y elimina su archivo.
+void ServidorControl::detener() {
+    if (!activo) {
+        return;
+    }
+    activo = false;
+    pthread_join(hilo, NULL);
+    close(fd);
+    unlink(ruta.c_str());
+    fd = -1;
+}
+
+// Hilo que acepta conexiones y responde a cada línea recibida. Una conexión que envía una línea demasiado
+// larga se cierra; las demás siguen siendo atendidas.
+void* ServidorControl::atender(void* arg) {
+    ServidorControl* servidor = reinterpret_cast<ServidorControl*>(arg);
+    Cliente clientes[MAX_CLIENTES_CONTROL];
+    struct pollfd esperas[MAX_CLIENTES_CONTROL + 1];
+    while (servidor->activo) {
+        esperas[0] = {servidor->fd, POLLIN, 0};
+        for (int i = 0; i < MAX_CLIENTES_CONTROL; ++i) {
+            esperas[i + 1] = {clientes[i].fd, POLLIN, 0}; // poll ignora los descriptores negativos
+        }
+        if (poll(esperas, MAX_CLIENTES_CONTROL + 1, 200) <= 0) {
+            continue;
+        }
+        if (esperas[0].revents & POLLIN) {
+            int nuevo = accept(servidor->fd, NULL, NULL);
+            int libre = 0;
+            while (libre < MAX_CLIENTES_CONTROL && clientes[libre].fd >= 0) {
+                libre++;
+            }
+            if (nuevo >= 0 && libre == MAX_CLIENTES_CONTROL) {
+                static const char LLENO[] = "error: demasiadas conexiones\n\n";
+                enviarTodo(nuevo, LLENO, sizeof(LLENO) - 1);
+                close(nuevo);
+            } else if (nuevo >= 0) {
+                struct timeval plazo = {1, 0}; // Un cliente que no lee no detiene a los demás indefinidamente
+                setsockopt(nuevo, SOL_SOCKET, SO_SNDTIMEO, &plazo, sizeof(plazo));
+                clientes[libre].fd = nuevo;
+                clientes[libre].pendiente.clear();
+            }
+        }
+        for (int i = 0; i < MAX_CLIENTES_CONTROL; ++i) {
+            Cliente& cliente = clientes[i];
+            if (cliente.fd < 0 || esperas[i + 1].revents == 0) {
+                continue;
+            }
+            char datos[512];
+            ssize_t leidos = recv(cliente.fd, datos, sizeof(datos), 0);
+            bool abierta = leidos > 0;
+            if (abierta) {
+                cliente.pendiente.append(datos, leidos);
+            }
+            size_t fin;
+            while (abierta && (fin = cliente.pendiente.find('\n')) != std::string::npos) {
+                std::string peticion = cliente.pendiente.substr(0, fin);
+                cliente.pendiente.erase(0, fin + 1);
+                if (!peticion.empty() && peticion.back() == '\r') {
+                    peticion.pop_back();
+                }
+                std::string respuesta = servidor->responder(peticion) + "\n"; // La línea vacía cierra la respuesta
+                abierta = enviarTodo(cliente.fd, respuesta.data(), respuesta.size());
+            }
+            if (abierta && cliente.pendiente.size() > MAX_PETICION_CONTROL) {
+                static const char LARGA[] = "error: petición demasiado larga\n\n";
+                enviarTodo(cliente.fd, LARGA, sizeof(LARGA) - 1);
+                abierta = false;
+            }
+            if (!abierta) {
+                close(cliente.fd);
+                cliente.fd = -1;
+            }
+        }
+    }
+    for (Cliente& cliente : clientes) {
+        if (cliente.fd >= 0) {
+            close(cliente.fd);
+        }
+    }
+    return nullptr;
+}
@@ -0,0 +1,84 @@
+/**
+ * @file control.h
+ * @autores Juan Pablo Hernández Ceballos
+ * Socket de control del monitor en ejecución y tabla de los últimos valores de cada sensor.
+ *
+ * El socket atiende un protocolo de texto por líneas: cada petición es una línea (`orden [argumento]`) y
+ * cada respuesta empieza con `ok` o con `error: motivo`, sigue con sus líneas de datos y termina con una
+ * línea vacía. La conexión queda abierta para más peticiones hasta que el cliente la cierra, así que se
+ * puede usar tanto desde un programa como a mano (`socat - UNIX-CONNECT:ruta`). Las peticiones las
+ * atiende un hilo propio; lo que consultan se lee con operaciones atómicas, sin tomar ningún mutex del
+ * camino de ingreso.
+ */
+
+#ifndef CONTROL_H
+#define CONTROL_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <pthread.h>
+#include <string>
+#include "lectura.h"
+
+const int MAX_CLIENTES_CONTROL = 16;       ///< Conexiones simultáneas al socket de control
+const size_t MAX_PETICION_CONTROL = 1024;  ///< Largo máximo de una línea de petición
+const size_t TAM_ULTIMOS_VALORES = 4096;   ///< Sensores que recuerda la tabla de últimos valores (potencia de dos)
+
+/**
+ * Último valor válido de cada sensor, por canal. Cada canal tiene un solo escritor (su hilo de
+ * evaluación) y cualquier hilo puede leer sin bloquearlo: las ranuras se reclaman con una comparación e
+ * intercambio y cada una lleva un contador de versión (seqlock) que el lector revisa antes y después de
+ * copiarla. Si la tabla se llena, los sensores nuevos no se recuerdan.
+ */
+class UltimosValores {
+public:
+    /**
+     * Valor leído de la tabla.
+     */
+    struct Valor {
+        Canal canal;        ///< Canal del sensor
+        uint32_t sensor;    ///< Identificador del sensor
+        double numero;      ///< Último valor válido
+        int64_t eventoMs;   ///< Hora de su evento (ms desde el epoch)
+    };
+
+    void registrar(const Lectura& lectura);
+    void visitar(const std::function<void(const Valor&)>& visitar) const;
+
+private:
+    struct alignas(64) Ranura {
+        std::atomic<uint64_t> clave{0};     ///< Canal y sensor más uno (0 = libre)
+        std::atomic<uint32_t> version{0};   ///< Impar mientras el escritor la modifica
+        std::atomic<uint64_t> numero{0};    ///< Bits del valor
+        std::atomic<int64_t> eventoMs{0};   ///< Hora del evento
+    };
+
+    Ranura ranuras[TAM_ULTIMOS_VALORES];
+};
+
+/**
+ * Servidor del socket de control. Cada línea recibida se pasa a la función de respuesta, cuyo texto
+ * (estado y líneas de datos) se envía seguido de la línea vacía que cierra la respuesta.
+ */
+class ServidorControl {
+public:
+    typedef std::function<std::string(const std::string&)> Responder;  ///< Atiende una petición
+
+    ServidorControl(const std::string& ruta, Responder responder);
+    ~ServidorControl();
+
+    bool iniciar();
+    void detener();
+
+private:
+    static void* atender(void* arg);
+
+    std::string ruta;                  ///< Ruta del socket
+    Responder responder;               ///< Respuesta a cada petición
+    int fd;                            ///< Socket de escucha
+    pthread_t hilo;                    ///< Hilo que atiende las conexiones
+    std::atomic<bool> activo{false};   ///< false para terminar el hilo
+};
+
+#endif //CONTROL_H
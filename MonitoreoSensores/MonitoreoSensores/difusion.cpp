@@ -0,0 +1,409 @@
+/**
+ * @file difusion.cpp
+ * @autores Juan Pablo Hernández Ceballos
+ * Implementa la difusión en vivo de las mediciones a los suscriptores.
+ */
+
+#include "difusion.h"
+#include "socket_unix.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <poll.h>
+#include <sstream>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static_assert(sizeof(RegistroDifundido) == 32, "El registro difundido debe ocupar 32 bytes");
+
+namespace {
+
+const size_t MAX_LINEA_SUSCRIPCION = 1024;  // Largo máximo de la línea de suscripción
+const char MAGIA_LOTE[4] = {'M', 'S', 'L', '1'};  // Comienzo de cada lote
+
+// Interpreta una lista de números separados por comas.
+bool leerSensores(const std::string& lista, std::vector<uint32_t>& sensores) {
+    std::istringstream partes(lista);
+    std::string parte;
+    while (std::getline(partes, parte, ',')) {
+        char* fin = nullptr;
+        unsigned long sensor = strtoul(parte.c_str(), &fin, 10);
+        if (parte.empty() || *fin != '\0' || sensor > UINT32_MAX) {
+            return false;
+        }
+        sensores.push_back(static_cast<uint32_t>(sensor));
+    }
+    std::sort(sensores.begin(), sensores.end());
+    return !sensores.empty();
+}
+
+// Interpreta una lista de nombres de canal separados por comas como una máscara.
+bool leerCanales(const std::string& lista, uint32_t& canales) {
+    std::istringstream partes(lista);
+    std::string parte;
+    canales = 0;
+    while (std::getline(partes, parte, ',')) {
+        int c = 0;
+        while (c < NUM_CANALES && parte != NOMBRE_CANAL[c]) {
+            c++;
+        }
+        if (c == NUM_CANALES) {
+            return false;
+        }
+        canales |= 1u << c;
+    }
+    return canales != 0;
+}
+
+} // namespace
+
+ServidorDifusion::ServidorDifusion(const std::string& ruta) : ruta(ruta), fd(-1), hilo() {
+}
+
+ServidorDifusion::~ServidorDifusion() {
+    detener();
+}
+
+// Conecta la difusión con sus métricas. Debe llamarse antes de iniciar.
+void ServidorDifusion::conectarMetricas(Medidor* suscriptores, Contador* descartadas, Contador* desconectados) {
+    medidorSuscriptores = suscriptores;
+    contadorDescartadas = descartadas;
+    contadorDesconectados = desconectados;
+}
+
+/**
+ * Abre el socket y lanza el hilo que atiende las suscripciones.
+ *
+ * @return true si el servidor quedó escuchando.
+ */
+bool ServidorDifusion::iniciar() {
+    fd = escucharUnix(ruta);
+    if (fd < 0) {
+        return false;
+    }
+    activo = true;
+    if (pthread_create(&hilo, NULL, atender, this) != 0) {
+        activo = false;
+        close(fd);
+        fd = -1;
+        return false;
+    }
+    return true;
+}
+
+// Detiene el hilo, desconecta a los suscriptores, cierra el socket y elimina su archivo.
+void ServidorDifusion::detener() {
+    if (!activo) {
+        return;
+    }
+    activo = false;
+    pthread_join(hilo, NULL);
+    for (Suscriptor& suscriptor : suscriptores) {
+        if (suscriptor.fd >= 0) {
+            cerrar(suscriptor, false);
+        }
+    }
+    close(fd);
+    unlink(ruta.c_str());
+    fd = -1;
+}
+
+/**
+ * Deja las mediciones válidas de un lote en la cola de cada suscriptor del canal que las acepta. La llama
+ * solo el hilo de evaluación del canal; nunca espera: lo que no cabe en una cola se descarta para ese
+ * suscriptor (o lo marca para desconectarlo, según su política). Sin suscriptores no hace nada.
+ *
+ * @param canal Canal del lote.
+ * @param lote Mediciones del lote.
+ * @param invalidas Máscara de las mediciones fuera del rango válido, que no se difunden.
+ */
+void ServidorDifusion::publicar(Canal canal, const std::vector<Lectura>& lote, uint64_t invalidas) {
+    if (activos.load(std::memory_order_relaxed) == 0) {
+        return;
+    }
+    for (Suscriptor& suscriptor : suscriptores) {
+        if (suscriptor.estado.load(std::memory_order_relaxed) != ACTIVO) {
+            continue;
+        }
+        // Anunciarse antes de confirmar el estado: quien lo cierra espera a que no quede nadie publicando
+        suscriptor.usuarios.fetch_add(1);
+        if (suscriptor.estado.load() == ACTIVO && ((suscriptor.canales >> canal) & 1)) {
+            Anillo& anillo = suscriptor.anillos[canal];
+            size_t cola = anillo.cola.load(std::memory_order_relaxed);
+            size_t cabeza = anillo.cabeza.load(std::memory_order_acquire);
+            uint64_t perdidas = 0;
+            for (size_t i = 0; i < lote.size(); ++i) {
+                const Lectura& lectura = lote[i];
+                if (((invalidas >> i) & 1) ||
+                    (!suscriptor.sensores.empty() &&
+                     !std::binary_search(suscriptor.sensores.begin(), suscriptor.sensores.end(), lectura.sensor))) {
+                    continue;
+                }
+                if (cola - cabeza > anillo.mascara) {
+                    cabeza = anillo.cabeza.load(std::memory_order_acquire);
+                    if (cola - cabeza > anillo.mascara) { // Sigue llena: el suscriptor no lee a tiempo
+                        perdidas++;
+                        continue;
+                    }
+                }
+                RegistroDifundido& registro = anillo.registros[cola & anillo.mascara];
+                registro.valor = lectura.numero;
+                registro.eventoMs = lectura.eventoMs();
+                registro.sensor = lectura.sensor;
+                registro.secuencia = lectura.secuencia;
+                registro.canal = canal;
+                memset(registro.relleno, 0, sizeof(registro.relleno));
+                cola++;
+            }
+            anillo.cola.store(cola, std::memory_order_release);
+            if (perdidas > 0) {
+                suscriptor.descartadas.fetch_add(perdidas, std::memory_order_relaxed);
+                if (suscriptor.politica == DESCONECTAR) {
+                    suscriptor.desbordado.store(true, std::memory_order_relaxed);
+                }
+                if (contadorDescartadas != nullptr) {
+                    contadorDescartadas->sumar(perdidas);
+                }
+            }
+        }
+        suscriptor.usuarios.fetch_sub(1);
+    }
+}
+
+// Hilo que acepta las conexiones, lee las suscripciones y envía a cada suscriptor lo que hay en sus colas.
+void* ServidorDifusion::atender(void* arg) {
+    ServidorDifusion* servidor = reinterpret_cast<ServidorDifusion*>(arg);
+    struct pollfd esperas[MAX_SUSCRIPTORES + 1];
+    int espera = ESPERA_DIFUSION_MS;
+    while (servidor->activo) {
+        esperas[0] = {servidor->fd, POLLIN, 0};
+        for (int i = 0; i < MAX_SUSCRIPTORES; ++i) {
+            const Suscriptor& suscriptor = servidor->suscriptores[i];
+            short eventos = static_cast<short>(POLLIN | (suscriptor.pendiente.empty() ? 0 : POLLOUT));
+            esperas[i + 1] = {suscriptor.fd, eventos, 0}; // poll ignora los descriptores negativos
+        }
+        poll(esperas, MAX_SUSCRIPTORES + 1, espera);
+        espera = ESPERA_DIFUSION_MS; // Mientras haya mediciones que enviar, se vuelve sin esperar
+        if (esperas[0].revents & POLLIN) {
+            servidor->aceptar();
+        }
+        for (int i = 0; i < MAX_SUSCRIPTORES; ++i) {
+            Suscriptor& suscriptor = servidor->suscriptores[i];
+            if (suscriptor.fd < 0 || suscriptor.fd != esperas[i + 1].fd) {
+                continue; // Se conectó en esta vuelta
+            }
+            if (esperas[i + 1].revents & (POLLIN | POLLHUP | POLLERR)) {
+                if (suscriptor.estado.load() == CONECTANDO) {
+                    servidor->leerSuscripcion(suscriptor);
+                    continue;
+                }
+                char descarte[256]; // Después de suscribirse el cliente solo puede cerrar
+                ssize_t leidos = recv(suscriptor.fd, descarte, sizeof(descarte), MSG_DONTWAIT);
+                if (leidos == 0 || (leidos < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+                    servidor->cerrar(suscriptor, false);
+                    continue;
+                }
+            }
+            if (suscriptor.estado.load() != ACTIVO) {
+                continue;
+            }
+            if (suscriptor.desbordado.load(std::memory_order_relaxed)) {
+                servidor->cerrar(suscriptor, true);
+            } else if (servidor->enviar(suscriptor) > 0) {
+                espera = 0;
+            }
+        }
+        servidor->liberarCerrados();
+    }
+    return nullptr;
+}
+
+// Acepta una conexión en una ranura libre; si no hay, la rechaza.
+void ServidorDifusion::aceptar() {
+    int nuevo = accept4(fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (nuevo < 0) {
+        return;
+    }
+    for (Suscriptor& suscriptor : suscriptores) {
+        if (suscriptor.estado.load() == LIBRE) {
+            suscriptor.fd = nuevo;
+            suscriptor.entrada.clear();
+            suscriptor.pendiente.clear();
+            suscriptor.estado.store(CONECTANDO);
+            return;
+        }
+    }
+    static const char LLENO[] = "error: demasiados suscriptores\n";
+    send(nuevo, LLENO, sizeof(LLENO) - 1, MSG_DONTWAIT | MSG_NOSIGNAL);
+    close(nuevo);
+}
+
+// Lee la línea de suscripción de un cliente recién conectado y, completa, lo suscribe o lo rechaza.
+void ServidorDifusion::leerSuscripcion(Suscriptor& suscriptor) {
+    char datos[256];
+    ssize_t leidos = recv(suscriptor.fd, datos, sizeof(datos), MSG_DONTWAIT);
+    if (leidos == 0 || (leidos < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+        cerrar(suscriptor, false);
+        return;
+    }
+    if (leidos > 0) {
+        suscriptor.entrada.append(datos, leidos);
+    }
+    size_t fin = suscriptor.entrada.find('\n');
+    if (fin == std::string::npos && suscriptor.entrada.size() <= MAX_LINEA_SUSCRIPCION) {
+        return; // Aún no llega la línea completa
+    }
+    std::string error = fin == std::string::npos ? "línea de suscripción demasiado larga"
+                                                 : suscribir(suscriptor, suscriptor.entrada.substr(0, fin));
+    if (!error.empty()) {
+        std::string respuesta = "error: " + error + "\n";
+        send(suscriptor.fd, respuesta.data(), respuesta.size(), MSG_DONTWAIT | MSG_NOSIGNAL);
+        cerrar(suscriptor, false);
+        return;
+    }
+    suscriptor.entrada.clear();
+    suscriptor.pendiente = "ok\n";
+    suscriptor.estado.store(ACTIVO); // Publica el filtro y las colas a los hilos de evaluación
+    int total = activos.fetch_add(1) + 1;
+    if (medidorSuscriptores != nullptr) {
+        medidorSuscriptores->fijar(total);
+    }
+    enviar(suscriptor);
+}
+
+/**
+ * Interpreta una línea de suscripción y prepara el filtro, la política y las colas del suscriptor.
+ *
+ * @param suscriptor Suscriptor que aún no está activo (ningún productor lo usa).
+ * @param linea Línea recibida, sin el fin de línea.
+ * @return Motivo del rechazo, o vacío si la suscripción es válida.
+ */
+std::string ServidorDifusion::suscribir(Suscriptor& suscriptor, const std::string& linea) {
+    std::istringstream palabras(linea);
+    std::string palabra;
+    if (!(palabras >> palabra) || palabra != "suscribir") {
+        return "se esperaba: suscribir [canales=...] [sensores=...] [politica=descartar|desconectar] [cola=N]";
+    }
+    uint32_t canales = (1u << NUM_CANALES) - 1;
+    std::vector<uint32_t> sensores;
+    Politica politica = DESCARTAR;
+    size_t tamCola = COLA_SUSCRIPTOR;
+    while (palabras >> palabra) {
+        size_t igual = palabra.find('=');
+        std::string clave = palabra.substr(0, igual);
+        std::string valor = igual == std::string::npos ? "" : palabra.substr(igual + 1);
+        if (clave == "canales" && leerCanales(valor, canales)) {
+            continue;
+        }
+        if (clave == "sensores" && leerSensores(valor, sensores)) {
+            continue;
+        }
+        if (clave == "politica" && (valor == "descartar" || valor == "desconectar")) {
+            politica = valor == "descartar" ? DESCARTAR : DESCONECTAR;
+            continue;
+        }
+        if (clave == "cola") {
+            char* fin = nullptr;
+            unsigned long pedido = strtoul(valor.c_str(), &fin, 10);
+            if (!valor.empty() && *fin == '\0' && pedido >= 1 && pedido <= MAX_COLA_SUSCRIPTOR) {
+                tamCola = 1;
+                while (tamCola < pedido) { // La cola es una potencia de dos
+                    tamCola <<= 1;
+                }
+                continue;
+            }
+        }
+        return "opción no válida: " + palabra;
+    }
+    suscriptor.canales = canales;
+    suscriptor.sensores = sensores;
+    suscriptor.politica = politica;
+    suscriptor.descartadas.store(0);
+    suscriptor.desbordado.store(false);
+    for (Anillo& anillo : suscriptor.anillos) {
+        if (anillo.mascara + 1 != tamCola || !anillo.registros) {
+            anillo.registros.reset(new RegistroDifundido[tamCola]);
+            anillo.mascara = tamCola - 1;
+        }
+        anillo.cabeza.store(0);
+        anillo.cola.store(0);
+    }
+    return "";
+}
+
+// Envía a un suscriptor lo pendiente y luego, por lotes, lo que hay en sus colas, hasta vaciarlas o hasta
+// que el socket no acepte más sin bloquear; lo que no entra queda pendiente para la próxima vuelta.
+// Devuelve cuántos registros sacó de las colas.
+size_t ServidorDifusion::enviar(Suscriptor& suscriptor) {
+    size_t sacados = 0;
+    while (true) {
+        while (!suscriptor.pendiente.empty()) {
+            ssize_t enviados = send(suscriptor.fd, suscriptor.pendiente.data(), suscriptor.pendiente.size(),
+                                    MSG_DONTWAIT | MSG_NOSIGNAL);
+            if (enviados < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                return sacados; // Socket lleno: sus colas se siguen llenando mientras tanto
+            }
+            if (enviados <= 0) {
+                cerrar(suscriptor, false);
+                return sacados;
+            }
+            suscriptor.pendiente.erase(0, enviados);
+        }
+
+        // Armar el próximo lote, alternando entre las colas de los canales
+        uint32_t cantidad = 0;
+        suscriptor.pendiente.assign(16, '\0'); // Cabecera, se completa al final
+        for (int c = 0; c < NUM_CANALES; ++c) {
+            Anillo& anillo = suscriptor.anillos[c];
+            if (!anillo.registros) {
+                continue;
+            }
+            size_t cabeza = anillo.cabeza.load(std::memory_order_relaxed);
+            size_t cola = anillo.cola.load(std::memory_order_acquire);
+            while (cabeza != cola && cantidad < MAX_LOTE_DIFUSION) {
+                suscriptor.pendiente.append(reinterpret_cast<const char*>(&anillo.registros[cabeza & anillo.mascara]),
+                                            sizeof(RegistroDifundido));
+                cabeza++;
+                cantidad++;
+            }
+            anillo.cabeza.store(cabeza, std::memory_order_release);
+        }
+        if (cantidad == 0) {
+            suscriptor.pendiente.clear();
+            return sacados;
+        }
+        sacados += cantidad;
+        uint64_t descartadas = suscriptor.descartadas.load(std::memory_order_relaxed);
+        memcpy(&suscriptor.pendiente[0], MAGIA_LOTE, 4);
+        memcpy(&suscriptor.pendiente[4], &cantidad, 4);
+        memcpy(&suscriptor.pendiente[8], &descartadas, 8);
+    }
+}
+
+// Desconecta a un suscriptor. Su ranura queda cerrándose hasta que ningún productor la use.
+void ServidorDifusion::cerrar(Suscriptor& suscriptor, bool desbordado) {
+    int anterior = suscriptor.estado.exchange(CERRANDO);
+    close(suscriptor.fd);
+    suscriptor.fd = -1;
+    suscriptor.pendiente.clear();
+    if (anterior == ACTIVO) {
+        int total = activos.fetch_sub(1) - 1;
+        if (medidorSuscriptores != nullptr) {
+            medidorSuscriptores->fijar(total);
+        }
+    }
+    if (desbordado && contadorDesconectados != nullptr) {
+        contadorDesconectados->sumar();
+    }
+}
+
+// Libera las ranuras cerradas que ya no usa ningún productor, para nuevos suscriptores.
+void ServidorDifusion::liberarCerrados() {
+    for (Suscriptor& suscriptor : suscriptores) {
+        if (suscriptor.estado.load() == CERRANDO && suscriptor.usuarios.load() == 0) {
+            suscriptor.estado.store(LIBRE);
+        }
+    }
+}
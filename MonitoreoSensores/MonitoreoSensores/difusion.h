@@ -0,0 +1,111 @@
+/**
+ * @file difusion.h
+ * @autores Juan Pablo Hernández Ceballos
+ * Difusión en vivo de las mediciones a suscriptores locales por un socket Unix.
+ *
+ * Un cliente se conecta y envía una línea de suscripción:
+ *
+ *     suscribir [canales=pH,temperatura] [sensores=1,5] [politica=descartar|desconectar] [cola=N]
+ *
+ * El servidor responde `ok` (o `error: motivo` y cierra) y desde entonces envía lotes binarios con las
+ * mediciones válidas que pasan el filtro, apenas las evalúa su hilo y sin esperar al disco. Cada lote es
+ * una cabecera de 16 bytes (`MSL1`, cantidad de registros en 32 bits y mediciones descartadas para este
+ * suscriptor hasta ahora en 64 bits) seguida de los registros de 32 bytes (ver RegistroDifundido), todo
+ * en el orden de bytes de la máquina.
+ *
+ * Cada suscriptor tiene una cola acotada por canal que llena el hilo de evaluación del canal sin bloquearse
+ * ni tomar mutex. Si el suscriptor no lee a tiempo y su cola se llena, según su política se descartan las
+ * mediciones que no caben (y se informan en la cabecera) o se lo desconecta: un suscriptor lento nunca
+ * detiene el ingreso ni la escritura de los archivos. Un hilo propio acepta las conexiones y envía los lotes
+ * con escrituras que no bloquean.
+ */
+
+#ifndef DIFUSION_H
+#define DIFUSION_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <pthread.h>
+#include <string>
+#include <vector>
+#include "lectura.h"
+#include "metricas.h"
+
+const int MAX_SUSCRIPTORES = 16;              ///< Suscriptores simultáneos
+const size_t COLA_SUSCRIPTOR = 16384;         ///< Registros por canal en la cola de un suscriptor, por defecto
+const size_t MAX_COLA_SUSCRIPTOR = 65536;     ///< Mayor cola que puede pedir un suscriptor
+const size_t MAX_LOTE_DIFUSION = 512;         ///< Registros por lote enviado
+const int ESPERA_DIFUSION_MS = 10;            ///< Espera del hilo de difusión cuando no hay nada que enviar
+
+/**
+ * Registro de una medición difundida (32 bytes).
+ */
+struct RegistroDifundido {
+    double valor;         ///< Valor de la medición
+    int64_t eventoMs;     ///< Hora del evento (ms desde el epoch)
+    uint32_t sensor;      ///< Identificador del sensor
+    uint32_t secuencia;   ///< Número de secuencia del sensor (0 si no lo envía)
+    uint8_t canal;        ///< Canal (0 = pH, 1 = temperatura)
+    uint8_t relleno[7];   ///< Ceros
+};
+
+/**
+ * Servidor de la difusión: las suscripciones, sus colas y el hilo que las envía.
+ */
+class ServidorDifusion {
+public:
+    explicit ServidorDifusion(const std::string& ruta);
+    ~ServidorDifusion();
+
+    void conectarMetricas(Medidor* suscriptores, Contador* descartadas, Contador* desconectados);
+    bool iniciar();
+    void detener();
+    void publicar(Canal canal, const std::vector<Lectura>& lote, uint64_t invalidas);
+
+private:
+    enum Estado { LIBRE, CONECTANDO, ACTIVO, CERRANDO };
+    enum Politica { DESCARTAR, DESCONECTAR };
+
+    // Cola de un solo productor (el hilo de evaluación del canal) y un solo consumidor (el de difusión).
+    struct Anillo {
+        std::unique_ptr<RegistroDifundido[]> registros;
+        size_t mascara = 0;
+        alignas(64) std::atomic<size_t> cabeza{0};  // Próximo a enviar (lo avanza el consumidor)
+        alignas(64) std::atomic<size_t> cola{0};    // Próximo a llenar (lo avanza el productor)
+    };
+
+    struct Suscriptor {
+        std::atomic<int> estado{LIBRE};      // Los productores solo publican en los ACTIVO
+        std::atomic<int> usuarios{0};        // Productores publicando en este momento
+        std::atomic<uint64_t> descartadas{0};
+        std::atomic<bool> desbordado{false}; // Se llenó una cola con la política de desconectar
+        uint32_t canales = 0;                // Máscara de canales suscritos
+        std::vector<uint32_t> sensores;      // Sensores suscritos, ordenados (vacío = todos)
+        Politica politica = DESCARTAR;
+        Anillo anillos[NUM_CANALES];
+        int fd = -1;                         // Solo los usa el hilo de difusión
+        std::string entrada;                 // Línea de suscripción a medio recibir
+        std::string pendiente;               // Lote que el socket aún no aceptó completo
+    };
+
+    static void* atender(void* arg);
+    void aceptar();
+    void leerSuscripcion(Suscriptor& suscriptor);
+    std::string suscribir(Suscriptor& suscriptor, const std::string& linea);
+    size_t enviar(Suscriptor& suscriptor);
+    void cerrar(Suscriptor& suscriptor, bool desbordado);
+    void liberarCerrados();
+
+    std::string ruta;                  ///< Ruta del socket
+    int fd;                            ///< Socket de escucha
+    pthread_t hilo;                    ///< Hilo que atiende las suscripciones
+    std::atomic<bool> activo{false};   ///< false para terminar el hilo
+    std::atomic<int> activos{0};       ///< Suscriptores activos (0: publicar no hace nada)
+    Suscriptor suscriptores[MAX_SUSCRIPTORES];
+    Medidor* medidorSuscriptores = nullptr;
+    Contador* contadorDescartadas = nullptr;
+    Contador* contadorDesconectados = nullptr;
+};
+
+#endif //DIFUSION_H
@@ -0,0 +1,227 @@
+/**
+ * @file escaneo.cpp
+ * @autores Juan Pablo Hernández Ceballos
+ * Implementa el escaneo de delimitadores (escalar, SSE2 y AVX2) y la decodificación de mediciones.
+ */
+
+#include "escaneo.h"
+
+#include <cmath>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define ESCANEO_X86 1
+#endif
+
+namespace {
+
+// Potencias de diez exactas en double para dividir la mantisa de un decimal.
+const double POTENCIAS_DIEZ[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15};
+
+// Convierte mantisa / 10^digitos a float con un solo redondeo, como std::stof. La división en double ya redondea
+// una vez; si su resultado cae justo en el punto medio entre dos float, convertirlo redondearía otra vez (al par)
+// aunque el decimal no fuera ese punto medio, así que en ese caso se compara de forma exacta con el decimal.
+float decimalAFloat(uint64_t mantisa, int digitos) {
+    double valor = static_cast<double>(mantisa) / POTENCIAS_DIEZ[digitos];
+    uint64_t bits;
+    memcpy(&bits, &valor, sizeof(bits));
+    const int SOBRANTES = 29; // Bits de la mantisa del double que no caben en la del float
+    if ((bits & ((1ull << SOBRANTES) - 1)) != (1ull << (SOBRANTES - 1))) {
+        return static_cast<float>(valor); // Lejos de un punto medio: el segundo redondeo no cambia nada
+    }
+    // El punto medio es m * 2^e (m de 25 bits); el decimal, mantisa / 10^digitos (mantisa < 10^15, valor >= 10^-15)
+    uint64_t m = ((bits & ((1ull << 52) - 1)) | (1ull << 52)) >> (SOBRANTES - 1);
+    int e = static_cast<int>((bits >> 52) & 0x7FF) - 1075 + (SOBRANTES - 1);
+    unsigned __int128 decimal = mantisa;
+    unsigned __int128 medio = static_cast<unsigned __int128>(m) * static_cast<uint64_t>(POTENCIAS_DIEZ[digitos]);
+    if (e < 0) {
+        decimal <<= -e; // A lo más 2^50 * 2^74
+    } else {
+        medio <<= e;
+    }
+    if (decimal == medio) {
+        return static_cast<float>(valor); // Justo en el punto medio: al par, igual que std::stof
+    }
+    return static_cast<float>(std::nextafter(valor, decimal > medio ? INFINITY : 0.0));
+}
+
+// Busca los delimitadores de [inicio, n) byte por byte; se usa para las colas y sin SIMD.
+size_t buscarEscalar(const char* datos, size_t inicio, size_t n, uint32_t* posiciones) {
+    size_t encontrados = 0;
+    for (size_t i = inicio; i < n; ++i) {
+        if (datos[i] == '\0' || datos[i] == '\n') {
+            posiciones[encontrados++] = static_cast<uint32_t>(i);
+        }
+    }
+    return encontrados;
+}
+
+#ifdef ESCANEO_X86
+// Compara 16 bytes por instrucción contra '\0' y '\n' y extrae las posiciones de la máscara.
+size_t buscarSse2(const char* datos, size_t n, uint32_t* posiciones) {
+    const __m128i nulo = _mm_setzero_si128();
+    const __m128i salto = _mm_set1_epi8('\n');
+    size_t encontrados = 0;
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i bloque = _mm_loadu_si128(reinterpret_cast<const __m128i*>(datos + i));
+        uint32_t mascara = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(bloque, nulo), _mm_cmpeq_epi8(bloque, salto)));
+        while (mascara != 0) {
+            posiciones[encontrados++] = static_cast<uint32_t>(i + __builtin_ctz(mascara));
+            mascara &= mascara - 1;
+        }
+    }
+    return encontrados + buscarEscalar(datos, i, n, posiciones + encontrados);
+}
+
+// Compara 32 bytes por instrucción contra '\0' y '\n' y extrae las posiciones de la máscara.
+__attribute__((target("avx2")))
+size_t buscarAvx2(const char* datos, size_t n, uint32_t* posiciones) {
+    const __m256i nulo = _mm256_setzero_si256();
+    const __m256i salto = _mm256_set1_epi8('\n');
+    size_t encontrados = 0;
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i bloque = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(datos + i));
+        uint32_t mascara = static_cast<uint32_t>(_mm256_movemask_epi8(
+            _mm256_or_si256(_mm256_cmpeq_epi8(bloque, nulo), _mm256_cmpeq_epi8(bloque, salto))));
+        while (mascara != 0) {
+            posiciones[encontrados++] = static_cast<uint32_t>(i + __builtin_ctz(mascara));
+            mascara &= mascara - 1;
+        }
+    }
+    return encontrados + buscarEscalar(datos, i, n, posiciones + encontrados);
+}
+#endif
+
+// Lee un número sin signo de hasta `maximo` dígitos; avanza `p`. Devuelve false si no hay dígitos o sobran.
+// El largo se revisa al final para no ramificar por dígito; un número demasiado largo se descarta entero.
+inline bool leerDigitos(const char*& p, const char* fin, int maximo, uint64_t& numero, int& digitos) {
+    const char* inicio = p;
+    uint64_t acumulado = 0;
+    unsigned digito;
+    while (p < fin && (digito = static_cast<unsigned char>(*p) - '0') < 10) {
+        acumulado = acumulado * 10 + digito;
+        p++;
+    }
+    numero = acumulado;
+    digitos = static_cast<int>(p - inicio);
+    return digitos > 0 && digitos <= maximo;
+}
+
+} // namespace
+
+/**
+ * Localiza los delimitadores ('\0' o '\n') de un bloque con la mejor implementación disponible.
+ *
+ * @param datos Bloque leído del pipe.
+ * @param n Largo del bloque.
+ * @param posiciones Recibe las posiciones de los delimitadores, en orden; debe tener lugar para n.
+ * @return Cantidad de delimitadores encontrados.
+ */
+size_t buscarDelimitadores(const char* datos, size_t n, uint32_t* posiciones) {
+    return buscarDelimitadores(mejorImplementacion(), datos, n, posiciones);
+}
+
+/**
+ * Localiza los delimitadores con una implementación concreta (debe estar disponible).
+ */
+size_t buscarDelimitadores(ImplementacionSimd implementacion, const char* datos, size_t n, uint32_t* posiciones) {
+#ifdef ESCANEO_X86
+    if (implementacion == SIMD_AVX2) {
+        return buscarAvx2(datos, n, posiciones);
+    }
+    if (implementacion == SIMD_SSE2) {
+        return buscarSse2(datos, n, posiciones);
+    }
+#endif
+    (void) implementacion;
+    return buscarEscalar(datos, 0, n, posiciones);
+}
+
+/**
+ * Decodifica una medición con los formatos cortos de los sensores: `[sensor:secuencia[@evento]:]valor`, con
+ * la hora opcional de la fuente en milisegundos desde el epoch y el valor
+ * entero (`68`, hasta 9 dígitos) o decimal con punto (`7.26`, hasta 15 dígitos en total), con signo opcional.
+ * Cualquier otra forma (exponentes, espacios, `inf`, números más largos) devuelve false y debe pasar por
+ * la validación general; para las que acepta, el resultado coincide con el de std::stoi / std::stof: los
+ * decimales se redondean a float una sola vez, también cuando la división en double cae en un punto medio.
+ *
+ * @param texto Medición sin el delimitador.
+ * @param largo Largo de la medición.
+ * @param medicion Recibe la medición decodificada.
+ * @return true si la medición tiene un formato corto reconocido.
+ */
+bool decodificarMedicion(const char* texto, size_t largo, MedicionDecodificada& medicion) {
+    const char* p = texto;
+    const char* fin = texto + largo;
+    uint64_t numero;
+    int digitos;
+
+    // Identidad opcional: sensor:secuencia: (un valor nunca lleva ':', así que basta mirar tras el primer número)
+    medicion.sensor = 0;
+    medicion.secuencia = 0;
+    medicion.evento = 0;
+    if (leerDigitos(p, fin, 10, numero, digitos) && p < fin && *p == ':') {
+        if (numero > UINT32_MAX) {
+            return false;
+        }
+        medicion.sensor = static_cast<uint32_t>(numero);
+        p++;
+        if (!leerDigitos(p, fin, 10, numero, digitos) || numero == 0 || numero > UINT32_MAX || p == fin) {
+            return false;
+        }
+        medicion.secuencia = static_cast<uint32_t>(numero);
+        if (*p == '@') { // Hora de la fuente
+            p++;
+            if (!leerDigitos(p, fin, 15, numero, digitos) || p == fin) {
+                return false;
+            }
+            medicion.evento = static_cast<int64_t>(numero);
+        }
+        if (*p != ':') {
+            return false;
+        }
+        p++;
+    } else {
+        p = texto; // Sin identidad: el primer número era el valor
+    }
+    medicion.valor = p;
+    medicion.largoValor = static_cast<size_t>(fin - p);
+
+    // Valor: [+-]digitos[.digitos]
+    bool negativo = false;
+    if (p < fin && (*p == '-' || *p == '+')) {
+        negativo = *p == '-';
+        p++;
+    }
+    uint64_t entero;
+    int digitosEntero;
+    if (!leerDigitos(p, fin, MAX_DIGITOS_DECIMAL, entero, digitosEntero)) {
+        return false;
+    }
+    if (p == fin) {
+        if (digitosEntero > MAX_DIGITOS_ENTERO) {
+            return false;
+        }
+        medicion.tipo = VALOR_ENTERO;
+        medicion.numero = negativo ? -static_cast<double>(entero) : static_cast<double>(entero);
+        return true;
+    }
+    if (*p != '.') {
+        return false;
+    }
+    p++;
+    uint64_t fraccion;
+    int digitosFraccion;
+    if (!leerDigitos(p, fin, MAX_DIGITOS_DECIMAL - digitosEntero, fraccion, digitosFraccion) || p != fin) {
+        return false;
+    }
+    // Mantisa exacta (< 10^15 < 2^53) sobre una potencia de diez exacta, redondeada a float una sola vez
+    float valor = decimalAFloat(entero * static_cast<uint64_t>(POTENCIAS_DIEZ[digitosFraccion]) + fraccion,
+                                digitosFraccion);
+    medicion.tipo = VALOR_DECIMAL;
+    medicion.numero = static_cast<double>(negativo ? -valor : valor);
+    return true;
+}
@@ -0,0 +1,48 @@
+/**
+ * @file escaneo.h
+ * @autores Juan Pablo Hernández Ceballos
+ * Escaneo vectorizado de los delimitadores de las mediciones y decodificación rápida de sus números.
+ *
+ * El recolector lee del pipe bloques grandes con muchas mediciones terminadas en '\0' o '\n'.
+ * buscarDelimitadores localiza todos los delimitadores de un bloque en una pasada (AVX2: 32 bytes por
+ * comparación; SSE2: 16; escalar como respaldo). decodificarMedicion interpreta una medición
+ * `sensor:secuencia:valor` o `sensor:secuencia@evento:valor` (o solo `valor`) con los formatos cortos que envían los sensores, sin
+ * copias, sin excepciones y sin reservar memoria.
+ */
+
+#ifndef ESCANEO_H
+#define ESCANEO_H
+
+#include <cstddef>
+#include <cstdint>
+#include "clasificacion.h"
+
+/**
+ * Tipo de valor de una medición decodificada.
+ */
+enum TipoValor : uint8_t {
+    VALOR_ENTERO = 0,   ///< Entero con signo opcional (temperatura)
+    VALOR_DECIMAL = 1   ///< Decimal con punto (pH)
+};
+
+/**
+ * Medición decodificada. `valor` apunta dentro del texto original.
+ */
+struct MedicionDecodificada {
+    uint32_t sensor = 0;      ///< Identificador del sensor (0 si no trae identidad)
+    uint32_t secuencia = 0;   ///< Número de secuencia (0 si no trae identidad)
+    int64_t evento = 0;       ///< Hora de la medición en la fuente, en ms desde el epoch (0 si no la trae)
+    const char* valor;        ///< Inicio del texto del valor
+    size_t largoValor;        ///< Largo del texto del valor
+    TipoValor tipo;           ///< Tipo de valor
+    double numero;            ///< Valor numérico
+};
+
+const int MAX_DIGITOS_ENTERO = 9;    ///< Dígitos de un entero decodificable sin desbordar un int
+const int MAX_DIGITOS_DECIMAL = 15;  ///< Dígitos de un decimal decodificable de forma exacta
+
+size_t buscarDelimitadores(const char* datos, size_t n, uint32_t* posiciones);
+size_t buscarDelimitadores(ImplementacionSimd implementacion, const char* datos, size_t n, uint32_t* posiciones);
+bool decodificarMedicion(const char* texto, size_t largo, MedicionDecodificada& medicion);
+
+#endif //ESCANEO_H
@@ -0,0 +1,62 @@
+/**
+ * @file espera.cpp
+ * @autores Juan Pablo Hernández Ceballos
+ * Implementa el ajuste del presupuesto de giro de la espera adaptativa.
+ */
+
+#include "espera.h"
+
+EsperaAdaptativa::EsperaAdaptativa(ModoEspera modo)
+    : modoActual(modo), ultimaLlegada(0), intervalo(GIRO_MAXIMO_NS * 2) {
+}
+
+// Cambia el modo de espera; los hilos que ya están girando terminan su giro actual.
+void EsperaAdaptativa::fijarModo(ModoEspera modo) {
+    modoActual.store(modo, std::memory_order_relaxed);
+}
+
+ModoEspera EsperaAdaptativa::modo() const {
+    return static_cast<ModoEspera>(modoActual.load(std::memory_order_relaxed));
+}
+
+/**
+ * Registra la llegada de un dato y actualiza el promedio móvil del intervalo entre llegadas.
+ * Solo lleva la cuenta en modo latencia. La llaman a la vez varios hilos (los productores de un buffer,
+ * cada uno con el mutex de su carril): la hora se intercambia de forma atómica y el promedio se actualiza
+ * con compare_exchange, así que ninguna llegada se pierde. Cada muestra es el intervalo desde la llegada
+ * anterior de cualquier productor, que es lo que ve el consumidor que espera.
+ */
+void EsperaAdaptativa::registrarLlegada() {
+    if (modoActual.load(std::memory_order_relaxed) != ESPERA_LATENCIA) {
+        return;
+    }
+    uint64_t ahora = relojNs();
+    uint64_t anterior = ultimaLlegada.exchange(ahora, std::memory_order_relaxed);
+    if (anterior == 0) {
+        return;
+    }
+    // Dos productores pueden leer la hora en un orden y cambiarla en el otro: entonces la muestra es 0
+    int64_t muestra = ahora > anterior ? static_cast<int64_t>(ahora - anterior) : 0;
+    uint64_t actual = intervalo.load(std::memory_order_relaxed);
+    uint64_t nuevo;
+    do {
+        int64_t promedio = static_cast<int64_t>(actual);
+        nuevo = static_cast<uint64_t>(promedio + ((muestra - promedio) >> PESO_PROMEDIO_LOG2));
+    } while (!intervalo.compare_exchange_weak(actual, nuevo, std::memory_order_relaxed));
+}
+
+/**
+ * Presupuesto de giro: el doble del intervalo promedio entre llegadas, acotado a [GIRO_MINIMO_NS,
+ * GIRO_MAXIMO_NS]. Si las llegadas están más espaciadas que el tope, girar no alcanzaría el próximo
+ * dato y solo se gira el mínimo, para atrapar las ráfagas.
+ *
+ * @return Nanosegundos a girar antes de ceder la CPU.
+ */
+uint64_t EsperaAdaptativa::presupuesto() const {
+    uint64_t promedio = intervalo.load(std::memory_order_relaxed);
+    if (promedio > GIRO_MAXIMO_NS) {
+        return GIRO_MINIMO_NS;
+    }
+    uint64_t giro = promedio * 2;
+    return giro < GIRO_MINIMO_NS ? GIRO_MINIMO_NS : (giro > GIRO_MAXIMO_NS ? GIRO_MAXIMO_NS : giro);
+}
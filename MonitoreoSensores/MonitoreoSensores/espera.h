@@ -0,0 +1,93 @@
+/**
+ * @file espera.h
+ * @autores Juan Pablo Hernández Ceballos
+ * Estrategia de espera adaptativa: girar con `pause`, luego ceder la CPU y, si aún no hay datos, bloquear.
+ *
+ * En modo latencia el hilo que espera gira durante un presupuesto de tiempo calculado a partir del
+ * intervalo reciente entre llegadas: si los datos llegan cada pocos microsegundos conviene girar y
+ * evitar la llamada al futex y el viaje por el planificador; si llegan de tarde en tarde, girar solo
+ * gasta CPU y el presupuesto se reduce al mínimo. En modo eficiencia no se gira y se bloquea de inmediato.
+ */
+
+#ifndef ESPERA_H
+#define ESPERA_H
+
+#include <atomic>
+#include <cstdint>
+#include <sched.h>
+#include "metricas.h"
+
+/**
+ * Modo de espera de un canal.
+ */
+enum ModoEspera : uint8_t {
+    ESPERA_EFICIENCIA = 0,  ///< Bloquear de inmediato (mínimo uso de CPU)
+    ESPERA_LATENCIA = 1     ///< Girar y ceder antes de bloquear (mínima latencia de despertar)
+};
+
+const uint64_t GIRO_MINIMO_NS = 2000;    ///< Presupuesto de giro cuando las llegadas son esporádicas
+const uint64_t GIRO_MAXIMO_NS = 50000;   ///< Tope del presupuesto de giro
+const int CESIONES_MAXIMAS = 8;          ///< sched_yield() tras el giro antes de bloquear
+const int PESO_PROMEDIO_LOG2 = 3;        ///< Peso 1/8 de cada llegada en el promedio móvil del intervalo
+
+/**
+ * Pausa breve dentro de un ciclo de giro; alivia al otro hilo del núcleo y el consumo.
+ */
+inline void pausaGiro() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield" ::: "memory");
+#endif
+}
+
+/**
+ * Política de espera de un canal con el presupuesto de giro ajustado según el ritmo de llegadas.
+ */
+class EsperaAdaptativa {
+public:
+    explicit EsperaAdaptativa(ModoEspera modo = ESPERA_EFICIENCIA);
+
+    void fijarModo(ModoEspera modo);
+    ModoEspera modo() const;
+    void registrarLlegada();
+    uint64_t presupuesto() const;
+
+    /**
+     * Gira y luego cede la CPU hasta que `lista()` sea verdadera o se agote el presupuesto.
+     * En modo eficiencia devuelve false sin esperar.
+     *
+     * @param lista Condición a comprobar; no debe bloquear.
+     * @return true si la condición se cumplió sin necesidad de bloquear.
+     */
+    template <typename Condicion>
+    bool girar(Condicion lista) const {
+        if (modoActual.load(std::memory_order_relaxed) != ESPERA_LATENCIA) {
+            return false;
+        }
+        uint64_t limite = relojNs() + presupuesto();
+        for (unsigned i = 1;; ++i) {
+            if (lista()) {
+                return true;
+            }
+            pausaGiro();
+            if (i % 32 == 0 && relojNs() >= limite) { // Consultar el reloj cada tanto
+                break;
+            }
+        }
+        for (int i = 0; i < CESIONES_MAXIMAS; ++i) {
+            sched_yield();
+            if (lista()) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    std::atomic<uint8_t> modoActual;     ///< ModoEspera vigente
+    std::atomic<uint64_t> ultimaLlegada; ///< Hora de la última llegada (ns)
+    std::atomic<uint64_t> intervalo;     ///< Promedio móvil del intervalo entre llegadas (ns)
+};
+
+#endif //ESPERA_H
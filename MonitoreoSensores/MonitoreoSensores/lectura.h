@@ -0,0 +1,83 @@
+/**
+ * @file lectura.h
+ * @autores Juan Pablo Hernández Ceballos
+ * Define la medición que viaja desde el hilo recolector hasta los hilos consumidores.
+ */
+
+#ifndef LECTURA_H
+#define LECTURA_H
+
+#include <cstdint>
+#include <cstring>
+
+/**
+ * Canales de medición que maneja el monitor.
+ */
+enum Canal : uint8_t {
+    CANAL_PH = 0,           ///< Mediciones de pH (valores flotantes)
+    CANAL_TEMPERATURA = 1,  ///< Mediciones de temperatura (valores enteros)
+    NUM_CANALES = 2         ///< Cantidad de canales
+};
+
+const char* const NOMBRE_CANAL[NUM_CANALES] = {"pH", "temperatura"};  ///< Nombre de cada canal en los mensajes
+
+const size_t TAM_VALOR_LECTURA = 30;  ///< Texto que se conserva de cada medición (el mismo que guarda el WAL)
+const int64_t MAX_DESFASE_EVENTO_MS = 86400000;  ///< Diferencia máxima aceptada entre la hora de la fuente y la de recepción
+
+/**
+ * Medición recibida de un sensor.
+ *
+ * El texto del valor se guarda dentro de la propia medición, de modo que copiarla no reserva memoria y
+ * las ranuras de los buffers se reutilizan sin pasar por malloc.
+ *
+ * @param valor Texto del valor de la medición (se recorta a TAM_VALOR_LECTURA bytes).
+ * @param largoValor Largo del texto del valor.
+ * @param canal Canal de la medición.
+ * @param persistir false si la etapa de evaluación la descartó (fuera de rango) y no va al archivo de salida.
+ * @param sensor Identificador del sensor que la envió.
+ * @param secuencia Número de secuencia asignado por el sensor (0 si el sensor no lo envía).
+ * @param numero Valor ya convertido a número por el recolector.
+ * @param lsn Posición del registro en el WAL (0 si el monitor corre sin WAL).
+ * @param recepcion Hora de recepción en segundos desde el epoch.
+ * @param desfaseEvento Hora de la medición en la fuente menos la de recepción, en milisegundos (0 si la
+ *                      fuente no envía su hora). La hora del evento ordena y fecha la medición en la salida.
+ */
+struct Lectura {
+    char valor[TAM_VALOR_LECTURA]; ///< Texto del valor de la medición, sin terminador
+    uint8_t largoValor = 0; ///< Largo del texto del valor
+    Canal canal = CANAL_PH; ///< Canal de la medición
+    bool persistir = true;  ///< Se escribe en el archivo de salida
+    uint32_t sensor = 0;    ///< Identificador del sensor
+    uint32_t secuencia = 0; ///< Número de secuencia del sensor (0 = sin secuencia)
+    int32_t desfaseEvento = 0; ///< Hora de la fuente menos la de recepción (ms)
+    double numero = 0;      ///< Valor numérico (entero para temperatura, flotante para pH)
+    uint64_t lsn = 0;       ///< Número de secuencia del registro en el WAL
+    int64_t recepcion = 0;  ///< Hora de recepción (segundos desde el epoch)
+
+    // Copia el texto del valor, recortándolo si no cabe.
+    void fijarValor(const char* texto, size_t largo) {
+        largoValor = static_cast<uint8_t>(largo < TAM_VALOR_LECTURA ? largo : TAM_VALOR_LECTURA);
+        memcpy(valor, texto, largoValor);
+    }
+
+    // Fija la hora de la medición en la fuente (ms desde el epoch). Se ignora si se aleja más de un día
+    // de la recepción (reloj del sensor sin ajustar): la medición queda con la hora de recepción.
+    void fijarEvento(int64_t eventoMs) {
+        int64_t desfase = eventoMs - recepcion * 1000;
+        desfaseEvento = desfase >= -MAX_DESFASE_EVENTO_MS && desfase <= MAX_DESFASE_EVENTO_MS
+                            ? static_cast<int32_t>(desfase) : 0;
+    }
+
+    // Hora del evento en milisegundos desde el epoch.
+    int64_t eventoMs() const {
+        return recepcion * 1000 + desfaseEvento;
+    }
+
+    // Hora del evento en segundos desde el epoch.
+    int64_t evento() const {
+        int64_t ms = eventoMs();
+        return ms >= 0 ? ms / 1000 : -((999 - ms) / 1000);
+    }
+};
+
+#endif //LECTURA_H
@@ -1,11 +1,464 @@
+/**
+ * @file main.cpp
+ * @autores Juan Pablo Hernández Ceballos
+ * Supervisor que lanza y administra los procesos monitor y sensor descritos en un archivo de topología.
+ *
+ * @detalles
+ * Cada línea del archivo de topología describe un programa a lanzar:
+ *
+ *     ejecutable [clave=valor ...] -- argumentos del programa
+ *
+ * Claves admitidas:
+ * - cantidad=N: Número de réplicas del programa (1 por defecto). En los argumentos, `{i}` se
+ *   reemplaza por el índice de la réplica (0..N-1).
+ * - cpu=LISTA: CPUs en las que puede ejecutarse cada réplica, por ejemplo `0`, `2-3` o `0,4-7`.
+ * - nice=N: Prioridad de planificación (valor nice) del proceso.
+ * - fifo=N: Ejecuta el proceso con la política SCHED_FIFO y prioridad N (requiere privilegios).
+ * - reinicio=nunca|fallo|siempre: Cuándo relanzar una réplica que terminó (fallo por defecto).
+ *
+ * Las líneas vacías y las que comienzan con `#` se ignoran. Las réplicas que fallan se relanzan con
+ * una espera que se duplica en cada caída (de 1 a 30 segundos) y vuelve a 1 si el proceso se mantuvo
+ * en ejecución al menos 30 segundos; si no se puede crear el proceso, se reintenta con la misma espera.
+ * Con SIGUSR1 se muestran las métricas agregadas por programa y con SIGINT o SIGTERM se detienen
+ * ordenadamente todos los procesos: un programa a la vez, del último de la topología al primero, de modo
+ * que los sensores terminan antes de que el monitor empiece a drenar. Un programa con plazo de drenado
+ * (`-d N` en sus argumentos, como el monitor) recibe SIGKILL solo si no terminó en N segundos más un margen.
+ *
+ * Este archivo contiene las siguientes funciones:
+ * - leerTopologia: Lee el archivo de topología.
+ * - plazoDrenado: Plazo de drenado (-d) indicado en los argumentos de un programa.
+ * - lanzar: Crea el proceso de una réplica con su afinidad y prioridad.
+ * - programarReinicio: Fija cuándo se relanza una réplica y duplica su espera.
+ * - detenerPrograma: Envía una señal a las réplicas en ejecución de un programa.
+ * - mostrarMetricas: Muestra las métricas agregadas de cada programa.
+ * - main: Función principal del supervisor.
+ */
+#include <algorithm>
 #include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <ctime>
 #include <unistd.h>
+#include <sched.h>
+#include <sys/resource.h>
 #include <sys/wait.h>
+#include "ubicacion.h"
+
+const int ESPERA_MINIMA = 1;      ///< Segundos de espera antes del primer reinicio
+const int ESPERA_MAXIMA = 30;     ///< Tope de la espera entre reinicios
+const int EJECUCION_ESTABLE = 30; ///< Segundos en ejecución tras los cuales se reinicia la espera
+const int PLAZO_TERMINO = 10;     ///< Segundos que se espera al primer programa (el monitor) antes de usar SIGKILL, si
+                                  ///< no indica su plazo de drenado (el del monitor es 5 por defecto)
+const int MARGEN_TERMINO = 5;     ///< Segundos que se esperan, además de su plazo de drenado (-d), al detener un programa
+const int PLAZO_ETAPA = 3;        ///< Segundos que se espera a los demás programas al detenerlos, antes de usar SIGKILL
+
+/**
+ * Cuándo se relanza una réplica que terminó.
+ */
+enum Reinicio {
+    REINICIO_NUNCA,    ///< No se relanza
+    REINICIO_FALLO,    ///< Se relanza si terminó con error o por una señal
+    REINICIO_SIEMPRE   ///< Se relanza siempre
+};
+
+/**
+ * Programa descrito por una línea del archivo de topología, junto con sus métricas agregadas.
+ */
+struct Programa {
+    std::string ejecutable;               ///< Ruta del ejecutable
+    std::vector<std::string> argumentos;  ///< Argumentos (pueden contener `{i}`)
+    std::vector<int> cpus;                ///< CPUs permitidas (vacío = sin restricción)
+    bool conNice = false;                 ///< true si se indicó un valor nice
+    int nice = 0;                         ///< Valor nice del proceso
+    int fifo = 0;                         ///< Prioridad SCHED_FIFO (0 = política por defecto)
+    int cantidad = 1;                     ///< Número de réplicas
+    Reinicio reinicio = REINICIO_FALLO;   ///< Política de reinicio
+    int plazoTermino = 0;                 ///< Segundos que se espera al detenerlo (0 = el de su etapa)
+
+    int inicios = 0;                      ///< Veces que se lanzó alguna réplica
+    int caidas = 0;                       ///< Terminaciones con error o por señal
+    int finalizados = 0;                  ///< Terminaciones correctas
+    long segundosEjecucion = 0;           ///< Tiempo acumulado de ejecución de las réplicas terminadas
+};
+
+/**
+ * Estado de una réplica de un programa.
+ */
+struct Proceso {
+    int programa;               ///< Índice del programa en la topología
+    int replica;                ///< Índice de la réplica
+    pid_t pid = -1;             ///< PID del proceso (-1 si no está en ejecución)
+    std::time_t inicio = 0;     ///< Hora en que se lanzó
+    std::time_t relanzar = 0;   ///< Hora a partir de la cual se puede relanzar (0 = no relanzar)
+    int espera = ESPERA_MINIMA; ///< Espera actual antes del siguiente reinicio
+};
+
+/**
+ * Busca el plazo de drenado en los argumentos de un programa (`-d N` o `-dN`, como en el monitor).
+ *
+ * @param argumentos Argumentos del programa.
+ * @return Segundos del plazo, o 0 si no se indica.
+ */
+int plazoDrenado(const std::vector<std::string>& argumentos) {
+    int plazo = 0;
+    for (size_t i = 0; i < argumentos.size(); ++i) {
+        if (argumentos[i] == "--") {
+            break; // Fin de las opciones
+        }
+        if (argumentos[i] == "-d" && i + 1 < argumentos.size()) {
+            plazo = atoi(argumentos[++i].c_str());
+        } else if (argumentos[i].compare(0, 2, "-d") == 0 && argumentos[i].size() > 2) {
+            plazo = atoi(argumentos[i].c_str() + 2);
+        }
+    }
+    return plazo > 0 ? plazo : 0;
+}
+
+/**
+ * Lee el archivo de topología.
+ *
+ * @param ruta Ruta del archivo.
+ * @param programas Vector donde se agregan los programas leídos.
+ * @return true si el archivo se leyó sin errores.
+ */
+bool leerTopologia(const char* ruta, std::vector<Programa>& programas) {
+    std::ifstream archivo(ruta);
+    if (!archivo.is_open()) {
+        std::cerr << "Error: No se pudo abrir el archivo de topología: " << ruta << std::endl;
+        return false;
+    }
+
+    std::string linea;
+    int numero = 0;
+    while (std::getline(archivo, linea)) {
+        numero++;
+        std::stringstream palabras(linea);
+        std::string palabra;
+        if (!(palabras >> palabra) || palabra[0] == '#') {
+            continue; // Línea vacía o comentario
+        }
+
+        Programa programa;
+        programa.ejecutable = palabra;
+        bool enArgumentos = false;
+        bool valido = true;
+        while (palabras >> palabra) {
+            if (enArgumentos) {
+                programa.argumentos.push_back(palabra);
+                continue;
+            }
+            if (palabra == "--") {
+                enArgumentos = true;
+                continue;
+            }
+            size_t igual = palabra.find('=');
+            std::string clave = palabra.substr(0, igual);
+            std::string valor = igual == std::string::npos ? "" : palabra.substr(igual + 1);
+            if (clave == "cantidad") {
+                programa.cantidad = atoi(valor.c_str());
+                valido = programa.cantidad > 0;
+            } else if (clave == "cpu") {
+                valido = leerCpus(valor, programa.cpus);
+            } else if (clave == "nice") {
+                programa.conNice = true;
+                programa.nice = atoi(valor.c_str());
+            } else if (clave == "fifo") {
+                programa.fifo = atoi(valor.c_str());
+            } else if (clave == "reinicio" && (valor == "nunca" || valor == "fallo" || valor == "siempre")) {
+                programa.reinicio = valor == "nunca" ? REINICIO_NUNCA : valor == "fallo" ? REINICIO_FALLO : REINICIO_SIEMPRE;
+            } else {
+                valido = false;
+            }
+            if (!valido) {
+                break;
+            }
+        }
+        if (!valido) {
+            std::cerr << "Error: Opción no válida en la línea " << numero << " de " << ruta << ": " << palabra << std::endl;
+            return false;
+        }
+        int drenado = plazoDrenado(programa.argumentos);
+        programa.plazoTermino = drenado > 0 ? drenado + MARGEN_TERMINO : 0; // Nunca interrumpir su drenado
+        programas.push_back(programa);
+    }
+    return true;
+}
+
+/**
+ * Fija cuándo se relanza una réplica y duplica su espera para la siguiente vez, hasta el tope.
+ *
+ * @param proceso Réplica a relanzar.
+ * @param ahora Hora actual.
+ */
+void programarReinicio(Proceso& proceso, std::time_t ahora) {
+    proceso.relanzar = ahora + proceso.espera;
+    proceso.espera = std::min(proceso.espera * 2, ESPERA_MAXIMA);
+}
+
+/**
+ * Crea el proceso de una réplica, fija su afinidad de CPU y su prioridad, y ejecuta el programa.
+ *
+ * Si el programa tiene varias CPUs y varias réplicas, cada réplica se fija a una CPU distinta
+ * de la lista, en orden circular. Si no se puede crear el proceso, se reintenta tras la espera de la
+ * réplica, sea cual sea su política de reinicio (nunca llegó a ejecutarse).
+ *
+ * @param programa Programa a lanzar.
+ * @param proceso Réplica a lanzar; se actualizan su PID y hora de inicio.
+ */
+void lanzar(Programa& programa, Proceso& proceso) {
+    pid_t pid = fork();
+    if (pid < 0) {
+        std::cerr << "Error: No se pudo crear el proceso para " << programa.ejecutable << ": " << strerror(errno)
+                  << "; se reintenta en " << proceso.espera << " s" << std::endl;
+        programarReinicio(proceso, std::time(nullptr));
+        return;
+    }
+
+    if (pid == 0) {
+        // Proceso hijo: restaurar las señales que el supervisor bloqueó
+        sigset_t ninguna;
+        sigemptyset(&ninguna);
+        sigprocmask(SIG_SETMASK, &ninguna, NULL);
+
+        // Afinidad de CPU
+        if (!programa.cpus.empty()) {
+            cpu_set_t conjunto;
+            CPU_ZERO(&conjunto);
+            if (programa.cantidad > 1 && programa.cpus.size() > 1) {
+                CPU_SET(programa.cpus[proceso.replica % programa.cpus.size()], &conjunto);
+            } else {
+                for (int cpu : programa.cpus) {
+                    CPU_SET(cpu, &conjunto);
+                }
+            }
+            if (sched_setaffinity(0, sizeof(conjunto), &conjunto) < 0) {
+                std::cerr << "Error: No se pudo fijar la afinidad de " << programa.ejecutable << ": " << strerror(errno) << std::endl;
+            }
+        }
+
+        // Prioridad de planificación
+        if (programa.fifo > 0) {
+            struct sched_param parametros;
+            parametros.sched_priority = programa.fifo;
+            if (sched_setscheduler(0, SCHED_FIFO, &parametros) < 0) {
+                std::cerr << "Error: No se pudo usar SCHED_FIFO en " << programa.ejecutable << ": " << strerror(errno) << std::endl;
+            }
+        }
+        if (programa.conNice && setpriority(PRIO_PROCESS, 0, programa.nice) < 0) {
+            std::cerr << "Error: No se pudo fijar la prioridad de " << programa.ejecutable << ": " << strerror(errno) << std::endl;
+        }
+
+        // Construir los argumentos reemplazando {i} por el índice de la réplica
+        std::vector<std::string> argumentos;
+        argumentos.push_back(programa.ejecutable);
+        for (std::string argumento : programa.argumentos) {
+            size_t marca;
+            while ((marca = argumento.find("{i}")) != std::string::npos) {
+                argumento.replace(marca, 3, std::to_string(proceso.replica));
+            }
+            argumentos.push_back(argumento);
+        }
+        std::vector<char*> argv;
+        for (std::string& argumento : argumentos) {
+            argv.push_back(&argumento[0]);
+        }
+        argv.push_back(nullptr);
+
+        execv(programa.ejecutable.c_str(), argv.data());
+        std::cerr << "Error: No se pudo ejecutar " << programa.ejecutable << ": " << strerror(errno) << std::endl;
+        _exit(127);
+    }
+
+    proceso.pid = pid;
+    proceso.inicio = std::time(nullptr);
+    proceso.relanzar = 0;
+    programa.inicios++;
+}
+
+/**
+ * Envía una señal a las réplicas en ejecución de un programa.
+ *
+ * @param programa Índice del programa en la topología.
+ * @param procesos Réplicas de todos los programas.
+ * @param senal Señal a enviar.
+ */
+void detenerPrograma(int programa, const std::vector<Proceso>& procesos, int senal) {
+    for (const Proceso& proceso : procesos) {
+        if (proceso.programa == programa && proceso.pid > 0) {
+            kill(proceso.pid, senal);
+        }
+    }
+}
+
+/**
+ * Muestra las métricas agregadas de cada programa.
+ *
+ * @param programas Programas de la topología.
+ * @param procesos Réplicas de todos los programas.
+ */
+void mostrarMetricas(const std::vector<Programa>& programas, const std::vector<Proceso>& procesos) {
+    std::time_t ahora = std::time(nullptr);
+    std::cout << "Métricas del supervisor:" << std::endl;
+    for (size_t i = 0; i < programas.size(); ++i) {
+        const Programa& programa = programas[i];
+        int activos = 0;
+        long segundos = programa.segundosEjecucion;
+        for (const Proceso& proceso : procesos) {
+            if (proceso.programa == static_cast<int>(i) && proceso.pid > 0) {
+                activos++;
+                segundos += ahora - proceso.inicio;
+            }
+        }
+        std::cout << "  " << programa.ejecutable << ": " << activos << "/" << programa.cantidad << " activos, "
+                  << programa.inicios << " inicios, " << programa.caidas << " caídas, "
+                  << programa.finalizados << " finalizados, " << segundos << " s de ejecución acumulada" << std::endl;
+    }
+}
 
 int main(int argc, char *argv[]) {
-    // Parse command line arguments
-    // Fork child processes for sensors
-    // Fork child process for monitor
-    // Wait for child processes to finish
+    // Iniciando variables
+    int option;  // Opción para getopt
+    char* topologyFile = nullptr;  // Archivo de topología
+    int metricsInterval = 0;  // Segundos entre reportes de métricas (0 = solo con SIGUSR1 y al final)
+
+    // Revisando argumentos y asignándolos
+    while ((option = getopt(argc, argv, "c:m:")) != -1) {
+        switch (option) {
+            case 'c':
+                topologyFile = optarg;  // Asignando el archivo de topología
+                break;
+            case 'm':
+                metricsInterval = atoi(optarg);  // Asignando el intervalo de métricas
+                break;
+            default:
+                std::cerr << "Uso: " << argv[0] << " -c archivoTopologia [-m segundosMetricas]" << std::endl;
+                return 1;
+        }
+    }
+    if (topologyFile == nullptr) {
+        std::cerr << "Uso: " << argv[0] << " -c archivoTopologia [-m segundosMetricas]" << std::endl;
+        return 1;
+    }
+
+    std::vector<Programa> programas;
+    if (!leerTopologia(topologyFile, programas)) {
+        return 1;
+    }
+
+    // Las señales se atienden de forma síncrona con sigtimedwait
+    sigset_t senales;
+    sigemptyset(&senales);
+    sigaddset(&senales, SIGCHLD);
+    sigaddset(&senales, SIGINT);
+    sigaddset(&senales, SIGTERM);
+    sigaddset(&senales, SIGUSR1);
+    sigprocmask(SIG_BLOCK, &senales, NULL);
+
+    // Lanzando las réplicas en el orden de la topología
+    std::vector<Proceso> procesos;
+    for (size_t i = 0; i < programas.size(); ++i) {
+        for (int replica = 0; replica < programas[i].cantidad; ++replica) {
+            Proceso proceso;
+            proceso.programa = static_cast<int>(i);
+            proceso.replica = replica;
+            procesos.push_back(proceso);
+        }
+    }
+    for (Proceso& proceso : procesos) {
+        lanzar(programas[proceso.programa], proceso);
+    }
+
+    bool terminando = false;
+    int etapa = static_cast<int>(programas.size()); // Programa que se está deteniendo (los posteriores ya terminaron)
+    std::time_t limiteEtapa = 0;
+    std::time_t ultimoReporte = std::time(nullptr);
+    while (true) {
+        struct timespec espera = {1, 0};
+        int senal = sigtimedwait(&senales, NULL, &espera);
+        std::time_t ahora = std::time(nullptr);
+
+        if ((senal == SIGINT || senal == SIGTERM) && !terminando) {
+            std::cout << "Deteniendo procesos..." << std::endl;
+            terminando = true;
+        } else if (senal == SIGUSR1) {
+            mostrarMetricas(programas, procesos);
+        }
+
+        // Recoger los procesos que terminaron
+        int estado;
+        pid_t pid;
+        while ((pid = waitpid(-1, &estado, WNOHANG)) > 0) {
+            for (Proceso& proceso : procesos) {
+                if (proceso.pid != pid) {
+                    continue;
+                }
+                Programa& programa = programas[proceso.programa];
+                long duracion = ahora - proceso.inicio;
+                bool fallo = !WIFEXITED(estado) || WEXITSTATUS(estado) != 0;
+                programa.segundosEjecucion += duracion;
+                proceso.pid = -1;
+                if (fallo) {
+                    programa.caidas++;
+                    std::cerr << programa.ejecutable << " [" << proceso.replica << "] terminó con "
+                              << (WIFSIGNALED(estado) ? "la señal " + std::to_string(WTERMSIG(estado))
+                                                      : "el código " + std::to_string(WEXITSTATUS(estado)))
+                              << std::endl;
+                } else {
+                    programa.finalizados++;
+                }
+                if (!terminando && (programa.reinicio == REINICIO_SIEMPRE || (fallo && programa.reinicio == REINICIO_FALLO))) {
+                    if (duracion >= EJECUCION_ESTABLE) {
+                        proceso.espera = ESPERA_MINIMA; // Se mantuvo estable: reiniciar la espera
+                    }
+                    programarReinicio(proceso, ahora);
+                }
+                break;
+            }
+        }
+
+        // Relanzar las réplicas cuya espera terminó
+        bool quedan = false;
+        for (Proceso& proceso : procesos) {
+            if (!terminando && proceso.pid < 0 && proceso.relanzar != 0 && ahora >= proceso.relanzar) {
+                lanzar(programas[proceso.programa], proceso);
+            }
+            quedan = quedan || proceso.pid > 0 || (!terminando && proceso.relanzar != 0);
+        }
+        if (!quedan) {
+            break;
+        }
+
+        // Detener un programa a la vez, del último al primero: los sensores dejan de escribir antes de que el
+        // monitor (primero en la topología) empiece a drenar. El que no termina en su plazo recibe SIGKILL
+        if (terminando) {
+            int total = static_cast<int>(programas.size());
+            auto enEjecucion = [&procesos](int programa) {
+                return std::count_if(procesos.begin(), procesos.end(), [programa](const Proceso& proceso) {
+                    return proceso.programa == programa && proceso.pid > 0;
+                });
+            };
+            if (etapa < total && ahora >= limiteEtapa) {
+                detenerPrograma(etapa, procesos, SIGKILL);
+            }
+            while (etapa > 0 && (etapa == total || enEjecucion(etapa) == 0)) {
+                etapa--;
+                detenerPrograma(etapa, procesos, SIGTERM);
+                int plazo = programas[etapa].plazoTermino;
+                limiteEtapa = ahora + (plazo > 0 ? plazo : etapa == 0 ? PLAZO_TERMINO : PLAZO_ETAPA);
+            }
+        }
+
+        if (metricsInterval > 0 && ahora - ultimoReporte >= metricsInterval) {
+            mostrarMetricas(programas, procesos);
+            ultimoReporte = ahora;
+        }
+    }
+
+    mostrarMetricas(programas, procesos);
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,322 @@
+/**
+ * @file metricas.cpp
+ * @autores Juan Pablo Hernández Ceballos
+ * Implementa el registro de métricas y el servidor que las exporta por un socket Unix.
+ */
+
+#include "metricas.h"
+#include "socket_unix.h"
+
+#include <cstdio>
+#include <ctime>
+#include <poll.h>
+#include <sstream>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+namespace {
+
+// Contador global para asignar una ranura a cada hilo la primera vez que suma.
+std::atomic<int> siguienteRanura{0};
+
+// Ranura de contador del hilo actual.
+int ranuraHilo() {
+    thread_local int ranura = siguienteRanura.fetch_add(1, std::memory_order_relaxed) % MAX_HILOS_METRICAS;
+    return ranura;
+}
+
+// Escribe el nombre de una serie con sus etiquetas, por ejemplo `nombre{canal="pH"}`.
+void escribirSerie(std::ostringstream& salida, const std::string& nombre, const std::string& etiquetas,
+                   const std::string& extra = "") {
+    salida << nombre;
+    if (!etiquetas.empty() || !extra.empty()) {
+        salida << "{" << etiquetas << (!etiquetas.empty() && !extra.empty() ? "," : "") << extra << "}";
+    }
+}
+
+} // namespace
+
+uint64_t relojNs() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return static_cast<uint64_t>(t.tv_sec) * 1000000000ull + t.tv_nsec;
+}
+
+// Suma n a la ranura del hilo actual.
+void Contador::sumar(uint64_t n) {
+    ranuras[ranuraHilo()].v.fetch_add(n, std::memory_order_relaxed);
+}
+
+// Valor total: suma de las ranuras de todos los hilos.
+uint64_t Contador::valor() const {
+    uint64_t total = 0;
+    for (const Ranura& ranura : ranuras) {
+        total += ranura.v.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+void Medidor::fijar(int64_t valor) {
+    v.store(valor, std::memory_order_relaxed);
+}
+
+void Medidor::sumar(int64_t n) {
+    v.fetch_add(n, std::memory_order_relaxed);
+}
+
+// Sube el medidor a `valor` si es mayor que el actual (marca de nivel máximo).
+void Medidor::maximo(int64_t valor) {
+    int64_t actual = v.load(std::memory_order_relaxed);
+    while (valor > actual && !v.compare_exchange_weak(actual, valor, std::memory_order_relaxed)) {
+    }
+}
+
+int64_t Medidor::valor() const {
+    return v.load(std::memory_order_relaxed);
+}
+
+// Registra una duración. La cubeta i cubre hasta 2^(i+8) ns; la última cubre el resto.
+void Histograma::observar(uint64_t nanosegundos) {
+    int i = 0;
+    uint64_t limite = 1ull << PRIMERA_CUBETA_LOG2;
+    while (i < CUBETAS_HISTOGRAMA && nanosegundos > limite) {
+        limite <<= 1;
+        i++;
+    }
+    cubetas[i].fetch_add(1, std::memory_order_relaxed);
+    total.fetch_add(1, std::memory_order_relaxed);
+    sumaNs.fetch_add(nanosegundos, std::memory_order_relaxed);
+}
+
+uint64_t Histograma::cubeta(int i) const {
+    return cubetas[i].load(std::memory_order_relaxed);
+}
+
+uint64_t Histograma::cantidad() const {
+    return total.load(std::memory_order_relaxed);
+}
+
+uint64_t Histograma::suma() const {
+    return sumaNs.load(std::memory_order_relaxed);
+}
+
+// Cota superior, en nanosegundos, de la cubeta donde cae el cuantil q (0 si no hay observaciones).
+uint64_t Histograma::percentil(double q) const {
+    uint64_t n = cantidad();
+    if (n == 0) {
+        return 0;
+    }
+    uint64_t objetivo = static_cast<uint64_t>(q * n);
+    uint64_t acumulado = 0;
+    for (int i = 0; i < CUBETAS_HISTOGRAMA; ++i) {
+        acumulado += cubeta(i);
+        if (acumulado > objetivo) {
+            return 1ull << (i + PRIMERA_CUBETA_LOG2);
+        }
+    }
+    return UINT64_MAX; // Cae en la cubeta abierta
+}
+
+RegistroMetricas::RegistroMetricas() {
+    pthread_mutex_init(&mutex, NULL);
+}
+
+RegistroMetricas::~RegistroMetricas() {
+    pthread_mutex_destroy(&mutex);
+}
+
+// Busca la familia con ese nombre o la crea. Requiere el mutex.
+RegistroMetricas::Familia& RegistroMetricas::familia(const std::string& nombre, const std::string& ayuda, Tipo tipo) {
+    for (Familia& f : familias) {
+        if (f.nombre == nombre) {
+            return f;
+        }
+    }
+    familias.push_back(Familia{nombre, ayuda, tipo, {}});
+    return familias.back();
+}
+
+/**
+ * Registra un contador. `etiquetas` va en formato Prometheus sin llaves, por ejemplo `canal="pH"`.
+ */
+Contador* RegistroMetricas::contador(const std::string& nombre, const std::string& ayuda, const std::string& etiquetas) {
+    pthread_mutex_lock(&mutex);
+    contadores.emplace_back(new Contador());
+    familia(nombre, ayuda, CONTADOR).instancias.push_back(Instancia{etiquetas, contadores.back().get()});
+    Contador* c = contadores.back().get();
+    pthread_mutex_unlock(&mutex);
+    return c;
+}
+
+Medidor* RegistroMetricas::medidor(const std::string& nombre, const std::string& ayuda, const std::string& etiquetas) {
+    pthread_mutex_lock(&mutex);
+    medidores.emplace_back(new Medidor());
+    familia(nombre, ayuda, MEDIDOR).instancias.push_back(Instancia{etiquetas, medidores.back().get()});
+    Medidor* m = medidores.back().get();
+    pthread_mutex_unlock(&mutex);
+    return m;
+}
+
+Histograma* RegistroMetricas::histograma(const std::string& nombre, const std::string& ayuda, const std::string& etiquetas) {
+    pthread_mutex_lock(&mutex);
+    histogramas.emplace_back(new Histograma());
+    familia(nombre, ayuda, HISTOGRAMA).instancias.push_back(Instancia{etiquetas, histogramas.back().get()});
+    Histograma* h = histogramas.back().get();
+    pthread_mutex_unlock(&mutex);
+    return h;
+}
+
+/**
+ * Devuelve todas las métricas en el formato de texto de Prometheus. Los histogramas se exportan en segundos.
+ */
+std::string RegistroMetricas::exportar() const {
+    std::ostringstream salida;
+    pthread_mutex_lock(&mutex);
+    for (const Familia& f : familias) {
+        static const char* const tipos[] = {"counter", "gauge", "histogram"};
+        salida << "# HELP " << f.nombre << " " << f.ayuda << "\n";
+        salida << "# TYPE " << f.nombre << " " << tipos[f.tipo] << "\n";
+        for (const Instancia& instancia : f.instancias) {
+            if (f.tipo == CONTADOR) {
+                escribirSerie(salida, f.nombre, instancia.etiquetas);
+                salida << " " << static_cast<const Contador*>(instancia.metrica)->valor() << "\n";
+            } else if (f.tipo == MEDIDOR) {
+                escribirSerie(salida, f.nombre, instancia.etiquetas);
+                salida << " " << static_cast<const Medidor*>(instancia.metrica)->valor() << "\n";
+            } else {
+                const Histograma* h = static_cast<const Histograma*>(instancia.metrica);
+                uint64_t acumulado = 0;
+                for (int i = 0; i <= CUBETAS_HISTOGRAMA; ++i) {
+                    acumulado += h->cubeta(i);
+                    char limite[32];
+                    if (i < CUBETAS_HISTOGRAMA) {
+                        snprintf(limite, sizeof(limite), "le=\"%g\"", (1ull << (i + PRIMERA_CUBETA_LOG2)) / 1e9);
+                    } else {
+                        snprintf(limite, sizeof(limite), "le=\"+Inf\"");
+                    }
+                    escribirSerie(salida, f.nombre + "_bucket", instancia.etiquetas, limite);
+                    salida << " " << acumulado << "\n";
+                }
+                escribirSerie(salida, f.nombre + "_sum", instancia.etiquetas);
+                salida << " " << h->suma() / 1e9 << "\n";
+                escribirSerie(salida, f.nombre + "_count", instancia.etiquetas);
+                salida << " " << h->cantidad() << "\n";
+            }
+        }
+    }
+    pthread_mutex_unlock(&mutex);
+    return salida.str();
+}
+
+/**
+ * Resume los histogramas registrados, una serie por línea con su cantidad y sus percentiles 50, 90, 99 y
+ * 99,9 en segundos (el límite superior de la cubeta; `+Inf` si cae en la cubeta abierta).
+ *
+ * @return Líneas `serie cantidad=N p50=... p90=... p99=... p999=...`.
+ */
+std::string RegistroMetricas::resumirHistogramas() const {
+    static const double CUANTILES[] = {0.5, 0.9, 0.99, 0.999};
+    static const char* const NOMBRES[] = {"p50", "p90", "p99", "p999"};
+    std::ostringstream salida;
+    pthread_mutex_lock(&mutex);
+    for (const Familia& f : familias) {
+        if (f.tipo != HISTOGRAMA) {
+            continue;
+        }
+        for (const Instancia& instancia : f.instancias) {
+            const Histograma* h = static_cast<const Histograma*>(instancia.metrica);
+            escribirSerie(salida, f.nombre, instancia.etiquetas);
+            salida << " cantidad=" << h->cantidad();
+            for (int i = 0; i < 4; ++i) {
+                uint64_t limite = h->percentil(CUANTILES[i]);
+                salida << " " << NOMBRES[i] << "=";
+                if (limite == UINT64_MAX) {
+                    salida << "+Inf";
+                } else {
+                    salida << limite / 1e9;
+                }
+            }
+            salida << "\n";
+        }
+    }
+    pthread_mutex_unlock(&mutex);
+    return salida.str();
+}
+
+ServidorMetricas::ServidorMetricas(const RegistroMetricas& registro, const std::string& ruta)
+    : registro(registro), ruta(ruta), fd(-1), hilo() {
+}
+
+ServidorMetricas::~ServidorMetricas() {
+    detener();
+}
+
+/**
+ * Abre el socket y lanza el hilo que atiende las conexiones.
+ *
+ * @return true si el servidor quedó escuchando.
+ */
+bool ServidorMetricas::iniciar() {
+    fd = escucharUnix(ruta);
+    if (fd < 0) {
+        return false;
+    }
+    activo = true;
+    if (pthread_create(&hilo, NULL, atender, this) != 0) {
+        activo = false;
+        close(fd);
+        fd = -1;
+        return false;
+    }
+    return true;
+}
+
+// Detiene el hilo, cierra el socket y elimina su archivo.
+void ServidorMetricas::detener() {
+    if (!activo) {
+        return;
+    }
+    activo = false;
+    pthread_join(hilo, NULL);
+    close(fd);
+    unlink(ruta.c_str());
+    fd = -1;
+}
+
+// Hilo que acepta conexiones y responde a cada una con las métricas.
+void* ServidorMetricas::atender(void* arg) {
+    ServidorMetricas* servidor = reinterpret_cast<ServidorMetricas*>(arg);
+    while (servidor->activo) {
+        struct pollfd escucha = {servidor->fd, POLLIN, 0};
+        if (poll(&escucha, 1, 200) <= 0) {
+            continue;
+        }
+        int cliente = accept(servidor->fd, NULL, NULL);
+        if (cliente < 0) {
+            continue;
+        }
+        struct timeval plazo = {1, 0}; // Un cliente que no lee no detiene al servidor ni a su detención
+        setsockopt(cliente, SOL_SOCKET, SO_SNDTIMEO, &plazo, sizeof(plazo));
+
+        // Esperar brevemente una petición; si es HTTP, responder con cabecera
+        char peticion[512];
+        ssize_t leidos = 0;
+        struct pollfd entrada = {cliente, POLLIN, 0};
+        if (poll(&entrada, 1, 100) > 0) {
+            leidos = recv(cliente, peticion, sizeof(peticion), 0);
+        }
+        std::string cuerpo = servidor->registro.exportar();
+        if (leidos >= 3 && std::string(peticion, 3) == "GET") {
+            std::string cabecera = "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: " +
+                                   std::to_string(cuerpo.size()) + "\r\n\r\n";
+            if (!enviarTodo(cliente, cabecera.data(), cabecera.size())) {
+                close(cliente); // Venció el plazo o el cliente se fue: no tiene sentido enviar el cuerpo
+                continue;
+            }
+        }
+        enviarTodo(cliente, cuerpo.data(), cuerpo.size());
+        close(cliente);
+    }
+    return nullptr;
+}
@@ -0,0 +1,138 @@
+/**
+ * @file metricas.h
+ * @autores Juan Pablo Hernández Ceballos
+ * Registro de métricas del monitor (contadores, medidores e histogramas) y su exportación en el
+ * formato de texto de Prometheus.
+ *
+ * Los contadores tienen una ranura por hilo en su propia línea de caché: sumar es una operación
+ * atómica relajada sobre la ranura del hilo, sin competencia, y las ranuras se suman al leer.
+ * Los histogramas usan cubetas de potencias de dos en nanosegundos.
+ */
+
+#ifndef METRICAS_H
+#define METRICAS_H
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <pthread.h>
+#include <string>
+#include <vector>
+
+const int MAX_HILOS_METRICAS = 64;       ///< Ranuras por contador (los hilos adicionales comparten ranura)
+const int CUBETAS_HISTOGRAMA = 28;       ///< Cubetas finitas de los histogramas (256 ns a ~34 s)
+const int PRIMERA_CUBETA_LOG2 = 8;       ///< Límite de la primera cubeta: 2^8 ns
+
+/**
+ * Contador monótono con una ranura por hilo.
+ */
+class Contador {
+public:
+    void sumar(uint64_t n = 1);
+    uint64_t valor() const;
+
+private:
+    struct alignas(64) Ranura {
+        std::atomic<uint64_t> v{0};
+    };
+    Ranura ranuras[MAX_HILOS_METRICAS];
+};
+
+/**
+ * Valor que sube y baja (ocupación, capacidad). También puede registrar un máximo histórico.
+ */
+class Medidor {
+public:
+    void fijar(int64_t v);
+    void sumar(int64_t n);
+    void maximo(int64_t v);
+    int64_t valor() const;
+
+private:
+    std::atomic<int64_t> v{0};
+};
+
+/**
+ * Histograma de duraciones en nanosegundos con cubetas de potencias de dos.
+ */
+class Histograma {
+public:
+    void observar(uint64_t nanosegundos);
+    uint64_t cubeta(int i) const;
+    uint64_t cantidad() const;
+    uint64_t suma() const;
+    uint64_t percentil(double q) const;
+
+private:
+    std::atomic<uint64_t> cubetas[CUBETAS_HISTOGRAMA + 1] = {};
+    std::atomic<uint64_t> total{0};
+    std::atomic<uint64_t> sumaNs{0};
+};
+
+/**
+ * Registro de métricas con nombre, ayuda y etiquetas. Las métricas deben registrarse antes de
+ * iniciar los hilos que las usan; los punteros devueltos son válidos mientras viva el registro.
+ */
+class RegistroMetricas {
+public:
+    RegistroMetricas();
+    ~RegistroMetricas();
+
+    Contador* contador(const std::string& nombre, const std::string& ayuda, const std::string& etiquetas = "");
+    Medidor* medidor(const std::string& nombre, const std::string& ayuda, const std::string& etiquetas = "");
+    Histograma* histograma(const std::string& nombre, const std::string& ayuda, const std::string& etiquetas = "");
+
+    std::string exportar() const;
+    std::string resumirHistogramas() const;
+
+private:
+    enum Tipo { CONTADOR, MEDIDOR, HISTOGRAMA };
+    struct Instancia {
+        std::string etiquetas;
+        void* metrica;
+    };
+    struct Familia {
+        std::string nombre;
+        std::string ayuda;
+        Tipo tipo;
+        std::vector<Instancia> instancias;
+    };
+
+    Familia& familia(const std::string& nombre, const std::string& ayuda, Tipo tipo);
+
+    mutable pthread_mutex_t mutex;                ///< Protege las familias durante el registro y la exportación
+    std::vector<Familia> familias;                ///< Familias en orden de registro
+    std::deque<std::unique_ptr<Contador>> contadores;
+    std::deque<std::unique_ptr<Medidor>> medidores;
+    std::deque<std::unique_ptr<Histograma>> histogramas;
+};
+
+/**
+ * Servidor que entrega las métricas en formato Prometheus a cada conexión en un socket Unix.
+ * Responde con una cabecera HTTP si el cliente envía una petición GET (p. ej. `curl --unix-socket`).
+ */
+class ServidorMetricas {
+public:
+    ServidorMetricas(const RegistroMetricas& registro, const std::string& ruta);
+    ~ServidorMetricas();
+
+    bool iniciar();
+    void detener();
+
+private:
+    static void* atender(void* arg);
+
+    const RegistroMetricas& registro;  ///< Métricas a exportar
+    std::string ruta;                  ///< Ruta del socket
+    int fd;                            ///< Socket de escucha
+    pthread_t hilo;                    ///< Hilo que atiende las conexiones
+    std::atomic<bool> activo{false};   ///< false para terminar el hilo
+};
+
+/**
+ * Hora monótona en nanosegundos, usada para medir esperas y latencias.
+ */
+uint64_t relojNs();
+
+#endif //METRICAS_H
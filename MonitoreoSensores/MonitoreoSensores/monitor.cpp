@@ -5,13 +5,31 @@
  * 
  * @detalles
  * Este archivo contiene las siguientes funciones y módulos:
- * - getCurrentTime: Obtiene la hora actual en formato HH:MM:SS.
- * - is_float: Verifica si una cadena representa un número flotante.
- * - is_integer: Verifica si una cadena representa un número entero.
- * - reco_hilo: Función del hilo recolector de datos de sensores.
- * - pH_hilo: Función del hilo que maneja los datos de pH.
- * - temperatura_hilo: Función del hilo que maneja los datos de temperatura.
+ * - clasificarMedicion: Clasifica una medición recibida y la agrega al lote de su canal.
+ * - agregarAlLote: Revisa la secuencia de una medición y la agrega al lote si no es un duplicado descartable.
+ * - entregarLote: Registra un lote de mediciones en el WAL y lo entrega a los buffers.
+ * - revisarSensores: Actualiza el estado de actividad de los sensores y decide si el monitor debe terminar.
+ * - terminarRecolector: Libera el pipe de un recolector; el último en terminar cierra los buffers.
+ * - reco_hilo: Función de los hilos recolectores de datos de sensores (uno por pipe).
+ * - terminarEvaluador: Marca el fin de un hilo de evaluación; el último cierra la cola de persistencia.
+ * - detectarAnomalias: Pasa las mediciones válidas de un lote por los detectores de anomalías del canal.
+ * - evaluacionPausada: Indica si la evaluación de un canal está pausada desde el socket de control.
+ * - pH_hilo: Función del hilo que evalúa los datos de pH.
+ * - temperatura_hilo: Función del hilo que evalúa los datos de temperatura.
+ * - persistirMedicion: Agrega una medición liberada al bloque de su archivo y a los agregados del canal.
+ * - desviarTardia: Escribe una medición que llegó después de la marca de agua en la salida de tardías.
+ * - persistencia_hilo: Función del hilo que escribe las mediciones de ambos canales en los archivos de salida.
+ * - registrarMetricas: Registra las métricas de los canales y conecta las de los buffers.
+ * - leerModosEspera: Interpreta la lista de canales que esperan en modo latencia.
+ * - abrirTardias: Abre la salida de mediciones tardías de un canal.
+ * - recargarConfiguracion: Vuelve a leer el archivo de configuración y publica la versión nueva.
+ * - responderControl: Atiende una petición del socket de control.
+ * - esperarHilo: Espera a que un hilo termine sin pasar de un plazo.
+ * - mostrarUbicacion: Muestra la topología detectada y la CPU de cada hilo.
  * - main: Función principal que inicia el programa y gestiona la creación y sincronización de hilos.
+ *   Al recibir SIGINT o SIGTERM detiene el ingreso, drena los buffers dentro de un plazo y muestra un resumen.
+ *   Con SIGUSR1 vuelca el perfil de contención de los buffers (si se compiló con BUFFER_PERFILADO).
+ *   Con SIGHUP recarga el archivo de configuración sin detener el ingreso.
  * 
  * @fecha 23/05/2024
  */
@@ -19,202 +37,659 @@
 #include <fstream>
 #include <pthread.h>
 #include <unistd.h>
-#include <semaphore.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cfloat>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
 #include <ctime>
-#include "buffer.cpp"
+#include <deque>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "agregados.h"
+#include "anomalias.h"
+#include "archivos_salida.h"
+#include "buffer.h"
+#include "clasificacion.h"
+#include "compactador.h"
+#include "configuracion.h"
+#include "control.h"
+#include "difusion.h"
+#include "escaneo.h"
+#include "espera.h"
+#include "metricas.h"
+#include "motor_es.h"
+#include "reorden.h"
+#include "secuencias.h"
+#include "ubicacion.h"
+#include "utilidades.h"
+#include "wal.h"
+
+const char* const ARCHIVO_PH = "pH-data.txt";                   ///< Archivo de salida de pH por defecto
+const char* const ARCHIVO_TEMPERATURA = "temperature-data.txt"; ///< Archivo de salida de temperatura por defecto
+const char* const DIRECTORIO_PH = "pH-data";                    ///< Directorio de los segmentos de pH por defecto
+const char* const DIRECTORIO_TEMPERATURA = "temperature-data";  ///< Directorio de los segmentos de temperatura por defecto
+const size_t MAX_LOTE_WAL = 256;  ///< Máximo de mediciones por confirmación en grupo del WAL
+const int REINTENTOS_WAL = 3;     ///< Intentos de confirmar un lote en el WAL antes de detener el ingreso
+const int INTERVALO_VIGILANCIA_MS = 100;  ///< Cada cuánto revisa el recolector la actividad de los sensores
+const size_t TAM_LECTURA_PIPE = 65536;    ///< Bytes que el recolector lee del pipe de una vez
+const size_t MAX_LOTE_CONSUMIDOR = BITS_MASCARA;  ///< Mediciones que un consumidor toma del buffer de una vez
+const size_t MAX_LOTE_PERSISTENCIA = 256;         ///< Mediciones que la persistencia toma de la cola de una vez
+const int TAM_COLA_PERSISTENCIA = 4096;           ///< Capacidad mínima de la cola de persistencia por canal
+const int ESPERA_PERSISTENCIA_MS = 100;           ///< Espera máxima de la persistencia por la cola (plazos y pedidos de vaciado)
+const LimitesCanal LIMITES_PH = {0.0f, FLT_MAX, 6.0f, 8.0f};             ///< Rango válido y alertas de pH
+const LimitesCanal LIMITES_TEMPERATURA = {0.0f, FLT_MAX, 20.0f, 31.6f};  ///< Rango válido y alertas de temperatura
+const double RESOLUCION_CANAL[NUM_CANALES] = {0.05, 0.5};  ///< Desviación mínima de los detectores de anomalías
+
+/**
+ * Estado de actividad de un sensor. Permite detectar desconexiones sin cerrar el pipe.
+ */
+struct EstadoSensor {
+    std::time_t ultimaLectura = 0;  ///< Hora de la última medición recibida
+    bool activo = false;            ///< true mientras el sensor envía datos dentro del plazo
+    Canal canal = CANAL_PH;         ///< Canal de su última medición, para los mensajes
+};
+
+typedef std::unordered_map<uint32_t, EstadoSensor> SensoresRecolector;  ///< Actividad de cada sensor de un pipe
+
+/**
+ * Métricas de un canal del monitor.
+ */
+struct MetricasCanal {
+    Contador* recibidas = nullptr;      ///< Mediciones válidas recibidas
+    Contador* negativas = nullptr;      ///< Mediciones rechazadas por valor negativo
+    Contador* descartadas = nullptr;    ///< Mediciones rechazadas por un buffer cerrado
+    Contador* fueraDeRango = nullptr;   ///< Mediciones fuera del rango válido al escribirlas
+    Contador* escritas = nullptr;       ///< Mediciones escritas en el archivo de salida
+    Contador* bytesEscritos = nullptr;  ///< Bytes escritos en el archivo de salida
+    Histograma* vaciado = nullptr;      ///< Latencia de la escritura de cada lote en el archivo de salida
+    Contador* perdidas = nullptr;       ///< Secuencias que nunca llegaron
+    Contador* duplicadas = nullptr;     ///< Secuencias recibidas más de una vez
+    Contador* reordenadas = nullptr;    ///< Secuencias recibidas después de una posterior
+    Contador* reinicios = nullptr;      ///< Sensores que volvieron a empezar su numeración
+    Contador* anomalias = nullptr;      ///< Anomalías informadas por los detectores
+    Contador* tardias = nullptr;        ///< Mediciones que llegaron después de la marca de agua
+};
 
 /**
  * Estructura para almacenar los argumentos que se pasarán a los hilos.
  * 
  * @param pH_buffer Puntero al buffer que almacena los datos de pH.
  * @param temp_buffer Puntero al buffer que almacena los datos de temperatura.
- * @param pipeName Nombre del pipe que se utilizará para la comunicación.
- * @param semaphore Semáforo para la sincronización entre hilos.
+ * @param salida Cola de persistencia: las mediciones evaluadas de ambos canales, un carril por canal.
+ * @param evaluadoresVivos Hilos de evaluación que aún no terminan; el último cierra la cola de persistencia.
+ * @param archivos Archivos de salida de cada canal.
+ * @param agregados Agregados por minuto y por hora de cada canal.
+ * @param detectores Detectores de anomalías de cada canal.
+ * @param configuracion Configuración vigente (límites de los canales y rotación); se recarga con SIGHUP.
+ * @param tardias Salida de las mediciones que llegan después de la marca de agua de cada canal.
+ * @param retrasoEventos Retraso tolerado en la hora del evento, en milisegundos (0 = sin reordenar).
+ * @param wal WAL donde se registran las mediciones antes de entregarlas (nullptr si está desactivado).
+ * @param idleTimeout Segundos sin datos tras los cuales un sensor se considera inactivo (0 = nunca).
+ * @param detener Se activa al recibir una señal de término (o cuando todos los sensores quedan inactivos)
+ *                para que los recolectores dejen de leer sus pipes.
+ * @param modoRecolector Modo de espera de los recolectores sobre los pipes (latencia si algún canal lo usa).
+ * @param recolectoresVivos Recolectores que aún no terminan; el último cierra los buffers.
+ * @param recolectoresConSensores Recolectores con algún sensor activo.
+ * @param huboSensores Algún sensor se conectó alguna vez.
+ * @param mutexWal Protege el turno de entrega a los buffers de los lotes registrados en el WAL.
+ * @param turnoWal Avisa que se entregó un lote (o que la entrega se interrumpió).
+ * @param entregadoWal Último LSN entregado a los buffers.
+ * @param entregaRota Un lote no pudo confirmarse: no se entrega ninguno posterior.
+ * @param deduplicar Descartar las mediciones duplicadas antes de registrarlas.
+ * @param motor Motor de entrada y salida de los pipes.
+ * @param metricas Métricas de cada canal.
+ * @param invalidas Mediciones que no son un número válido (no se sabe a qué canal pertenecen).
+ * @param confirmacionWal Latencia de la confirmación en grupo del WAL.
+ * @param ultimos Último valor válido de cada sensor, para el socket de control.
+ * @param difusion Difusión en vivo de las mediciones válidas a los suscriptores.
+ * @param pausado Canales cuya evaluación se pausó desde el socket de control.
+ * @param vaciadosPedidos Vaciados de los archivos pedidos por el socket de control.
+ * @param vaciadosHechos Último vaciado pedido que el hilo de persistencia ya completó.
+ * @param fallo Un error de escritura impidió guardar mediciones; el monitor termina con código 1.
  */
 struct ThreadArgs {
     Buffer* pH_buffer;    ///< Buffer para los datos de pH
     Buffer* temp_buffer;  ///< Buffer para los datos de temperatura
-    char* pipeName;       ///< Nombre del pipe para la comunicación entre procesos
-    sem_t semaphore;      ///< Semáforo para la sincronización entre hilos
+    Buffer* salida;       ///< Cola hacia el hilo de persistencia
+    std::atomic<int> evaluadoresVivos{NUM_CANALES};       ///< Hilos de evaluación en ejecución
+    ArchivosSalida* archivos[NUM_CANALES];                ///< Archivos de salida de cada canal
+    Agregados* agregados[NUM_CANALES];                    ///< Agregados por minuto y por hora de cada canal
+    DetectorAnomalias* detectores[NUM_CANALES];           ///< Detectores de anomalías de cada canal
+    ConfiguracionPublicada* configuracion;                ///< Configuración vigente
+    Sumidero* tardias[NUM_CANALES];                       ///< Mediciones tardías de cada canal
+    int64_t retrasoEventos = 0;                           ///< Retraso tolerado en la hora del evento (ms)
+    Wal* wal;             ///< WAL de las mediciones (nullptr si está desactivado)
+    int idleTimeout;      ///< Segundos de inactividad antes de dar por desconectado un sensor
+    std::atomic<bool> detener{false};                     ///< Solicitud de término del recolector
+    ModoEspera modoRecolector = ESPERA_EFICIENCIA;        ///< Modo de espera de los recolectores sobre los pipes
+    std::atomic<int> recolectoresVivos{0};                ///< Recolectores en ejecución
+    std::atomic<int> recolectoresConSensores{0};          ///< Recolectores con algún sensor activo
+    std::atomic<bool> huboSensores{false};                ///< Algún sensor se conectó alguna vez
+    pthread_mutex_t mutexWal = PTHREAD_MUTEX_INITIALIZER; ///< Turno de entrega, en orden de LSN
+    pthread_cond_t turnoWal = PTHREAD_COND_INITIALIZER;   ///< Fin de la entrega de un lote
+    uint64_t entregadoWal = 0;                            ///< Último LSN entregado a los buffers
+    bool entregaRota = false;                             ///< Un lote no se confirmó: no se entrega ninguno más
+    bool deduplicar = false;                              ///< Descartar duplicados
+    MotorEs motor = MOTOR_CLASICO;                        ///< Motor de entrada y salida de los pipes
+    MetricasCanal metricas[NUM_CANALES];                  ///< Métricas de cada canal
+    Contador* invalidas = nullptr;                        ///< Mediciones no numéricas
+    Histograma* confirmacionWal = nullptr;                ///< Latencia de la confirmación del WAL
+    UltimosValores ultimos;                               ///< Último valor de cada sensor
+    ServidorDifusion* difusion = nullptr;                 ///< Difusión a los suscriptores
+    std::atomic<bool> pausado[NUM_CANALES] = {};          ///< Evaluación pausada de cada canal
+    std::atomic<uint64_t> vaciadosPedidos{0};             ///< Vaciados pedidos
+    std::atomic<uint64_t> vaciadosHechos{0};              ///< Vaciados completados
+    std::atomic<bool> fallo{false};                       ///< Hubo un error de escritura
+};
+
+/**
+ * Argumentos propios de cada hilo recolector.
+ * 
+ * @param args Argumentos compartidos por todos los hilos.
+ * @param indice Número del recolector; también es su carril en los buffers.
+ * @param pipeName Pipe que atiende el recolector.
+ * @param secuencias Seguimiento de las secuencias de los sensores de este pipe.
+ * @param conSensores true mientras alguno de sus sensores está activo.
+ */
+struct Recolector {
+    ThreadArgs* args = nullptr;           ///< Argumentos compartidos
+    int indice = 0;                       ///< Número del recolector y carril en los buffers
+    std::string pipeName;                 ///< Pipe que atiende el recolector
+    SeguimientoSecuencias secuencias;     ///< Secuencias recibidas de cada sensor de este pipe
+    bool conSensores = false;             ///< Algún sensor de este pipe está activo
+    pthread_t hilo;                       ///< Hilo del recolector
 };
 
 
 /**
- * Obtiene la hora actual en formato HH:MM:SS.
+ * Revisa el número de secuencia de una medición y la agrega al lote de su canal.
  * 
- * @return Una cadena que representa la hora actual.
+ * Las mediciones sin secuencia (sensores antiguos) se identifican por su canal y no se revisan.
+ * 
+ * @param canal Canal de la medición.
+ * @param lectura Medición ya clasificada.
+ * @param lote Lote de mediciones pendientes de entregar a los buffers.
+ * @param recolector Recolector que recibió la medición.
  */
-std::string getCurrentTime() {
-    std::time_t currentTime = std::time(nullptr); // Obtener la hora actual en segundos desde el epoch
-    std::tm* localTime = std::localtime(&currentTime); // Convertir la hora actual en una estructura de tiempo local
-    char timeString[100]; // Buffer para almacenar la hora formateada como cadena
-    std::strftime(timeString, sizeof(timeString), "%H:%M:%S", localTime); // Formatear la hora en formato HH:MM:SS
-    return std::string(timeString); // Devolver la hora formateada como una cadena
+void agregarAlLote(Canal canal, Lectura& lectura, std::vector<std::pair<Canal, Lectura>>& lote, Recolector* recolector) {
+    ThreadArgs* args = recolector->args;
+    if (lectura.secuencia == 0) {
+        lectura.sensor = canal;
+    } else {
+        MetricasCanal& metricas = args->metricas[canal];
+        uint64_t perdidas;
+        SeguimientoSecuencias::Resultado resultado = recolector->secuencias.registrar(lectura.sensor, lectura.secuencia, perdidas);
+        if (perdidas > 0) {
+            metricas.perdidas->sumar(perdidas);
+        }
+        if (resultado == SeguimientoSecuencias::REORDENADA) {
+            metricas.reordenadas->sumar();
+        } else if (resultado == SeguimientoSecuencias::REINICIO) {
+            metricas.reinicios->sumar();
+        } else if (resultado == SeguimientoSecuencias::DUPLICADA) {
+            metricas.duplicadas->sumar();
+            if (args->deduplicar) {
+                return;
+            }
+        }
+    }
+    lectura.canal = canal;
+    lote.emplace_back(canal, lectura);
 }
 
 /**
- * Verifica si una cadena representa un número flotante.
+ * Clasifica una medición recibida del sensor y la agrega al lote de su canal.
+ * 
+ * Los enteros no negativos son temperaturas y los flotantes no negativos son valores de pH.
+ * La medición puede traer la identidad del sensor (`sensor:secuencia:valor`) o solo el valor; tras la
+ * secuencia puede venir la hora del evento en la fuente (`sensor:secuencia@milisegundos:valor`).
+ * Los formatos cortos que envían los sensores se decodifican sin copias ni excepciones; cualquier
+ * otro pasa por la validación general con is_integer / is_float.
  * 
- * @param str La cadena que se va a verificar.
- * @return true si la cadena representa un número flotante, false en caso contrario.
+ * @param texto Texto de la medición, sin el delimitador.
+ * @param largo Largo del texto.
+ * @param lote Lote de mediciones pendientes de entregar a los buffers.
+ * @param recolector Recolector que recibió la medición; las rechazadas se cuentan en sus argumentos.
  */
-bool is_float(const std::string& str) {
-    try {
-        std::size_t pos; // Variable para almacenar la posición del primer carácter no convertido
-        std::stof(str, &pos); // Convertir la cadena a flotante
-        // Tiene éxito si no hay caracteres restantes en la cadena
-        return pos == str.size(); // Devolver true si no hay caracteres restantes, indicando que la conversión fue exitosa
-    } catch (...) {
-        return false; // Capturar cualquier excepción y devolver false si ocurre un error durante la conversión
+void clasificarMedicion(const char* texto, size_t largo, std::vector<std::pair<Canal, Lectura>>& lote, Recolector* recolector) {
+    ThreadArgs* args = recolector->args;
+    Lectura lectura;
+    lectura.recepcion = std::time(nullptr);
+    bool esEntero, esFlotante;
+    MedicionDecodificada medicion;
+    if (decodificarMedicion(texto, largo, medicion)) { // Formato corto
+        lectura.sensor = medicion.sensor;
+        lectura.secuencia = medicion.secuencia;
+        if (medicion.evento != 0) {
+            lectura.fijarEvento(medicion.evento);
+        }
+        lectura.fijarValor(medicion.valor, medicion.largoValor);
+        lectura.numero = medicion.numero;
+        esEntero = medicion.tipo == VALOR_ENTERO;
+        esFlotante = medicion.tipo == VALOR_DECIMAL;
+    } else { // Validación general
+        std::string line(texto, largo);
+        std::string valor;
+        int64_t evento = 0;
+        if (!separarIdentidad(line, lectura.sensor, lectura.secuencia, evento, valor)) {
+            valor = line; // Medición sin identidad
+        } else if (evento != 0) {
+            lectura.fijarEvento(evento);
+        }
+        esEntero = is_integer(valor);
+        esFlotante = !esEntero && is_float(valor);
+        if (esEntero) {
+            lectura.numero = std::stoi(valor); // Convertir el valor a entero
+        } else if (esFlotante) {
+            lectura.numero = std::stof(valor); // Convertir el valor a flotante
+        }
+        lectura.fijarValor(valor.data(), valor.size());
+    }
+    if (esEntero) { // Verificar si el valor es un entero
+        if (lectura.numero >= 0) { // Verificar si el valor es positivo
+            agregarAlLote(CANAL_TEMPERATURA, lectura, lote, recolector); // Agregar el valor al lote de temperatura
+        } else {
+            args->metricas[CANAL_TEMPERATURA].negativas->sumar();
+            std::cerr << "Error: valor negativo recibido del sensor" << std::endl; // Mensaje de error si el valor es negativo
+        }
+    } else if (esFlotante) { // Verificar si el valor es un flotante
+        if (lectura.numero >= 0.0) { // Verificar si el valor es positivo
+            agregarAlLote(CANAL_PH, lectura, lote, recolector); // Agregar el valor al lote de pH
+        } else {
+            args->metricas[CANAL_PH].negativas->sumar();
+            std::cerr << "Error: valor negativo recibido del sensor" << std::endl; // Mensaje de error si el valor es negativo
+        }
+    } else {
+        args->invalidas->sumar();
+        std::cerr << "Error: valor no válido recibido del sensor" << std::endl; // Mensaje de error si la línea no es válida
     }
 }
 
 /**
- * Verifica si una cadena representa un número entero.
+ * Registra un lote de mediciones en el WAL y, una vez durable, lo entrega a los buffers.
+ * 
+ * Todas las mediciones del lote se confirman con una sola escritura y un solo fdatasync()
+ * (confirmación en grupo), y con varios recolectores los lotes que llegan mientras se sincroniza otro
+ * se confirman juntos en la escritura siguiente, de modo que el WAL no limita la velocidad de ingreso.
+ * Ningún mutex se retiene durante la sincronización ni la entrega. Los lotes se entregan a los buffers
+ * por turnos en orden de LSN: así los buffers siempre contienen un prefijo de los LSN y los
+ * consumidores escriben en el orden del WAL, que es lo que supone el punto de control.
+ * 
+ * Si el lote no llega a ser durable tras REINTENTOS_WAL intentos, no se entrega: el monitor detiene el
+ * ingreso y termina con error, en lugar de escribir mediciones que una caída no podría recuperar. Los
+ * lotes posteriores tampoco se entregan (dejarían un hueco en el prefijo); los que ya eran durables se
+ * recuperan del WAL en el siguiente inicio.
  * 
- * @param str La cadena que se va a verificar.
- * @return true si la cadena representa un número entero, false en caso contrario.
+ * @param lote Lote de mediciones; queda vacío al terminar.
+ * @param recolector Recolector que entrega el lote; su índice es su carril en los buffers.
+ * @param sensores Estado de actividad de cada sensor del pipe; se actualiza con las mediciones entregadas.
+ * @return false si el lote no pudo confirmarse en el WAL.
  */
-bool is_integer(const std::string& str) {
-    try {
-        std::size_t pos; // Variable para almacenar la posición del primer carácter no convertido
-        std::stoi(str, &pos); // Convertir la cadena a entero
-        // La conversión tiene éxito si no hay caracteres restantes en la cadena
-        return pos == str.size(); // Devolver true si no hay caracteres restantes, indicando que la conversión fue exitosa
-    } catch (...) {
-        return false; // Capturar cualquier excepción y devolver false si ocurre un error durante la conversión
+bool entregarLote(std::vector<std::pair<Canal, Lectura>>& lote, Recolector* recolector, SensoresRecolector& sensores) {
+    ThreadArgs* args = recolector->args;
+    if (args->wal != nullptr && !lote.empty()) {
+        uint64_t ultimo = args->wal->agregar(lote); // LSN consecutivos para todo el lote
+        uint64_t primero = lote.front().second.lsn;
+        uint64_t inicio = relojNs();
+        bool confirmado = args->wal->confirmar(ultimo);
+        for (int intento = 1; !confirmado && intento < REINTENTOS_WAL; ++intento) {
+            usleep(INTERVALO_VIGILANCIA_MS * 1000);
+            confirmado = args->wal->confirmar(ultimo); // El lote sigue pendiente con los mismos LSN
+        }
+        args->confirmacionWal->observar(relojNs() - inicio);
+
+        // Esperar el turno: se entrega cuando ya se entregaron todos los LSN anteriores
+        pthread_mutex_lock(&args->mutexWal);
+        if (!confirmado) {
+            args->entregaRota = true;
+            pthread_cond_broadcast(&args->turnoWal);
+        }
+        while (!args->entregaRota && args->entregadoWal != primero - 1) {
+            pthread_cond_wait(&args->turnoWal, &args->mutexWal);
+        }
+        bool roto = args->entregaRota;
+        pthread_mutex_unlock(&args->mutexWal);
+        if (roto) {
+            if (!confirmado) {
+                std::cerr << "Error: No se pudo confirmar el lote en el WAL; se detiene el ingreso (" << lote.size()
+                          << " mediciones sin entregar)" << std::endl;
+            }
+            args->fallo = true;
+            args->detener = true;
+            lote.clear();
+            return false;
+        }
     }
+    for (auto& medicion : lote) {
+        EstadoSensor& sensor = sensores[medicion.second.sensor];
+        sensor.canal = medicion.first;
+        if (!sensor.activo) {
+            std::cout << "Sensor " << medicion.second.sensor << " de " << NOMBRE_CANAL[medicion.first] << " conectado"
+                      << std::endl;
+            sensor.activo = true;
+            if (!recolector->conSensores) { // Primer sensor activo de este pipe
+                recolector->conSensores = true;
+                args->recolectoresConSensores++;
+                args->huboSensores = true;
+            }
+        }
+        sensor.ultimaLectura = medicion.second.recepcion;
+        args->metricas[medicion.first].recibidas->sumar();
+        Buffer* destino = medicion.first == CANAL_PH ? args->pH_buffer : args->temp_buffer;
+        if (!destino->add(medicion.second, recolector->indice)) { // El buffer ya fue cerrado
+            args->metricas[medicion.first].descartadas->sumar();
+        }
+    }
+    if (args->wal != nullptr && !lote.empty()) { // Ceder el turno al lote siguiente
+        pthread_mutex_lock(&args->mutexWal);
+        args->entregadoWal = lote.back().second.lsn;
+        pthread_cond_broadcast(&args->turnoWal);
+        pthread_mutex_unlock(&args->mutexWal);
+    }
+    lote.clear();
+    return true;
 }
 
+/**
+ * Actualiza el estado de actividad de los sensores de un recolector y decide si el monitor debe terminar.
+ * 
+ * Un sensor que no envía datos durante `idleTimeout` segundos se marca como inactivo. El monitor
+ * termina cuando todos los sensores que alguna vez se conectaron, en cualquiera de los pipes, están
+ * inactivos; si el sensor se reinicia dentro del plazo, simplemente sigue enviando al mismo pipe sin
+ * interrumpir nada.
+ * 
+ * @param sensores Estado de actividad de cada sensor del recolector, por identificador.
+ * @param recolector Recolector dueño de los sensores.
+ * @return true si el monitor debe terminar.
+ */
+bool revisarSensores(SensoresRecolector& sensores, Recolector* recolector) {
+    ThreadArgs* args = recolector->args;
+    int idleTimeout = args->idleTimeout;
+    if (idleTimeout <= 0) {
+        return false;
+    }
+    std::time_t ahora = std::time(nullptr);
+    bool algunoActivo = false;
+    for (auto& entrada : sensores) {
+        EstadoSensor& sensor = entrada.second;
+        if (sensor.activo && ahora - sensor.ultimaLectura >= idleTimeout) {
+            std::cout << "Sensor " << entrada.first << " de " << NOMBRE_CANAL[sensor.canal] << " inactivo por "
+                      << idleTimeout << " segundos" << std::endl;
+            sensor.activo = false;
+        }
+        algunoActivo = algunoActivo || sensor.activo;
+    }
+    if (recolector->conSensores && !algunoActivo) { // El último sensor activo de este pipe se desconectó
+        recolector->conSensores = false;
+        args->recolectoresConSensores--;
+    }
+    return args->huboSensores && args->recolectoresConSensores == 0;
+}
 
+/**
+ * Borra el pipe de un recolector que termina. El último recolector en terminar cierra los buffers:
+ * los otros hilos drenan lo que quede y terminan.
+ * 
+ * @param recolector Recolector que termina.
+ */
+void terminarRecolector(Recolector* recolector) {
+    ThreadArgs* args = recolector->args;
+    unlink(recolector->pipeName.c_str()); // Borrar el pipe
+    if (args->recolectoresVivos.fetch_sub(1) == 1) {
+        args->pH_buffer->close();
+        args->temp_buffer->close();
+        std::cout << "Finalizado el procesamiento de mediciones" << std::endl; // Mensaje de finalización
+    }
+}
 
 /**
  * Función para recolectar datos de los sensores y manejarlos entre hilos.
  * 
- * Esta función se ejecuta en un hilo separado. Abre un pipe para leer los datos
- * de los sensores y los procesa, distribuyéndolos entre los buffers correspondientes.
- * Si el sensor no está conectado, espera 10 segundos antes de terminar el proceso y 
- * enviar mensajes a los otros hilos para que también terminen.
+ * Esta función se ejecuta en un hilo por cada pipe. Abre su pipe para leer los datos
+ * de los sensores y los procesa, distribuyéndolos entre los buffers correspondientes por el carril
+ * propio del recolector, de modo que varios recolectores leen y decodifican en paralelo sin competir
+ * entre sí y las mediciones de cada sensor conservan su orden.
+ * Las mediciones llegan terminadas en '\0' (o '\n') y una misma lectura del pipe puede
+ * traer muchas: los delimitadores de todo el bloque se localizan en una pasada vectorizada y las
+ * mediciones se acumulan en un lote mientras haya más datos disponibles.
+ * El recolector mantiene abierto su propio extremo de escritura del pipe, de modo que la
+ * desconexión de un sensor no cierra el pipe y el sensor puede reconectarse al instante.
+ * Cuando todos los sensores llevan `idleTimeout` segundos inactivos, o cuando se solicita el
+ * término, entrega el último lote; el último recolector en terminar cierra los buffers para que
+ * los otros hilos los drenen y terminen.
+ * En modo latencia, antes de dormir vigila el pipe durante un presupuesto ajustado al ritmo de llegadas.
+ * Con el motor io_uring, la espera y la lectura son una sola llamada al sistema y la vigilancia mira el
+ * anillo de completado sin entrar al núcleo.
  * 
- * @param arg Puntero a una estructura `ThreadArgs` que contiene los argumentos necesarios 
- *            para la función, incluyendo los buffers para pH y temperatura, el nombre del pipe
- *            y un semáforo.
+ * @param arg Puntero a una estructura `Recolector` con el pipe, el carril y los argumentos compartidos
+ *            (buffers para pH y temperatura y WAL).
  * @return void* Siempre devuelve nullptr.
  */
 void* reco_hilo(void* arg) {
-    // Convertir el argumento a un puntero ThreadArgs
-    ThreadArgs* args = reinterpret_cast<ThreadArgs*>(arg);
+    // Convertir el argumento a un puntero Recolector
+    Recolector* recolector = reinterpret_cast<Recolector*>(arg);
+    ThreadArgs* args = recolector->args;
 
-    // Obtener los buffers y el nombre del pipe del argumento
-    Buffer* bufferPh = args->pH_buffer;
-    Buffer* bufferTemp = args->temp_buffer;
-    const char* pipeName = args->pipeName;
+    // Obtener el nombre del pipe del argumento
+    const char* pipeName = recolector->pipeName.c_str();
 
-    // Abrir el Pipe
-    int pipeFd = open(pipeName, O_RDONLY);
-    if (pipeFd < 0) {
-        sem_post(&args->semaphore); // Incrementar el semáforo
+    // Abrir el Pipe sin bloquear y mantener abierto un extremo de escritura propio
+    int pipeFd = open(pipeName, O_RDONLY | O_NONBLOCK);
+    int pipeEscritor = pipeFd < 0 ? -1 : open(pipeName, O_WRONLY); // Evita el fin de archivo al desconectarse un sensor
+    if (pipeFd < 0 || pipeEscritor < 0) {
         std::cerr << "Error: No se pudo abrir el pipe: " << pipeName << std::endl;
+        if (pipeFd >= 0) {
+            close(pipeFd);
+        }
+        args->detener = true; // Detener a los demás recolectores para que los otros hilos terminen
+        terminarRecolector(recolector);
         return nullptr; // Salir de la función si hay un error
     }
 
     // Leer datos del pipe
-    std::string line; // Variable para almacenar la línea leída del pipe
+    std::string line; // Medición incompleta que quedó al final de la última lectura
+    LectorPipe lector(pipeFd, TAM_LECTURA_PIPE, args->motor); // Bloque leído del pipe y su motor
+    std::vector<uint32_t> delimitadores(TAM_LECTURA_PIPE); // Posiciones de los delimitadores del bloque
+    std::vector<std::pair<Canal, Lectura>> lote; // Mediciones pendientes de confirmar en el WAL
+    SensoresRecolector sensores; // Actividad de cada sensor de este pipe
+    EsperaAdaptativa esperaPipe(args->modoRecolector); // Giro antes de dormir a la espera del pipe
     while (true) { // Bucle infinito para leer continuamente del pipe
-        char buffer[256]; // Buffer para almacenar los datos leídos
-        int bytesRead = read(pipeFd, buffer, sizeof(buffer) - 1); // Leer datos del pipe
-        if (bytesRead <= 0) { // Verificar si no se han leído bytes
-            // El sensor no está conectado; esperando 10 segundos
-            sleep(10); // Esperar 10 segundos
-            // Enviar mensajes a los otros hilos para terminar
-            bufferPh->add("-1"); // Agregar mensaje de terminación al buffer de pH
-            bufferTemp->add("-1"); // Agregar mensaje de terminación al buffer de temperatura
-            // Borrar el pipe y terminar el proceso
-            unlink(pipeName); // Borrar el pipe
-            std::cout << "Finalizado el procesamiento de mediciones" << std::endl; // Mensaje de finalización
-            break; // Salir del bucle
+        if (lote.empty()) { // En modo latencia, vigilar el pipe un instante antes de dormir
+            esperaPipe.girar([&lector] { return lector.hayDatos(); });
         }
-
-        // Procesar la línea y agregar a los buffers
-        buffer[bytesRead] = '\0'; // Terminar la cadena con un carácter nulo
-        line = buffer; // Convertir el buffer a un string
-        if (is_integer(line)) { // Verificar si la línea es un entero
-            int value = std::stoi(line); // Convertir la línea a entero
-            if (value >= 0) { // Verificar si el valor es positivo
-                bufferTemp->add(line); // Agregar el valor al buffer de temperatura
-            } else {
-                std::cerr << "Error: valor negativo recibido del sensor" << std::endl; // Mensaje de error si el valor es negativo
-            }
-        } else if (is_float(line)) { // Verificar si la línea es un flotante
-            float value = std::stof(line); // Convertir la línea a flotante
-            if (value >= 0.0f) { // Verificar si el valor es positivo
-                bufferPh->add(line); // Agregar el valor al buffer de pH
-            } else {
-                std::cerr << "Error: valor negativo recibido del sensor" << std::endl; // Mensaje de error si el valor es negativo
+        // Esperar datos; si hay un lote pendiente, solo comprobar si llegó algo más
+        const char* datos;
+        ssize_t bytesRead = lector.leer(datos, lote.empty() ? INTERVALO_VIGILANCIA_MS : 0); // Leer datos del pipe
+        if (bytesRead > 0) {
+            esperaPipe.registrarLlegada();
+            // Separar las mediciones y agregarlas al lote
+            size_t fines = buscarDelimitadores(datos, bytesRead, delimitadores.data());
+            size_t inicio = 0;
+            for (size_t k = 0; k < fines; ++k) {
+                size_t fin = delimitadores[k];
+                if (!line.empty()) { // Completar la medición que quedó de la lectura anterior
+                    line.append(datos + inicio, fin - inicio);
+                    clasificarMedicion(line.data(), line.size(), lote, recolector);
+                    line.clear();
+                } else if (fin > inicio) {
+                    clasificarMedicion(datos + inicio, fin - inicio, lote, recolector);
+                }
+                inicio = fin + 1;
             }
-        } else {
-            std::cerr << "Error: valor no válido recibido del sensor" << std::endl; // Mensaje de error si la línea no es válida
+            line.append(datos + inicio, bytesRead - inicio); // Medición incompleta al final del bloque
+        }
+        if (bytesRead > 0 && lote.size() < MAX_LOTE_WAL) {
+            continue; // Seguir acumulando mientras haya datos en el pipe
+        }
+
+        // Confirmar el lote cuando no quedan datos en el pipe o alcanzó su tamaño máximo
+        if (!entregarLote(lote, recolector, sensores)) {
+            break; // El WAL no acepta más registros: ya se pidió detener a los demás recolectores
+        }
+
+        if (args->detener || revisarSensores(sensores, recolector)) {
+            args->detener = true; // Sin sensores activos en ningún pipe: detener también a los demás recolectores
+            break; // Salir del bucle
         }
     }
 
     // Cerrar el pipe
+    lector.cerrar(); // Cancelar la lectura en vuelo antes de cerrar el pipe
+    close(pipeEscritor); // Cerrar el extremo de escritura propio
     close(pipeFd); // Cerrar el descriptor de archivo del pipe
+    terminarRecolector(recolector);
 
     return nullptr; // Devolver nullptr al finalizar la función
 }
 
 
 
+/**
+ * Escribe de una vez las líneas de un lote en el archivo de salida, midiendo los bytes y la latencia.
+ * Si la escritura falla, las líneas siguen pendientes en el archivo y no se cuentan como escritas.
+ * 
+ * @param file Archivo de salida con las líneas del lote pendientes (o ya presentadas en el anillo).
+ * @param lineas Cantidad de líneas pendientes.
+ * @param metricas Métricas del canal del archivo.
+ * @param inicio Hora en que empezó la escritura del lote, que comparten todos sus archivos.
+ * @return false si el archivo no se pudo escribir.
+ */
+bool escribirLote(Sumidero& file, uint64_t lineas, MetricasCanal& metricas, uint64_t inicio) {
+    size_t bytes = file.pendiente();
+    if (bytes == 0) {
+        return true;
+    }
+    bool correcto = file.vaciar();
+    metricas.bytesEscritos->sumar(bytes - file.pendiente()); // Solo lo que llegó al archivo
+    if (!correcto) {
+        std::cerr << "Error: No se pudo escribir el archivo de salida: " << strerror(errno) << std::endl;
+        return false;
+    }
+    metricas.vaciado->observar(relojNs() - inicio);
+    metricas.escritas->sumar(lineas);
+    return true;
+}
+
+/**
+ * Marca el fin de un hilo de evaluación. El último en terminar cierra la cola de persistencia: el hilo
+ * de persistencia escribe lo que quede y termina.
+ * 
+ * @param args Argumentos compartidos por los hilos.
+ */
+void terminarEvaluador(ThreadArgs* args) {
+    if (args->evaluadoresVivos.fetch_sub(1) == 1) {
+        args->salida->close();
+    }
+}
+
+/**
+ * Pasa las mediciones válidas de un lote por los detectores de anomalías del canal y avisa en la consola
+ * de cada anomalía nueva. Publica el estado de los detectores cuando corresponde, para que lo guarde el hilo
+ * de persistencia.
+ *
+ * @param args Argumentos de los hilos.
+ * @param canal Canal del lote.
+ * @param lote Mediciones del lote.
+ * @param invalidas Máscara de las mediciones fuera del rango válido, que no se evalúan.
+ */
+void detectarAnomalias(ThreadArgs* args, Canal canal, const std::vector<Lectura>& lote, uint64_t invalidas) {
+    DetectorAnomalias* detector = args->detectores[canal];
+    for (size_t i = 0; i < lote.size(); ++i) {
+        if ((invalidas >> i) & 1) {
+            continue;
+        }
+        double puntaje;
+        TipoAnomalia tipo = detector->evaluar(lote[i], puntaje);
+        if (tipo == ANOMALIA_NINGUNA) {
+            continue;
+        }
+        args->metricas[canal].anomalias->sumar();
+        std::cout << "¡Anomalía! Sensor " << lote[i].sensor << " de " << NOMBRE_CANAL[canal] << ": valor ";
+        if (canal == CANAL_PH) {
+            std::cout << static_cast<float>(lote[i].numero);
+        } else {
+            std::cout << static_cast<int>(lote[i].numero);
+        }
+        std::cout << " (detector " << nombreAnomalia(tipo) << ", z = " << puntaje << ")" << std::endl;
+    }
+    detector->publicarSiToca(time(nullptr));
+}
+
+/**
+ * Indica si la evaluación de un canal está pausada desde el socket de control. Un canal pausado no genera
+ * alertas, no pasa por los detectores de anomalías, no difunde ni actualiza los últimos valores, pero sus
+ * mediciones siguen hacia la persistencia (las fuera de rango se siguen descartando): la pausa nunca
+ * frena el ingreso ni al otro canal.
+ *
+ * @param args Argumentos de los hilos.
+ * @param canal Canal del hilo de evaluación.
+ * @return true si el lote debe pasar sin evaluarse.
+ */
+bool evaluacionPausada(ThreadArgs* args, Canal canal) {
+    return args->pausado[canal].load(std::memory_order_relaxed);
+}
+
 /**
  * Función que maneja el procesamiento de datos de pH en un hilo separado.
  * 
- * Esta función se ejecuta en un hilo dedicado a manejar los datos de pH recolectados
- * por otro hilo y almacenados en un buffer. Abre un archivo para escribir los datos,
- * lee del buffer y escribe los valores de pH junto con la hora actual en el archivo.
- * Si se detectan valores fuera del rango normal, emite una alerta en la consola.
+ * Esta función se ejecuta en un hilo dedicado a evaluar los datos de pH recolectados
+ * por otro hilo y almacenados en un buffer. Toma las mediciones del buffer por lotes y las clasifica
+ * de una vez contra los límites del canal (núcleo vectorial); solo las marcadas generan una alerta en
+ * la consola. Las válidas pasan además por los detectores de anomalías de su sensor. Después pasa el
+ * lote a la cola de persistencia, marcando las que están fuera de rango, sin esperar al disco: las
+ * alertas no se demoran por lo que tarde la escritura.
  * 
  * @param arg Puntero a una estructura `ThreadArgs` que contiene los argumentos necesarios 
- *            para la función, incluyendo el buffer para pH, el nombre del pipe y un semáforo.
+ *            para la función, incluyendo el buffer para pH y la cola de persistencia.
  * @return void* Siempre devuelve nullptr.
  */
 void* pH_hilo(void* arg) {
     // Convertir el argumento a un puntero ThreadArgs
     ThreadArgs* thread_args = reinterpret_cast<ThreadArgs*>(arg);
 
-    // Obtener el buffer de pH y el valor del semáforo
+    // Obtener el buffer de pH
     Buffer* pH_buffer = thread_args->pH_buffer;
-    int semaphore_value;
-    sem_getvalue(&thread_args->semaphore, &semaphore_value); // Obtener el valor del semáforo
-
-    // Abrir el archivo para escribir los datos de pH
-    std::ofstream pH_file("pH-data.txt"); // Abrir el archivo de datos de pH
-    if (!pH_file.is_open()) { // Verificar si el archivo se abrió correctamente
-        std::cerr << "Error: No se pudo abrir el archivo: pH-data.txt" << std::endl;
-        return nullptr;
-    }
-
-    // Verificar el valor del semáforo antes de procesar los datos
-    if (semaphore_value > 0) { // Si el semáforo es mayor que cero, se detiene el proceso
-        pH_file.close(); // Cerrar el archivo
-        pH_buffer->~Buffer(); // Destruir el buffer
-        return nullptr;
-    }
 
-    // Leer datos del buffer y escribir en el archivo
-    std::string data; // Variable para almacenar los datos leídos del buffer
-    while ((data = pH_buffer->remove()) != "-1") { // Bucle para leer los datos del buffer
-        float value = std::stof(data); // Convertir el dato a flotante
-        if (value >= 8.0 || value <= 6.0) { // Verificar si el valor está fuera del rango normal
-            std::cout << "¡Alerta! Valor de pH fuera del rango normal: " << value << std::endl;
+    // Leer datos del buffer, evaluarlos y pasarlos a la persistencia
+    MetricasCanal& metricas = thread_args->metricas[CANAL_PH];
+    std::vector<Lectura> lote; // Lote de mediciones leídas del buffer
+    lote.reserve(MAX_LOTE_CONSUMIDOR); // Se reutiliza en cada lote
+    float valores[MAX_LOTE_CONSUMIDOR]; // Valores del lote
+    uint64_t invalidas, alertas; // Máscaras de la clasificación del lote
+    while (pH_buffer->removeBatch(lote, MAX_LOTE_CONSUMIDOR)) { // Hasta que el buffer se cierre y quede vacío
+        bool pausado = evaluacionPausada(thread_args, CANAL_PH); // Pausado: el lote solo pasa a la persistencia
+        for (size_t i = 0; i < lote.size(); ++i) {
+            valores[i] = static_cast<float>(lote[i].numero); // Valor ya convertido por el recolector
+        }
+        const LimitesCanal& limites = thread_args->configuracion->actual()->limites[CANAL_PH]; // Los vigentes en este lote
+        clasificarLote(valores, lote.size(), limites, &invalidas, &alertas); // Verificar el lote contra los límites
+        for (uint64_t marcas = pausado ? 0 : alertas; marcas != 0; marcas &= marcas - 1) { // Solo las mediciones marcadas
+            std::cout << "¡Alerta! Valor de pH fuera del rango normal: " << valores[__builtin_ctzll(marcas)] << std::endl;
+        }
+        if (!pausado) {
+            detectarAnomalias(thread_args, CANAL_PH, lote, invalidas);
+            thread_args->difusion->publicar(CANAL_PH, lote, invalidas); // Sin esperar a los suscriptores
+        }
+        for (size_t i = 0; i < lote.size(); ++i) {
+            lote[i].persistir = !((invalidas >> i) & 1); // Las fuera de rango solo avanzan el punto de control
+            if (!lote[i].persistir) {
+                metricas.fueraDeRango->sumar();
+            } else if (!pausado) {
+                thread_args->ultimos.registrar(lote[i]); // Último valor del sensor, para el socket de control
+            }
+            thread_args->salida->add(lote[i], CANAL_PH); // Pasar la medición a la persistencia por el carril del canal
         }
-        pH_file << value << " " << getCurrentTime() << std::endl; // Escribir el valor de pH en el archivo
     }
-
-    // Cerrar el archivo y destruir el buffer
-    pH_file.close(); // Cerrar el archivo
-    pH_buffer->~Buffer(); // Destruir el buffer
+    thread_args->detectores[CANAL_PH]->publicar(); // El estado aprendido queda para el próximo inicio
+    terminarEvaluador(thread_args);
 
     return nullptr;
 }
@@ -222,56 +697,551 @@ void* pH_hilo(void* arg) {
 /**
  * Función que maneja el procesamiento de datos de temperatura en un hilo separado.
  * 
- * Esta función se ejecuta en un hilo dedicado a manejar los datos de temperatura recolectados
- * por otro hilo y almacenados en un buffer. Abre un archivo para escribir los datos, lee del buffer
- * y escribe los valores de temperatura junto con la hora actual en el archivo. Si se detectan valores
- * fuera del rango normal, emite una alerta en la consola.
+ * Esta función se ejecuta en un hilo dedicado a evaluar los datos de temperatura recolectados
+ * por otro hilo y almacenados en un buffer. Toma las mediciones por lotes, las clasifica de una vez
+ * contra los límites del canal (solo las marcadas generan una alerta), pasa las válidas por los
+ * detectores de anomalías y pasa el lote a la cola de persistencia, sin esperar al disco.
  * 
  * @param arg Puntero a una estructura `ThreadArgs` que contiene los argumentos necesarios 
- *            para la función, incluyendo el buffer para temperatura, el nombre del pipe y un semáforo.
+ *            para la función, incluyendo el buffer para temperatura y la cola de persistencia.
  * @return void* Siempre devuelve nullptr.
  */
 void* temperatura_hilo(void* arg) {
     // Convertir el argumento a un puntero ThreadArgs
     ThreadArgs* thread_args = reinterpret_cast<ThreadArgs*>(arg);
 
-    // Obtener el buffer de temperatura y el valor del semáforo
+    // Obtener el buffer de temperatura
     Buffer* temperature_buffer = thread_args->temp_buffer;
-    int semaphore_value;
-    sem_getvalue(&thread_args->semaphore, &semaphore_value); // Obtener el valor del semáforo
 
-    // Abrir el archivo para escribir los datos de temperatura
-    std::ofstream temperature_file("temperature-data.txt"); // Abrir el archivo de datos de temperatura
-    if (!temperature_file.is_open()) { // Verificar si el archivo se abrió correctamente
-        std::cerr << "Error: No se pudo abrir el archivo: temperature-data.txt" << std::endl;
-        return nullptr;
+    // Leer datos del buffer, evaluarlos y pasarlos a la persistencia
+    MetricasCanal& metricas = thread_args->metricas[CANAL_TEMPERATURA];
+    std::vector<Lectura> lote; // Lote de mediciones leídas del buffer
+    lote.reserve(MAX_LOTE_CONSUMIDOR); // Se reutiliza en cada lote
+    int enteros[MAX_LOTE_CONSUMIDOR]; // Valores del lote
+    float valores[MAX_LOTE_CONSUMIDOR]; // Valores del lote para la clasificación
+    uint64_t invalidas, alertas; // Máscaras de la clasificación del lote
+    while (temperature_buffer->removeBatch(lote, MAX_LOTE_CONSUMIDOR)) { // Hasta que el buffer se cierre y quede vacío
+        bool pausado = evaluacionPausada(thread_args, CANAL_TEMPERATURA); // Pausado: el lote solo pasa a la persistencia
+        for (size_t i = 0; i < lote.size(); ++i) {
+            enteros[i] = static_cast<int>(lote[i].numero); // Valor ya convertido por el recolector
+            valores[i] = static_cast<float>(enteros[i]);
+        }
+        const LimitesCanal& limites = thread_args->configuracion->actual()->limites[CANAL_TEMPERATURA]; // Los vigentes en este lote
+        clasificarLote(valores, lote.size(), limites, &invalidas, &alertas); // Verificar el lote contra los límites
+        for (uint64_t marcas = pausado ? 0 : alertas; marcas != 0; marcas &= marcas - 1) { // Solo las mediciones marcadas
+            std::cout << "¡Alerta! Valor de temperatura fuera del rango normal: " << enteros[__builtin_ctzll(marcas)] << std::endl;
+        }
+        if (!pausado) {
+            detectarAnomalias(thread_args, CANAL_TEMPERATURA, lote, invalidas);
+            thread_args->difusion->publicar(CANAL_TEMPERATURA, lote, invalidas); // Sin esperar a los suscriptores
+        }
+        for (size_t i = 0; i < lote.size(); ++i) {
+            lote[i].persistir = !((invalidas >> i) & 1); // Las fuera de rango solo avanzan el punto de control
+            if (!lote[i].persistir) {
+                metricas.fueraDeRango->sumar();
+            } else if (!pausado) {
+                thread_args->ultimos.registrar(lote[i]); // Último valor del sensor, para el socket de control
+            }
+            thread_args->salida->add(lote[i], CANAL_TEMPERATURA); // Pasar la medición a la persistencia
+        }
     }
+    thread_args->detectores[CANAL_TEMPERATURA]->publicar(); // El estado aprendido queda para el próximo inicio
+    terminarEvaluador(thread_args);
 
-    // Verificar el valor del semáforo antes de procesar los datos
-    if (semaphore_value > 0) { // Si el semáforo es mayor que cero, se detiene el proceso
-        temperature_file.close(); // Cerrar el archivo
-        temperature_buffer->~Buffer(); // Destruir el buffer
-        return nullptr;
+    return nullptr; // Devolver nullptr
+}
+
+/**
+ * Agrega una medición al bloque de su archivo de salida, fechada con la hora de su evento, y la acumula
+ * en los agregados del canal. Las descartadas por la evaluación solo avanzan el punto de control.
+ *
+ * @param args Argumentos de los hilos, con los archivos y los agregados de cada canal.
+ * @param lectura Medición liberada, en orden de LSN o, con reordenamiento, de hora del evento.
+ */
+void persistirMedicion(ThreadArgs* args, const Lectura& lectura) {
+    Segmento* destino = args->archivos[lectura.canal]->destino(lectura); // Archivo de la medición
+    if (destino == nullptr || !lectura.persistir) {
+        return;
+    }
+    const char* hora = horaDe(lectura.evento());
+    char linea[64];
+    int largo = lectura.canal == CANAL_PH
+                    ? snprintf(linea, sizeof(linea), "%g %s\n", static_cast<float>(lectura.numero), hora)
+                    : snprintf(linea, sizeof(linea), "%d %s\n", static_cast<int>(lectura.numero), hora);
+    args->archivos[lectura.canal]->agregar(destino, linea, largo); // Agregar la línea al bloque de su archivo
+    args->agregados[lectura.canal]->agregar(lectura);
+}
+
+/**
+ * Escribe una medición que llegó después de la marca de agua en la salida de tardías de su canal, con
+ * el valor, la hora del evento, el sensor y los milisegundos que la separan de la marca.
+ *
+ * @param args Argumentos de los hilos, con la salida de tardías y las métricas de cada canal.
+ * @param lectura Medición tardía.
+ * @param marca Marca de agua del canal (ms).
+ */
+void desviarTardia(ThreadArgs* args, const Lectura& lectura, int64_t marca) {
+    args->metricas[lectura.canal].tardias->sumar();
+    if (!lectura.persistir) {
+        args->archivos[lectura.canal]->desviar(lectura, nullptr, 0); // Solo avanza el punto de control
+        return;
+    }
+    const char* hora = horaDe(lectura.evento());
+    long long retraso = static_cast<long long>(marca - lectura.eventoMs());
+    char linea[96];
+    int largo = lectura.canal == CANAL_PH
+                    ? snprintf(linea, sizeof(linea), "%g %s %u %lld\n", static_cast<float>(lectura.numero), hora,
+                               lectura.sensor, retraso)
+                    : snprintf(linea, sizeof(linea), "%d %s %u %lld\n", static_cast<int>(lectura.numero), hora,
+                               lectura.sensor, retraso);
+    args->archivos[lectura.canal]->desviar(lectura, linea, largo);
+}
+
+/**
+ * Función del hilo de persistencia: escribe en los archivos de salida las mediciones evaluadas.
+ * 
+ * Toma de la cola de persistencia lotes que mezclan ambos canales (con el WAL, en orden de LSN),
+ * formatea cada medición con la hora de su evento y, por cada lote, escribe de una vez las líneas de cada
+ * archivo (el del canal, o el segmento de cada sensor y día), seguidas de fdatasync() si se pidió; con
+ * io_uring, las de todos los archivos del lote se envían juntas con una sola llamada al sistema. Cada
+ * vez que la cola queda vacía registra el avance de cada archivo en el punto de control del WAL y
+ * cierra los segmentos de días anteriores. Después de cada lote sella los archivos que alcanzaron el
+ * límite de rotación. Cada medición escrita se acumula además en los agregados de su canal, que se
+ * escriben al cerrarse cada minuto y cada hora. Si se recarga la configuración, la rotación nueva se
+ * aplica desde el lote siguiente. También guarda las instantáneas del estado de los detectores de anomalías
+ * que publican los hilos de evaluación, para que el disco no demore las alertas.
+ *
+ * Con un retraso tolerado, las mediciones de cada canal pasan antes por el reordenamiento: se escriben
+ * en orden de hora del evento a medida que la marca de agua las libera, y las que llegan después de la
+ * marca van a la salida de tardías. Los agregados se cierran según la marca y no según el reloj, y
+ * mientras haya mediciones retenidas la espera de la cola tiene plazo para liberarlas aunque no llegue
+ * nada más.
+ *
+ * La espera de la cola tiene siempre un plazo, para atender también los pedidos de vaciado del socket de
+ * control: tras el lote en curso, registra el avance y escribe y sincroniza todos los archivos abiertos.
+ *
+ * Si un archivo no se puede escribir, sus líneas siguen pendientes y su punto de control no avanza: el
+ * hilo detiene el ingreso y el monitor termina con código 1, y con el WAL lo que falte se recupera al
+ * siguiente inicio.
+ * 
+ * @param arg Puntero a una estructura `ThreadArgs` con la cola de persistencia y los archivos de salida.
+ * @return void* Siempre devuelve nullptr.
+ */
+void* persistencia_hilo(void* arg) {
+    ThreadArgs* thread_args = reinterpret_cast<ThreadArgs*>(arg);
+    Buffer* salida = thread_args->salida;
+
+    // Abrir los archivos de salida
+    ArchivosSalida** archivos = thread_args->archivos;
+    Agregados** agregados = thread_args->agregados;
+    for (int c = 0; c < NUM_CANALES; ++c) {
+        if (!archivos[c]->abrir() || !agregados[c]->abrir()) {
+            // Sin archivos no hay dónde escribir: detener el ingreso y cerrar la cola para que los evaluadores no
+            // se bloqueen en ella; lo ya confirmado en el WAL se recupera en el siguiente inicio
+            thread_args->fallo = true;
+            thread_args->detener = true;
+            salida->close();
+            return nullptr;
+        }
+    }
+    bool reordenar = thread_args->retrasoEventos > 0;
+    std::unique_ptr<Reordenamiento> reorden[NUM_CANALES];
+    if (reordenar) {
+        for (int c = 0; c < NUM_CANALES; ++c) {
+            reorden[c].reset(new Reordenamiento(thread_args->retrasoEventos));
+        }
+    }
+    auto fallar = [thread_args]() { // Un archivo no se pudo escribir: detener el ingreso y terminar con error
+        thread_args->fallo = true;
+        thread_args->detener = true;
+    };
+    auto horaCierre = [&](int c) -> std::time_t { // Hasta dónde pueden cerrarse las cubetas del canal
+        return reordenar ? std::max<int64_t>(reorden[c]->marcaAgua() / 1000, 0) : time(nullptr);
+    };
+    auto escribirLotes = [&]() { // Liberar lo que permite la marca y escribir los archivos de ambos canales
+        Lectura liberada;
+        for (int c = 0; c < NUM_CANALES; ++c) {
+            if (reordenar) {
+                while (reorden[c]->extraer(liberada)) {
+                    persistirMedicion(thread_args, liberada);
+                }
+                archivos[c]->retener(reorden[c]->lsnRetenido(), reorden[c]->marcaAgua()); // Para el corte del canal
+                thread_args->tardias[c]->presentar();
+            }
+            for (Segmento* segmento : archivos[c]->conLineas()) { // Una escritura por archivo y lote
+                segmento->archivo.presentar(); // Con io_uring, todas van juntas en el primer vaciado
+            }
+        }
+        uint64_t inicio = relojNs();
+        for (int c = 0; c < NUM_CANALES; ++c) {
+            if (reordenar && !thread_args->tardias[c]->vaciar()) {
+                std::cerr << "Error: No se pudo escribir la salida de tardías: " << strerror(errno) << std::endl;
+                fallar();
+            }
+            for (Segmento* segmento : archivos[c]->conLineas()) {
+                if (!escribirLote(segmento->archivo, segmento->lineas, thread_args->metricas[c], inicio)) {
+                    fallar();
+                }
+            }
+            archivos[c]->terminarLote(); // Sellar los archivos que alcanzaron el límite de rotación
+            agregados[c]->cerrarVencidas(horaCierre(c)); // Escribir las cubetas que ya terminaron
+            thread_args->detectores[c]->guardarPublicado(); // Estado de los detectores, si hay uno nuevo
+        }
+    };
+
+    // Leer mediciones de la cola y escribirlas en su archivo
+    std::vector<Lectura> lote; // Lote de mediciones de ambos canales
+    lote.reserve(MAX_LOTE_PERSISTENCIA); // Se reutiliza en cada lote
+    uint64_t version = thread_args->configuracion->actual()->version; // Configuración aplicada a los archivos
+    while (true) {
+        if (!salida->tryRemoveBatch(lote, MAX_LOTE_PERSISTENCIA)) { // Antes de esperar, registrar el avance en el WAL
+            for (int c = 0; c < NUM_CANALES; ++c) {
+                if (!archivos[c]->registrarAvance()) {
+                    fallar();
+                }
+                agregados[c]->cerrarVencidas(horaCierre(c));
+            }
+            bool pedido = thread_args->vaciadosPedidos.load() != thread_args->vaciadosHechos.load();
+            bool abierta = pedido || salida->removeBatchFor(lote, MAX_LOTE_PERSISTENCIA, ESPERA_PERSISTENCIA_MS);
+            if (!abierta) { // Cola cerrada y sin datos pendientes
+                break;
+            }
+        }
+        const Configuracion* config = thread_args->configuracion->actual();
+        if (config->version != version) { // Se recargó la configuración: la rotación nueva rige desde este lote
+            version = config->version;
+            for (int c = 0; c < NUM_CANALES; ++c) {
+                archivos[c]->cambiarRotacion(config->rotacion);
+            }
+        }
+        if (!reordenar) {
+            for (const Lectura& lectura : lote) {
+                persistirMedicion(thread_args, lectura);
+            }
+        } else {
+            int64_t ahora = static_cast<int64_t>(relojNs() / 1000000);
+            for (const Lectura& lectura : lote) {
+                Reordenamiento& canal = *reorden[lectura.canal];
+                if (!canal.agregar(lectura, ahora)) { // Llegó después de la marca de agua
+                    desviarTardia(thread_args, lectura, canal.marcaAgua());
+                }
+            }
+            for (int c = 0; c < NUM_CANALES; ++c) {
+                reorden[c]->revisarInactividad(ahora); // Un canal sin mediciones libera lo retenido
+            }
+        }
+        escribirLotes();
+        uint64_t pedido = thread_args->vaciadosPedidos.load();
+        if (pedido != thread_args->vaciadosHechos.load()) { // Vaciado pedido por el socket de control
+            for (int c = 0; c < NUM_CANALES; ++c) {
+                bool correcto = archivos[c]->registrarAvance();
+                correcto = archivos[c]->sincronizarTodo() && correcto;
+                if (reordenar) {
+                    thread_args->tardias[c]->presentar(true);
+                    correcto = thread_args->tardias[c]->vaciar() && thread_args->tardias[c]->sincronizarDatos() && correcto;
+                }
+                if (!correcto) {
+                    std::cerr << "Error: No se pudieron sincronizar los archivos de salida: " << strerror(errno) << std::endl;
+                    fallar();
+                }
+            }
+            thread_args->vaciadosHechos.store(pedido);
+        }
+    }
+    if (reordenar) { // Al cerrar ya no llegará nada más: liberar todo lo retenido
+        for (int c = 0; c < NUM_CANALES; ++c) {
+            reorden[c]->liberarTodo();
+        }
+        escribirLotes();
+    }
+    for (int c = 0; c < NUM_CANALES; ++c) {
+        if (!archivos[c]->cerrar()) { // Registrar lo que falte y cerrar los archivos
+            fallar();
+        }
+        agregados[c]->cerrar(); // Escribir las cubetas abiertas
+        thread_args->detectores[c]->guardarPublicado(); // El último estado de los detectores
+        if (reordenar) {
+            thread_args->tardias[c]->cerrar();
+        }
     }
 
-    // Leer datos del buffer y escribir en el archivo
-    std::string data; // Variable para almacenar los datos leídos del buffer
-    while ((data = temperature_buffer->remove()) != "-1") { // Bucle para leer los datos del buffer
-        int value = std::stoi(data); // Convertir el dato a entero
-        if (value >= 31.6 || value <= 20) { // Verificar si el valor está fuera del rango normal
-            std::cout << "¡Alerta! Valor de temperatura fuera del rango normal: " << value << std::endl;
+    return nullptr;
+}
+
+/**
+ * Registra las métricas de cada canal y del WAL, y conecta las de los buffers.
+ * 
+ * @param registro Registro donde se crean las métricas.
+ * @param args Argumentos de los hilos; recibe los punteros a las métricas.
+ */
+void registrarMetricas(RegistroMetricas& registro, ThreadArgs& args) {
+    Buffer* buffers[NUM_CANALES] = {args.pH_buffer, args.temp_buffer};
+    for (int c = 0; c < NUM_CANALES; ++c) {
+        std::string canal = std::string("canal=\"") + NOMBRE_CANAL[c] + "\"";
+        MetricasCanal& metricas = args.metricas[c];
+        metricas.recibidas = registro.contador("monisenso_lecturas_recibidas_total",
+                                               "Mediciones válidas recibidas de los sensores.", canal);
+        metricas.negativas = registro.contador("monisenso_lecturas_rechazadas_total",
+                                               "Mediciones rechazadas, por motivo.", canal + ",motivo=\"negativo\"");
+        metricas.descartadas = registro.contador("monisenso_lecturas_rechazadas_total", "",
+                                                 canal + ",motivo=\"buffer_cerrado\"");
+        metricas.fueraDeRango = registro.contador("monisenso_lecturas_rechazadas_total", "",
+                                                  canal + ",motivo=\"fuera_de_rango\"");
+        metricas.escritas = registro.contador("monisenso_lecturas_escritas_total",
+                                              "Mediciones escritas en los archivos de salida.", canal);
+        metricas.bytesEscritos = registro.contador("monisenso_bytes_escritos_total",
+                                                   "Bytes escritos en los archivos de salida.", canal);
+        metricas.vaciado = registro.histograma("monisenso_vaciado_segundos",
+                                               "Latencia de la escritura de cada lote en los archivos de salida.", canal);
+
+        MetricasBuffer metricasBuffer;
+        metricasBuffer.capacidad = registro.medidor("monisenso_buffer_capacidad", "Capacidad del buffer del canal.", canal);
+        metricasBuffer.ocupacion = registro.medidor("monisenso_buffer_ocupacion",
+                                                    "Mediciones en el buffer del canal.", canal);
+        metricasBuffer.ocupacionMaxima = registro.medidor("monisenso_buffer_ocupacion_maxima",
+                                                          "Máxima ocupación alcanzada por el buffer del canal.", canal);
+        metricasBuffer.esperaAdd = registro.histograma("monisenso_buffer_espera_segundos",
+                                                       "Tiempo bloqueado esperando en el buffer, por operación.",
+                                                       canal + ",operacion=\"add\"");
+        metricasBuffer.esperaRemove = registro.histograma("monisenso_buffer_espera_segundos", "",
+                                                          canal + ",operacion=\"remove\"");
+        metricasBuffer.girosExitosos = registro.contador("monisenso_buffer_giros_total",
+                                                         "Esperas en modo latencia, por resultado del giro.",
+                                                         canal + ",resultado=\"sin_bloqueo\"");
+        metricasBuffer.girosFallidos = registro.contador("monisenso_buffer_giros_total", "",
+                                                         canal + ",resultado=\"bloqueo\"");
+        buffers[c]->setMetrics(metricasBuffer);
+
+        metricas.perdidas = registro.contador("monisenso_secuencias_total",
+                                              "Anomalías en las secuencias de los sensores, por tipo.",
+                                              canal + ",tipo=\"perdida\"");
+        metricas.duplicadas = registro.contador("monisenso_secuencias_total", "", canal + ",tipo=\"duplicada\"");
+        metricas.reordenadas = registro.contador("monisenso_secuencias_total", "", canal + ",tipo=\"reordenada\"");
+        metricas.reinicios = registro.contador("monisenso_secuencias_total", "", canal + ",tipo=\"reinicio\"");
+        metricas.anomalias = registro.contador("monisenso_anomalias_total",
+                                               "Anomalías informadas por los detectores de los sensores.", canal);
+        metricas.tardias = registro.contador("monisenso_lecturas_tardias_total",
+                                             "Mediciones que llegaron después de la marca de agua del canal.", canal);
+    }
+    args.invalidas = registro.contador("monisenso_lecturas_rechazadas_total", "",
+                                       "canal=\"desconocido\",motivo=\"invalido\"");
+
+    MetricasBuffer metricasSalida;
+    metricasSalida.ocupacion = registro.medidor("monisenso_persistencia_ocupacion",
+                                                "Mediciones evaluadas que esperan ser escritas.");
+    metricasSalida.ocupacionMaxima = registro.medidor("monisenso_persistencia_ocupacion_maxima",
+                                                      "Máxima cantidad de mediciones en espera de ser escritas.");
+    metricasSalida.esperaAdd = registro.histograma("monisenso_persistencia_espera_segundos",
+                                                   "Tiempo bloqueado en la cola de persistencia, por operación "
+                                                   "(add: la evaluación esperó al disco).", "operacion=\"add\"");
+    metricasSalida.esperaRemove = registro.histograma("monisenso_persistencia_espera_segundos", "",
+                                                      "operacion=\"remove\"");
+    args.salida->setMetrics(metricasSalida);
+    args.confirmacionWal = registro.histograma("monisenso_wal_confirmacion_segundos",
+                                               "Latencia de la confirmación en grupo del WAL (escritura y fdatasync).");
+}
+
+/**
+ * Interpreta la lista de canales que esperan en modo latencia, por ejemplo `pH,temperatura`.
+ * Los canales que no aparecen quedan en modo eficiencia.
+ * 
+ * @param lista Nombres de canal separados por comas.
+ * @param modos Modo de espera de cada canal.
+ * @return false si algún nombre no corresponde a un canal.
+ */
+bool leerModosEspera(const std::string& lista, ModoEspera* modos) {
+    size_t inicio = 0;
+    while (inicio <= lista.size()) {
+        size_t fin = lista.find(',', inicio);
+        std::string nombre = lista.substr(inicio, fin == std::string::npos ? std::string::npos : fin - inicio);
+        int c = 0;
+        while (c < NUM_CANALES && nombre != NOMBRE_CANAL[c]) {
+            c++;
         }
-        temperature_file << value << " " << getCurrentTime() << std::endl; // Escribir el valor de temperatura en el archivo
+        if (c == NUM_CANALES) {
+            std::cerr << "Error: canal desconocido: " << nombre << std::endl;
+            return false;
+        }
+        modos[c] = ESPERA_LATENCIA;
+        if (fin == std::string::npos) {
+            break;
+        }
+        inicio = fin + 1;
     }
+    return true;
+}
 
-    // Cerrar el archivo y destruir el buffer
-    temperature_file.close(); // Cerrar el archivo
-    temperature_buffer->~Buffer(); // Destruir el buffer
+/**
+ * Abre la salida de mediciones tardías de un canal (`ruta.tardias`, junto al archivo o directorio del canal).
+ *
+ * @param tardias Sumidero de la salida.
+ * @param ruta Archivo o directorio del canal.
+ * @return false si no se pudo abrir.
+ */
+bool abrirTardias(Sumidero& tardias, const std::string& ruta) {
+    std::string destino = rutaJunto(ruta, "tardias");
+    if (!tardias.abrir(destino.c_str(), true)) {
+        std::cerr << "Error: No se pudo abrir el archivo: " << destino << std::endl;
+        return false;
+    }
+    return true;
+}
 
-    return nullptr; // Devolver nullptr
+/**
+ * Vuelve a leer el archivo de configuración y publica la versión nueva. Los buffers cambian de capacidad
+ * en el acto, sin perder mediciones; los límites de los canales y la rotación rigen desde el lote
+ * siguiente de cada hilo. Si el archivo no es válido se conserva la configuración vigente completa.
+ *
+ * @param args Argumentos de los hilos, con los buffers y la configuración publicada.
+ * @param ruta Archivo de configuración (nullptr si el monitor se inició sin -g).
+ * @return Configuración publicada, o nullptr si no se recargó.
+ */
+const Configuracion* recargarConfiguracion(ThreadArgs& args, const char* ruta) {
+    if (ruta == nullptr) {
+        std::cerr << "Aviso: no hay archivo de configuración que recargar (-g)" << std::endl;
+        return nullptr;
+    }
+    const Configuracion* anterior = args.configuracion->actual();
+    Configuracion nueva = *anterior;
+    if (!leerConfiguracion(ruta, nueva)) {
+        std::cerr << "Aviso: se conserva la configuración vigente" << std::endl;
+        return nullptr;
+    }
+    if (nueva.tamBuffer != anterior->tamBuffer) {
+        args.pH_buffer->resize(nueva.tamBuffer);
+        args.temp_buffer->resize(nueva.tamBuffer);
+        args.salida->resize(std::max(nueva.tamBuffer, TAM_COLA_PERSISTENCIA));
+    }
+    const Configuracion* publicada = args.configuracion->publicar(nueva);
+    std::cout << "Configuración recargada (versión " << publicada->version << ")" << std::endl;
+    return publicada;
+}
+
+/**
+ * Atiende una petición del socket de control. Se ejecuta en el hilo del socket y solo lee contadores,
+ * ocupaciones y la tabla de últimos valores, sin tomar los mutex del ingreso; las órdenes que cambian algo
+ * lo piden a los hilos con una marca atómica (pausa, vaciado) o con SIGHUP (recarga). Ninguna espera a
+ * otro hilo: `vaciar` responde con el número del vaciado pedido, y `estado` informa el último completado.
+ *
+ * Órdenes: `estado`, `ocupacion`, `ultimos [sensor]`, `latencias`, `vaciar`, `pausar canal`,
+ * `reanudar canal`, `recargar` y `ayuda`.
+ *
+ * @param args Argumentos de los hilos.
+ * @param registro Métricas del monitor (para los histogramas de latencia).
+ * @param inicio Hora de inicio del monitor.
+ * @param peticion Línea recibida.
+ * @return Respuesta: `ok` o `error: motivo` y las líneas de datos.
+ */
+std::string responderControl(ThreadArgs& args, const RegistroMetricas& registro, std::time_t inicio,
+                             const std::string& peticion) {
+    std::istringstream palabras(peticion);
+    std::string orden, argumento;
+    palabras >> orden >> argumento;
+    std::ostringstream respuesta;
+    if (orden == "estado") {
+        respuesta << "ok\n"
+                  << "activo_segundos " << std::time(nullptr) - inicio << "\n"
+                  << "version_configuracion " << args.configuracion->actual()->version << "\n"
+                  << "recolectores " << args.recolectoresVivos.load() << "\n"
+                  << "vaciado_completado " << args.vaciadosHechos.load() << "\n";
+        for (int c = 0; c < NUM_CANALES; ++c) {
+            const MetricasCanal& metricas = args.metricas[c];
+            respuesta << NOMBRE_CANAL[c] << " recibidas=" << metricas.recibidas->valor()
+                      << " escritas=" << metricas.escritas->valor()
+                      << " rechazadas=" << metricas.negativas->valor() + metricas.fueraDeRango->valor()
+                      << " descartadas=" << metricas.descartadas->valor()
+                      << " tardias=" << metricas.tardias->valor() << " anomalias=" << metricas.anomalias->valor()
+                      << " perdidas=" << metricas.perdidas->valor()
+                      << " pausado=" << (args.pausado[c].load() ? "si" : "no") << "\n";
+        }
+    } else if (orden == "ocupacion") {
+        Buffer* buffers[NUM_CANALES] = {args.pH_buffer, args.temp_buffer};
+        respuesta << "ok\n";
+        for (int c = 0; c < NUM_CANALES; ++c) {
+            respuesta << NOMBRE_CANAL[c] << " " << buffers[c]->occupancy() << " " << buffers[c]->capacity() << "\n";
+        }
+        respuesta << "persistencia " << args.salida->occupancy() << " " << args.salida->capacity() << "\n";
+    } else if (orden == "ultimos") {
+        char* fin = nullptr;
+        unsigned long sensor = strtoul(argumento.c_str(), &fin, 10);
+        if (!argumento.empty() && *fin != '\0') {
+            return "error: sensor no válido: " + argumento + "\n";
+        }
+        respuesta << "ok\n";
+        args.ultimos.visitar([&](const UltimosValores::Valor& valor) {
+            if (!argumento.empty() && valor.sensor != sensor) {
+                return;
+            }
+            respuesta << NOMBRE_CANAL[valor.canal] << " " << valor.sensor << " ";
+            if (valor.canal == CANAL_PH) {
+                respuesta << static_cast<float>(valor.numero);
+            } else {
+                respuesta << static_cast<int>(valor.numero);
+            }
+            respuesta << " " << horaDe(valor.eventoMs / 1000) << "\n";
+        });
+    } else if (orden == "latencias") {
+        respuesta << "ok\n" << registro.resumirHistogramas();
+    } else if (orden == "vaciar") {
+        uint64_t pedido = args.vaciadosPedidos.fetch_add(1) + 1; // Sin esperarlo: el hilo del socket atiende a todos
+        respuesta << "ok\n"
+                  << "vaciado " << pedido << "\n";
+    } else if (orden == "pausar" || orden == "reanudar") {
+        int c = 0;
+        while (c < NUM_CANALES && argumento != NOMBRE_CANAL[c]) {
+            c++;
+        }
+        if (c == NUM_CANALES) {
+            return "error: canal desconocido: " + argumento + "\n";
+        }
+        args.pausado[c] = orden == "pausar";
+        respuesta << "ok\n";
+    } else if (orden == "recargar") {
+        kill(getpid(), SIGHUP); // La atiende el hilo principal, como una recarga desde fuera
+        respuesta << "ok\n";
+    } else if (orden == "ayuda") {
+        respuesta << "ok\n"
+                  << "estado: mediciones de cada canal, versión de la configuración y tiempo activo\n"
+                  << "ocupacion: mediciones en cada buffer y su capacidad\n"
+                  << "ultimos [sensor]: último valor válido de cada sensor\n"
+                  << "latencias: cantidad y percentiles de cada histograma de latencia (segundos)\n"
+                  << "vaciar: pedir que se escriban y sincronicen los archivos de salida (ver vaciado_completado en estado)\n"
+                  << "pausar canal / reanudar canal: detener o seguir la evaluación de un canal (se sigue guardando)\n"
+                  << "recargar: volver a leer el archivo de configuración\n";
+    } else {
+        return "error: orden desconocida: " + orden + "\n";
+    }
+    return respuesta.str();
 }
 
+/**
+ * Espera a que un hilo termine sin pasar de un plazo.
+ * 
+ * @param hilo Hilo a esperar.
+ * @param limite Hora límite absoluta (CLOCK_REALTIME).
+ * @return true si el hilo terminó dentro del plazo.
+ */
+bool esperarHilo(pthread_t hilo, const struct timespec& limite) {
+    return pthread_timedjoin_np(hilo, NULL, &limite) == 0;
+}
 
+/**
+ * Muestra la topología detectada y dónde corre cada hilo del monitor.
+ * 
+ * @param topologia Topología de la máquina.
+ * @param ubicacion Plan de ubicación de los hilos.
+ */
+void mostrarUbicacion(const Topologia& topologia, const Ubicacion& ubicacion) {
+    std::cout << "Ubicación de los hilos (" << topologia.cpus().size() << " CPUs permitidas, " << topologia.nodos()
+              << " nodos NUMA, " << topologia.dominiosL3() << " dominios L3):" << std::endl;
+    for (size_t i = 0; i < ubicacion.recolectores.size(); ++i) {
+        std::cout << "  recolector " << i << ": " << describirCpus(ubicacion.recolectores[i], topologia) << std::endl;
+    }
+    for (int c = 0; c < NUM_CANALES; ++c) {
+        std::cout << "  " << NOMBRE_CANAL[c] << ": " << describirCpus(ubicacion.consumidores[c], topologia) << std::endl;
+    }
+    std::cout << "  persistencia: " << describirCpus(ubicacion.persistencia, topologia) << std::endl;
+}
 
 int main(int argc, char *argv[]) {
     // Iniciando variables
@@ -280,12 +1250,32 @@ int main(int argc, char *argv[]) {
     char* temperatureFile = nullptr;  // Nombre del archivo para datos de temperatura
     char* pHFile = nullptr;  // Nombre del archivo para datos de pH
     char* pipeName = nullptr;  // Nombre del pipe
+    char* walFile = nullptr;  // Nombre del archivo del WAL (opcional)
+    int idleTimeout = 10;  // Segundos sin datos antes de dar por desconectado un sensor
+    int drainDeadline = 5;  // Segundos para drenar los buffers al recibir una señal de término
+    char* metricsSocket = nullptr;  // Ruta del socket de métricas (opcional)
+    char* controlSocket = nullptr;  // Ruta del socket de control (opcional)
+    char* subscriptionSocket = nullptr;  // Ruta del socket de suscripciones (opcional)
+    bool dedupe = false;  // Descartar mediciones duplicadas
+    int collectors = 1;  // Hilos recolectores, cada uno con su propio pipe
+    char* placement = nullptr;  // Ubicación de los hilos en las CPUs (opcional)
+    MotorEs ioEngine = MOTOR_CLASICO;  // Motor de entrada y salida
+    bool syncOutput = false;  // Sincronizar los archivos de salida tras cada lote
+    bool shardOutput = false;  // Un archivo de salida por sensor y día
+    Rotacion rotation;  // Límites de la rotación de los archivos de salida
+    int64_t retention = 0;  // Segundos que se conservan los archivos sellados (0 = siempre)
+    char* configFile = nullptr;  // Archivo de configuración recargable (opcional)
+    int64_t eventDelay = 0;  // Segundos de retraso tolerados en la hora del evento (0 = sin reordenar)
+    ModoEspera waitModes[NUM_CANALES] = {ESPERA_EFICIENCIA, ESPERA_EFICIENCIA};  // Modo de espera de cada canal
 
     // Revisando argumentos y asignándolos
-    while ((option = getopt(argc, argv, "b:t:h:p:")) != -1) {
+    while ((option = getopt(argc, argv, "b:t:h:p:w:i:d:m:C:S:l:uc:a:e:fsr:k:o:g:")) != -1) {
         switch (option) {
             case 'b':
-                bufferSize = atoi(optarg);  // Asignando el tamaño del buffer
+                if (!leerTamBuffer(optarg, bufferSize)) {  // Asignando el tamaño del buffer
+                    std::cerr << "Error: tamaño de buffer no válido (1 a " << MAX_TAM_BUFFER << "): " << optarg << std::endl;
+                    return 1;
+                }
                 break;
             case 't':
                 temperatureFile = optarg;  // Asignando el nombre del archivo de temperatura
@@ -296,50 +1286,397 @@ int main(int argc, char *argv[]) {
             case 'p':
                 pipeName = optarg;  // Asignando el nombre del pipe
                 break;
+            case 'w':
+                walFile = optarg;  // Asignando el nombre del archivo del WAL
+                break;
+            case 'i':
+                idleTimeout = atoi(optarg);  // Asignando el tiempo de inactividad de los sensores
+                break;
+            case 'd':
+                drainDeadline = atoi(optarg);  // Asignando el plazo de drenado
+                break;
+            case 'm':
+                metricsSocket = optarg;  // Asignando la ruta del socket de métricas
+                break;
+            case 'C':
+                controlSocket = optarg;  // Asignando la ruta del socket de control
+                break;
+            case 'S':
+                subscriptionSocket = optarg;  // Asignando la ruta del socket de suscripciones
+                break;
+            case 'u':
+                dedupe = true;  // Activando el descarte de duplicados
+                break;
+            case 'c':
+                collectors = atoi(optarg);  // Asignando la cantidad de recolectores
+                break;
+            case 'a':
+                placement = optarg;  // Asignando la ubicación de los hilos
+                break;
+            case 'e':
+                if (!leerMotor(optarg, ioEngine)) {  // Asignando el motor de entrada y salida
+                    std::cerr << "Error: motor de entrada y salida desconocido: " << optarg << std::endl;
+                    return 1;
+                }
+                break;
+            case 'f':
+                syncOutput = true;  // Activando la sincronización de los archivos de salida
+                break;
+            case 's':
+                shardOutput = true;  // Activando un archivo de salida por sensor y día
+                break;
+            case 'r':
+                if (!leerRotacion(optarg, rotation)) {  // Asignando los límites de la rotación
+                    return 1;
+                }
+                break;
+            case 'k':
+                if (!leerDuracion(optarg, retention)) {  // Asignando la retención de los archivos sellados
+                    std::cerr << "Error: retención no válida: " << optarg << std::endl;
+                    return 1;
+                }
+                break;
+            case 'o':
+                if (!leerDuracion(optarg, eventDelay)) {  // Asignando el retraso tolerado en la hora del evento
+                    std::cerr << "Error: retraso no válido: " << optarg << std::endl;
+                    return 1;
+                }
+                break;
+            case 'g':
+                configFile = optarg;  // Asignando el archivo de configuración
+                break;
+            case 'l':
+                if (!leerModosEspera(optarg, waitModes)) {  // Asignando los canales en modo latencia
+                    return 1;
+                }
+                break;
             default:
-                std::cerr << "Uso: " << argv[0] << " -b tamañoBuffer -t archivoTemperatura -h archivoPh -p nombrePipe" << std::endl;
+                std::cerr << "Uso: " << argv[0] << " -b tamañoBuffer -t archivoTemperatura -h archivoPh -p nombrePipe [-w archivoWal] [-i segundosInactividad] [-d segundosDrenado] [-m socketMetricas] [-C socketControl] [-S socketSuscripciones] [-l canalesLatencia] [-u] [-c recolectores] [-a ubicacion] [-e clasico|uring] [-f] [-s] [-r rotacion] [-k retencion] [-o retraso] [-g archivoConfig]" << std::endl;
                 return 1;
         }
     }
+    if (collectors < 1) {
+        std::cerr << "Error: se necesita al menos un recolector" << std::endl;
+        return 1;
+    }
+    std::string rutaPh = pHFile != nullptr ? pHFile : (shardOutput ? DIRECTORIO_PH : ARCHIVO_PH);
+    std::string rutaTemperatura = temperatureFile != nullptr ? temperatureFile
+                                                             : (shardOutput ? DIRECTORIO_TEMPERATURA : ARCHIVO_TEMPERATURA);
+    if (rutaPh == rutaTemperatura) {
+        std::cerr << "Error: los archivos de pH y de temperatura deben ser distintos" << std::endl;
+        return 1;
+    }
 
-    // Creando Pipe
-    if (mkfifo(pipeName, 0666) < 0) {  // Crea un pipe con permisos de lectura/escritura
-        std::cerr << "Failed to create pipe: " << pipeName << std::endl;
+    // Armando la configuración inicial: la de la línea de comandos y, encima, la del archivo
+    Configuracion inicial;
+    inicial.tamBuffer = bufferSize;
+    inicial.limites[CANAL_PH] = LIMITES_PH;
+    inicial.limites[CANAL_TEMPERATURA] = LIMITES_TEMPERATURA;
+    inicial.rotacion = rotation;
+    inicial.retencion = retention;
+    if (configFile != nullptr && !leerConfiguracion(configFile, inicial)) {
         return 1;
     }
+    if (inicial.tamBuffer <= 0) {
+        std::cerr << "Error: falta el tamaño del buffer (-b o buffer= en el archivo de configuración)" << std::endl;
+        return 1;
+    }
+    ConfiguracionPublicada configuracion(inicial);
+    const Configuracion* vigente = configuracion.actual();
 
-    // Abriendo pipe
-    int pipeFd = open(pipeName, O_RDONLY);  // Abre el pipe para lectura
-    if (pipeFd < 0) {
-        std::cerr << "Failed to open pipe: " << pipeName << std::endl;
+    // Ubicando los hilos en la topología de la máquina
+    Topologia topologia;
+    Ubicacion ubicacion;
+    ubicacion.recolectores.resize(collectors);  // Sin -a, ningún hilo se fija
+    if (placement != nullptr) {
+        if (!topologia.cargar()) {
+            std::cerr << "Error: No se pudo leer la topología de la máquina" << std::endl;
+            return 1;
+        }
+        if (!planificarUbicacion(placement, topologia, collectors, ubicacion)) {
+            return 1;
+        }
+        mostrarUbicacion(topologia, ubicacion);
+    }
+
+    if (ioEngine == MOTOR_URING && !uringDisponible()) {
+        std::cerr << "Aviso: io_uring no está disponible; se usa el motor clásico" << std::endl;
+        ioEngine = MOTOR_CLASICO;
+    }
+    AnilloEscritura escrituraUring;  // Anillo de los archivos que escribe el hilo de persistencia (solo con io_uring)
+    AnilloEscritura* anilloSalida = ioEngine == MOTOR_URING && escrituraUring.iniciar(ENTRADAS_ANILLO_ESCRITURA)
+                                        ? &escrituraUring : nullptr;
+
+    // Abriendo el WAL y recuperando las mediciones que no alcanzaron a escribirse
+    Wal* wal = nullptr;
+    if (walFile != nullptr) {
+        wal = new Wal(walFile);
+        if (!wal->abrir()) {
+            delete wal;
+            return 1;
+        }
+    }
+    bool compact = vigente->mantieneSellados();  // Hay archivos sellados que mantener (una recarga puede activarlo)
+    ArchivosSalida archivosPh(CANAL_PH, rutaPh, shardOutput, vigente->rotacion, anilloSalida, syncOutput, wal);
+    ArchivosSalida archivosTemp(CANAL_TEMPERATURA, rutaTemperatura, shardOutput, vigente->rotacion, anilloSalida,
+                                syncOutput, wal);
+    Agregados agregadosPh(rutaPh, anilloSalida, syncOutput);
+    Agregados agregadosTemp(rutaTemperatura, anilloSalida, syncOutput);
+    DetectorAnomalias detectorPh(rutaPh, RESOLUCION_CANAL[CANAL_PH]);
+    DetectorAnomalias detectorTemp(rutaTemperatura, RESOLUCION_CANAL[CANAL_TEMPERATURA]);
+    if (!detectorPh.cargar() || !detectorTemp.cargar()) {
+        delete wal;
+        return 1;
+    }
+    if (!archivosPh.preparar() || !archivosTemp.preparar() ||
+        (wal != nullptr && (!archivosPh.recuperar(agregadosPh, vigente->limites[CANAL_PH]) ||
+                            !archivosTemp.recuperar(agregadosTemp, vigente->limites[CANAL_TEMPERATURA])))) {
+        delete wal;
         return 1;
     }
+    Sumidero tardiasPh(anilloSalida, syncOutput);  // Mediciones que llegan después de la marca de agua (tras recortarlas)
+    Sumidero tardiasTemp(anilloSalida, syncOutput);
+    if (eventDelay > 0) {
+        if (!abrirTardias(tardiasPh, rutaPh) || !abrirTardias(tardiasTemp, rutaTemperatura)) {
+            delete wal;
+            return 1;
+        }
+        archivosPh.desviarA(&tardiasPh);
+        archivosTemp.desviarA(&tardiasTemp);
+    }
 
-    // Creando buffers
-    Buffer bufferPh(bufferSize);  // Inicializa el buffer para datos de pH
-    Buffer bufferTemp(bufferSize);  // Inicializa el buffer para datos de temperatura
+    // Preparando el compactador: revisa el directorio de cada canal (segmentado) o el de su archivo
+    std::vector<FuenteCompactacion> fuentes;
+    const std::string* rutas[NUM_CANALES] = {&rutaPh, &rutaTemperatura};
+    for (int c = 0; c < NUM_CANALES; ++c) {
+        FuenteCompactacion fuente;
+        fuente.canal = static_cast<Canal>(c);
+        size_t barra = rutas[c]->rfind('/');
+        if (shardOutput) {
+            fuente.directorio = *rutas[c];
+        } else {
+            fuente.directorio = barra == std::string::npos ? "." : rutas[c]->substr(0, barra == 0 ? 1 : barra);
+            fuente.prefijo = barra == std::string::npos ? *rutas[c] : rutas[c]->substr(barra + 1);
+        }
+        fuentes.push_back(fuente);
+    }
+    Compactador compactador(fuentes, vigente->retencion);
 
     // Preparando los argumentos para los hilos
     ThreadArgs args;
+    std::deque<Recolector> recolectores(collectors);  // Un recolector por pipe
+    for (int i = 0; i < collectors; ++i) {
+        Recolector& recolector = recolectores[i];
+        recolector.args = &args;
+        recolector.indice = i;
+        recolector.pipeName = pipeName;  // El primero usa el nombre indicado; los demás, nombrePipe.1, nombrePipe.2...
+        if (i > 0) {
+            recolector.pipeName += "." + std::to_string(i);
+        }
+    }
+
+    // Las secuencias que el WAL registró antes de una caída vuelven a la ventana de cada recolector (no se sabe
+    // por qué pipe llegó cada sensor): con -u, lo que una fuente reenvía tras la caída se descarta como duplicado
+    if (wal != nullptr) {
+        uint64_t perdidas;
+        for (const Wal::Registro& registro : wal->registros()) {
+            if (registro.secuencia == 0) {
+                continue;
+            }
+            for (Recolector& recolector : recolectores) {
+                recolector.secuencias.registrar(registro.sensor, registro.secuencia, perdidas);
+            }
+        }
+    }
+
+    // Creando Pipes
+    for (int i = 0; i < collectors; ++i) {
+        if (mkfifo(recolectores[i].pipeName.c_str(), 0666) < 0) {  // Crea un pipe con permisos de lectura/escritura
+            std::cerr << "Failed to create pipe: " << recolectores[i].pipeName << std::endl;
+            for (int j = 0; j < i; ++j) {
+                unlink(recolectores[j].pipeName.c_str());  // Borrar los pipes ya creados
+            }
+            return 1;
+        }
+    }
+    auto borrarPipes = [&recolectores]() {  // Para los errores antes de lanzar los recolectores, que los borran al terminar
+        for (const Recolector& recolector : recolectores) {
+            unlink(recolector.pipeName.c_str());
+        }
+    };
+
+    // Creando buffers, con un carril por recolector. Cada uno se construye desde la CPU de su consumidor: sus
+    // ranuras se escriben al crearlas y el núcleo asigna cada página al nodo NUMA de quien la toca primero
+    std::vector<int> cpusPermitidas;  // Afinidad original del hilo principal
+    for (const CpuTopologia& cpu : topologia.cpus()) {
+        cpusPermitidas.push_back(cpu.cpu);
+    }
+    fijarAfinidad(ubicacion.consumidores[CANAL_PH]);
+    Buffer bufferPh(vigente->tamBuffer, collectors);  // Inicializa el buffer para datos de pH
+    fijarAfinidad(ubicacion.consumidores[CANAL_TEMPERATURA]);
+    Buffer bufferTemp(vigente->tamBuffer, collectors);  // Inicializa el buffer para datos de temperatura
+    fijarAfinidad(ubicacion.persistencia);
+    Buffer bufferSalida(std::max(vigente->tamBuffer, TAM_COLA_PERSISTENCIA), NUM_CANALES);  // Cola de persistencia, un carril por canal
+    fijarAfinidad(cpusPermitidas);
+
     args.pH_buffer = &bufferPh;  // Asigna el buffer de pH
     args.temp_buffer = &bufferTemp;  // Asigna el buffer de temperatura
-    args.pipeName = pipeName;  // Asigna el nombre del pipe
-    sem_init(&args.semaphore, 0, 0);  // Inicializa el semáforo
+    args.salida = &bufferSalida;  // Asigna la cola de persistencia
+    args.archivos[CANAL_PH] = &archivosPh;  // Asigna los archivos de salida de cada canal
+    args.archivos[CANAL_TEMPERATURA] = &archivosTemp;
+    args.agregados[CANAL_PH] = &agregadosPh;  // Asigna los agregados de cada canal
+    args.agregados[CANAL_TEMPERATURA] = &agregadosTemp;
+    args.detectores[CANAL_PH] = &detectorPh;  // Asigna los detectores de anomalías de cada canal
+    args.detectores[CANAL_TEMPERATURA] = &detectorTemp;
+    args.configuracion = &configuracion;  // Asigna la configuración vigente
+    args.tardias[CANAL_PH] = &tardiasPh;  // Asigna la salida de tardías de cada canal
+    args.tardias[CANAL_TEMPERATURA] = &tardiasTemp;
+    args.retrasoEventos = eventDelay * 1000;  // Asigna el retraso tolerado en milisegundos
+    args.wal = wal;  // Asigna el WAL (nullptr si está desactivado)
+    args.entregadoWal = wal != nullptr ? wal->ultimoAgregado() : 0;  // El primer lote entrega el LSN siguiente
+    args.idleTimeout = idleTimeout;  // Asigna el tiempo de inactividad de los sensores
+    args.deduplicar = dedupe;  // Asigna el descarte de duplicados
+    args.motor = ioEngine;  // Asigna el motor de entrada y salida
+    bufferPh.setWaitMode(waitModes[CANAL_PH]);  // Asigna el modo de espera de cada canal
+    bufferTemp.setWaitMode(waitModes[CANAL_TEMPERATURA]);
+    for (ModoEspera modo : waitModes) {
+        if (modo == ESPERA_LATENCIA) {
+            args.modoRecolector = ESPERA_LATENCIA;  // El recolector atiende a todos los canales
+        }
+    }
+
+    // Bloqueando SIGINT, SIGTERM, SIGUSR1 y SIGHUP en todos los hilos; el hilo principal las atiende con sigtimedwait
+    sigset_t senales;
+    sigemptyset(&senales);
+    sigaddset(&senales, SIGINT);
+    sigaddset(&senales, SIGTERM);
+    sigaddset(&senales, SIGUSR1);
+    sigaddset(&senales, SIGHUP);
+    pthread_sigmask(SIG_BLOCK, &senales, NULL);
+
+    // Registrando las métricas y, si se pidió, exportándolas por el socket
+    RegistroMetricas registro;
+    registrarMetricas(registro, args);
+    compactador.conectarMetricas(
+        registro.contador("monisenso_compactacion_archivos_total", "Archivos sellados reunidos en archivos compactados."),
+        registro.contador("monisenso_retencion_archivos_borrados_total",
+                          "Archivos sellados o compactados borrados por la retención."),
+        registro.contador("monisenso_compactacion_bytes_leidos_total", "Bytes leídos por el compactador."));
+    ServidorMetricas servidorMetricas(registro, metricsSocket != nullptr ? metricsSocket : "");
+    if (metricsSocket != nullptr && !servidorMetricas.iniciar()) {
+        std::cerr << "Error: No se pudo abrir el socket de métricas: " << metricsSocket << std::endl;
+        borrarPipes();
+        return 1;
+    }
+    ServidorDifusion difusion(subscriptionSocket != nullptr ? subscriptionSocket : "");
+    difusion.conectarMetricas(
+        registro.medidor("monisenso_suscriptores", "Suscriptores conectados a la difusión de mediciones."),
+        registro.contador("monisenso_difusion_descartadas_total",
+                          "Mediciones que no cupieron en la cola de un suscriptor lento."),
+        registro.contador("monisenso_difusion_desconectados_total",
+                          "Suscriptores desconectados por no leer a tiempo."));
+    args.difusion = &difusion;
+    if (subscriptionSocket != nullptr && !difusion.iniciar()) {
+        std::cerr << "Error: No se pudo abrir el socket de suscripciones: " << subscriptionSocket << std::endl;
+        borrarPipes();
+        return 1;
+    }
+    std::time_t inicioMonitor = std::time(nullptr);
+    ServidorControl servidorControl(controlSocket != nullptr ? controlSocket : "",
+                                    [&args, &registro, inicioMonitor](const std::string& peticion) {
+                                        return responderControl(args, registro, inicioMonitor, peticion);
+                                    });
+    if (controlSocket != nullptr && !servidorControl.iniciar()) {
+        std::cerr << "Error: No se pudo abrir el socket de control: " << controlSocket << std::endl;
+        borrarPipes();
+        return 1;
+    }
 
     // Creando hilos
-    pthread_t threadRecolector, threadPh, threadTemp;  // Identificadores para los hilos
-    pthread_create(&threadRecolector, NULL, reco_hilo, &args);  // Crea el hilo recolector de datos
-    pthread_create(&threadPh, NULL, pH_hilo, &args);  // Crea el hilo para manejar los datos de pH
-    pthread_create(&threadTemp, NULL, temperatura_hilo, &args);  // Crea el hilo para manejar los datos de temperatura
+    pthread_t threadPh, threadTemp, threadSalida, threadCompactador;  // Identificadores para los hilos
+    args.recolectoresVivos = collectors;
+    for (Recolector& recolector : recolectores) {
+        crearHilo(&recolector.hilo, reco_hilo, &recolector, ubicacion.recolectores[recolector.indice]);  // Crea los hilos recolectores de datos
+    }
+    crearHilo(&threadPh, pH_hilo, &args, ubicacion.consumidores[CANAL_PH]);  // Crea el hilo para manejar los datos de pH
+    crearHilo(&threadTemp, temperatura_hilo, &args, ubicacion.consumidores[CANAL_TEMPERATURA]);  // Crea el hilo para manejar los datos de temperatura
+    crearHilo(&threadSalida, persistencia_hilo, &args, ubicacion.persistencia);  // Crea el hilo que escribe los archivos de salida
+    if (compact) {
+        crearHilo(&threadCompactador, compactador_hilo, &compactador, std::vector<int>());  // Crea el compactador, sin fijar
+    }
+
+    // Esperando a que los recolectores terminen por inactividad o a recibir una señal de término
+    int senal = 0;
+    while (args.recolectoresVivos > 0) {
+        struct timespec espera = {0, INTERVALO_VIGILANCIA_MS * 1000000L};
+        int recibida = sigtimedwait(&senales, NULL, &espera);
+        if (recibida == SIGUSR1) {  // Volcado del perfil de los buffers a pedido
+            std::cerr << "Perfil del buffer de pH:\n" << bufferPh.profile()
+                      << "Perfil del buffer de temperatura:\n" << bufferTemp.profile()
+                      << "Perfil de la cola de persistencia:\n" << bufferSalida.profile() << std::flush;
+        } else if (recibida == SIGHUP) {  // Recarga de la configuración, sin detener el ingreso
+            const Configuracion* nueva = recargarConfiguracion(args, configFile);
+            if (nueva != nullptr) {
+                compactador.cambiarRetencion(nueva->retencion);
+                if (!compact && nueva->mantieneSellados()) {  // La rotación o la retención se activaron ahora
+                    compact = true;
+                    crearHilo(&threadCompactador, compactador_hilo, &compactador, std::vector<int>());
+                }
+            }
+        } else if (recibida > 0) {
+            senal = recibida;
+            break;
+        }
+    }
 
-    // Uniendo hilos
-    pthread_join(threadRecolector, NULL);  // Espera a que el hilo recolector termine
-    pthread_join(threadPh, NULL);  // Espera a que el hilo de pH termine
-    pthread_join(threadTemp, NULL);  // Espera a que el hilo de temperatura termine
+    // Drenando: los recolectores entregan su último lote y el último cierra los buffers; los evaluadores los vacían,
+    // y el último cierra la cola de persistencia, que se escribe completa
+    struct timespec inicio, limite;
+    clock_gettime(CLOCK_REALTIME, &inicio);
+    limite = inicio;
+    limite.tv_sec += drainDeadline;
+    bool completo = true;
+    if (senal != 0) {
+        std::cout << "Señal recibida (" << strsignal(senal) << "); drenando mediciones..." << std::endl;
+        args.detener = true;  // Detiene el ingreso
+    }
+    for (Recolector& recolector : recolectores) {
+        completo = completo && esperarHilo(recolector.hilo, limite);
+    }
+    completo = completo && esperarHilo(threadPh, limite);  // Espera a que el hilo de pH termine
+    completo = completo && esperarHilo(threadTemp, limite);  // Espera a que el hilo de temperatura termine
+    completo = completo && esperarHilo(threadSalida, limite);  // Espera a que se escriba lo pendiente
+    if (compact) {
+        compactador.detener();  // Abandona la compactación en curso; los archivos sellados quedan intactos
+        completo = completo && esperarHilo(threadCompactador, limite);
+    }
+    struct timespec fin;
+    clock_gettime(CLOCK_REALTIME, &fin);
+    long duracionMs = (fin.tv_sec - inicio.tv_sec) * 1000 + (fin.tv_nsec - inicio.tv_nsec) / 1000000;
+
+    // Mostrando el resumen
+    std::cout << "Resumen:" << std::endl;
+    for (int c = 0; c < NUM_CANALES; ++c) {
+        const MetricasCanal& metricas = args.metricas[c];
+        std::cout << "  " << NOMBRE_CANAL[c] << ": " << metricas.recibidas->valor() << " recibidas, "
+                  << metricas.escritas->valor() << " escritas, " << metricas.descartadas->valor() << " descartadas"
+                  << std::endl;
+    }
+    std::cout << "  drenado en " << duracionMs << " ms" << std::endl;
+    if (!completo) {
+        // Los hilos siguen usando los buffers; terminar sin destruirlos. El WAL conserva lo pendiente.
+        std::cerr << "Error: el drenado superó el plazo de " << drainDeadline << " segundos"
+                  << (wal != nullptr ? "; las mediciones pendientes se recuperarán del WAL" : "") << std::endl;
+        std::cout.flush();
+        _exit(1);
+    }
 
-    // Cerrando pipe y destruyendo semáforo
-    close(pipeFd);  // Cierra el file descriptor del pipe
-    sem_destroy(&args.semaphore);  // Destruye el semáforo
+    detectorPh.guardarPublicado();  // Si el hilo de persistencia no llegó a abrir sus archivos, nadie lo guardó
+    detectorTemp.guardarPublicado();
+    servidorControl.detener();  // Cierra el socket de control
+    difusion.detener();  // Desconecta a los suscriptores
+    servidorMetricas.detener();  // Cierra el socket de métricas
+    delete wal;  // Cierra el WAL
 
-    return 0;  // Finaliza el programa
+    return args.fallo ? 1 : 0;  // Finaliza el programa (1 si se perdieron escrituras)
 }
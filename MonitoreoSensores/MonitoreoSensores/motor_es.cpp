@@ -0,0 +1,565 @@
+/**
+ * @file motor_es.cpp
+ * @autores Juan Pablo Hernández Ceballos
+ * Implementa el anillo de io_uring, el lector de pipes y el sumidero de los archivos de salida.
+ */
+
+#include "motor_es.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+const uint64_t DATO_LECTURA = 1;         ///< Marca de las lecturas del pipe en el anillo
+const uint64_t DATO_CANCELACION = 4;     ///< Marca de la cancelación de la lectura en vuelo
+const uint64_t BIT_SINCRONIZACION = 1;   ///< Bit que distingue la sincronización de un archivo de su escritura (la
+                                         ///< marca de ambas es la dirección del sumidero, siempre par)
+
+/**
+ * Interpreta el nombre de un motor de entrada y salida (`clasico` o `uring`).
+ *
+ * @param nombre Nombre del motor.
+ * @param motor Motor leído.
+ * @return false si el nombre no corresponde a un motor.
+ */
+bool leerMotor(const std::string& nombre, MotorEs& motor) {
+    if (nombre == "clasico") {
+        motor = MOTOR_CLASICO;
+    } else if (nombre == "uring") {
+        motor = MOTOR_URING;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Comprueba si el núcleo permite crear un anillo de io_uring con las funciones que usa el monitor.
+bool uringDisponible() {
+    AnilloUring prueba;
+    return prueba.iniciar(1);
+}
+
+AnilloUring::AnilloUring()
+    : fd(-1), memoriaEnvio(MAP_FAILED), largoEnvio(0), memoriaCompletado(MAP_FAILED), largoCompletado(0),
+      entradas(static_cast<io_uring_sqe*>(MAP_FAILED)), largoEntradas(0), colaEnvio(nullptr), cabezaEnvio(nullptr),
+      mascaraEnvio(0), indices(nullptr), colaCompletado(nullptr), cabezaCompletado(nullptr), mascaraCompletado(0),
+      completados(nullptr), colaLocal(0), sinEnviar(0) {
+}
+
+AnilloUring::~AnilloUring() {
+    cerrar();
+}
+
+// Desmapea los anillos y cierra el descriptor. Cerrar el anillo cancela lo que quede en vuelo.
+void AnilloUring::cerrar() {
+    if (entradas != MAP_FAILED) {
+        munmap(entradas, largoEntradas);
+    }
+    if (memoriaCompletado != MAP_FAILED && memoriaCompletado != memoriaEnvio) {
+        munmap(memoriaCompletado, largoCompletado);
+    }
+    if (memoriaEnvio != MAP_FAILED) {
+        munmap(memoriaEnvio, largoEnvio);
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    fd = -1;
+    memoriaEnvio = memoriaCompletado = MAP_FAILED;
+    entradas = static_cast<io_uring_sqe*>(MAP_FAILED);
+}
+
+/**
+ * Crea el anillo y mapea sus colas. Se exige la espera con plazo de io_uring_enter (núcleo 5.11 o
+ * posterior); sin ella el anillo no se activa.
+ *
+ * @param cantidad Entradas del anillo de envío.
+ * @return false si el núcleo no ofrece io_uring.
+ */
+bool AnilloUring::iniciar(unsigned cantidad) {
+    io_uring_params parametros;
+    memset(&parametros, 0, sizeof(parametros));
+    fd = static_cast<int>(syscall(__NR_io_uring_setup, cantidad, &parametros));
+    if (fd < 0) {
+        return false;
+    }
+    if (!(parametros.features & IORING_FEAT_EXT_ARG)) {
+        cerrar();
+        return false;
+    }
+    largoEnvio = parametros.sq_off.array + parametros.sq_entries * sizeof(unsigned);
+    largoCompletado = parametros.cq_off.cqes + parametros.cq_entries * sizeof(io_uring_cqe);
+    bool unidos = parametros.features & IORING_FEAT_SINGLE_MMAP; // Un solo mapeo para ambos anillos
+    if (unidos) {
+        largoEnvio = largoCompletado = largoEnvio > largoCompletado ? largoEnvio : largoCompletado;
+    }
+    memoriaEnvio = mmap(nullptr, largoEnvio, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (memoriaEnvio == MAP_FAILED) {
+        cerrar();
+        return false;
+    }
+    memoriaCompletado = unidos ? memoriaEnvio
+                               : mmap(nullptr, largoCompletado, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                                      IORING_OFF_CQ_RING);
+    largoEntradas = parametros.sq_entries * sizeof(io_uring_sqe);
+    entradas = static_cast<io_uring_sqe*>(mmap(nullptr, largoEntradas, PROT_READ | PROT_WRITE,
+                                               MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES));
+    if (memoriaCompletado == MAP_FAILED || entradas == MAP_FAILED) {
+        cerrar();
+        return false;
+    }
+
+    char* envio = static_cast<char*>(memoriaEnvio);
+    colaEnvio = reinterpret_cast<unsigned*>(envio + parametros.sq_off.tail);
+    cabezaEnvio = reinterpret_cast<unsigned*>(envio + parametros.sq_off.head);
+    mascaraEnvio = *reinterpret_cast<unsigned*>(envio + parametros.sq_off.ring_mask);
+    indices = reinterpret_cast<unsigned*>(envio + parametros.sq_off.array);
+    char* completado = static_cast<char*>(memoriaCompletado);
+    colaCompletado = reinterpret_cast<unsigned*>(completado + parametros.cq_off.tail);
+    cabezaCompletado = reinterpret_cast<unsigned*>(completado + parametros.cq_off.head);
+    mascaraCompletado = *reinterpret_cast<unsigned*>(completado + parametros.cq_off.ring_mask);
+    completados = reinterpret_cast<io_uring_cqe*>(completado + parametros.cq_off.cqes);
+    colaLocal = *colaEnvio;
+    sinEnviar = 0;
+    return true;
+}
+
+bool AnilloUring::activo() const {
+    return fd >= 0;
+}
+
+// Reserva la siguiente entrada de envío, ya en cero. Queda pendiente hasta el próximo enviar().
+// Devuelve nullptr si el anillo de envío está lleno.
+io_uring_sqe* AnilloUring::preparar() {
+    unsigned cola = colaLocal;
+    if (cola - __atomic_load_n(cabezaEnvio, __ATOMIC_ACQUIRE) > mascaraEnvio) {
+        return nullptr;
+    }
+    unsigned posicion = cola & mascaraEnvio;
+    io_uring_sqe* entrada = &entradas[posicion];
+    memset(entrada, 0, sizeof(*entrada));
+    indices[posicion] = posicion;
+    colaLocal++;
+    sinEnviar++;
+    return entrada;
+}
+
+/**
+ * Publica las entradas preparadas y, si se pide, espera completados, todo en una sola llamada al sistema.
+ *
+ * @param esperadas Completados a esperar (0 = solo enviar).
+ * @param esperaMs Plazo de la espera en milisegundos (-1 = sin plazo).
+ * @return Entradas aceptadas por el núcleo, o -errno si la llamada falló por otro motivo que el plazo.
+ */
+int AnilloUring::enviar(unsigned esperadas, int esperaMs) {
+    __atomic_store_n(colaEnvio, colaLocal, __ATOMIC_RELEASE); // Entradas escritas antes que la cola
+    unsigned banderas = 0;
+    __kernel_timespec plazo = {esperaMs / 1000, (esperaMs % 1000) * 1000000L};
+    io_uring_getevents_arg argumento;
+    memset(&argumento, 0, sizeof(argumento));
+    if (esperadas > 0) {
+        banderas |= IORING_ENTER_GETEVENTS;
+        if (esperaMs >= 0) {
+            banderas |= IORING_ENTER_EXT_ARG;
+            argumento.ts = reinterpret_cast<uint64_t>(&plazo);
+        }
+    }
+    long resultado = syscall(__NR_io_uring_enter, fd, sinEnviar, esperadas, banderas,
+                             (banderas & IORING_ENTER_EXT_ARG) ? &argumento : nullptr, sizeof(argumento));
+    if (resultado < 0) {
+        return errno == ETIME || errno == EINTR ? 0 : -errno;
+    }
+    sinEnviar -= static_cast<unsigned>(resultado);
+    return static_cast<int>(resultado);
+}
+
+// Entradas de envío que aún se pueden preparar.
+unsigned AnilloUring::libres() const {
+    return mascaraEnvio + 1 - (colaLocal - __atomic_load_n(cabezaEnvio, __ATOMIC_ACQUIRE));
+}
+
+// Retira el completado más antiguo, si lo hay.
+bool AnilloUring::completada(io_uring_cqe& resultado) {
+    unsigned cabeza = *cabezaCompletado;
+    if (cabeza == __atomic_load_n(colaCompletado, __ATOMIC_ACQUIRE)) {
+        return false;
+    }
+    resultado = completados[cabeza & mascaraCompletado];
+    __atomic_store_n(cabezaCompletado, cabeza + 1, __ATOMIC_RELEASE); // La entrada ya se copió
+    return true;
+}
+
+// Hay completados sin retirar. No entra al núcleo, así que sirve para girar sobre el anillo.
+bool AnilloUring::hayCompletadas() const {
+    return *cabezaCompletado != __atomic_load_n(colaCompletado, __ATOMIC_ACQUIRE);
+}
+
+// Prepara el lector del pipe. Con io_uring, el pipe pasa a modo bloqueante: el anillo espera los datos
+// por su cuenta, y como el recolector mantiene abierto un extremo de escritura nunca hay fin de archivo.
+LectorPipe::LectorPipe(int fd, size_t tamBloque, MotorEs motor)
+    : fd(fd), motorActual(MOTOR_CLASICO), bloque(tamBloque), enVuelo(false), listos(0) {
+    if (motor == MOTOR_URING && anillo.iniciar(ENTRADAS_ANILLO)) {
+        motorActual = MOTOR_URING;
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+    }
+}
+
+LectorPipe::~LectorPipe() {
+    cerrar();
+}
+
+MotorEs LectorPipe::motor() const {
+    return motorActual;
+}
+
+// Presenta una lectura sobre el bloque; se envía al núcleo con el próximo AnilloUring::enviar().
+bool LectorPipe::lanzarLectura() {
+    io_uring_sqe* entrada = anillo.preparar();
+    if (entrada == nullptr) {
+        return false;
+    }
+    entrada->opcode = IORING_OP_READ;
+    entrada->fd = fd;
+    entrada->addr = reinterpret_cast<uint64_t>(bloque.data());
+    entrada->len = static_cast<uint32_t>(bloque.size());
+    entrada->off = static_cast<uint64_t>(-1); // Posición actual: el pipe no admite desplazamientos
+    entrada->user_data = DATO_LECTURA;
+    enVuelo = true;
+    return true;
+}
+
+/**
+ * Espera hasta `esperaMs` milisegundos a que el pipe tenga datos y los lee.
+ *
+ * @param datos Recibe el comienzo de los datos leídos; son válidos hasta la siguiente llamada.
+ * @param esperaMs Plazo de la espera (0 = solo comprobar).
+ * @return Bytes leídos, 0 si no llegó nada dentro del plazo o -1 si la lectura falló (con errno).
+ */
+ssize_t LectorPipe::leer(const char*& datos, int esperaMs) {
+    datos = bloque.data();
+    if (motorActual == MOTOR_CLASICO) {
+        struct pollfd sondeo = {fd, POLLIN, 0};
+        int listo = poll(&sondeo, 1, esperaMs);
+        if (listo <= 0 || !(sondeo.revents & POLLIN)) {
+            return 0;
+        }
+        ssize_t leidos = read(fd, bloque.data(), bloque.size());
+        return leidos < 0 && errno == EAGAIN ? 0 : leidos;
+    }
+    if (listos == 0) {
+        if (!enVuelo && !lanzarLectura()) {
+            errno = EBUSY;
+            return -1;
+        }
+        if (!anillo.hayCompletadas()) { // Envía la lectura, si es nueva, y espera en la misma llamada
+            anillo.enviar(1, esperaMs);
+        }
+        io_uring_cqe resultado;
+        if (!anillo.completada(resultado)) {
+            return 0; // La lectura sigue en vuelo
+        }
+        enVuelo = false;
+        if (resultado.res == -EAGAIN || resultado.res == -EINTR) {
+            return 0;
+        }
+        listos = resultado.res;
+    }
+    ssize_t leidos = listos;
+    listos = 0;
+    if (leidos < 0) {
+        errno = static_cast<int>(-leidos);
+        return -1;
+    }
+    return leidos;
+}
+
+// Comprueba sin bloquear si hay datos. Con io_uring, la primera llamada presenta la lectura y las demás
+// solo miran el anillo de completado, sin llamadas al sistema.
+bool LectorPipe::hayDatos() {
+    if (motorActual == MOTOR_CLASICO) {
+        struct pollfd sondeo = {fd, POLLIN, 0};
+        return poll(&sondeo, 1, 0) > 0;
+    }
+    if (!enVuelo && listos == 0) {
+        if (!lanzarLectura()) {
+            return false;
+        }
+        anillo.enviar(0, 0);
+    }
+    return listos != 0 || anillo.hayCompletadas();
+}
+
+// Cancela la lectura en vuelo y espera su completado: el núcleo no debe escribir en el bloque una vez
+// liberado. Después cierra el anillo. No cierra el pipe.
+void LectorPipe::cerrar() {
+    if (!anillo.activo()) {
+        return;
+    }
+    if (enVuelo) {
+        io_uring_sqe* entrada = anillo.preparar();
+        if (entrada != nullptr) {
+            entrada->opcode = IORING_OP_ASYNC_CANCEL;
+            entrada->addr = DATO_LECTURA;
+            entrada->user_data = DATO_CANCELACION;
+        }
+        io_uring_cqe resultado;
+        for (int intento = 0; enVuelo && intento < 10 && anillo.enviar(1, 100) >= 0; ++intento) {
+            while (anillo.completada(resultado)) {
+                enVuelo = enVuelo && resultado.user_data != DATO_LECTURA;
+            }
+        }
+    }
+    anillo.cerrar();
+}
+
+/**
+ * Crea el anillo compartido.
+ *
+ * @param entradas Entradas del anillo de envío; cada archivo presentado ocupa una o dos.
+ * @return false si el núcleo no ofrece io_uring.
+ */
+bool AnilloEscritura::iniciar(unsigned entradas) {
+    return anillo.iniciar(entradas);
+}
+
+bool AnilloEscritura::activo() const {
+    return anillo.activo();
+}
+
+/**
+ * Envía al núcleo las operaciones presentadas por todos los archivos y espera sus resultados, todo en
+ * una sola llamada al sistema (más las que hagan falta si el núcleo no acepta todo de una vez). Cada
+ * archivo recibe el resultado de sus operaciones y lo aplica en su siguiente vaciado.
+ */
+void AnilloEscritura::enviar() {
+    unsigned esperadas = operaciones;
+    operaciones = 0;
+    while (esperadas > 0) {
+        int enviadas = anillo.enviar(esperadas, -1);
+        if (enviadas < 0) { // Sin poder entrar al núcleo no hay completados que esperar
+            for (Sumidero* sumidero : presentados) {
+                sumidero->completar(enviadas, false);
+            }
+            break;
+        }
+        io_uring_cqe resultado;
+        while (esperadas > 0 && anillo.completada(resultado)) {
+            esperadas--;
+            Sumidero* sumidero = reinterpret_cast<Sumidero*>(resultado.user_data & ~BIT_SINCRONIZACION);
+            sumidero->completar(resultado.res, resultado.user_data & BIT_SINCRONIZACION);
+        }
+    }
+    presentados.clear();
+}
+
+// El anillo se comparte entre todos los archivos del hilo que los escribe; nullptr usa el motor clásico.
+Sumidero::Sumidero(AnilloEscritura* anillo, bool sincronizar)
+    : fd(-1), anillo(anillo != nullptr && anillo->activo() ? anillo : nullptr), sincronizar(sincronizar), escritos(0),
+      presentado(false), enviado(0), errorEnvio(0), sincronizado(false) {
+}
+
+Sumidero::~Sumidero() {
+    cerrar();
+}
+
+/**
+ * Abre el archivo de salida.
+ *
+ * @param ruta Ruta del archivo.
+ * @param anexar true para escribir al final del contenido existente; false para vaciarlo.
+ * @return false si no se pudo abrir.
+ */
+bool Sumidero::abrir(const char* ruta, bool anexar) {
+    fd = open(ruta, O_WRONLY | O_CREAT | (anexar ? O_APPEND : O_TRUNC), 0644);
+    if (fd < 0) {
+        return false;
+    }
+    off_t fin = lseek(fd, 0, SEEK_END);
+    escritos = fin > 0 ? static_cast<uint64_t>(fin) : 0;
+    return true;
+}
+
+// Agrega una línea al bloque pendiente; no se escribe hasta vaciar().
+void Sumidero::agregar(const char* linea, size_t largo) {
+    bloque.append(linea, largo);
+}
+
+/**
+ * Presenta en el anillo compartido la escritura del bloque pendiente y, si corresponde, la sincronización
+ * enlazada a ella, sin entrar al núcleo: se envían con las de los demás archivos en AnilloEscritura::enviar()
+ * y el resultado se aplica en el siguiente vaciar().
+ *
+ * @param sincronizarAhora Sincronizar el archivo aunque no se sincronice en cada vaciado (y aunque no haya
+ *                         nada que escribir).
+ * @return false si no quedó nada presentado (motor clásico, nada que hacer o anillo lleno); vaciar()
+ *         escribe entonces por su cuenta.
+ */
+bool Sumidero::presentar(bool sincronizarAhora) {
+    bool sincronizarlo = sincronizar || sincronizarAhora;
+    if (anillo == nullptr || fd < 0 || presentado || (bloque.empty() && !sincronizarAhora)) {
+        return false;
+    }
+    unsigned necesarias = (bloque.empty() ? 0 : 1) + (sincronizarlo ? 1 : 0);
+    if (anillo->anillo.libres() < necesarias) {
+        return false;
+    }
+    io_uring_sqe* escritura = bloque.empty() ? nullptr : anillo->anillo.preparar();
+    io_uring_sqe* sincronizacion = sincronizarlo ? anillo->anillo.preparar() : nullptr;
+    if (escritura != nullptr) {
+        escritura->opcode = IORING_OP_WRITE;
+        escritura->fd = fd;
+        escritura->addr = reinterpret_cast<uint64_t>(bloque.data());
+        escritura->len = static_cast<uint32_t>(bloque.size());
+        escritura->off = escritos;
+        escritura->user_data = reinterpret_cast<uint64_t>(this);
+        if (sincronizacion != nullptr) {
+            escritura->flags |= IOSQE_IO_LINK; // Si la escritura queda corta, el núcleo cancela la sincronización
+        }
+    }
+    if (sincronizacion != nullptr) {
+        sincronizacion->opcode = IORING_OP_FSYNC;
+        sincronizacion->fd = fd;
+        sincronizacion->fsync_flags = IORING_FSYNC_DATASYNC;
+        sincronizacion->user_data = reinterpret_cast<uint64_t>(this) | BIT_SINCRONIZACION;
+    }
+    anillo->operaciones += necesarias;
+    anillo->presentados.push_back(this);
+    presentado = true;
+    enviado = 0;
+    errorEnvio = 0;
+    sincronizado = false;
+    return true;
+}
+
+// Recibe el resultado de una operación presentada (bytes escritos o -errno).
+void Sumidero::completar(int resultado, bool sincronizacion) {
+    if (resultado < 0 && resultado != -ECANCELED) {
+        errorEnvio = errorEnvio != 0 ? errorEnvio : -resultado;
+    } else if (sincronizacion) {
+        sincronizado = resultado == 0;
+    } else if (resultado > 0) {
+        enviado += static_cast<size_t>(resultado);
+    }
+}
+
+// Aplica el resultado del último envío: lo que llegó al archivo deja de estar pendiente.
+bool Sumidero::recoger() {
+    if (!presentado) {
+        return true;
+    }
+    presentado = false;
+    escritos += enviado;
+    bloque.erase(0, enviado);
+    sincronizado = sincronizado && bloque.empty() && errorEnvio == 0;
+    if (errorEnvio != 0) {
+        errno = errorEnvio;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Escribe el bloque pendiente con una sola operación (más las que hagan falta si la escritura queda
+ * corta) y, si se pidió, sincroniza el archivo. Si el bloque ya se presentó en el anillo compartido y se
+ * envió, solo aplica ese resultado y escribe lo que haya faltado. Si la escritura falla, lo que no llegó
+ * al archivo sigue pendiente para el próximo vaciado; si solo falla la sincronización, los datos ya
+ * están escritos.
+ *
+ * @return false si la escritura o la sincronización fallaron (con errno).
+ */
+bool Sumidero::vaciar() {
+    if (presentado && !anillo->presentados.empty()) {
+        anillo->enviar(); // Presentado pero aún no enviado: enviarlo ahora con los demás
+    }
+    if (!recoger()) {
+        return false;
+    }
+    if (bloque.empty() || fd < 0) {
+        return true;
+    }
+    if (anillo == nullptr) {
+        size_t hecho = 0;
+        bool correcto = escribirClasico(hecho);
+        escritos += hecho;
+        bloque.erase(0, hecho);
+        return correcto;
+    }
+    while (!bloque.empty()) { // Lo que una escritura corta dejó pendiente
+        size_t antes = bloque.size();
+        if (!presentar()) { // Anillo lleno con lo que presentaron otros archivos: enviarlo primero
+            anillo->enviar();
+            if (!presentar()) {
+                errno = EBUSY;
+                return false;
+            }
+        }
+        anillo->enviar();
+        if (!recoger()) {
+            return false;
+        }
+        if (bloque.size() == antes) {
+            errno = EIO; // El núcleo no escribió nada ni informó un error
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Sincroniza con el disco los datos ya escritos, aunque el sumidero no sincronice en cada vaciado. Si el
+ * último envío por el anillo ya lo sincronizó (ver presentar()), no vuelve a hacerlo.
+ *
+ * @return false si la sincronización falló (con errno).
+ */
+bool Sumidero::sincronizarDatos() {
+    if (sincronizado) {
+        sincronizado = false;
+        return true;
+    }
+    return fd < 0 || fdatasync(fd) == 0;
+}
+
+// Escribe el bloque con write(); `hecho` recibe los bytes que llegaron al archivo.
+bool Sumidero::escribirClasico(size_t& hecho) {
+    while (hecho < bloque.size()) {
+        ssize_t escrito = write(fd, bloque.data() + hecho, bloque.size() - hecho);
+        if (escrito < 0 && errno == EINTR) {
+            continue;
+        }
+        if (escrito < 0) {
+            return false;
+        }
+        hecho += static_cast<size_t>(escrito);
+    }
+    return !sincronizar || fdatasync(fd) == 0;
+}
+
+// Bytes de líneas que esperan ser escritas.
+size_t Sumidero::pendiente() const {
+    return bloque.size();
+}
+
+// Tamaño del archivo contando solo lo ya escrito.
+uint64_t Sumidero::posicion() const {
+    return escritos;
+}
+
+// Escribe lo pendiente y cierra el archivo. Lo que no se pudo escribir se pierde (y se avisa), para que no
+// termine en otro archivo si el sumidero se vuelve a abrir.
+void Sumidero::cerrar() {
+    if (fd < 0) {
+        return;
+    }
+    if (!vaciar()) {
+        std::cerr << "Error: Se perdieron " << bloque.size() << " bytes al cerrar un archivo de salida: "
+                  << strerror(errno) << std::endl;
+        bloque.clear();
+    }
+    close(fd);
+    fd = -1;
+}
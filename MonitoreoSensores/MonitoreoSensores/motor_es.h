@@ -0,0 +1,161 @@
+/**
+ * @file motor_es.h
+ * @autores Juan Pablo Hernández Ceballos
+ * Motor de entrada y salida del monitor: lectura de los pipes y escritura de los archivos de salida.
+ *
+ * Con el motor clásico, el recolector espera con poll() y lee con read(), y el hilo de persistencia
+ * escribe con write(). Con io_uring (sin bibliotecas externas, con las llamadas al sistema directamente),
+ * cada recolector tiene su propio anillo: mantiene siempre una lectura en vuelo, la presenta y espera en
+ * una sola llamada y puede vigilar el anillo sin entrar al núcleo. Todos los archivos que escribe el hilo
+ * de persistencia (salidas, agregados y tardías) comparten un solo anillo (ver AnilloEscritura): cada
+ * archivo presenta en él la escritura de su lote y la sincronización enlazada, y el hilo las envía todas
+ * y espera sus resultados con una sola llamada, sin importar cuántos archivos toque el lote. Si el núcleo
+ * no ofrece io_uring, se usa el motor clásico. En ambos motores cada lote de mediciones se escribe con una
+ * sola operación por archivo en lugar de una por línea.
+ */
+
+#ifndef MOTOR_ES_H
+#define MOTOR_ES_H
+
+#include <cstddef>
+#include <cstdint>
+#include <linux/io_uring.h>
+#include <string>
+#include <sys/types.h>
+#include <vector>
+
+/**
+ * Motor de entrada y salida.
+ */
+enum MotorEs : uint8_t {
+    MOTOR_CLASICO = 0,  ///< poll(), read() y write()
+    MOTOR_URING = 1     ///< io_uring, con el clásico como respaldo
+};
+
+const unsigned ENTRADAS_ANILLO = 8;              ///< Entradas del anillo de envío del lector de cada pipe
+const unsigned ENTRADAS_ANILLO_ESCRITURA = 256;  ///< Entradas del anillo compartido por los archivos de salida
+
+bool leerMotor(const std::string& nombre, MotorEs& motor);
+bool uringDisponible();
+
+/**
+ * Anillo de io_uring de un solo hilo, sin liburing.
+ */
+class AnilloUring {
+public:
+    AnilloUring();
+    ~AnilloUring();
+
+    bool iniciar(unsigned entradas);
+    bool activo() const;
+    io_uring_sqe* preparar();
+    unsigned libres() const;
+    int enviar(unsigned esperadas, int esperaMs);
+    bool completada(io_uring_cqe& resultado);
+    bool hayCompletadas() const;
+    void cerrar();
+
+private:
+    int fd;                      ///< Descriptor del anillo (-1 si no está activo)
+    void* memoriaEnvio;          ///< Anillo de envío mapeado
+    size_t largoEnvio;           ///< Bytes mapeados del anillo de envío
+    void* memoriaCompletado;     ///< Anillo de completado mapeado (el mismo que el de envío si el núcleo los une)
+    size_t largoCompletado;      ///< Bytes mapeados del anillo de completado
+    io_uring_sqe* entradas;      ///< Entradas de envío
+    size_t largoEntradas;        ///< Bytes mapeados de las entradas
+    unsigned* colaEnvio;         ///< Cola del anillo de envío (la escribe este hilo)
+    unsigned* cabezaEnvio;       ///< Cabeza del anillo de envío (la escribe el núcleo)
+    unsigned mascaraEnvio;       ///< Máscara de posiciones del anillo de envío
+    unsigned* indices;           ///< Arreglo de índices del anillo de envío
+    unsigned* colaCompletado;    ///< Cola del anillo de completado (la escribe el núcleo)
+    unsigned* cabezaCompletado;  ///< Cabeza del anillo de completado (la escribe este hilo)
+    unsigned mascaraCompletado;  ///< Máscara de posiciones del anillo de completado
+    io_uring_cqe* completados;   ///< Entradas de completado
+    unsigned colaLocal;          ///< Cola incluyendo las entradas preparadas y aún no publicadas
+    unsigned sinEnviar;          ///< Entradas preparadas que el núcleo aún no recibe
+};
+
+/**
+ * Lector de un pipe. Con io_uring deja una lectura en vuelo sobre su bloque y la espera junto con el
+ * envío de la siguiente, en una sola llamada al sistema.
+ */
+class LectorPipe {
+public:
+    LectorPipe(int fd, size_t tamBloque, MotorEs motor);
+    ~LectorPipe();
+
+    MotorEs motor() const;
+    ssize_t leer(const char*& datos, int esperaMs);
+    bool hayDatos();
+    void cerrar();
+
+private:
+    bool lanzarLectura();
+
+    int fd;                    ///< Pipe del recolector
+    MotorEs motorActual;       ///< Motor en uso (clásico si io_uring no está disponible)
+    std::vector<char> bloque;  ///< Bloque donde se leen los datos
+    AnilloUring anillo;        ///< Anillo del lector (solo con io_uring)
+    bool enVuelo;              ///< Hay una lectura presentada sin completar
+    ssize_t listos;            ///< Resultado de una lectura completada que aún no se entrega (0 = ninguno)
+};
+
+class Sumidero;
+
+/**
+ * Anillo de io_uring compartido por los archivos de salida de un hilo. Cada archivo presenta en él la
+ * escritura de su bloque (ver Sumidero::presentar()) y enviar() las entrega todas al núcleo y espera sus
+ * resultados en una sola llamada; cada archivo los recoge en su siguiente Sumidero::vaciar(). Entre
+ * presentar y enviar no se agregan líneas a los archivos presentados.
+ */
+class AnilloEscritura {
+public:
+    bool iniciar(unsigned entradas);
+    bool activo() const;
+    void enviar();
+
+private:
+    friend class Sumidero;
+
+    AnilloUring anillo;                 ///< Anillo de envío y completado
+    std::vector<Sumidero*> presentados; ///< Archivos con operaciones presentadas y aún no enviadas
+    unsigned operaciones = 0;           ///< Operaciones presentadas y aún no enviadas
+};
+
+/**
+ * Archivo de salida que recibe las líneas de un lote y las escribe con una sola operación, seguida
+ * opcionalmente de fdatasync(). Con io_uring, la operación va al anillo compartido del hilo que escribe.
+ */
+class Sumidero {
+public:
+    Sumidero(AnilloEscritura* anillo, bool sincronizar);
+    ~Sumidero();
+
+    bool abrir(const char* ruta, bool anexar);
+    void agregar(const char* linea, size_t largo);
+    bool presentar(bool sincronizarAhora = false);
+    bool vaciar();
+    bool sincronizarDatos();
+    size_t pendiente() const;
+    uint64_t posicion() const;
+    void cerrar();
+
+private:
+    friend class AnilloEscritura;
+
+    bool escribirClasico(size_t& hecho);
+    void completar(int resultado, bool sincronizacion);
+    bool recoger();
+
+    int fd;                     ///< Archivo de salida (-1 si está cerrado)
+    AnilloEscritura* anillo;    ///< Anillo compartido (nullptr con el motor clásico)
+    bool sincronizar;           ///< Sincronizar el archivo tras cada escritura
+    std::string bloque;         ///< Líneas pendientes de escribir
+    uint64_t escritos;          ///< Posición del final del archivo
+    bool presentado;            ///< Tiene operaciones en el anillo cuyo resultado aún no se recoge
+    size_t enviado;             ///< Bytes del bloque que llegaron al archivo en el último envío
+    int errorEnvio;             ///< Error del último envío (0 = ninguno)
+    bool sincronizado;          ///< El último envío sincronizó el archivo y no quedó nada pendiente
+};
+
+#endif //MOTOR_ES_H
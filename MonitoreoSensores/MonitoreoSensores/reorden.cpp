@@ -0,0 +1,89 @@
+/**
+ * @file reorden.cpp
+ * @autores Juan Pablo Hernández Ceballos
+ * Implementa el reordenamiento por hora del evento.
+ */
+
+#include "reorden.h"
+
+#include <algorithm>
+#include <functional>
+
+/**
+ * @param retrasoMs Retraso tolerado entre la mayor hora de evento vista y la de una medición (ms).
+ */
+Reordenamiento::Reordenamiento(int64_t retrasoMs)
+    : retraso(retrasoMs), maximo(INT64_MIN), marca(INT64_MIN), ultimaLlegada(0), llegadas(0) {
+}
+
+/**
+ * Retiene una medición y avanza la marca de agua. Se ordena por horaOrden(): una medición fechada después
+ * de su recepción no adelanta la marca del canal ni desvía a tardías las mediciones de los demás sensores.
+ *
+ * @param lectura Medición recibida.
+ * @param ahoraMs Reloj monótono en milisegundos.
+ * @return false si la medición llega tarde (su hora es anterior a la marca); no se retiene.
+ */
+bool Reordenamiento::agregar(const Lectura& lectura, int64_t ahoraMs) {
+    int64_t evento = horaOrden(lectura.eventoMs(), lectura.recepcion);
+    ultimaLlegada = ahoraMs;
+    if (evento < marca) {
+        return false;
+    }
+    retenidas.push(Retenida{evento, llegadas++, lectura});
+    lsns.insert(lectura.lsn);
+    if (evento > maximo) {
+        maximo = evento;
+        marca = std::max(marca, maximo - retraso);
+    }
+    return true;
+}
+
+/**
+ * Saca la siguiente medición liberada por la marca de agua, en orden de hora del evento.
+ *
+ * @param lectura Recibe la medición.
+ * @return false si no queda ninguna liberada.
+ */
+bool Reordenamiento::extraer(Lectura& lectura) {
+    if (retenidas.empty() || retenidas.top().evento > marca) {
+        return false;
+    }
+    lectura = retenidas.top().lectura;
+    retenidas.pop();
+    lsns.erase(lsns.find(lectura.lsn));
+    return true;
+}
+
+/**
+ * Libera lo retenido si el canal pasó un retraso completo sin recibir mediciones.
+ *
+ * @param ahoraMs Reloj monótono en milisegundos.
+ */
+void Reordenamiento::revisarInactividad(int64_t ahoraMs) {
+    if (!retenidas.empty() && ahoraMs - ultimaLlegada >= retraso) {
+        marca = std::max(marca, maximo);
+    }
+}
+
+/**
+ * Libera todo lo retenido (al cerrar el monitor).
+ */
+void Reordenamiento::liberarTodo() {
+    marca = std::max(marca, maximo);
+}
+
+// Indica si no queda ninguna medición retenida.
+bool Reordenamiento::vacio() const {
+    return retenidas.empty();
+}
+
+// LSN más bajo de las mediciones retenidas (UINT64_MAX si no hay ninguna).
+uint64_t Reordenamiento::lsnRetenido() const {
+    return lsns.empty() ? UINT64_MAX : *lsns.begin();
+}
+
+// Marca de agua actual en milisegundos (INT64_MIN antes de la primera medición).
+int64_t Reordenamiento::marcaAgua() const {
+    return marca;
+}
@@ -0,0 +1,74 @@
+/**
+ * @file reorden.h
+ * @autores Juan Pablo Hernández Ceballos
+ * Reordenamiento por hora del evento de las mediciones de un canal.
+ *
+ * Las mediciones llegan en orden de recepción, pero las fuentes pueden enviarlas con retraso o por
+ * recolectores distintos. El hilo de persistencia retiene las de cada canal y las libera en orden de
+ * hora del evento detrás de una marca de agua: la mayor hora de evento vista menos el retraso tolerado.
+ * Una medición con hora anterior a la marca llega tarde (ya se liberaron mediciones posteriores) y el
+ * hilo la desvía a la salida de tardías. Una medición con hora posterior a su recepción se ordena por la
+ * hora de recepción, para que un reloj adelantado en una fuente no mueva la marca. Si el canal pasa un
+ * retraso completo sin recibir nada, la marca alcanza la mayor hora vista y se libera todo lo retenido.
+ */
+
+#ifndef REORDEN_H
+#define REORDEN_H
+
+#include <algorithm>
+#include <cstdint>
+#include <queue>
+#include <set>
+#include <vector>
+#include "lectura.h"
+
+/**
+ * Hora con la que se ordena una medición: la de su evento, salvo que sea posterior al final del segundo en
+ * que se recibió (reloj de la fuente adelantado).
+ *
+ * @param eventoMs Hora del evento (ms).
+ * @param recepcion Hora de recepción (segundos).
+ */
+inline int64_t horaOrden(int64_t eventoMs, int64_t recepcion) {
+    return std::min(eventoMs, recepcion * 1000 + 999);
+}
+
+/**
+ * Mediciones retenidas de un canal. Lo usa solo el hilo de persistencia.
+ */
+class Reordenamiento {
+public:
+    explicit Reordenamiento(int64_t retrasoMs);
+
+    bool agregar(const Lectura& lectura, int64_t ahoraMs);
+    bool extraer(Lectura& lectura);
+    void revisarInactividad(int64_t ahoraMs);
+    void liberarTodo();
+    bool vacio() const;
+    uint64_t lsnRetenido() const;
+    int64_t marcaAgua() const;
+
+private:
+    /**
+     * Medición retenida; el número de llegada desempata las de igual hora.
+     */
+    struct Retenida {
+        int64_t evento;   ///< Hora del evento (ms)
+        uint64_t llegada; ///< Orden de llegada
+        Lectura lectura;  ///< Medición
+
+        bool operator>(const Retenida& otra) const {
+            return evento != otra.evento ? evento > otra.evento : llegada > otra.llegada;
+        }
+    };
+
+    int64_t retraso;      ///< Retraso tolerado (ms)
+    int64_t maximo;       ///< Mayor hora de evento vista (ms)
+    int64_t marca;        ///< Marca de agua: se liberan las mediciones con hora hasta aquí (ms)
+    int64_t ultimaLlegada; ///< Reloj monótono de la última medición recibida (ms)
+    uint64_t llegadas;    ///< Mediciones recibidas
+    std::priority_queue<Retenida, std::vector<Retenida>, std::greater<Retenida>> retenidas; ///< Por hora del evento
+    std::multiset<uint64_t> lsns;  ///< LSN de las mediciones retenidas
+};
+
+#endif //REORDEN_H
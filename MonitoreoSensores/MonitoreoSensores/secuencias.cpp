@@ -0,0 +1,53 @@
+/**
+ * @file secuencias.cpp
+ * @autores Juan Pablo Hernández Ceballos
+ * Implementa la clasificación de mediciones por número de secuencia.
+ */
+
+#include "secuencias.h"
+
+/**
+ * Registra la secuencia de una medición y la clasifica.
+ *
+ * @param sensor Identificador del sensor.
+ * @param secuencia Número de secuencia de la medición (desde 1).
+ * @param perdidas Recibe cuántas secuencias salieron de la ventana sin haber llegado.
+ * @return Clasificación de la medición.
+ */
+SeguimientoSecuencias::Resultado SeguimientoSecuencias::registrar(uint32_t sensor, uint32_t secuencia,
+                                                                  uint64_t& perdidas) {
+    perdidas = 0;
+    Estado& estado = sensores[sensor];
+    if (estado.ultima == 0 || (secuencia == 1 && estado.ultima > 1)) { // Primera medición o nueva ejecución
+        Resultado resultado = estado.ultima == 0 ? NUEVA : REINICIO;
+        estado.ultima = secuencia;
+        estado.ventana = ~0ull; // No hay historia anterior que reclamar
+        return resultado;
+    }
+
+    if (secuencia > estado.ultima) {
+        uint64_t avance = secuencia - estado.ultima;
+        if (avance >= VENTANA_SECUENCIAS) {
+            // Sale toda la ventana, más las secuencias saltadas que nunca entraron en ella
+            perdidas = VENTANA_SECUENCIAS - __builtin_popcountll(estado.ventana) + (avance - VENTANA_SECUENCIAS);
+            estado.ventana = 1;
+        } else {
+            uint64_t salientes = estado.ventana >> (VENTANA_SECUENCIAS - avance);
+            perdidas = avance - __builtin_popcountll(salientes);
+            estado.ventana = (estado.ventana << avance) | 1;
+        }
+        estado.ultima = secuencia;
+        return NUEVA;
+    }
+
+    uint32_t atraso = estado.ultima - secuencia;
+    if (atraso >= VENTANA_SECUENCIAS) {
+        return REORDENADA; // Llegó tan tarde que ya se había contado como perdida
+    }
+    uint64_t bit = 1ull << atraso;
+    if (estado.ventana & bit) {
+        return DUPLICADA;
+    }
+    estado.ventana |= bit;
+    return REORDENADA;
+}
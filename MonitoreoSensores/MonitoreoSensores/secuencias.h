@@ -0,0 +1,44 @@
+/**
+ * @file secuencias.h
+ * @autores Juan Pablo Hernández Ceballos
+ * Seguimiento de los números de secuencia de cada sensor para detectar pérdidas, duplicados y
+ * llegadas fuera de orden.
+ *
+ * Por sensor se guarda la secuencia más alta recibida y una ventana de 64 bits con las últimas 64
+ * secuencias (bit i = se recibió `ultima - i`). Cada medición se clasifica en O(1) con un
+ * desplazamiento y una prueba de bit. Una secuencia que sale de la ventana sin haber llegado se cuenta
+ * como perdida. La secuencia 1 marca el inicio de una nueva ejecución del sensor.
+ */
+
+#ifndef SECUENCIAS_H
+#define SECUENCIAS_H
+
+#include <cstdint>
+#include <unordered_map>
+
+const uint32_t VENTANA_SECUENCIAS = 64;  ///< Secuencias recordadas por sensor
+
+class SeguimientoSecuencias {
+public:
+    /**
+     * Clasificación de una medición según su número de secuencia.
+     */
+    enum Resultado {
+        NUEVA,       ///< Secuencia mayor que todas las anteriores
+        REORDENADA,  ///< Secuencia atrasada que aún no había llegado
+        DUPLICADA,   ///< Secuencia que ya había llegado
+        REINICIO     ///< Secuencia 1 tras otras: el sensor volvió a empezar
+    };
+
+    Resultado registrar(uint32_t sensor, uint32_t secuencia, uint64_t& perdidas);
+
+private:
+    struct Estado {
+        uint64_t ventana = 0;   ///< Bit i: se recibió la secuencia `ultima - i`
+        uint32_t ultima = 0;    ///< Secuencia más alta recibida (0 = ninguna)
+    };
+
+    std::unordered_map<uint32_t, Estado> sensores;  ///< Estado por identificador de sensor
+};
+
+#endif //SECUENCIAS_H
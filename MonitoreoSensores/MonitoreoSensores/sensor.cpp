@@ -1,5 +1,7 @@
 #include <iostream>
 #include <fstream>
+#include <chrono>
+#include <string>
 #include <unistd.h>
 #include <sys/stat.h>
 #include <fcntl.h>
@@ -11,9 +13,10 @@ int main(int argc, char *argv[]) {
     int intervaloTiempo = 0;
     char* archivoDatosNombre = nullptr;
     char* pipeNombre = nullptr;
+    int idSensor = -1;
 
     // Procesamiento de argumentos de línea de comandos usando getopt
-    while ((opcion = getopt(argc, argv, "s:t:f:p:")) != -1) {
+    while ((opcion = getopt(argc, argv, "s:t:f:p:n:")) != -1) {
         switch (opcion) {
             case 's':
                 // Asigna el tipo de sensor basado en el argumento
@@ -31,9 +34,13 @@ int main(int argc, char *argv[]) {
                 // Asigna el nombre del pipe basado en el argumento
                 pipeNombre = optarg;
                 break;
+            case 'n':
+                // Asigna el identificador del sensor basado en el argumento
+                idSensor = atoi(optarg);
+                break;
             default:
                 // Muestra el uso correcto del programa en caso de argumentos incorrectos
-                std::cerr << "Uso: " << argv[0] << " -s tipoSensor -t intervaloTiempo -f archivoDatosNombre -p pipeNombre" << std::endl;
+                std::cerr << "Uso: " << argv[0] << " -s tipoSensor -t intervaloTiempo -f archivoDatosNombre -p pipeNombre [-n idSensor]" << std::endl;
                 return 1;
         }
     }
@@ -57,12 +64,25 @@ int main(int argc, char *argv[]) {
         }
     } while (pipeFd < 0);
 
+    // Sin identificador explícito, el sensor se identifica por su número de proceso, único en el equipo
+    // mientras se ejecuta (el tipo no basta: dos sensores del mismo tipo se confundirían en el monitor)
+    if (idSensor < 0) {
+        idSensor = static_cast<int>(getpid());
+        std::cerr << "Aviso: Sin -n, el sensor se identifica como " << idSensor << std::endl;
+    }
+
     // Lectura del archivo línea por línea y escritura en el pipe
     std::string linea;
     ssize_t bytesEscritos;
+    uint32_t secuencia = 0; // Número de secuencia de la última medición enviada
     while (std::getline(archivoDatos, linea)) {
-        // Escribe la línea leída en el pipe
-        bytesEscritos = write(pipeFd, linea.c_str(), linea.size() + 1);
+        // Escribe la línea leída en el pipe con la identidad del sensor y la hora de la medición en
+        // milisegundos: sensor:secuencia@evento:valor
+        long long evento = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        std::string medicion = std::to_string(idSensor) + ":" + std::to_string(++secuencia) + "@" +
+                               std::to_string(evento) + ":" + linea;
+        bytesEscritos = write(pipeFd, medicion.c_str(), medicion.size() + 1);
         if (bytesEscritos == -1) {
             // Muestra un mensaje de error si falla la escritura en el pipe y cierra los recursos
             std::cerr << "Error: Falló la escritura en el pipe" << std::endl;
@@ -0,0 +1,75 @@
+/**
+ * @file socket_unix.cpp
+ * @autores Juan Pablo Hernández Ceballos
+ * Implementa las funciones auxiliares de sockets Unix.
+ */
+
+#include "socket_unix.h"
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/**
+ * Crea un socket Unix de flujo escuchando en la ruta indicada. Si ya existe un socket en esa
+ * ruta (de una ejecución anterior) se reemplaza; si existe cualquier otro tipo de archivo, no se toca
+ * y la función falla.
+ *
+ * @param ruta Ruta del socket.
+ * @return Descriptor del socket, o -1 si hubo un error.
+ */
+int escucharUnix(const std::string& ruta) {
+    struct sockaddr_un direccion;
+    memset(&direccion, 0, sizeof(direccion));
+    direccion.sun_family = AF_UNIX;
+    if (ruta.size() >= sizeof(direccion.sun_path)) {
+        std::cerr << "Error: Ruta de socket demasiado larga: " << ruta << std::endl;
+        return -1;
+    }
+    strncpy(direccion.sun_path, ruta.c_str(), sizeof(direccion.sun_path) - 1);
+
+    struct stat existente;
+    if (lstat(ruta.c_str(), &existente) == 0) {
+        if (!S_ISSOCK(existente.st_mode)) {
+            std::cerr << "Error: La ruta del socket ya existe y no es un socket: " << ruta << std::endl;
+            return -1;
+        }
+        unlink(ruta.c_str()); // Eliminar un socket abandonado
+    } else if (errno != ENOENT) {
+        std::cerr << "Error: No se pudo revisar la ruta del socket: " << ruta << ": " << strerror(errno) << std::endl;
+        return -1;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        std::cerr << "Error: No se pudo crear el socket: " << ruta << std::endl;
+        return -1;
+    }
+    if (bind(fd, reinterpret_cast<struct sockaddr*>(&direccion), sizeof(direccion)) < 0 || listen(fd, 16) < 0) {
+        std::cerr << "Error: No se pudo escuchar en el socket: " << ruta << std::endl;
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * Envía todo el bloque por el socket, reintentando si send() envía solo una parte.
+ *
+ * @return false si la conexión se cerró o hubo un error.
+ */
+bool enviarTodo(int fd, const char* datos, size_t largo) {
+    while (largo > 0) {
+        ssize_t enviados = send(fd, datos, largo, MSG_NOSIGNAL);
+        if (enviados <= 0) {
+            return false;
+        }
+        datos += enviados;
+        largo -= enviados;
+    }
+    return true;
+}
@@ -0,0 +1,16 @@
+/**
+ * @file socket_unix.h
+ * @autores Juan Pablo Hernández Ceballos
+ * Funciones auxiliares para los sockets Unix por los que el monitor atiende a procesos locales.
+ */
+
+#ifndef SOCKET_UNIX_H
+#define SOCKET_UNIX_H
+
+#include <cstddef>
+#include <string>
+
+int escucharUnix(const std::string& ruta);
+bool enviarTodo(int fd, const char* datos, size_t largo);
+
+#endif //SOCKET_UNIX_H
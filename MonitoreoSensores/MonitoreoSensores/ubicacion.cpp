@@ -0,0 +1,367 @@
+/**
+ * @file ubicacion.cpp
+ * @autores Juan Pablo Hernández Ceballos
+ * Implementa la lectura de la topología, el plan de ubicación de los hilos y la fijación de afinidad.
+ */
+
+#include "ubicacion.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fstream>
+#include <iostream>
+#include <sched.h>
+#include <set>
+#include <sstream>
+
+const char* const RUTA_CPUS = "/sys/devices/system/cpu/cpu";  ///< Prefijo de la topología de cada CPU
+const char* const CLAVE_RECOLECTOR = "recolector";             ///< Clave de los recolectores en la configuración
+const char* const CLAVE_PERSISTENCIA = "persistencia";         ///< Clave del hilo de persistencia en la configuración
+const char* const CLAVE_CONSUMIDOR[NUM_CANALES] = {"pH", "temperatura"};  ///< Clave del consumidor de cada canal
+
+// Lee la primera línea de un archivo de sysfs.
+static bool leerTexto(const std::string& ruta, std::string& texto) {
+    std::ifstream archivo(ruta);
+    return static_cast<bool>(std::getline(archivo, texto));
+}
+
+// Lee un entero de un archivo de sysfs; si no existe, deja el valor como estaba.
+static bool leerEntero(const std::string& ruta, int& valor) {
+    std::ifstream archivo(ruta);
+    return static_cast<bool>(archivo >> valor);
+}
+
+// Menor CPU de una lista de sysfs como `0-3,8-11`, o -1 si no se pudo leer.
+static int menorCpu(const std::string& ruta) {
+    std::string texto;
+    std::vector<int> cpus;
+    if (!leerTexto(ruta, texto) || !leerCpus(texto, cpus)) {
+        return -1;
+    }
+    return *std::min_element(cpus.begin(), cpus.end());
+}
+
+// Nodo NUMA de una CPU: su directorio en sysfs contiene un enlace `nodeN`. Sin NUMA, nodo 0.
+static int nodoDeCpu(const std::string& base) {
+    int nodo = 0;
+    DIR* directorio = opendir(base.c_str());
+    if (directorio == nullptr) {
+        return nodo;
+    }
+    while (struct dirent* entrada = readdir(directorio)) {
+        if (strncmp(entrada->d_name, "node", 4) == 0 && entrada->d_name[4] >= '0' && entrada->d_name[4] <= '9') {
+            nodo = atoi(entrada->d_name + 4);
+            break;
+        }
+    }
+    closedir(directorio);
+    return nodo;
+}
+
+/**
+ * Lee la ubicación de cada CPU permitida al proceso. Si sysfs no está disponible, las CPUs quedan en un
+ * único nodo, socket y dominio L3, cada una en su propio núcleo.
+ *
+ * @return false si no se pudo consultar la afinidad del proceso.
+ */
+bool Topologia::cargar() {
+    lista.clear();
+    cpu_set_t permitidas;
+    if (sched_getaffinity(0, sizeof(permitidas), &permitidas) < 0) {
+        return false;
+    }
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        if (!CPU_ISSET(cpu, &permitidas)) {
+            continue;
+        }
+        CpuTopologia info;
+        info.cpu = cpu;
+        info.nucleo = cpu;
+        std::string base = RUTA_CPUS + std::to_string(cpu);
+        leerEntero(base + "/topology/physical_package_id", info.paquete);
+        leerEntero(base + "/topology/core_id", info.nucleo);
+        info.nodo = nodoDeCpu(base);
+        info.dominioL3 = -1;
+        int nivel;
+        for (int i = 0; leerEntero(base + "/cache/index" + std::to_string(i) + "/level", nivel); ++i) {
+            if (nivel == 3) {
+                info.dominioL3 = menorCpu(base + "/cache/index" + std::to_string(i) + "/shared_cpu_list");
+            }
+        }
+        if (info.dominioL3 < 0) { // Sin L3 conocida, el dominio es el socket
+            info.dominioL3 = menorCpu(base + "/topology/core_siblings_list");
+        }
+        if (info.dominioL3 < 0) {
+            info.dominioL3 = 0;
+        }
+        lista.push_back(info);
+    }
+    return !lista.empty();
+}
+
+const std::vector<CpuTopologia>& Topologia::cpus() const {
+    return lista;
+}
+
+// Busca una CPU permitida; nullptr si la CPU no existe o el proceso no puede usarla.
+const CpuTopologia* Topologia::buscar(int cpu) const {
+    for (const CpuTopologia& info : lista) {
+        if (info.cpu == cpu) {
+            return &info;
+        }
+    }
+    return nullptr;
+}
+
+int Topologia::nodos() const {
+    std::set<int> distintos;
+    for (const CpuTopologia& info : lista) {
+        distintos.insert(info.nodo);
+    }
+    return static_cast<int>(distintos.size());
+}
+
+int Topologia::dominiosL3() const {
+    std::set<int> distintos;
+    for (const CpuTopologia& info : lista) {
+        distintos.insert(info.dominioL3);
+    }
+    return static_cast<int>(distintos.size());
+}
+
+// Dominio L3 con más CPUs permitidas (el de menor número si hay empate).
+int Topologia::dominioMayor() const {
+    int mayor = 0;
+    size_t cantidadMayor = 0;
+    for (const CpuTopologia& info : lista) {
+        size_t cantidad = std::count_if(lista.begin(), lista.end(),
+                                        [&info](const CpuTopologia& otra) { return otra.dominioL3 == info.dominioL3; });
+        if (cantidad > cantidadMayor) {
+            mayor = info.dominioL3;
+            cantidadMayor = cantidad;
+        }
+    }
+    return mayor;
+}
+
+/**
+ * CPUs de un dominio L3, primero una por núcleo físico y después sus hermanas de SMT. Así los primeros
+ * hilos que se ubican no comparten núcleo.
+ *
+ * @param dominioL3 Dominio a recorrer.
+ * @return CPUs del dominio en orden de preferencia.
+ */
+std::vector<int> Topologia::cpusDeDominio(int dominioL3) const {
+    std::vector<int> primeras, hermanas;
+    std::set<std::pair<int, int>> nucleos;  // (socket, núcleo) ya usados
+    for (const CpuTopologia& info : lista) {
+        if (info.dominioL3 != dominioL3) {
+            continue;
+        }
+        if (nucleos.insert({info.paquete, info.nucleo}).second) {
+            primeras.push_back(info.cpu);
+        } else {
+            hermanas.push_back(info.cpu);
+        }
+    }
+    primeras.insert(primeras.end(), hermanas.begin(), hermanas.end());
+    return primeras;
+}
+
+/**
+ * Interpreta una lista de CPUs como `0,2-3`.
+ *
+ * @param texto Lista de CPUs.
+ * @param cpus Vector donde se agregan las CPUs leídas.
+ * @return true si la lista es válida.
+ */
+bool leerCpus(const std::string& texto, std::vector<int>& cpus) {
+    std::stringstream partes(texto);
+    std::string parte;
+    while (std::getline(partes, parte, ',')) {
+        int desde, hasta;
+        char guion;
+        std::stringstream rango(parte);
+        if (!(rango >> desde)) {
+            return false;
+        }
+        hasta = desde;
+        if (rango >> guion && (guion != '-' || !(rango >> hasta))) {
+            return false;
+        }
+        for (int cpu = desde; cpu <= hasta; ++cpu) {
+            cpus.push_back(cpu);
+        }
+    }
+    return !cpus.empty();
+}
+
+// Escribe una lista de números agrupando los consecutivos, como `0,2-3`.
+static std::string formatearLista(std::vector<int> numeros) {
+    std::sort(numeros.begin(), numeros.end());
+    numeros.erase(std::unique(numeros.begin(), numeros.end()), numeros.end());
+    std::string texto;
+    for (size_t i = 0; i < numeros.size();) {
+        size_t j = i;
+        while (j + 1 < numeros.size() && numeros[j + 1] == numeros[j] + 1) {
+            j++;
+        }
+        texto += (texto.empty() ? "" : ",") + std::to_string(numeros[i]);
+        if (j > i) {
+            texto += "-" + std::to_string(numeros[j]);
+        }
+        i = j + 1;
+    }
+    return texto;
+}
+
+/**
+ * Describe dónde corre un hilo, por ejemplo `CPU 2 (nodo 0, L3 0)`.
+ *
+ * @param cpus CPUs asignadas al hilo (vacío = sin fijar).
+ * @param topologia Topología de la máquina.
+ * @return Texto legible.
+ */
+std::string describirCpus(const std::vector<int>& cpus, const Topologia& topologia) {
+    if (cpus.empty()) {
+        return "sin fijar";
+    }
+    std::vector<int> nodos, dominios;
+    for (int cpu : cpus) {
+        if (const CpuTopologia* info = topologia.buscar(cpu)) {
+            nodos.push_back(info->nodo);
+            dominios.push_back(info->dominioL3);
+        }
+    }
+    return (cpus.size() == 1 ? "CPU " : "CPUs ") + formatearLista(cpus) + " (nodo " + formatearLista(nodos) +
+           ", L3 " + formatearLista(dominios) + ")";
+}
+
+/**
+ * Arma el plan de ubicación de los hilos del monitor.
+ *
+ * Con `auto`, todos los hilos van al dominio L3 con más CPUs permitidas: primero los consumidores, luego
+ * los recolectores y al final el de persistencia, uno por CPU y repartidos por núcleos físicos antes de
+ * usar las hermanas de SMT; si hay más hilos que CPUs, se vuelve a empezar. Si no, la configuración es
+ * una lista de `clave=cpus` separadas por `:`, con las claves `recolector`, `pH`, `temperatura` y
+ * `persistencia`, por ejemplo
+ * `recolector=0,2:pH=1:temperatura=3`. Con varios recolectores y varias CPUs, cada recolector se fija a
+ * una CPU de la lista; los hilos sin clave quedan sin fijar.
+ *
+ * @param config Configuración de ubicación.
+ * @param topologia Topología de la máquina.
+ * @param recolectores Cantidad de recolectores.
+ * @param ubicacion Plan resultante.
+ * @return false si la configuración no es válida o nombra CPUs no permitidas.
+ */
+bool planificarUbicacion(const std::string& config, const Topologia& topologia, int recolectores, Ubicacion& ubicacion) {
+    ubicacion.recolectores.assign(recolectores, std::vector<int>());
+    for (std::vector<int>& cpus : ubicacion.consumidores) {
+        cpus.clear();
+    }
+    ubicacion.persistencia.clear();
+    if (config == "auto") {
+        std::vector<int> cpus = topologia.cpusDeDominio(topologia.dominioMayor());
+        if (cpus.empty()) {
+            std::cerr << "Error: no se encontraron CPUs para ubicar los hilos" << std::endl;
+            return false;
+        }
+        size_t siguiente = 0;
+        for (std::vector<int>& consumidor : ubicacion.consumidores) {
+            consumidor.assign(1, cpus[siguiente++ % cpus.size()]);
+        }
+        for (std::vector<int>& recolector : ubicacion.recolectores) {
+            recolector.assign(1, cpus[siguiente++ % cpus.size()]);
+        }
+        ubicacion.persistencia.assign(1, cpus[siguiente % cpus.size()]);
+        return true;
+    }
+
+    std::stringstream entradas(config);
+    std::string entrada;
+    while (std::getline(entradas, entrada, ':')) {
+        size_t igual = entrada.find('=');
+        std::string clave = entrada.substr(0, igual);
+        std::vector<int> cpus;
+        if (igual == std::string::npos || !leerCpus(entrada.substr(igual + 1), cpus)) {
+            std::cerr << "Error: ubicación inválida: " << entrada << std::endl;
+            return false;
+        }
+        for (int cpu : cpus) {
+            if (topologia.buscar(cpu) == nullptr) {
+                std::cerr << "Error: la CPU " << cpu << " no existe o no está permitida al monitor" << std::endl;
+                return false;
+            }
+        }
+        if (clave == CLAVE_RECOLECTOR) {
+            for (int i = 0; i < recolectores; ++i) {
+                ubicacion.recolectores[i] = recolectores > 1 && cpus.size() > 1 ? std::vector<int>(1, cpus[i % cpus.size()]) : cpus;
+            }
+            continue;
+        }
+        if (clave == CLAVE_PERSISTENCIA) {
+            ubicacion.persistencia = cpus;
+            continue;
+        }
+        int c = 0;
+        while (c < NUM_CANALES && clave != CLAVE_CONSUMIDOR[c]) {
+            c++;
+        }
+        if (c == NUM_CANALES) {
+            std::cerr << "Error: hilo desconocido en la ubicación: " << clave << std::endl;
+            return false;
+        }
+        ubicacion.consumidores[c] = cpus;
+    }
+    return true;
+}
+
+/**
+ * Fija la afinidad del hilo que llama. Con una lista vacía no hace nada.
+ *
+ * @param cpus CPUs permitidas al hilo.
+ * @return false si el sistema rechazó la afinidad.
+ */
+bool fijarAfinidad(const std::vector<int>& cpus) {
+    if (cpus.empty()) {
+        return true;
+    }
+    cpu_set_t conjunto;
+    CPU_ZERO(&conjunto);
+    for (int cpu : cpus) {
+        CPU_SET(cpu, &conjunto);
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(conjunto), &conjunto) == 0;
+}
+
+/**
+ * Crea un hilo que nace ya fijado a sus CPUs, sin pasar antes por otras. Si el sistema rechaza la
+ * afinidad, avisa y lo crea sin fijar.
+ *
+ * @param hilo Identificador del hilo creado.
+ * @param rutina Función del hilo.
+ * @param arg Argumento de la función.
+ * @param cpus CPUs permitidas al hilo (vacío = sin fijar).
+ * @return true si el hilo se creó.
+ */
+bool crearHilo(pthread_t* hilo, void* (*rutina)(void*), void* arg, const std::vector<int>& cpus) {
+    pthread_attr_t atributos;
+    pthread_attr_init(&atributos);
+    if (!cpus.empty()) {
+        cpu_set_t conjunto;
+        CPU_ZERO(&conjunto);
+        for (int cpu : cpus) {
+            CPU_SET(cpu, &conjunto);
+        }
+        pthread_attr_setaffinity_np(&atributos, sizeof(conjunto), &conjunto);
+    }
+    int error = pthread_create(hilo, &atributos, rutina, arg);
+    pthread_attr_destroy(&atributos);
+    if (error != 0 && !cpus.empty()) {
+        std::cerr << "Error: No se pudo fijar la afinidad de un hilo: " << strerror(error) << "; se crea sin fijar" << std::endl;
+        error = pthread_create(hilo, NULL, rutina, arg);
+    }
+    return error == 0;
+}
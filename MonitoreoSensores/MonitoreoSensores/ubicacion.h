@@ -0,0 +1,64 @@
+/**
+ * @file ubicacion.h
+ * @autores Juan Pablo Hernández Ceballos
+ * Ubicación de los hilos del monitor en la topología de la máquina (nodos NUMA, cachés L3 y núcleos).
+ *
+ * La topología se lee de /sys/devices/system/cpu y se limita a las CPUs permitidas al proceso. Los
+ * recolectores y los consumidores comparten los buffers, así que conviene que corran dentro de un
+ * mismo dominio L3 (y por lo tanto de un mismo nodo NUMA): las líneas de caché de los buffers viajan
+ * entonces por la L3 compartida y no entre sockets.
+ */
+
+#ifndef UBICACION_H
+#define UBICACION_H
+
+#include <pthread.h>
+#include <string>
+#include <vector>
+#include "lectura.h"
+
+/**
+ * Posición de una CPU en la topología.
+ */
+struct CpuTopologia {
+    int cpu = 0;        ///< Número de la CPU
+    int nodo = 0;       ///< Nodo NUMA
+    int paquete = 0;    ///< Socket físico
+    int nucleo = 0;     ///< Núcleo dentro del socket (las CPU hermanas de SMT comparten núcleo)
+    int dominioL3 = 0;  ///< Menor CPU que comparte la caché L3 con esta (el socket si no hay L3)
+};
+
+/**
+ * CPUs permitidas al proceso y su ubicación en nodos, dominios L3 y núcleos.
+ */
+class Topologia {
+public:
+    bool cargar();
+
+    const std::vector<CpuTopologia>& cpus() const;
+    const CpuTopologia* buscar(int cpu) const;
+    int nodos() const;
+    int dominiosL3() const;
+    int dominioMayor() const;
+    std::vector<int> cpusDeDominio(int dominioL3) const;
+
+private:
+    std::vector<CpuTopologia> lista;  ///< CPUs permitidas, en orden creciente
+};
+
+/**
+ * CPUs asignadas a cada hilo del monitor. Una lista vacía deja al hilo sin fijar.
+ */
+struct Ubicacion {
+    std::vector<std::vector<int>> recolectores;  ///< CPUs de cada recolector
+    std::vector<int> consumidores[NUM_CANALES];  ///< CPUs del consumidor de cada canal
+    std::vector<int> persistencia;               ///< CPUs del hilo que escribe los archivos de salida
+};
+
+bool leerCpus(const std::string& texto, std::vector<int>& cpus);
+std::string describirCpus(const std::vector<int>& cpus, const Topologia& topologia);
+bool planificarUbicacion(const std::string& config, const Topologia& topologia, int recolectores, Ubicacion& ubicacion);
+bool fijarAfinidad(const std::vector<int>& cpus);
+bool crearHilo(pthread_t* hilo, void* (*rutina)(void*), void* arg, const std::vector<int>& cpus);
+
+#endif //UBICACION_H
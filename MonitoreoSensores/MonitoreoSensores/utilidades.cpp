@@ -0,0 +1,215 @@
+/**
+ * @file utilidades.cpp
+ * @autores Juan Pablo Hernández Ceballos
+ * Funciones auxiliares de formato de hora y validación de mediciones compartidas por el monitor
+ * y el banco de pruebas de rendimiento.
+ */
+
+#include "utilidades.h"
+
+#include <cstdlib>
+#include <string>
+
+/**
+ * Convierte una hora en segundos desde el epoch al formato HH:MM:SS.
+ * 
+ * @param currentTime La hora a convertir.
+ * @return Una cadena que representa la hora indicada.
+ */
+std::string formatearHora(std::time_t currentTime) {
+    std::tm* localTime = std::localtime(&currentTime); // Convertir la hora en una estructura de tiempo local
+    char timeString[100]; // Buffer para almacenar la hora formateada como cadena
+    std::strftime(timeString, sizeof(timeString), "%H:%M:%S", localTime); // Formatear la hora en formato HH:MM:SS
+    return std::string(timeString); // Devolver la hora formateada como una cadena
+}
+
+/**
+ * Obtiene la hora actual en formato HH:MM:SS.
+ * 
+ * @return Una cadena que representa la hora actual.
+ */
+std::string getCurrentTime() {
+    return formatearHora(std::time(nullptr)); // Obtener la hora actual en segundos desde el epoch y formatearla
+}
+
+/**
+ * Formatea un instante como HH:MM:SS sin reservar memoria.
+ *
+ * Cada hilo guarda el último segundo formateado y solo vuelve a formatear cuando cambia, de modo que
+ * escribir muchas mediciones del mismo segundo no llama a localtime ni crea cadenas.
+ *
+ * @param instante Segundos desde el epoch.
+ * @return La hora; el texto es del hilo que llama y se sobrescribe al formatear otro segundo.
+ */
+const char* horaDe(std::time_t instante) {
+    thread_local std::time_t ultima = -1; // Segundo de la hora guardada
+    thread_local char hora[16]; // Hora formateada de ese segundo
+    if (instante != ultima) {
+        std::tm local;
+        localtime_r(&instante, &local); // Sin el estado compartido de localtime
+        std::strftime(hora, sizeof(hora), "%H:%M:%S", &local);
+        ultima = instante;
+    }
+    return hora;
+}
+
+/**
+ * Ruta de un archivo auxiliar junto a la salida de un canal: la ruta seguida de una extensión
+ * (`pH-data.txt.1m`, o `pH-data.1m` para el directorio `pH-data/`).
+ *
+ * @param ruta Archivo de salida del canal, o directorio de sus segmentos.
+ * @param extension Extensión sin el punto.
+ */
+std::string rutaJunto(const std::string& ruta, const char* extension) {
+    std::string base = ruta;
+    while (base.size() > 1 && base.back() == '/') {
+        base.pop_back(); // El directorio de los segmentos, sin la barra final
+    }
+    return base + "." + extension;
+}
+
+/**
+ * Obtiene la hora actual en formato HH:MM:SS sin reservar memoria.
+ * 
+ * Cada hilo guarda la última hora formateada y solo la vuelve a formatear cuando cambia el segundo,
+ * de modo que escribir muchas mediciones por segundo no llama a localtime ni crea cadenas.
+ * 
+ * @return La hora actual; el texto es del hilo que llama y se sobrescribe en el siguiente segundo.
+ */
+const char* horaActual() {
+    return horaDe(std::time(nullptr));
+}
+
+/**
+ * Verifica si una cadena representa un número flotante.
+ * 
+ * @param str La cadena que se va a verificar.
+ * @return true si la cadena representa un número flotante, false en caso contrario.
+ */
+bool is_float(const std::string& str) {
+    try {
+        std::size_t pos; // Variable para almacenar la posición del primer carácter no convertido
+        std::stof(str, &pos); // Convertir la cadena a flotante
+        // Tiene éxito si no hay caracteres restantes en la cadena
+        return pos == str.size(); // Devolver true si no hay caracteres restantes, indicando que la conversión fue exitosa
+    } catch (...) {
+        return false; // Capturar cualquier excepción y devolver false si ocurre un error durante la conversión
+    }
+}
+
+/**
+ * Verifica si una cadena representa un número entero.
+ * 
+ * @param str La cadena que se va a verificar.
+ * @return true si la cadena representa un número entero, false en caso contrario.
+ */
+bool is_integer(const std::string& str) {
+    try {
+        std::size_t pos; // Variable para almacenar la posición del primer carácter no convertido
+        std::stoi(str, &pos); // Convertir la cadena a entero
+        // La conversión tiene éxito si no hay caracteres restantes en la cadena
+        return pos == str.size(); // Devolver true si no hay caracteres restantes, indicando que la conversión fue exitosa
+    } catch (...) {
+        return false; // Capturar cualquier excepción y devolver false si ocurre un error durante la conversión
+    }
+}
+
+/**
+ * Separa una medición con identidad, de la forma `sensor:secuencia:valor` o `sensor:secuencia@evento:valor`.
+ * 
+ * @param linea Medición tal como llegó del sensor.
+ * @param sensor Recibe el identificador del sensor.
+ * @param secuencia Recibe el número de secuencia (desde 1).
+ * @param evento Recibe la hora de la fuente en milisegundos desde el epoch (0 si no la trae).
+ * @param valor Recibe el texto del valor.
+ * @return true si la medición trae identidad válida; false si no la trae o está mal formada.
+ */
+bool separarIdentidad(const std::string& linea, uint32_t& sensor, uint32_t& secuencia, int64_t& evento,
+                      std::string& valor) {
+    size_t primero = linea.find(':');
+    if (primero == std::string::npos) {
+        return false;
+    }
+    size_t segundo = linea.find(':', primero + 1);
+    if (segundo == std::string::npos || primero == 0 || segundo == primero + 1) {
+        return false;
+    }
+    char* fin;
+    unsigned long id = std::strtoul(linea.c_str(), &fin, 10);
+    if (fin != linea.c_str() + primero || id > UINT32_MAX) {
+        return false;
+    }
+    unsigned long numero = std::strtoul(linea.c_str() + primero + 1, &fin, 10);
+    if (numero == 0 || numero > UINT32_MAX) {
+        return false;
+    }
+    long long hora = 0;
+    if (*fin == '@' && fin + 1 != linea.c_str() + segundo) { // Hora de la fuente
+        hora = std::strtoll(fin + 1, &fin, 10);
+    }
+    if (fin != linea.c_str() + segundo || hora < 0) {
+        return false;
+    }
+    evento = hora;
+    sensor = static_cast<uint32_t>(id);
+    secuencia = static_cast<uint32_t>(numero);
+    valor = linea.substr(segundo + 1);
+    return true;
+}
+
+/**
+ * Interpreta un tamaño con sufijo opcional `K`, `M` o `G` (potencias de 1024), por ejemplo `64M`.
+ * 
+ * @param texto Tamaño a interpretar.
+ * @param bytes Recibe el tamaño en bytes.
+ * @return true si el texto es un tamaño mayor que cero.
+ */
+bool leerTamano(const std::string& texto, uint64_t& bytes) {
+    char* fin;
+    unsigned long long numero = std::strtoull(texto.c_str(), &fin, 10);
+    if (fin == texto.c_str() || numero == 0) {
+        return false;
+    }
+    int desplazamiento = 0;
+    switch (*fin) {
+        case '\0': break;
+        case 'K': case 'k': desplazamiento = 10; fin++; break;
+        case 'M': case 'm': desplazamiento = 20; fin++; break;
+        case 'G': case 'g': desplazamiento = 30; fin++; break;
+        default: return false;
+    }
+    if (*fin != '\0' || numero > (UINT64_MAX >> desplazamiento)) {
+        return false;
+    }
+    bytes = static_cast<uint64_t>(numero) << desplazamiento;
+    return true;
+}
+
+/**
+ * Interpreta una duración con sufijo `s`, `m`, `h` o `d` (segundos si no lo trae), por ejemplo `12h`.
+ * 
+ * @param texto Duración a interpretar.
+ * @param segundos Recibe la duración en segundos.
+ * @return true si el texto es una duración mayor que cero.
+ */
+bool leerDuracion(const std::string& texto, int64_t& segundos) {
+    char* fin;
+    long long numero = std::strtoll(texto.c_str(), &fin, 10);
+    if (fin == texto.c_str() || numero <= 0) {
+        return false;
+    }
+    int64_t unidad = 1;
+    switch (*fin) {
+        case '\0': break;
+        case 's': fin++; break;
+        case 'm': unidad = 60; fin++; break;
+        case 'h': unidad = 3600; fin++; break;
+        case 'd': unidad = 86400; fin++; break;
+        default: return false;
+    }
+    if (*fin != '\0' || numero > INT64_MAX / unidad) {
+        return false;
+    }
+    segundos = numero * unidad;
+    return true;
+}
@@ -0,0 +1,26 @@
+/**
+ * @file utilidades.h
+ * @autores Juan Pablo Hernández Ceballos
+ * Funciones auxiliares de formato de hora, validación de mediciones y lectura de opciones.
+ */
+
+#ifndef UTILIDADES_H
+#define UTILIDADES_H
+
+#include <cstdint>
+#include <ctime>
+#include <string>
+
+std::string formatearHora(std::time_t currentTime);
+std::string getCurrentTime();
+const char* horaActual();
+const char* horaDe(std::time_t instante);
+std::string rutaJunto(const std::string& ruta, const char* extension);
+bool is_float(const std::string& str);
+bool is_integer(const std::string& str);
+bool separarIdentidad(const std::string& linea, uint32_t& sensor, uint32_t& secuencia, int64_t& evento,
+                      std::string& valor);
+bool leerTamano(const std::string& texto, uint64_t& bytes);
+bool leerDuracion(const std::string& texto, int64_t& segundos);
+
+#endif //UTILIDADES_H
@@ -0,0 +1,530 @@
+/**
+ * @file wal.cpp
+ * @autores Juan Pablo Hernández Ceballos
+ * Implementa el registro de escritura anticipada (WAL) y sus puntos de control.
+ *
+ * @detalles
+ * El archivo comienza con un encabezado de 16 bytes (firma y LSN base) seguido de registros de tamaño
+ * fijo protegidos con CRC32, que guardan también la hora de la fuente y el número de secuencia que envió el
+ * sensor. Un registro incompleto o con CRC
+ * inválido al final del archivo se considera una escritura interrumpida y se descarta al abrir. Los puntos
+ * de control se guardan en un archivo de texto aparte que se reemplaza de forma atómica con rename().
+ *
+ * Cuando todos los registros están en los archivos de salida, el WAL se vacía truncándolo. Si algún canal
+ * aún necesita registros (por ejemplo, los que retiene para reordenarlos), los anteriores se descartan
+ * copiando el resto a un archivo nuevo, solo cuando son muchos y al menos la mitad del WAL, para que la
+ * copia no cueste más que lo que libera.
+ */
+
+#include "wal.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <unistd.h>
+
+namespace {
+
+const char FIRMA_WAL[8] = {'M', 'S', 'W', 'A', 'L', '0', '0', '3'};
+const char FIRMA_WAL_ANTERIOR[8] = {'M', 'S', 'W', 'A', 'L', '0', '0', '2'};  ///< Mismos registros, secuencia propia del WAL
+const size_t TAM_ENCABEZADO = 16;
+const size_t TAM_VALOR = 30;
+const uint64_t MIN_RECORTE_WAL = 16384;  ///< Registros descartables a partir de los cuales se recorta el WAL (1 MiB)
+
+// Registro tal como se guarda en el archivo (64 bytes).
+struct RegistroDisco {
+    uint64_t lsn;
+    int64_t recepcion;
+    uint32_t sensor;
+    uint32_t secuencia;
+    uint8_t canal;
+    uint8_t largo;
+    char valor[TAM_VALOR];
+    int32_t desfaseEvento;
+    uint32_t crc;
+};
+static_assert(sizeof(RegistroDisco) == 64, "El registro del WAL debe medir 64 bytes");
+
+// Calcula el CRC32 (polinomio 0xEDB88320) de un bloque de memoria.
+uint32_t crc32(const void* datos, size_t largo) {
+    static uint32_t tabla[256];
+    static bool iniciada = false;
+    if (!iniciada) {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            tabla[i] = c;
+        }
+        iniciada = true;
+    }
+    const unsigned char* p = static_cast<const unsigned char*>(datos);
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < largo; ++i) {
+        crc = tabla[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+// Escribe todo el bloque, reintentando si write() escribe solo una parte.
+bool escribirTodo(int fd, const char* datos, size_t largo) {
+    while (largo > 0) {
+        ssize_t escritos = write(fd, datos, largo);
+        if (escritos < 0) {
+            return false;
+        }
+        datos += escritos;
+        largo -= escritos;
+    }
+    return true;
+}
+
+} // namespace
+
+// Constructor del WAL. No toca el disco hasta que se llama a abrir().
+Wal::Wal(const std::string& ruta)
+    : ruta(ruta), rutaPuntos(ruta + ".ckpt"), rutaTemporal(rutaPuntos + ".tmp"), fd(-1), lsnBase(0),
+      siguienteLsn(1), durable(0), escribiendo(false), rondasFallidas(0) {
+    pthread_mutex_init(&mutexLote, NULL);
+    pthread_cond_init(&condLote, NULL);
+    pthread_mutex_init(&mutex, NULL);
+    for (int c = 0; c < NUM_CANALES; ++c) {
+        confirmado[c] = 0;
+        cubierto[c] = 0;
+    }
+}
+
+// Destructor del WAL. Cierra el archivo; los registros no confirmados se pierden.
+Wal::~Wal() {
+    if (fd >= 0) {
+        close(fd);
+    }
+    pthread_cond_destroy(&condLote);
+    pthread_mutex_destroy(&mutexLote);
+    pthread_mutex_destroy(&mutex);
+}
+
+/**
+ * Abre (o crea) el WAL, lee los registros válidos y carga los puntos de control.
+ *
+ * @return true si el WAL quedó listo para recibir registros.
+ */
+bool Wal::abrir() {
+    // Cargar los puntos de control existentes
+    std::ifstream archivoPuntos(rutaPuntos);
+    std::string tipo;
+    while (archivoPuntos >> tipo) {
+        if (tipo == "P") {
+            int canal;
+            Punto p;
+            std::string sumidero;
+            archivoPuntos >> canal >> p.punto.lsn >> p.punto.offset;
+            std::getline(archivoPuntos >> std::ws, sumidero);
+            p.canal = static_cast<Canal>(canal);
+            p.punto.existe = true;
+            puntos[sumidero] = p;
+            if (p.punto.lsn >= siguienteLsn) {
+                siguienteLsn = p.punto.lsn + 1;
+            }
+        } else if (tipo == "C") {
+            int canal;
+            Corte c;
+            archivoPuntos >> canal >> c.lsn >> c.marca;
+            c.existe = true;
+            if (canal >= 0 && canal < NUM_CANALES) {
+                cortes[canal] = c;
+            }
+        } else { // Incluye las líneas S de versiones anteriores, que ya no se usan
+            std::getline(archivoPuntos, tipo);
+        }
+    }
+
+    fd = open(ruta.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        std::cerr << "Error: No se pudo abrir el WAL: " << ruta << std::endl;
+        return false;
+    }
+
+    // Validar el encabezado o crear uno nuevo si el archivo está vacío
+    char encabezado[TAM_ENCABEZADO];
+    ssize_t leidos = pread(fd, encabezado, sizeof(encabezado), 0);
+    if (leidos == 0) {
+        lsnBase = siguienteLsn - 1;
+        durable = lsnBase;
+        return escribirEncabezado();
+    }
+    // El formato anterior numeraba las secuencias por su cuenta: sus registros pasan al actual sin secuencia
+    bool anterior = leidos == static_cast<ssize_t>(TAM_ENCABEZADO) &&
+                    memcmp(encabezado, FIRMA_WAL_ANTERIOR, sizeof(FIRMA_WAL_ANTERIOR)) == 0;
+    if (leidos != static_cast<ssize_t>(TAM_ENCABEZADO) ||
+        (!anterior && memcmp(encabezado, FIRMA_WAL, sizeof(FIRMA_WAL)) != 0)) {
+        if (leidos == static_cast<ssize_t>(TAM_ENCABEZADO) && memcmp(encabezado, FIRMA_WAL, 5) == 0) {
+            std::cerr << "Error: El WAL está en un formato que esta versión no admite: " << ruta << std::endl;
+        } else {
+            std::cerr << "Error: El archivo no es un WAL válido: " << ruta << std::endl;
+        }
+        return false;
+    }
+    memcpy(&lsnBase, encabezado + sizeof(FIRMA_WAL), sizeof(lsnBase));
+    if (lsnBase >= siguienteLsn) {
+        siguienteLsn = lsnBase + 1;
+    }
+
+    // Leer registros hasta el primero incompleto, corrupto o fuera de secuencia
+    off_t posicion = TAM_ENCABEZADO;
+    uint64_t esperado = lsnBase + 1;
+    RegistroDisco r;
+    while (pread(fd, &r, sizeof(r), posicion) == static_cast<ssize_t>(sizeof(r))) {
+        if (r.crc != crc32(&r, offsetof(RegistroDisco, crc)) || r.lsn != esperado || r.canal >= NUM_CANALES ||
+            r.largo > TAM_VALOR) {
+            break;
+        }
+        if (anterior) { // Sin la secuencia del WAL anterior, el registro vale igual en el formato actual
+            r.secuencia = 0;
+            r.crc = crc32(&r, offsetof(RegistroDisco, crc));
+            if (pwrite(fd, &r, sizeof(r), posicion) != static_cast<ssize_t>(sizeof(r))) {
+                std::cerr << "Error: No se pudo actualizar el formato del WAL: " << ruta << std::endl;
+                return false;
+            }
+        }
+        Registro registro{r.lsn, r.recepcion, r.recepcion * 1000 + r.desfaseEvento, r.sensor, r.secuencia,
+                          static_cast<Canal>(r.canal), std::string(r.valor, r.largo)};
+        recuperados.push_back(registro);
+        confirmado[r.canal] = r.lsn;
+        esperado++;
+        posicion += sizeof(r);
+    }
+    if (esperado > siguienteLsn) {
+        siguienteLsn = esperado;
+    }
+    durable = siguienteLsn - 1;
+
+    // Descartar la cola rota de una escritura interrumpida
+    if (anterior && !escribirEncabezado()) { // Los registros ya están en el formato actual
+        return false;
+    }
+    if (ftruncate(fd, posicion) < 0 || lseek(fd, posicion, SEEK_SET) < 0) {
+        std::cerr << "Error: No se pudo truncar el WAL: " << ruta << std::endl;
+        return false;
+    }
+    // Un vaciado interrumpido puede dejar un LSN base atrasado respecto a los puntos de control
+    if (recuperados.empty() && lsnBase != siguienteLsn - 1) {
+        lsnBase = siguienteLsn - 1;
+        return escribirEncabezado();
+    }
+    return true;
+}
+
+/**
+ * Registros válidos encontrados al abrir el WAL, en orden de LSN.
+ */
+const std::vector<Wal::Registro>& Wal::registros() const {
+    return recuperados;
+}
+
+/**
+ * Agrega un lote de mediciones a los registros pendientes, con LSN consecutivos que se anotan en cada
+ * medición. Los registros no son durables hasta confirmarlos. Varios hilos pueden agregar a la vez; el
+ * lote de cada uno queda contiguo.
+ *
+ * @param lote Mediciones y su canal; reciben su LSN.
+ * @return El LSN del último registro del lote.
+ */
+uint64_t Wal::agregar(std::vector<std::pair<Canal, Lectura>>& lote) {
+    RegistroDisco r;
+    memset(&r, 0, sizeof(r));
+    pthread_mutex_lock(&mutexLote);
+    for (auto& medicion : lote) {
+        const Lectura& lectura = medicion.second;
+        r.lsn = siguienteLsn++;
+        r.recepcion = lectura.recepcion;
+        r.sensor = lectura.sensor;
+        r.secuencia = lectura.secuencia;
+        r.canal = medicion.first;
+        r.largo = static_cast<uint8_t>(lectura.largoValor < TAM_VALOR ? lectura.largoValor : TAM_VALOR);
+        memset(r.valor, 0, sizeof(r.valor));
+        memcpy(r.valor, lectura.valor, r.largo);
+        r.desfaseEvento = lectura.desfaseEvento;
+        r.crc = crc32(&r, offsetof(RegistroDisco, crc));
+        const char* bytes = reinterpret_cast<const char*>(&r);
+        lotePendiente.insert(lotePendiente.end(), bytes, bytes + sizeof(r));
+        medicion.second.lsn = r.lsn;
+    }
+    uint64_t ultimo = siguienteLsn - 1;
+    pthread_mutex_unlock(&mutexLote);
+    return ultimo;
+}
+
+/**
+ * Espera a que sean durables los registros hasta `hasta` (confirmación en grupo). Si nadie está escribiendo,
+ * el hilo escribe todos los pendientes, los suyos y los que otros hilos agregaron mientras tanto, con una
+ * sola escritura y un solo fdatasync(); si no, espera el resultado de esa escritura y, si no alcanzó a
+ * incluir sus registros, escribe la siguiente. Así varios recolectores comparten cada sincronización.
+ * Si la escritura que llevaba sus registros falla, devuelve false a todos los que esperaban; los registros
+ * siguen pendientes con los mismos LSN, de modo que volver a llamar reintenta sin repetir ninguno.
+ *
+ * @param hasta LSN del último registro que debe quedar en disco.
+ * @return true si los registros quedaron en disco.
+ */
+bool Wal::confirmar(uint64_t hasta) {
+    pthread_mutex_lock(&mutexLote);
+    uint64_t fallidas = rondasFallidas;
+    while (durable < hasta) {
+        if (rondasFallidas != fallidas) {
+            pthread_mutex_unlock(&mutexLote);
+            return false;
+        }
+        if (escribiendo) {
+            pthread_cond_wait(&condLote, &mutexLote);
+            continue;
+        }
+        escribiendo = true; // Este hilo escribe lo pendiente de todos
+        loteEscritura.swap(lotePendiente);
+        uint64_t ultimo = durable;
+        pthread_mutex_unlock(&mutexLote);
+        bool escrito = escribirLote(ultimo);
+        pthread_mutex_lock(&mutexLote);
+        if (escrito) {
+            durable = ultimo + loteEscritura.size() / sizeof(RegistroDisco);
+        } else { // Vuelve adelante de lo que se agregó mientras tanto
+            lotePendiente.insert(lotePendiente.begin(), loteEscritura.begin(), loteEscritura.end());
+            rondasFallidas++;
+        }
+        loteEscritura.clear();
+        escribiendo = false;
+        pthread_cond_broadcast(&condLote);
+    }
+    pthread_mutex_unlock(&mutexLote);
+    return true;
+}
+
+/**
+ * LSN del último registro agregado (el último recuperado, o el del punto de control, si aún no se agrega
+ * ninguno).
+ */
+uint64_t Wal::ultimoAgregado() {
+    pthread_mutex_lock(&mutexLote);
+    uint64_t ultimo = siguienteLsn - 1;
+    pthread_mutex_unlock(&mutexLote);
+    return ultimo;
+}
+
+/**
+ * Escribe los registros de loteEscritura con una sola llamada a write() y los hace durables con
+ * fdatasync(). Si la escritura falla, el archivo vuelve al tamaño que tenía antes del lote. Si ni
+ * siquiera puede truncarse, el WAL queda inutilizable. La llama solo el hilo que escribe.
+ *
+ * @param ultimo Último LSN que ya está en el archivo.
+ * @return true si el lote quedó en disco.
+ */
+bool Wal::escribirLote(uint64_t ultimo) {
+    if (fd < 0) {
+        return false;
+    }
+    truncarSiAplicado(ultimo);
+    off_t tamano = lseek(fd, 0, SEEK_END); // Tamaño antes del lote
+    if (tamano < 0 || !escribirTodo(fd, loteEscritura.data(), loteEscritura.size()) || fdatasync(fd) < 0) {
+        std::cerr << "Error: Falló la escritura en el WAL: " << ruta << ": " << strerror(errno) << std::endl;
+        if (tamano < 0 || ftruncate(fd, tamano) < 0 || lseek(fd, tamano, SEEK_SET) < 0) {
+            std::cerr << "Error: No se pudo deshacer el lote en el WAL: " << ruta << std::endl;
+            close(fd); // Con registros a medias, ningún reintento es seguro
+            fd = -1;
+        }
+        return false;
+    }
+
+    pthread_mutex_lock(&mutex);
+    for (size_t i = 0; i < loteEscritura.size(); i += sizeof(RegistroDisco)) {
+        const RegistroDisco* r = reinterpret_cast<const RegistroDisco*>(loteEscritura.data() + i);
+        confirmado[r->canal] = r->lsn;
+    }
+    pthread_mutex_unlock(&mutex);
+    return true;
+}
+
+/**
+ * Devuelve el punto de control registrado para un archivo de salida.
+ */
+Wal::PuntoControl Wal::puntoControl(const std::string& sumidero) {
+    pthread_mutex_lock(&mutex);
+    PuntoControl p;
+    auto it = puntos.find(sumidero);
+    if (it != puntos.end()) {
+        p = it->second.punto;
+    }
+    pthread_mutex_unlock(&mutex);
+    return p;
+}
+
+/**
+ * Registra que el archivo de salida contiene todos los registros del canal hasta `lsn` y que en ese
+ * momento medía `offset` bytes. El archivo debe haberse vaciado (flush) antes de llamar a esta función.
+ *
+ * @return true si el punto de control quedó guardado.
+ */
+bool Wal::registrarPunto(Canal canal, const std::string& sumidero, uint64_t lsn, uint64_t offset) {
+    pthread_mutex_lock(&mutex);
+    Punto& p = puntos[sumidero];
+    p.canal = canal;
+    p.punto.lsn = lsn;
+    p.punto.offset = offset;
+    p.punto.existe = true;
+    bool ok = guardarPuntos();
+    pthread_mutex_unlock(&mutex);
+    return ok;
+}
+
+/**
+ * Devuelve el último corte registrado de un canal.
+ */
+Wal::Corte Wal::corte(Canal canal) {
+    pthread_mutex_lock(&mutex);
+    Corte c = cortes[canal];
+    pthread_mutex_unlock(&mutex);
+    return c;
+}
+
+/**
+ * Registra de una sola vez el punto de control de varios archivos de un canal y su corte nuevo. Cada archivo
+ * queda en `nuevo.lsn` con su tamaño actual; deben haberse vaciado antes de llamar a esta función. Como se
+ * guardan juntos, una caída nunca deja un corte que cubra bytes que ningún punto de control registró.
+ *
+ * @param canal Canal de los archivos.
+ * @param archivos Ruta y tamaño de cada archivo con mediciones desde su último punto de control.
+ * @param nuevo Corte del canal.
+ * @param retenido LSN más bajo que el canal aún retiene (UINT64_MAX si no retiene ninguno).
+ * @return true si los puntos de control quedaron guardados.
+ */
+bool Wal::registrarCorte(Canal canal, const std::vector<std::pair<std::string, uint64_t>>& archivos,
+                         const Corte& nuevo, uint64_t retenido) {
+    pthread_mutex_lock(&mutex);
+    for (const auto& archivo : archivos) {
+        Punto& p = puntos[archivo.first];
+        p.canal = canal;
+        p.punto.lsn = nuevo.lsn;
+        p.punto.offset = archivo.second;
+        p.punto.existe = true;
+    }
+    cortes[canal] = nuevo;
+    cortes[canal].existe = true;
+    bool ok = guardarPuntos();
+    if (ok) { // Lo retenido sigue haciendo falta aunque esté bajo el corte
+        cubierto[canal] = std::min(nuevo.lsn, retenido - 1);
+    }
+    pthread_mutex_unlock(&mutex);
+    return ok;
+}
+
+// Escribe el encabezado con el LSN base actual. Debe llamarse sin registros en el archivo.
+bool Wal::escribirEncabezado() {
+    char encabezado[TAM_ENCABEZADO];
+    memcpy(encabezado, FIRMA_WAL, sizeof(FIRMA_WAL));
+    memcpy(encabezado + sizeof(FIRMA_WAL), &lsnBase, sizeof(lsnBase));
+    if (pwrite(fd, encabezado, sizeof(encabezado), 0) != static_cast<ssize_t>(sizeof(encabezado)) ||
+        lseek(fd, TAM_ENCABEZADO, SEEK_SET) < 0 || fdatasync(fd) < 0) {
+        std::cerr << "Error: No se pudo escribir el encabezado del WAL: " << ruta << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Guarda los puntos de control en un archivo temporal y lo reemplaza con rename(). Requiere el mutex.
+// El texto se arma en un búfer que se reutiliza entre llamadas, sin reservar memoria en cada vaciado.
+bool Wal::guardarPuntos() {
+    textoPuntos.clear();
+    char campo[96];
+    for (const auto& p : puntos) {
+        int largo = snprintf(campo, sizeof(campo), "P %d %llu %llu ", static_cast<int>(p.second.canal),
+                             static_cast<unsigned long long>(p.second.punto.lsn),
+                             static_cast<unsigned long long>(p.second.punto.offset));
+        textoPuntos.append(campo, largo);
+        textoPuntos.append(p.first);
+        textoPuntos.push_back('\n');
+    }
+    for (int c = 0; c < NUM_CANALES; ++c) {
+        if (cortes[c].existe) {
+            int largo = snprintf(campo, sizeof(campo), "C %d %llu %lld\n", c,
+                                 static_cast<unsigned long long>(cortes[c].lsn),
+                                 static_cast<long long>(cortes[c].marca));
+            textoPuntos.append(campo, largo);
+        }
+    }
+
+    int fdPuntos = open(rutaTemporal.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fdPuntos < 0) {
+        std::cerr << "Error: No se pudo guardar el punto de control: " << rutaTemporal << std::endl;
+        return false;
+    }
+    bool ok = escribirTodo(fdPuntos, textoPuntos.data(), textoPuntos.size()) && fsync(fdPuntos) == 0;
+    close(fdPuntos);
+    if (!ok || rename(rutaTemporal.c_str(), rutaPuntos.c_str()) < 0) {
+        std::cerr << "Error: No se pudo guardar el punto de control: " << rutaPuntos << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Descarta los registros que ya están en los archivos de salida: vacía el WAL si lo están todos o, si no, recorta
+// los anteriores al primero que aún hace falta a algún canal, cuando son suficientes. `ultimo` es el último LSN
+// escrito en el archivo. La llama solo el hilo que escribe.
+void Wal::truncarSiAplicado(uint64_t ultimo) {
+    pthread_mutex_lock(&mutex);
+    uint64_t limite = ultimo;
+    for (int c = 0; c < NUM_CANALES; ++c) {
+        if (cubierto[c] < confirmado[c]) {
+            limite = std::min(limite, cubierto[c]);
+        }
+    }
+    off_t tamano = lseek(fd, 0, SEEK_END);
+    uint64_t registros = tamano > static_cast<off_t>(TAM_ENCABEZADO) ? (tamano - TAM_ENCABEZADO) / sizeof(RegistroDisco) : 0;
+    uint64_t descartables = limite > lsnBase ? limite - lsnBase : 0;
+    if (registros > 0 && limite == ultimo) {
+        if (ftruncate(fd, TAM_ENCABEZADO) == 0) {
+            lsnBase = ultimo;
+            escribirEncabezado();
+        }
+    } else if (descartables >= MIN_RECORTE_WAL && descartables * 2 >= registros) {
+        recortar(limite);
+    }
+    lseek(fd, 0, SEEK_END);
+    pthread_mutex_unlock(&mutex);
+}
+
+// Copia los registros posteriores a `limite` a un archivo nuevo con ese LSN base y lo pone en lugar del WAL con
+// rename(). Si algo falla, el WAL queda como estaba. Requiere el mutex.
+bool Wal::recortar(uint64_t limite) {
+    std::string rutaNueva = ruta + ".tmp";
+    int nuevo = open(rutaNueva.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (nuevo < 0) {
+        std::cerr << "Error: No se pudo recortar el WAL: " << rutaNueva << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+    char encabezado[TAM_ENCABEZADO];
+    memcpy(encabezado, FIRMA_WAL, sizeof(FIRMA_WAL));
+    memcpy(encabezado + sizeof(FIRMA_WAL), &limite, sizeof(limite));
+    bool ok = escribirTodo(nuevo, encabezado, sizeof(encabezado));
+    char bloque[64 * sizeof(RegistroDisco)];
+    off_t posicion = TAM_ENCABEZADO + (limite - lsnBase) * sizeof(RegistroDisco);
+    ssize_t leidos = 0;
+    while (ok && (leidos = pread(fd, bloque, sizeof(bloque), posicion)) > 0) {
+        ok = escribirTodo(nuevo, bloque, leidos);
+        posicion += leidos;
+    }
+    ok = ok && leidos == 0 && fdatasync(nuevo) == 0 && rename(rutaNueva.c_str(), ruta.c_str()) == 0;
+    if (!ok) {
+        std::cerr << "Error: No se pudo recortar el WAL: " << ruta << ": " << strerror(errno) << std::endl;
+        close(nuevo);
+        unlink(rutaNueva.c_str());
+        return false;
+    }
+    close(fd);
+    fd = nuevo;
+    lsnBase = limite;
+    return true;
+}
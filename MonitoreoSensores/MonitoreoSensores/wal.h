@@ -0,0 +1,113 @@
+/**
+ * @file wal.h
+ * @autores Juan Pablo Hernández Ceballos
+ * Registro de escritura anticipada (WAL) del monitor.
+ *
+ * Los hilos recolectores escriben cada medición en el WAL antes de entregarla a los buffers; los lotes
+ * que varios recolectores agregan a la vez se hacen durables con una sola escritura (el primero que
+ * confirma escribe los de todos y los demás esperan su resultado). Los hilos
+ * consumidores registran hasta qué registro llegaron en cada archivo de salida (punto de control), de
+ * modo que al reiniciar tras una caída se pueden reenviar exactamente una vez las mediciones que no
+ * alcanzaron a escribirse. Cada canal registra además su corte (ver Corte), con el que el WAL descarta
+ * los registros que ya no hacen falta aunque el canal retenga otros para reordenarlos.
+ */
+
+#ifndef WAL_H
+#define WAL_H
+
+#include <cstdint>
+#include <map>
+#include <pthread.h>
+#include <string>
+#include <utility>
+#include <vector>
+#include "lectura.h"
+
+class Wal {
+public:
+    /**
+     * Registro válido leído del WAL al abrirlo.
+     */
+    struct Registro {
+        uint64_t lsn;          ///< Número de secuencia global del registro
+        int64_t recepcion;     ///< Hora de recepción (segundos desde el epoch)
+        int64_t evento;        ///< Hora de la medición en la fuente (ms desde el epoch)
+        uint32_t sensor;       ///< Identificador del sensor
+        uint32_t secuencia;    ///< Número de secuencia que envió el sensor (0 si no la envía)
+        Canal canal;           ///< Canal al que pertenece la medición
+        std::string valor;     ///< Texto de la medición
+    };
+
+    /**
+     * Punto de control de un archivo de salida: último registro aplicado y tamaño del archivo en ese momento.
+     */
+    struct PuntoControl {
+        uint64_t lsn = 0;      ///< Último LSN escrito en el archivo
+        uint64_t offset = 0;   ///< Tamaño del archivo tras escribir ese registro
+        bool existe = false;   ///< false si el archivo nunca ha sido registrado
+    };
+
+    /**
+     * Corte de un canal: toda medición del canal con LSN hasta `lsn` y hora de orden hasta `marca` ya está
+     * en algún archivo de salida, cubierta por su punto de control. Las demás (las posteriores y las que el
+     * reordenamiento retenía) se reenvían al recuperar.
+     */
+    struct Corte {
+        uint64_t lsn = 0;            ///< Mayor LSN recibido por el hilo de persistencia
+        int64_t marca = INT64_MAX;   ///< Marca de agua del reordenamiento (INT64_MAX sin reordenar)
+        bool existe = false;         ///< false si el canal nunca registró un corte
+    };
+
+    explicit Wal(const std::string& ruta);
+    ~Wal();
+
+    bool abrir();
+    const std::vector<Registro>& registros() const;
+
+    uint64_t agregar(std::vector<std::pair<Canal, Lectura>>& lote);
+    bool confirmar(uint64_t hasta);
+    uint64_t ultimoAgregado();
+
+    PuntoControl puntoControl(const std::string& sumidero);
+    bool registrarPunto(Canal canal, const std::string& sumidero, uint64_t lsn, uint64_t offset);
+    Corte corte(Canal canal);
+    bool registrarCorte(Canal canal, const std::vector<std::pair<std::string, uint64_t>>& archivos,
+                        const Corte& nuevo, uint64_t retenido);
+
+private:
+    struct Punto {
+        Canal canal;
+        PuntoControl punto;
+    };
+
+    bool escribirEncabezado();
+    bool escribirLote(uint64_t ultimo);
+    bool guardarPuntos();
+    void truncarSiAplicado(uint64_t ultimo);
+    bool recortar(uint64_t limite);
+
+    std::string ruta;                           ///< Ruta del archivo del WAL
+    std::string rutaPuntos;                     ///< Ruta del archivo con los puntos de control
+    std::string rutaTemporal;                   ///< Archivo donde se escriben los puntos antes del rename()
+    int fd;                                     ///< Descriptor del archivo del WAL (solo lo usa quien escribe)
+    uint64_t lsnBase;                           ///< LSN anterior al primer registro del archivo
+    std::vector<Registro> recuperados;          ///< Registros encontrados al abrir
+    std::vector<char> loteEscritura;            ///< Registros que se están escribiendo (solo lo usa quien escribe)
+
+    pthread_mutex_t mutexLote;                  ///< Protege los campos siguientes, hasta condLote
+    uint64_t siguienteLsn;                      ///< LSN que recibirá el próximo registro
+    uint64_t durable;                           ///< Último LSN escrito y sincronizado en el archivo
+    std::vector<char> lotePendiente;            ///< Registros agregados que aún no se escriben
+    bool escribiendo;                           ///< Un hilo está escribiendo un lote
+    uint64_t rondasFallidas;                    ///< Escrituras de lotes que fallaron
+    pthread_cond_t condLote;                    ///< Avisa el fin de cada escritura de lote
+
+    pthread_mutex_t mutex;                      ///< Protege los campos siguientes
+    uint64_t confirmado[NUM_CANALES];           ///< Último LSN durable de cada canal
+    uint64_t cubierto[NUM_CANALES];             ///< LSN de cada canal hasta el que el WAL ya no hace falta
+    Corte cortes[NUM_CANALES];                  ///< Último corte registrado de cada canal
+    std::map<std::string, Punto> puntos;        ///< Puntos de control por archivo de salida
+    std::string textoPuntos;                    ///< Búfer reutilizado para el texto de los puntos de control
+};
+
+#endif //WAL_H